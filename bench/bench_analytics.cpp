@@ -0,0 +1,245 @@
+// Book analytics benchmark: the cost of keeping top-N features (microprice, imbalance, depth, VWAP) current after every
+// event of a replay.
+// Usage: bench_analytics [--events N] [--levels N] [--lobster file.csv [--tick N]] [--seed S]
+//
+// The same events run through a fresh ladder book once per mode; after each event the mode brings the features up to
+// date:
+//  - book alone:      nothing, the baseline
+//  - depth poll:      GetDepth(N) into a reused OrderBookLevelInfos, features computed from its LevelInfos, as a
+//                     strategy outside the book does it
+//  - analytics full:  BookAnalytics re-reading both sides every event (Invalidate before each Update)
+//  - analytics:       BookAnalytics re-reading only the sides whose top N changed
+//  - + columns:       the same, with every row appended to FeatureColumns
+// The events are synthetic order flow (order_flow.h) or, with --lobster, a LOBSTER message file replayed through
+// LobsterReplay; either way they are loaded before timing. Every pass runs three times and the fastest is reported.
+
+#include "../book_analytics.h"
+#include "../lobster_replay.h"
+#include "order_flow.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+
+namespace {
+
+constexpr std::size_t kRepeats = 3;
+
+struct Feed{
+ std::vector<FlowEvent> flow;        // Synthetic, or
+ std::vector<LobsterEvent> lobster;  // a LOBSTER file
+ LevelConfig levels;
+ std::size_t Events() const { return lobster.empty() ? flow.size() : lobster.size(); }
+};
+
+void Apply(LadderOrderBook& book, const FlowEvent& event){
+ switch (event.op){
+ case FlowOp::Add:
+  book.ProcessNewOrder(Order(event.order_id, event.side, event.price, event.quantity, OrderType::Goodtillcancel));
+  break;
+ case FlowOp::Sweep:
+  book.ProcessNewOrder(Order(event.order_id, event.side, event.price, event.quantity, OrderType::Fillandkill));
+  break;
+ case FlowOp::Cancel:
+  book.TryCancelOrder(event.order_id);
+  break;
+ case FlowOp::Modify:
+  book.Modify(ModifyOrder(event.order_id, event.side, event.price, event.quantity));
+  break;
+ }
+}
+
+// What each mode does after an event; Checksum keeps the work observable
+struct NoFeatures{
+ NoFeatures(LadderOrderBook&, std::size_t) { }
+ void After(std::uint64_t) { }
+ double Checksum() const { return 0; }
+};
+
+class DepthPoll{
+ public:
+  DepthPoll(LadderOrderBook& book, std::size_t levels): book_ {book}, levels_ {levels} { }
+
+  void After(std::uint64_t){
+   book_.GetDepth(levels_, depth_);
+   double bid_depth = 0;
+   double bid_notional = 0;
+   for (const LevelInfo& level : depth_.getBids()){
+    bid_depth += level.quantity;
+    bid_notional += static_cast<double>(level.price) * level.quantity;
+   }
+   double ask_depth = 0;
+   double ask_notional = 0;
+   for (const LevelInfo& level : depth_.getAsks()){
+    ask_depth += level.quantity;
+    ask_notional += static_cast<double>(level.price) * level.quantity;
+   }
+   features_.bid_depth = bid_depth;
+   features_.ask_depth = ask_depth;
+   features_.bid_vwap = bid_depth == 0 ? NAN : bid_notional / bid_depth;
+   features_.ask_vwap = ask_depth == 0 ? NAN : ask_notional / ask_depth;
+   features_.imbalance = bid_depth + ask_depth == 0 ? 0.0 : (bid_depth - ask_depth) / (bid_depth + ask_depth);
+   if (depth_.getBids().empty() || depth_.getAsks().empty()){
+    features_.microprice = NAN;
+   }
+   else {
+    const LevelInfo& bid = depth_.getBids().front();
+    const LevelInfo& ask = depth_.getAsks().front();
+    features_.microprice = (static_cast<double>(bid.price) * ask.quantity + static_cast<double>(ask.price) * bid.quantity)
+     / (static_cast<double>(bid.quantity) + ask.quantity);
+   }
+   checksum_ += features_.imbalance;
+  }
+
+  double Checksum() const { return checksum_; }
+
+ private:
+  LadderOrderBook& book_;
+  std::size_t levels_;
+  OrderBookLevelInfos depth_;
+  BookFeatures features_;
+  double checksum_{0};
+};
+
+template <bool Full, bool Columns>
+class Analytics{
+ public:
+  Analytics(LadderOrderBook& book, std::size_t levels): analytics_ {book, levels} {
+   if (Columns){
+    columns_.Reserve(1 << 21);
+   }
+  }
+
+  void After(std::uint64_t timestamp_ns){
+   if (Full){
+    analytics_.Invalidate();
+   }
+   analytics_.Update();
+   checksum_ += analytics_.Features().imbalance;
+   if (Columns){
+    columns_.Append(timestamp_ns, analytics_.Features());
+   }
+  }
+
+  double Checksum() const { return checksum_; }
+  const BookAnalytics<LadderOrderBook>& Get() const { return analytics_; }
+
+ private:
+  BookAnalytics<LadderOrderBook> analytics_;
+  FeatureColumns columns_;
+  double checksum_{0};
+};
+
+struct PassResult{
+ double seconds{0};
+ double checksum{0};
+ std::uint64_t reads{0};
+};
+
+template <typename Mode>
+PassResult Pass(const Feed& feed, std::size_t levels){
+ PassResult best;
+ for (std::size_t repeat = 0; repeat < kRepeats; ++repeat){
+  auto book = std::make_unique<LadderOrderBook>(feed.levels, feed.Events());
+  auto mode = std::make_unique<Mode>(*book, levels);
+  LobsterReplay<LadderOrderBook> replay(*book);
+  auto start = std::chrono::steady_clock::now();
+  if (feed.lobster.empty()){
+   for (const FlowEvent& event : feed.flow){
+    Apply(*book, event);
+    mode->After(event.timestamp_ns);
+   }
+  }
+  else {
+   for (const LobsterEvent& event : feed.lobster){
+    replay.Apply(event);
+    mode->After(event.timestamp_ns);
+   }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (repeat == 0 || seconds < best.seconds){
+   best.seconds = seconds;
+   best.checksum = mode->Checksum();
+   if constexpr (!std::is_same_v<Mode, NoFeatures> && !std::is_same_v<Mode, DepthPoll>){
+    best.reads = mode->Get().Reads();
+   }
+  }
+ }
+ return best;
+}
+
+template <typename Mode>
+void Run(const char* name, const Feed& feed, std::size_t levels, double baseline){
+ PassResult result = Pass<Mode>(feed, levels);
+ double events = static_cast<double>(feed.Events());
+ std::printf("%-16s %12.1f %12.1f %12.2f %16.3f\n", name, result.seconds / events * 1e9, (result.seconds - baseline) / events * 1e9,
+  static_cast<double>(result.reads) / events, result.checksum);
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ FlowConfig flow_config;
+ std::size_t levels = 10;
+ const char* lobster = nullptr;
+ Price tick = 100;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--events") == 0 && has_value){
+   flow_config.events = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--levels") == 0 && has_value){
+   levels = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--lobster") == 0 && has_value){
+   lobster = argv[++i];
+  }
+  else if (std::strcmp(argv[i], "--tick") == 0 && has_value){
+   tick = static_cast<Price>(std::atoi(argv[++i]));
+  }
+  else if (std::strcmp(argv[i], "--seed") == 0 && has_value){
+   flow_config.seed = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--events N] [--levels N] [--lobster file.csv [--tick N]] [--seed S]\n", argv[0]);
+   return 2;
+  }
+ }
+
+ try {
+  Feed feed;
+  if (lobster != nullptr){
+   LobsterMessageReader reader(lobster);
+   LobsterEvent event{};
+   while (reader.Next(event)){
+    feed.lobster.push_back(event);
+   }
+   feed.levels = LevelConfig{tick, 4096};
+  }
+  else {
+   feed.flow = GenerateOrderFlow(flow_config);
+   feed.levels = LevelConfig{flow_config.tick, 4096};
+  }
+  double baseline = Pass<NoFeatures>(feed, levels).seconds;
+  std::printf("%zu events (%s), top %zu levels\n\n", feed.Events(), lobster != nullptr ? lobster : "synthetic flow", levels);
+  std::printf("%-16s %12s %12s %12s %16s\n", "mode", "ns/event", "over book", "reads/event", "imbalance sum");
+  std::printf("%-16s %12.1f %12.1f %12s %16s\n", "book alone", baseline / static_cast<double>(feed.Events()) * 1e9, 0.0, "-", "-");
+  Run<DepthPoll>("depth poll", feed, levels, baseline);
+  Run<Analytics<true, false>>("analytics full", feed, levels, baseline);
+  Run<Analytics<false, false>>("analytics", feed, levels, baseline);
+  Run<Analytics<false, true>>("+ columns", feed, levels, baseline);
+  return 0;
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "bench_analytics: %s\n", e.what());
+  return 1;
+ }
+}
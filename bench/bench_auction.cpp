@@ -0,0 +1,124 @@
+// Auction benchmark: an opening-auction order batch applied one order at a time (ProcessNewOrder, continuous matching)
+// versus all at once (ProcessBatch, one uncross at the clearing price).
+// Usage: bench_auction [--orders N] [--spread TICKS] [--rounds R] [--seed S]
+//
+// Orders are limit orders with prices uniform in mid +/- spread on both sides, so the collected book is heavily crossed,
+// as it is at an open. Each round starts from a fresh book; the reported time is the best round, per order.
+
+#include "../ordersApi.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+struct CountingSink : BookEventSink{
+ std::uint64_t fills{0};
+ std::uint64_t volume{0};
+ void OnFill(const FillEvent& fill){
+  ++fills;
+  volume += fill.quantity;
+ }
+};
+
+std::vector<Order> AuctionOrders(std::size_t count, Price spread, std::uint64_t seed){
+ std::mt19937_64 rng(seed);
+ std::uniform_int_distribution<Price> price(10000 - spread, 10000 + spread);
+ std::uniform_int_distribution<Quantity> quantity(1, 500);
+ std::vector<Order> orders;
+ orders.reserve(count);
+ for (std::size_t i = 0; i < count; ++i){
+  orders.emplace_back(static_cast<OrderId>(i + 1), rng() & 1 ? OrderSide::Buy : OrderSide::Sell, price(rng), quantity(rng), OrderType::Goodtillcancel);
+ }
+ return orders;
+}
+
+struct Result{
+ double ns_per_order{0};
+ std::uint64_t fills{0};
+ std::uint64_t volume{0};
+ std::size_t resting{0};
+};
+
+template <typename Book, typename Apply>
+Result Run(const std::vector<Order>& orders, std::size_t rounds, Apply apply){
+ Result result;
+ double best = 0;
+ for (std::size_t round = 0; round < rounds; ++round){
+  Book book(LevelConfig{1, 4096}, orders.size());
+  CountingSink sink;
+  auto start = std::chrono::steady_clock::now();
+  apply(book, sink);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (round == 0 || seconds < best){
+   best = seconds;
+  }
+  result.fills = sink.fills;
+  result.volume = sink.volume;
+  result.resting = book.Size();
+ }
+ result.ns_per_order = best * 1e9 / static_cast<double>(orders.size());
+ return result;
+}
+
+template <typename Book>
+void Compare(const char* name, const std::vector<Order>& orders, std::size_t rounds){
+ Result sequential = Run<Book>(orders, rounds, [&orders](Book& book, CountingSink& sink){
+  for (const Order& order : orders){
+   book.ProcessNewOrder(order, sink);
+  }
+ });
+ Result batch = Run<Book>(orders, rounds, [&orders](Book& book, CountingSink& sink){
+  book.ProcessBatch(orders, sink);
+ });
+ std::printf("%-7s %-11s %10.1f %10llu %12llu %10zu\n", name, "sequential", sequential.ns_per_order,
+  static_cast<unsigned long long>(sequential.fills), static_cast<unsigned long long>(sequential.volume), sequential.resting);
+ std::printf("%-7s %-11s %10.1f %10llu %12llu %10zu   %.2fx\n", name, "batch", batch.ns_per_order,
+  static_cast<unsigned long long>(batch.fills), static_cast<unsigned long long>(batch.volume), batch.resting,
+  sequential.ns_per_order / batch.ns_per_order);
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ std::size_t count = 200000;
+ Price spread = 50;
+ std::size_t rounds = 5;
+ std::uint64_t seed = 42;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--orders") == 0 && has_value){
+   count = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--spread") == 0 && has_value){
+   spread = static_cast<Price>(std::strtol(argv[++i], nullptr, 10));
+  }
+  else if (std::strcmp(argv[i], "--rounds") == 0 && has_value){
+   rounds = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--seed") == 0 && has_value){
+   seed = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--orders N] [--spread TICKS] [--rounds R] [--seed S]\n", argv[0]);
+   return 2;
+  }
+ }
+ if (count == 0 || rounds == 0 || spread <= 0){
+  std::fprintf(stderr, "bench_auction: --orders, --rounds and --spread must be positive\n");
+  return 2;
+ }
+
+ std::vector<Order> orders = AuctionOrders(count, spread, seed);
+ std::printf("%zu orders, prices 10000 +/- %d, best of %zu rounds\n", count, static_cast<int>(spread), rounds);
+ std::printf("%-7s %-11s %10s %10s %12s %10s\n", "backend", "mode", "ns/order", "fills", "volume", "resting");
+ Compare<OrderBook>("map", orders, rounds);
+ Compare<LadderOrderBook>("ladder", orders, rounds);
+ return 0;
+}
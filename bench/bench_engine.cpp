@@ -0,0 +1,194 @@
+// Matching engine scaling benchmark: the same many-instrument command stream run with 1..N shard threads.
+// Usage: bench_engine [--symbols K] [--events N] [--threads T] [--lobster file.csv] [--no-pin]
+//
+// The stream is built once. By default every instrument gets its own synthetic flow (order_flow.h, a different seed per
+// instrument). With --lobster, every instrument replays the same LOBSTER message file instead. Instruments are
+// interleaved round-robin, as a feed handler sees them. The main thread feeds commands and drains fills and acks.
+// Each thread count starts from fresh books. Reported rate is commands per second from the first submit until every
+// command has been applied; speedup is relative to one shard.
+
+#include "../matching_engine.h"
+#include "../lobster_parser.h"
+#include "order_flow.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+EngineCommand FromFlow(InstrumentId instrument, const FlowEvent& event){
+ EngineCommand command{event.order_id, instrument, event.price, event.quantity, EngineCommandType::NewOrder, event.side, OrderType::Goodtillcancel};
+ if (event.op == FlowOp::Cancel){
+  command.type = EngineCommandType::Cancel;
+ }
+ else if (event.op == FlowOp::Sweep){
+  command.order_type = OrderType::Fillandkill;
+ }
+ else if (event.op == FlowOp::Modify){
+  command.type = EngineCommandType::Modify;
+ }
+ return command;
+}
+
+// LOBSTER rows that change the book; hidden executions, crosses and halts are skipped
+bool FromLobster(InstrumentId instrument, const LobsterEvent& event, EngineCommand& command){
+ command = EngineCommand{event.order_id, instrument, event.price, event.size, EngineCommandType::NewOrder, event.side, OrderType::Goodtillcancel};
+ switch (event.type){
+ case LobsterEventType::NewOrder:
+  return true;
+ case LobsterEventType::PartialCancel:
+  command.type = EngineCommandType::Reduce;
+  return true;
+ case LobsterEventType::FullCancel:
+  command.type = EngineCommandType::Cancel;
+  return true;
+ case LobsterEventType::VisibleExecution:
+  command.type = EngineCommandType::Execute;
+  return true;
+ default:
+  return false;
+ }
+}
+
+std::vector<EngineCommand> SyntheticStream(std::size_t symbols, std::size_t events){
+ std::vector<std::vector<FlowEvent>> flows(symbols);
+ for (std::size_t s = 0; s < symbols; ++s){
+  FlowConfig config;
+  config.events = events / symbols;
+  config.seed = 42 + s;
+  flows[s] = GenerateOrderFlow(config);
+ }
+ std::vector<EngineCommand> stream;
+ stream.reserve(events);
+ for (std::size_t i = 0; i < events / symbols; ++i){
+  for (std::size_t s = 0; s < symbols; ++s){
+   stream.push_back(FromFlow(static_cast<InstrumentId>(s), flows[s][i]));
+  }
+ }
+ return stream;
+}
+
+std::vector<EngineCommand> LobsterStream(const char* path, std::size_t symbols, std::size_t events){
+ std::vector<LobsterEvent> rows;
+ LobsterMessageReader reader(path);
+ LobsterEvent row{};
+ while (rows.size() < events / symbols && reader.Next(row)){
+  rows.push_back(row);
+ }
+ std::vector<EngineCommand> stream;
+ stream.reserve(rows.size() * symbols);
+ EngineCommand command{};
+ for (const LobsterEvent& event : rows){
+  for (std::size_t s = 0; s < symbols; ++s){
+   if (FromLobster(static_cast<InstrumentId>(s), event, command)){
+    stream.push_back(command);
+   }
+  }
+ }
+ return stream;
+}
+
+struct RunResult{
+ double seconds{0};
+ std::uint64_t events_out{0};
+ std::uint64_t fills{0};
+ std::uint64_t unknown_orders{0};
+ std::uint64_t output_stalls{0};
+};
+
+RunResult Run(const std::vector<EngineCommand>& stream, std::size_t symbols, std::size_t threads, const EngineConfig& base){
+ EngineConfig config = base;
+ config.shards = threads;
+ config.first_core = 1; // Leave core 0 to the feeding thread where there are enough cores
+ MatchingEngine<> engine(config);
+ for (std::size_t s = 0; s < symbols; ++s){
+  engine.AddInstrument(static_cast<InstrumentId>(s));
+ }
+ engine.Start();
+
+ RunResult result;
+ auto on_event = [&result](const EngineEvent& e){
+  ++result.events_out;
+  result.fills += e.event.type == BookEventType::Fill;
+ };
+ auto start = std::chrono::steady_clock::now();
+ for (const EngineCommand& command : stream){
+  engine.Submit(command, on_event);
+ }
+ engine.Flush(on_event);
+ result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+ engine.Stop();
+ for (std::size_t shard = 0; shard < engine.ShardCount(); ++shard){
+  result.unknown_orders += engine.Stats(shard).unknown_orders;
+  result.output_stalls += engine.Stats(shard).output_stalls;
+ }
+ return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ std::size_t symbols = 1000;
+ std::size_t events = 4000000;
+ std::size_t max_threads = std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 1;
+ const char* lobster = nullptr;
+ EngineConfig config;
+ config.levels = LevelConfig{1, 1024};
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--symbols") == 0 && has_value){
+   symbols = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--events") == 0 && has_value){
+   events = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--threads") == 0 && has_value){
+   max_threads = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--lobster") == 0 && has_value){
+   lobster = argv[++i];
+   config.levels = LevelConfig{100, 4096};
+  }
+  else if (std::strcmp(argv[i], "--no-pin") == 0){
+   config.pin_threads = false;
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--symbols K] [--events N] [--threads T] [--lobster file.csv] [--no-pin]\n", argv[0]);
+   return 2;
+  }
+ }
+ if (symbols == 0 || max_threads == 0){
+  std::fprintf(stderr, "bench_engine: --symbols and --threads must be positive\n");
+  return 2;
+ }
+
+ try {
+  std::vector<EngineCommand> stream = lobster != nullptr ? LobsterStream(lobster, symbols, events) : SyntheticStream(symbols, events);
+  std::printf("%zu commands over %zu instruments (%s), %u hardware threads\n", stream.size(), symbols,
+   lobster != nullptr ? lobster : "synthetic flow", std::thread::hardware_concurrency());
+  std::printf("%8s %12s %10s %12s %12s %10s\n", "threads", "M cmds/s", "speedup", "events out", "fills", "stalls");
+  double baseline = 0;
+  for (std::size_t threads = 1; threads <= max_threads; ++threads){
+   RunResult result = Run(stream, symbols, threads, config);
+   double rate = static_cast<double>(stream.size()) / result.seconds;
+   if (threads == 1){
+    baseline = rate;
+   }
+   std::printf("%8zu %12.2f %9.2fx %12llu %12llu %10llu\n", threads, rate / 1e6, rate / baseline,
+    static_cast<unsigned long long>(result.events_out), static_cast<unsigned long long>(result.fills),
+    static_cast<unsigned long long>(result.output_stalls));
+  }
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "bench_engine: %s\n", e.what());
+  return 1;
+ }
+ return 0;
+}
@@ -0,0 +1,185 @@
+// Order expiry benchmark: the cost of timed orders on a ladder book, and of expiring them on the timing wheel.
+// Usage: bench_expiry [--orders N] [--seed S]
+//
+// Times are nanoseconds after midnight, as in LOBSTER: the session opens at 9:30 and closes at 16:00. N passive orders
+// (both sides, never crossing) are added after the open, then removed in one of four ways:
+//  - cancel:      good-till-cancel orders, each cancelled with TryCancelOrder at the close (the floor for any removal)
+//  - scan:        good-till-cancel orders, expired at the close the way a book without timers would: walk every
+//                 order with ForEachOrder to collect the due ones (all of them), then cancel each
+//  - day close:   day orders, all expired by one AdvanceTime(close)
+//  - gtd spread:  good-till-date orders with expiries spread uniformly over the session, expired by advancing the
+//                 clock in 100 ms steps; reports the slowest single step
+// Every pass runs three times on a fresh book and the fastest is reported.
+
+#include "../ordersApi.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+constexpr Timestamp kOpen = 34200ULL * 1000000000ULL;    // 9:30
+constexpr Timestamp kClose = 57600ULL * 1000000000ULL;   // 16:00
+constexpr Timestamp kStep = 100ULL * 1000000ULL;         // Clock step of the spread pass: 100 ms
+constexpr std::size_t kRepeats = 3;
+
+struct Resting{
+ OrderSide side;
+ Price price;
+ Timestamp expiry;
+};
+
+struct PassResult{
+ double add_seconds{0};
+ double remove_seconds{0};
+ std::size_t removed{0};
+ double worst_step_seconds{0};
+};
+
+using Clock = std::chrono::steady_clock;
+
+double Seconds(Clock::time_point start){ return std::chrono::duration<double>(Clock::now() - start).count(); }
+
+std::vector<Resting> MakeOrders(std::size_t count, std::uint64_t seed){
+ std::mt19937_64 rng(seed);
+ std::uniform_int_distribution<Price> offset(0, 999);
+ std::uniform_int_distribution<Timestamp> expiry(kOpen + 1, kClose);
+ std::vector<Resting> orders(count);
+ for (Resting& order : orders){
+  order.side = rng() & 1 ? OrderSide::Buy : OrderSide::Sell;
+  order.price = order.side == OrderSide::Buy ? 10000 - offset(rng) : 10001 + offset(rng);
+  order.expiry = expiry(rng);
+ }
+ return orders;
+}
+
+std::unique_ptr<LadderOrderBook> NewBook(std::size_t count){
+ auto book = std::make_unique<LadderOrderBook>(LevelConfig{1, 4096}, count);
+ book->SetSessionClose(kClose);
+ book->AdvanceTime(kOpen);
+ return book;
+}
+
+double Add(LadderOrderBook& book, const std::vector<Resting>& orders, OrderType type){
+ BookEventSink sink;
+ auto start = Clock::now();
+ for (std::size_t i = 0; i < orders.size(); ++i){
+  const Resting& order = orders[i];
+  book.ProcessNewOrder(Order(i + 1, order.side, order.price, 100, type), order.expiry, sink);
+ }
+ return Seconds(start);
+}
+
+PassResult Cancel(const std::vector<Resting>& orders){
+ PassResult result;
+ auto book = NewBook(orders.size());
+ result.add_seconds = Add(*book, orders, OrderType::Goodtillcancel);
+ auto start = Clock::now();
+ for (std::size_t i = 0; i < orders.size(); ++i){
+  result.removed += book->TryCancelOrder(i + 1);
+ }
+ result.remove_seconds = Seconds(start);
+ return result;
+}
+
+PassResult Scan(const std::vector<Resting>& orders){
+ PassResult result;
+ auto book = NewBook(orders.size());
+ result.add_seconds = Add(*book, orders, OrderType::Goodtillcancel);
+ auto start = Clock::now();
+ std::vector<OrderId> due;   // Collected first: cancelling while walking the levels would invalidate the walk
+ due.reserve(orders.size());
+ for (OrderSide side : {OrderSide::Buy, OrderSide::Sell}){
+  book->ForEachOrder(side, [&](const PriceLevel&, const Order& order){ due.push_back(order.GetOrderId()); });
+ }
+ for (OrderId id : due){
+  result.removed += book->TryCancelOrder(id);
+ }
+ result.remove_seconds = Seconds(start);
+ return result;
+}
+
+PassResult DayClose(const std::vector<Resting>& orders){
+ PassResult result;
+ auto book = NewBook(orders.size());
+ result.add_seconds = Add(*book, orders, OrderType::Day);
+ auto start = Clock::now();
+ result.removed = book->AdvanceTime(kClose);
+ result.remove_seconds = Seconds(start);
+ return result;
+}
+
+PassResult GtdSpread(const std::vector<Resting>& orders){
+ PassResult result;
+ auto book = NewBook(orders.size());
+ result.add_seconds = Add(*book, orders, OrderType::Goodtilldate);
+ auto start = Clock::now();
+ for (Timestamp now = kOpen + kStep; now < kClose + kStep; now += kStep){
+  auto step_start = Clock::now();
+  result.removed += book->AdvanceTime(now);
+  result.worst_step_seconds = std::max(result.worst_step_seconds, Seconds(step_start));
+ }
+ result.remove_seconds = Seconds(start);
+ return result;
+}
+
+void Run(const char* name, PassResult (*pass)(const std::vector<Resting>&), const std::vector<Resting>& orders){
+ PassResult best;
+ for (std::size_t repeat = 0; repeat < kRepeats; ++repeat){
+  PassResult result = pass(orders);
+  if (repeat == 0 || result.add_seconds + result.remove_seconds < best.add_seconds + best.remove_seconds){
+   best = result;
+  }
+ }
+ double count = static_cast<double>(orders.size());
+ std::printf("%-12s %12.1f %12zu %14.1f %14.2f", name, best.add_seconds / count * 1e9, best.removed,
+  best.removed == 0 ? 0.0 : best.remove_seconds / static_cast<double>(best.removed) * 1e9, best.remove_seconds * 1e3);
+ if (best.worst_step_seconds > 0){
+  std::printf(" %14.1f", best.worst_step_seconds * 1e6);
+ }
+ std::printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ std::size_t count = 2000000;
+ std::uint64_t seed = 1;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--orders") == 0 && has_value){
+   count = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--seed") == 0 && has_value){
+   seed = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--orders N] [--seed S]\n", argv[0]);
+   return 2;
+  }
+ }
+
+ try {
+  std::vector<Resting> orders = MakeOrders(count, seed);
+  std::printf("%zu resting orders, session 9:30-16:00, %llu ms clock steps for gtd spread\n\n", count,
+   static_cast<unsigned long long>(kStep / 1000000));
+  std::printf("%-12s %12s %12s %14s %14s %14s\n", "mode", "add ns/ord", "removed", "remove ns/ord", "remove ms", "worst step us");
+  Run("cancel", Cancel, orders);
+  Run("scan", Scan, orders);
+  Run("day close", DayClose, orders);
+  Run("gtd spread", GtdSpread, orders);
+  return 0;
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "bench_expiry: %s\n", e.what());
+  return 1;
+ }
+}
@@ -0,0 +1,229 @@
+// Order gateway round trip: tick-to-ack latency of a loopback client talking to a gateway process through shared memory.
+// Usage: bench_gateway [--requests N] [--window W] [--depth D] [--attach /shm_name]
+//
+// Without --attach the benchmark forks its own gateway process (ladder book, tick 1) and stops it at the end; with
+// --attach it connects to a running order_gateway instead. The client keeps up to W requests in flight (1 is strict
+// ping-pong; by default 1, 8 and 64 are run in turn). It adds passive buys and, once D of its orders rest, cancels the
+// oldest instead, so the book stays about D orders deep and nothing trades. Each request carries its TscClock send
+// time as its tag; the first response to it (accepted, cancelled or rejected) stops the clock. A tenth of the requests
+// are sent first as warm-up and not measured.
+// Both processes busy-poll. With fewer free cores than two, every round trip includes the scheduler handing the core
+// over (SpinBackoff yields after a few hundred spins), and the numbers measure that instead of the rings.
+
+#include "../gateway.h"
+#include "../tsc_clock.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+namespace {
+
+std::atomic<bool> stop_requested{false};
+
+void OnSignal(int){ stop_requested.store(true, std::memory_order_relaxed); }
+
+struct RunResult{
+ std::vector<std::uint64_t> ticks;   // Round trip of every measured request
+ std::uint64_t rejects{0};
+ double seconds{0};
+};
+
+// Send `requests` requests with at most `window` in flight; record round trips into result if given
+void Drive(GatewayClient& client, std::size_t requests, std::size_t window, std::size_t depth, std::deque<OrderId>& resting, RunResult* result){
+ std::size_t sent = 0;
+ std::size_t answered = 0;
+ SpinBackoff backoff;
+ GatewayResponse response{};
+ while (answered < requests){
+  bool progress = false;
+  while (client.TryReceive(response)){
+   progress = true;
+   if (response.type == GatewayResponseType::Fill || response.type == GatewayResponseType::Modified){
+    continue; // Not a first answer (no fills or modifies in this flow)
+   }
+   std::uint64_t now = TscClock::Now();
+   ++answered;
+   if (response.type == GatewayResponseType::Accepted){
+    resting.push_back(response.order_id);
+   }
+   if (result != nullptr){
+    result->ticks.push_back(now - response.client_tag);
+    result->rejects += response.type == GatewayResponseType::Rejected;
+   }
+  }
+  if (sent < requests && sent - answered < window){
+   GatewayRequest request{};
+   request.side = OrderSide::Buy;
+   request.order_type = OrderType::Goodtillcancel;
+   bool cancel = resting.size() >= depth;
+   if (cancel){
+    request.type = GatewayRequestType::Cancel;
+    request.order_id = resting.front();
+   }
+   else {
+    request.type = GatewayRequestType::NewOrder;
+    request.price = static_cast<Price>(1000 - sent % 64);
+    request.quantity = 100;
+   }
+   request.client_tag = TscClock::Now();
+   if (client.TrySend(request)){
+    progress = true;
+    ++sent;
+    if (cancel){
+     resting.pop_front();
+    }
+   }
+  }
+  if (progress){
+   backoff.Reset();
+  }
+  else {
+   backoff.Wait();
+  }
+ }
+}
+
+RunResult Run(GatewayClient& client, std::size_t requests, std::size_t window, std::size_t depth){
+ std::deque<OrderId> resting;
+ Drive(client, requests / 10, window, depth, resting, nullptr);
+ RunResult result;
+ result.ticks.reserve(requests);
+ auto start = std::chrono::steady_clock::now();
+ Drive(client, requests, window, depth, resting, &result);
+ result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+ std::size_t outstanding = 0;
+ while (!resting.empty() || outstanding != 0){ // Leave the book as it was found, and no answers behind for the next run
+  if (!resting.empty()){
+   GatewayRequest request{};
+   request.type = GatewayRequestType::Cancel;
+   request.order_id = resting.front();
+   if (client.TrySend(request)){
+    resting.pop_front();
+    ++outstanding;
+   }
+  }
+  GatewayResponse response{};
+  while (client.TryReceive(response)){
+   --outstanding;
+  }
+ }
+ return result;
+}
+
+void Print(std::size_t window, RunResult& result){
+ std::sort(result.ticks.begin(), result.ticks.end());
+ auto at = [&](double quantile){ return TscClock::ToNs(result.ticks[static_cast<std::size_t>(quantile * static_cast<double>(result.ticks.size() - 1))]); };
+ std::printf("%6zu %10zu %10.0f %10.0f %10.0f %10.0f %12.0f %8llu\n", window, result.ticks.size(), at(0.50), at(0.99), at(0.999),
+  TscClock::ToNs(result.ticks.back()), static_cast<double>(result.ticks.size()) / result.seconds, static_cast<unsigned long long>(result.rejects));
+}
+
+// Retry while the gateway process creates and initialises its segment
+std::unique_ptr<GatewayClient> Connect(const std::string& name){
+ for (int attempt = 0;; ++attempt){
+  try {
+   return std::make_unique<GatewayClient>(name);
+  }
+  catch (const std::runtime_error&){
+   if (attempt == 500){
+    throw;
+   }
+   std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+ }
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ std::size_t requests = 200000;
+ std::size_t depth = 64;
+ std::vector<std::size_t> windows{1, 8, 64};
+ std::string attach;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--requests") == 0 && has_value){
+   requests = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--window") == 0 && has_value){
+   windows = {std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10))};
+  }
+  else if (std::strcmp(argv[i], "--depth") == 0 && has_value){
+   depth = std::max<std::size_t>(1, std::strtoull(argv[++i], nullptr, 10));
+  }
+  else if (std::strcmp(argv[i], "--attach") == 0 && has_value){
+   attach = argv[++i];
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--requests N] [--window W] [--depth D] [--attach /shm_name]\n", argv[0]);
+   return 2;
+  }
+ }
+ if (requests == 0){
+  requests = 1;
+ }
+
+ std::string name = attach;
+ pid_t gateway = -1;
+ if (attach.empty()){
+  name = "/bench_gateway_" + std::to_string(::getpid());
+  gateway = ::fork();
+  if (gateway == 0){
+   std::signal(SIGTERM, OnSignal);
+   try {
+    GatewayConfig config;
+    config.name = name;
+    config.clients = 1;
+    config.levels = LevelConfig{1, 4096};
+    {
+     Gateway<LadderOrderBook> server(config);   // Unlinks the segment when it goes out of scope
+     server.Run(stop_requested);
+    }
+    std::_Exit(0);
+   }
+   catch (const std::exception& e){
+    std::fprintf(stderr, "bench_gateway: gateway process: %s\n", e.what());
+    std::_Exit(1);
+   }
+  }
+  if (gateway < 0){
+   std::fprintf(stderr, "bench_gateway: fork failed\n");
+   return 1;
+  }
+ }
+
+ int status = 0;
+ try {
+  std::unique_ptr<GatewayClient> client = Connect(name);
+  std::printf("gateway %s, %zu requests per window, book depth %zu, %u hardware threads\n\n", name.c_str(), requests, depth,
+   std::thread::hardware_concurrency());
+  std::printf("%6s %10s %10s %10s %10s %10s %12s %8s\n", "window", "requests", "p50 ns", "p99 ns", "p99.9 ns", "max ns", "requests/s", "rejects");
+  for (std::size_t window : windows){
+   RunResult result = Run(*client, requests, window, depth);
+   Print(window, result);
+  }
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "bench_gateway: %s\n", e.what());
+  status = 1;
+ }
+ if (gateway > 0){
+  ::kill(gateway, SIGTERM);
+  ::waitpid(gateway, nullptr, 0);
+ }
+ return status;
+}
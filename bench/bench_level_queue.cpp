@@ -0,0 +1,155 @@
+// Level queue benchmark: linked queues (LadderOrderBook) against ring-buffer queues (RingOrderBook) under cancel-heavy
+// churn, at a given number of orders per level.
+// Usage: bench_level_queue [--depth N] [--levels N] [--seed S]
+//
+// One side of the book holds depth x levels resting orders, spread uniformly over the levels. Each pass, per backend:
+//  - add:     fill the book
+//  - churn:   4 x as many cancel-and-replace steps, each cancelling a random live order (from the middle of its queue)
+//             and adding a new one at a random level. The pool hands the freed slots back out of order, so afterwards
+//             neighbours in a queue are far apart in memory, as they are in a book that has been trading all day
+//  - walk:    ForEachOrder over the side, four times (per order visited)
+//  - cancel:  cancel half of the live orders at random
+//  - sweep:   one market order taking everything left
+// Without --depth, runs depths 16, 256 and 4096. Every pass runs three times on a fresh book and the fastest is reported.
+
+#include "../ordersApi.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+constexpr std::size_t kRepeats = 3;
+constexpr std::size_t kChurnFactor = 4;
+constexpr std::size_t kWalks = 4;
+constexpr Price kBasePrice = 10000;
+
+struct PassResult{
+ double add_ns{0};
+ double churn_ns{0};
+ double walk_ns{0};
+ double cancel_ns{0};
+ double sweep_ns{0};
+ std::uint64_t checksum{0};
+ double Total() const { return add_ns + churn_ns + walk_ns + cancel_ns + sweep_ns; }
+};
+
+using Clock = std::chrono::steady_clock;
+
+double NsPer(Clock::time_point start, std::size_t count){
+ return std::chrono::duration<double>(Clock::now() - start).count() / static_cast<double>(count) * 1e9;
+}
+
+template <typename Book>
+PassResult Pass(std::size_t depth, std::size_t levels, std::uint64_t seed){
+ PassResult result;
+ std::size_t live = depth * levels;
+ auto book = std::make_unique<Book>(LevelConfig{1, 4096}, live);
+ std::mt19937_64 rng(seed);
+ auto price = [&](){ return kBasePrice - static_cast<Price>(rng() % levels); };
+ BookEventSink sink;
+ OrderId next_id = 1;
+ std::vector<OrderId> ids;
+ ids.reserve(live);
+
+ auto start = Clock::now();
+ for (std::size_t i = 0; i < live; ++i){
+  book->ProcessNewOrder(Order(next_id, OrderSide::Buy, price(), 10, OrderType::Goodtillcancel), sink);
+  ids.push_back(next_id++);
+ }
+ result.add_ns = NsPer(start, live);
+
+ std::size_t churn = live * kChurnFactor;
+ start = Clock::now();
+ for (std::size_t i = 0; i < churn; ++i){
+  OrderId& slot = ids[rng() % live];
+  book->TryCancelOrder(slot, sink);
+  book->ProcessNewOrder(Order(next_id, OrderSide::Buy, price(), 10, OrderType::Goodtillcancel), sink);
+  slot = next_id++;
+ }
+ result.churn_ns = NsPer(start, churn);
+
+ start = Clock::now();
+ for (std::size_t walk = 0; walk < kWalks; ++walk){
+  book->ForEachOrder(OrderSide::Buy, [&](const auto&, const Order& order){ result.checksum += order.GetOrderId(); });
+ }
+ result.walk_ns = NsPer(start, live * kWalks);
+
+ std::shuffle(ids.begin(), ids.end(), rng);
+ std::size_t cancels = live / 2;
+ start = Clock::now();
+ for (std::size_t i = 0; i < cancels; ++i){
+  book->TryCancelOrder(ids[i], sink);
+ }
+ result.cancel_ns = NsPer(start, cancels);
+
+ std::size_t remaining = book->Size();
+ start = Clock::now();
+ book->ProcessNewOrder(Order(next_id, OrderSide::Sell, 0, static_cast<Quantity>(remaining * 10), OrderType::Market), sink);
+ result.sweep_ns = NsPer(start, remaining);
+ result.checksum += book->Size();
+ return result;
+}
+
+template <typename Book>
+void Run(const char* name, std::size_t depth, std::size_t levels, std::uint64_t seed){
+ PassResult best;
+ for (std::size_t repeat = 0; repeat < kRepeats; ++repeat){
+  PassResult result = Pass<Book>(depth, levels, seed);
+  if (repeat == 0 || result.Total() < best.Total()){
+   best = result;
+  }
+ }
+ std::printf("%8zu %-8s %10.1f %10.1f %10.1f %10.1f %10.1f %20llu\n", depth, name, best.add_ns, best.churn_ns, best.walk_ns,
+  best.cancel_ns, best.sweep_ns, static_cast<unsigned long long>(best.checksum));
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ std::vector<std::size_t> depths{16, 256, 4096};
+ std::size_t levels = 50;
+ std::uint64_t seed = 1;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--depth") == 0 && has_value){
+   depths.assign(1, std::strtoull(argv[++i], nullptr, 10));
+  }
+  else if (std::strcmp(argv[i], "--levels") == 0 && has_value){
+   levels = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--seed") == 0 && has_value){
+   seed = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--depth N] [--levels N] [--seed S]\n", argv[0]);
+   return 2;
+  }
+ }
+ if (levels == 0 || levels > 4096){
+  std::fprintf(stderr, "bench_level_queue: --levels must be 1 to 4096\n");
+  return 2;
+ }
+
+ try {
+  std::printf("%zu levels, %zu cancel-and-replace steps per resting order, ns per operation\n\n", levels, kChurnFactor);
+  std::printf("%8s %-8s %10s %10s %10s %10s %10s %20s\n", "depth", "queues", "add", "churn", "walk", "cancel", "sweep", "checksum");
+  for (std::size_t depth : depths){
+   Run<LadderOrderBook>("linked", depth, levels, seed);
+   Run<RingOrderBook>("ring", depth, levels, seed);
+  }
+  return 0;
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "bench_level_queue: %s\n", e.what());
+  return 1;
+ }
+}
@@ -0,0 +1,166 @@
+// Market data feed benchmark: encoding cost on top of the book, stream size, and decoder messages per second.
+// Usage: bench_market_data [--events N] [--modify R] [--seed S]
+//
+// The same synthetic flow (order_flow.h) runs through a fresh ladder book once without a feed, as the baseline, and
+// then once per feed mode with a MarketDataEncoder as the book's sink. A batch is closed every B events (1, 16 and
+// 256), and its bytes are appended to one stream buffer, as a publisher would copy them out. The whole stream is then
+// decoded into a MarketDataDecoder, and both of its views (L2 levels and L3 orders) are compared with the book's
+// final depth. Every pass runs three times on fresh state and the fastest is reported; encode ns/ev is the time over
+// the baseline.
+
+#include "../market_data.h"
+#include "../ordersApi.h"
+#include "order_flow.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <vector>
+
+
+namespace {
+
+template <typename Sink>
+void Apply(LadderOrderBook& book, const FlowEvent& event, Sink& sink){
+ switch (event.op){
+ case FlowOp::Add:
+  book.ProcessNewOrder(Order(event.order_id, event.side, event.price, event.quantity, OrderType::Goodtillcancel), sink);
+  break;
+ case FlowOp::Sweep:
+  book.ProcessNewOrder(Order(event.order_id, event.side, event.price, event.quantity, OrderType::Fillandkill), sink);
+  break;
+ case FlowOp::Cancel:
+  book.TryCancelOrder(event.order_id, sink);
+  break;
+ case FlowOp::Modify:
+  book.Modify(ModifyOrder(event.order_id, event.side, event.price, event.quantity), sink);
+  break;
+ }
+}
+
+constexpr std::size_t kRepeats = 3;   // Each pass is timed this many times on fresh state; the fastest counts
+
+double Seconds(std::chrono::steady_clock::time_point start){
+ return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double Baseline(const std::vector<FlowEvent>& flow, const LevelConfig& levels){
+ double best = 0;
+ for (std::size_t repeat = 0; repeat < kRepeats; ++repeat){
+  LadderOrderBook book(levels, flow.size());
+  BookEventSink sink;
+  auto start = std::chrono::steady_clock::now();
+  for (const FlowEvent& event : flow){
+   Apply(book, event, sink);
+  }
+  double seconds = Seconds(start);
+  best = repeat == 0 ? seconds : std::min(best, seconds);
+ }
+ return best;
+}
+
+void Run(const char* name, const MarketDataConfig& config, std::size_t batch, const std::vector<FlowEvent>& flow, const LevelConfig& levels,
+ double baseline, std::vector<char>& stream){
+ std::unique_ptr<LadderOrderBook> book;
+ std::unique_ptr<MarketDataEncoder> encoder;
+ double encode_seconds = 0;
+ for (std::size_t repeat = 0; repeat < kRepeats; ++repeat){
+  book = std::make_unique<LadderOrderBook>(levels, flow.size());
+  encoder = std::make_unique<MarketDataEncoder>(config);
+  stream.clear();
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < flow.size(); ++i){
+   Apply(*book, flow[i], *encoder);
+   if ((i + 1) % batch == 0 || i + 1 == flow.size()){
+    encoder->EndBatch();
+    stream.insert(stream.end(), encoder->Data(), encoder->Data() + encoder->Size());
+    encoder->Clear();
+   }
+  }
+  double seconds = Seconds(start);
+  encode_seconds = repeat == 0 ? seconds : std::min(encode_seconds, seconds);
+ }
+
+ std::unique_ptr<MarketDataDecoder> decoder;
+ std::size_t decoded = 0;
+ double decode_seconds = 0;
+ for (std::size_t repeat = 0; repeat < kRepeats; ++repeat){
+  decoder = std::make_unique<MarketDataDecoder>();
+  auto start = std::chrono::steady_clock::now();
+  decoded = decoder->Decode(stream.data(), stream.size());
+  double seconds = Seconds(start);
+  decode_seconds = repeat == 0 ? seconds : std::min(decode_seconds, seconds);
+ }
+
+ OrderBookLevelInfos book_depth = book->GetSnapshot();
+ OrderBookLevelInfos mirror;
+ bool match = true;
+ if (config.l2){
+  decoder->GetDepth(SIZE_MAX, mirror);
+  match = match && SameDepth(mirror, book_depth);
+ }
+ if (config.l3){
+  decoder->GetOrderDepth(SIZE_MAX, mirror);
+  match = match && SameDepth(mirror, book_depth) && decoder->Orders() == book->Size();
+ }
+ double events = static_cast<double>(flow.size());
+ std::printf("%-14s %6zu %12llu %8llu %10.1f %12.1f %12.1f %14.2f %6s\n", name, batch,
+  static_cast<unsigned long long>(encoder->Messages()), static_cast<unsigned long long>(encoder->Count(MarketDataType::LevelUpdate)),
+  static_cast<double>(stream.size()) / events, (encode_seconds - baseline) / events * 1e9, encode_seconds / events * 1e9,
+  static_cast<double>(decoded) / decode_seconds / 1e6, encoder->Dropped() == 0 && match ? "yes" : "NO");
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ FlowConfig flow_config;
+ flow_config.modify_ratio = 0.1;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--events") == 0 && has_value){
+   flow_config.events = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--modify") == 0 && has_value){
+   flow_config.modify_ratio = std::atof(argv[++i]);
+  }
+  else if (std::strcmp(argv[i], "--seed") == 0 && has_value){
+   flow_config.seed = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--events N] [--modify R] [--seed S]\n", argv[0]);
+   return 2;
+  }
+ }
+
+ try {
+  std::vector<FlowEvent> flow = GenerateOrderFlow(flow_config);
+  LevelConfig levels{flow_config.tick, 4096};
+  double baseline = Baseline(flow, levels);
+  std::printf("%zu events, book alone %.1f ns/event\n\n", flow.size(), baseline / static_cast<double>(flow.size()) * 1e9);
+  std::printf("%-14s %6s %12s %8s %10s %12s %12s %14s %6s\n", "mode", "batch", "messages", "L2", "bytes/ev", "encode ns/ev",
+   "total ns/ev", "decode M msg/s", "match");
+
+  MarketDataConfig plain;
+  MarketDataConfig conflated;
+  conflated.conflate = true;
+  MarketDataConfig l2_only;
+  l2_only.l3 = false;
+  l2_only.conflate = true;
+  std::vector<char> stream;
+  stream.reserve(flow.size() * 64);
+  for (std::size_t batch : {1, 16, 256}){
+   Run("l3+l2", plain, batch, flow, levels, baseline, stream);
+   Run("l3+l2 conflate", conflated, batch, flow, levels, baseline, stream);
+   Run("l2 conflate", l2_only, batch, flow, levels, baseline, stream);
+  }
+  return 0;
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "bench_market_data: %s\n", e.what());
+  return 1;
+ }
+}
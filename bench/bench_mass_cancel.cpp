@@ -0,0 +1,188 @@
+// Mass cancel benchmark: emptying a full book with the bulk cancels against cancelling every order by id.
+// Usage: bench_mass_cancel [--orders N] [--levels N] [--seed S]
+//
+// N passive orders (both sides, never crossing) rest over the given number of levels per side, then are all removed in
+// one of these ways:
+//  - by id:        TryCancelOrder for every order in arrival order, as a kill switch without mass cancel would
+//  - by id random: the same in random order, so each cancel's index probe and level lookup miss the cache
+//  - range:        CancelRange over four price bands per side; the book never empties along the way, so every order's
+//                  slot and index entry are freed one by one
+//  - side:         CancelSide(Buy), then CancelSide(Sell), which finds the book about to empty and resets it wholesale
+//  - all:          CancelAll
+//  - all + events: CancelAll with a sink that counts the cancel events and sums their quantities
+// Every pass runs three times on a fresh book and the fastest is reported.
+
+#include "../ordersApi.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+constexpr std::size_t kRepeats = 3;
+constexpr std::size_t kBands = 4;
+constexpr Price kMid = 100000;
+
+struct Resting{
+ OrderSide side;
+ Price price;
+};
+
+enum class Mode{ ById, ByIdRandom, Range, Side, All, AllEvents };
+
+// Counts cancel events, so the sink's calls cannot be optimized away
+struct CountingSink : BookEventSink{
+ std::size_t cancelled{0};
+ std::uint64_t quantity{0};
+ void OnCancelled(OrderId, Quantity remaining){
+  ++cancelled;
+  quantity += remaining;
+ }
+};
+
+struct PassResult{
+ double seconds{0};
+ std::size_t removed{0};
+};
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<Resting> MakeOrders(std::size_t count, std::size_t levels, std::uint64_t seed){
+ std::mt19937_64 rng(seed);
+ std::vector<Resting> orders(count);
+ for (Resting& order : orders){
+  Price offset = static_cast<Price>(rng() % levels);
+  order.side = rng() & 1 ? OrderSide::Buy : OrderSide::Sell;
+  order.price = order.side == OrderSide::Buy ? kMid - 1 - offset : kMid + offset;
+ }
+ return orders;
+}
+
+template <typename Book>
+PassResult Pass(Mode mode, const std::vector<Resting>& orders, std::size_t levels, const std::vector<OrderId>& shuffled){
+ auto book = std::make_unique<Book>(LevelConfig{1, static_cast<std::uint32_t>(2 * levels)}, orders.size());
+ BookEventSink sink;
+ for (std::size_t i = 0; i < orders.size(); ++i){
+  book->ProcessNewOrder(Order(i + 1, orders[i].side, orders[i].price, 100, OrderType::Goodtillcancel), sink);
+ }
+ PassResult result;
+ CountingSink counting;
+ auto start = Clock::now();
+ switch (mode){
+ case Mode::ById:
+  for (std::size_t i = 0; i < orders.size(); ++i){
+   result.removed += book->TryCancelOrder(i + 1);
+  }
+  break;
+ case Mode::ByIdRandom:
+  for (OrderId id : shuffled){
+   result.removed += book->TryCancelOrder(id);
+  }
+  break;
+ case Mode::Range: {
+  Price band = static_cast<Price>((levels + kBands - 1) / kBands);
+  for (std::size_t i = 0; i < kBands; ++i){
+   Price near = static_cast<Price>(i) * band;
+   result.removed += book->CancelRange(OrderSide::Buy, kMid - near - band, kMid - 1 - near);
+   result.removed += book->CancelRange(OrderSide::Sell, kMid + near, kMid + near + band - 1);
+  }
+  break;
+ }
+ case Mode::Side:
+  result.removed = book->CancelSide(OrderSide::Buy);
+  result.removed += book->CancelSide(OrderSide::Sell);
+  break;
+ case Mode::All:
+  result.removed = book->CancelAll();
+  break;
+ case Mode::AllEvents:
+  book->CancelAll(counting);
+  result.removed = counting.cancelled;
+  break;
+ }
+ result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+ if (book->Size() != 0 || counting.quantity != (mode == Mode::AllEvents ? result.removed * 100 : 0)){
+  std::fprintf(stderr, "bench_mass_cancel: book not emptied\n");
+  std::exit(1);
+ }
+ return result;
+}
+
+template <typename Book>
+void Run(const char* name, const char* backend, Mode mode, const std::vector<Resting>& orders, std::size_t levels,
+ const std::vector<OrderId>& shuffled){
+ PassResult best;
+ for (std::size_t repeat = 0; repeat < kRepeats; ++repeat){
+  PassResult result = Pass<Book>(mode, orders, levels, shuffled);
+  if (repeat == 0 || result.seconds < best.seconds){
+   best = result;
+  }
+ }
+ std::printf("%-14s %-8s %10zu %12.1f %12.2f\n", name, backend, best.removed,
+  best.removed == 0 ? 0.0 : best.seconds / static_cast<double>(best.removed) * 1e9, best.seconds * 1e3);
+}
+
+template <typename Book>
+void RunAll(const char* backend, const std::vector<Resting>& orders, std::size_t levels, const std::vector<OrderId>& shuffled){
+ Run<Book>("by id", backend, Mode::ById, orders, levels, shuffled);
+ Run<Book>("by id random", backend, Mode::ByIdRandom, orders, levels, shuffled);
+ Run<Book>("range", backend, Mode::Range, orders, levels, shuffled);
+ Run<Book>("side", backend, Mode::Side, orders, levels, shuffled);
+ Run<Book>("all", backend, Mode::All, orders, levels, shuffled);
+ Run<Book>("all + events", backend, Mode::AllEvents, orders, levels, shuffled);
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ std::size_t count = 2000000;
+ std::size_t levels = 1000;
+ std::uint64_t seed = 1;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--orders") == 0 && has_value){
+   count = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--levels") == 0 && has_value){
+   levels = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--seed") == 0 && has_value){
+   seed = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--orders N] [--levels N] [--seed S]\n", argv[0]);
+   return 2;
+  }
+ }
+ if (levels == 0 || levels > 1000000){
+  std::fprintf(stderr, "bench_mass_cancel: --levels must be 1 to 1000000\n");
+  return 2;
+ }
+
+ try {
+  std::vector<Resting> orders = MakeOrders(count, levels, seed);
+  std::vector<OrderId> shuffled(count);
+  for (std::size_t i = 0; i < count; ++i){
+   shuffled[i] = i + 1;
+  }
+  std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(seed));
+  std::printf("%zu resting orders over %zu levels per side\n\n", count, levels);
+  std::printf("%-14s %-8s %10s %12s %12s\n", "mode", "backend", "removed", "ns/order", "total ms");
+  RunAll<LadderOrderBook>("ladder", orders, levels, shuffled);
+  RunAll<RingOrderBook>("ring", orders, levels, shuffled);
+  RunAll<OrderBook>("map", orders, levels, shuffled);
+  return 0;
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "bench_mass_cancel: %s\n", e.what());
+  return 1;
+ }
+}
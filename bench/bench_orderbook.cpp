@@ -0,0 +1,337 @@
+// OrderBook benchmark: throughput and per-operation latency percentiles on synthetic order flow.
+// Usage: bench_orderbook [--events N] [--cancel R] [--sweep R] [--modify R] [--decay P] [--replace] [--seed S] [--backend map|ladder|ring|both|all] [--json]
+//
+// Each backend runs the same pre-generated flow (see order_flow.h) twice on a fresh book:
+//  1. throughput pass: no per-operation timing
+//  2. latency pass: every operation timed with TscClock; book depth and live order count sampled periodically
+// Operations are classified as add (rests without trading), match (passive order that crossed), sweep (aggressive
+// fill-and-kill), cancel and modify. Modifies go through Modify, or with --replace through the cancel plus new order
+// that callers used before it existed. --decay sets how fast resting depth thins out behind the touch: higher values
+// pile the flow into fewer, longer queues. --backend both runs map and ladder; all adds ring, the ladder with
+// ring-buffer level queues (RingLevels). --json prints one JSON object per backend instead of the table.
+// Where the CPU's counters are readable (perf_counters.h), the throughput pass also reports instructions, branches and
+// branch misses per event.
+// Built with -DORDERBOOK_METRICS=1 (make bench builds it as bench_orderbook_metrics), the throughput pass runs with the
+// book's own instrumentation on and reports its histograms and counters; comparing its events/s with bench_orderbook's
+// gives the instrumentation overhead.
+
+#include "../ordersApi.h"
+#include "../tsc_clock.h"
+#include "order_flow.h"
+#include "perf_counters.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+enum Op { kAdd, kMatch, kSweep, kCancel, kModify, kOpCount };
+const char* const kOpNames[kOpCount] = {"add", "match", "sweep", "cancel", "modify"};
+const char* const kBookOpNames[kBookOps] = {"add", "match", "cancel", "level create", "level erase"};
+const char* const kBookCounterNames[kBookCounters] = {"levels_created", "levels_erased", "sweeps", "orders_matched", "duplicates_rejected"};
+
+constexpr std::size_t kDepthSampleInterval = 1024;
+
+struct LatencyStats{
+ std::size_t count{0};
+ double mean_ns{0};
+ double p50_ns{0};
+ double p99_ns{0};
+ double p999_ns{0};
+ double max_ns{0};
+};
+
+struct Range{
+ std::size_t min{std::numeric_limits<std::size_t>::max()};
+ std::size_t max{0};
+ double sum{0};
+ std::size_t samples{0};
+ void Add(std::size_t value){
+  min = std::min(min, value);
+  max = std::max(max, value);
+  sum += static_cast<double>(value);
+  ++samples;
+ }
+ double Mean() const { return samples == 0 ? 0 : sum / static_cast<double>(samples); }
+};
+
+struct Report{
+ const char* backend;
+ std::size_t events{0};
+ double seconds{0};
+ bool counters{false};      // Hardware counters were available for the throughput pass
+ CounterValues counts;
+ LatencyStats ops[kOpCount];
+ std::size_t cancel_misses{0};   // Cancels and modifies of orders that had already filled
+ std::uint64_t trades{0};
+ Range live_orders;
+ Range bid_levels;
+ Range ask_levels;
+ MetricsSnapshot metrics;   // The throughput pass book's own instrumentation (zero unless ORDERBOOK_METRICS)
+};
+
+// Counts fills through the allocation-free sink API
+struct CountingSink : BookEventSink{
+ std::uint64_t fills{0};
+ void OnFill(const FillEvent&) { ++fills; }
+};
+
+template <typename Book>
+Op Apply(Book& book, const FlowEvent& event, CountingSink& sink, std::size_t& cancel_misses, bool replace){
+ switch (event.op){
+ case FlowOp::Add:
+  {
+   std::uint64_t before = sink.fills;
+   book.ProcessNewOrder(Order(event.order_id, event.side, event.price, event.quantity, OrderType::Goodtillcancel), sink);
+   return sink.fills == before ? kAdd : kMatch;
+  }
+ case FlowOp::Sweep:
+  book.ProcessNewOrder(Order(event.order_id, event.side, event.price, event.quantity, OrderType::Fillandkill), sink);
+  return kSweep;
+ case FlowOp::Cancel:
+  if (!book.TryCancelOrder(event.order_id, sink)){
+   ++cancel_misses;
+  }
+  return kCancel;
+ case FlowOp::Modify:
+  if (replace){
+   if (book.TryCancelOrder(event.order_id, sink)){
+    book.ProcessNewOrder(ModifyOrder(event.order_id, event.side, event.price, event.quantity).toOrder(), sink);
+   }
+   else {
+    ++cancel_misses;
+   }
+  }
+  else if (!book.Modify(ModifyOrder(event.order_id, event.side, event.price, event.quantity), sink)){
+   ++cancel_misses;
+  }
+  return kModify;
+ }
+ return kAdd;
+}
+
+LatencyStats Summarize(std::vector<std::uint64_t>& ticks){
+ LatencyStats stats;
+ stats.count = ticks.size();
+ if (ticks.empty()){
+  return stats;
+ }
+ std::sort(ticks.begin(), ticks.end());
+ auto at = [&](double quantile){
+  std::size_t index = static_cast<std::size_t>(quantile * static_cast<double>(ticks.size() - 1));
+  return TscClock::ToNs(ticks[index]);
+ };
+ double total = 0;
+ for (std::uint64_t value : ticks){
+  total += static_cast<double>(value);
+ }
+ stats.mean_ns = total / static_cast<double>(ticks.size()) / TscClock::TicksPerNs();
+ stats.p50_ns = at(0.50);
+ stats.p99_ns = at(0.99);
+ stats.p999_ns = at(0.999);
+ stats.max_ns = TscClock::ToNs(ticks.back());
+ return stats;
+}
+
+template <typename Book>
+Report Run(const char* name, const std::vector<FlowEvent>& flow, const LevelConfig& config, bool replace){
+ Report report;
+ report.backend = name;
+ report.events = flow.size();
+
+ {
+  Book book(config, flow.size());
+  CountingSink sink;
+  std::size_t misses = 0;
+  HardwareCounters counters;
+  auto start = std::chrono::steady_clock::now();
+  counters.Start();
+  for (const FlowEvent& event : flow){
+   Apply(book, event, sink, misses, replace);
+  }
+  report.counts = counters.Stop();
+  report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  report.counters = counters.Available();
+  report.trades = sink.fills;
+  report.cancel_misses = misses;
+  book.ReadMetrics(report.metrics);
+ }
+
+ std::vector<std::uint64_t> samples[kOpCount];
+ for (auto& bucket : samples){
+  bucket.reserve(flow.size());
+ }
+ Book book(config, flow.size());
+ CountingSink sink;
+ std::size_t misses = 0;
+ for (std::size_t i = 0; i < flow.size(); ++i){
+  std::uint64_t start = TscClock::Start();
+  Op op = Apply(book, flow[i], sink, misses, replace);
+  std::uint64_t stop = TscClock::Stop();
+  samples[op].push_back(stop - start);
+  if (i % kDepthSampleInterval == 0){
+   report.live_orders.Add(book.Size());
+   report.bid_levels.Add(book.LevelCount(OrderSide::Buy));
+   report.ask_levels.Add(book.LevelCount(OrderSide::Sell));
+  }
+ }
+ for (int op = 0; op < kOpCount; ++op){
+  report.ops[op] = Summarize(samples[op]);
+ }
+ return report;
+}
+
+void PrintTable(const Report& report){
+ std::printf("\n[%s] %zu events in %.3f s: %.2f M events/s, %llu trades, %zu cancel misses\n", report.backend, report.events, report.seconds,
+  static_cast<double>(report.events) / report.seconds / 1e6, static_cast<unsigned long long>(report.trades), report.cancel_misses);
+ if (report.counters){
+  double events = static_cast<double>(report.events);
+  std::printf("per event: %.1f instructions, %.1f branches, %.3f branch misses\n", static_cast<double>(report.counts.instructions) / events,
+   static_cast<double>(report.counts.branches) / events, static_cast<double>(report.counts.branch_misses) / events);
+ }
+ else {
+  std::printf("hardware counters unavailable\n");
+ }
+ std::printf("%-8s %10s %10s %10s %10s %10s %10s   (ns)\n", "op", "count", "mean", "p50", "p99", "p99.9", "max");
+ for (int op = 0; op < kOpCount; ++op){
+  const LatencyStats& s = report.ops[op];
+  std::printf("%-8s %10zu %10.1f %10.1f %10.1f %10.1f %10.1f\n", kOpNames[op], s.count, s.mean_ns, s.p50_ns, s.p99_ns, s.p999_ns, s.max_ns);
+ }
+ std::printf("live orders  min %zu  mean %.1f  max %zu\n", report.live_orders.min, report.live_orders.Mean(), report.live_orders.max);
+ std::printf("bid levels   min %zu  mean %.1f  max %zu\n", report.bid_levels.min, report.bid_levels.Mean(), report.bid_levels.max);
+ std::printf("ask levels   min %zu  mean %.1f  max %zu\n", report.ask_levels.min, report.ask_levels.Mean(), report.ask_levels.max);
+ if (!BookMetrics::kEnabled){
+  return;
+ }
+ const MetricsSnapshot& metrics = report.metrics;
+ std::printf("in-book metrics (throughput pass)\n%-14s %10s %10s %10s %10s %10s %10s   (ns)\n", "op", "calls", "timed", "mean", "p50", "p99", "max");
+ for (std::size_t op = 0; op < kBookOps; ++op){
+  const HistogramSnapshot& h = metrics.ops[op];
+  std::printf("%-14s %10llu %10llu %10.1f %10.1f %10.1f %10.1f\n", kBookOpNames[op], static_cast<unsigned long long>(metrics.calls[op]),
+   static_cast<unsigned long long>(h.count), h.Mean() / TscClock::TicksPerNs(),
+   TscClock::ToNs(h.Percentile(0.50)), TscClock::ToNs(h.Percentile(0.99)), TscClock::ToNs(h.max));
+ }
+ for (std::size_t counter = 0; counter < kBookCounters; ++counter){
+  std::printf("%s %llu%s", kBookCounterNames[counter], static_cast<unsigned long long>(metrics.counters[counter]), counter + 1 < kBookCounters ? ", " : "\n");
+ }
+ std::printf("orders matched per sweep: mean %.2f, p99 %llu, max %llu\n", metrics.sweep_matches.Mean(),
+  static_cast<unsigned long long>(metrics.sweep_matches.Percentile(0.99)), static_cast<unsigned long long>(metrics.sweep_matches.max));
+}
+
+void PrintRange(const char* name, const Range& range, bool last){
+ std::printf("\"%s\":{\"min\":%zu,\"mean\":%.2f,\"max\":%zu}%s", name, range.min, range.Mean(), range.max, last ? "" : ",");
+}
+
+void PrintJson(const Report& report){
+ std::printf("{\"backend\":\"%s\",\"events\":%zu,\"seconds\":%.6f,\"events_per_sec\":%.1f,\"trades\":%llu,\"cancel_misses\":%zu,",
+  report.backend, report.events, report.seconds, static_cast<double>(report.events) / report.seconds,
+  static_cast<unsigned long long>(report.trades), report.cancel_misses);
+ if (report.counters){
+  std::printf("\"instructions\":%llu,\"branches\":%llu,\"branch_misses\":%llu,", static_cast<unsigned long long>(report.counts.instructions),
+   static_cast<unsigned long long>(report.counts.branches), static_cast<unsigned long long>(report.counts.branch_misses));
+ }
+ std::printf("\"ops\":{");
+ for (int op = 0; op < kOpCount; ++op){
+  const LatencyStats& s = report.ops[op];
+  std::printf("\"%s\":{\"count\":%zu,\"mean_ns\":%.1f,\"p50_ns\":%.1f,\"p99_ns\":%.1f,\"p999_ns\":%.1f,\"max_ns\":%.1f}%s",
+   kOpNames[op], s.count, s.mean_ns, s.p50_ns, s.p99_ns, s.p999_ns, s.max_ns, op + 1 < kOpCount ? "," : "");
+ }
+ std::printf("},\"depth\":{");
+ PrintRange("live_orders", report.live_orders, false);
+ PrintRange("bid_levels", report.bid_levels, false);
+ PrintRange("ask_levels", report.ask_levels, true);
+ std::printf("}");
+ if (BookMetrics::kEnabled){
+  std::printf(",\"metrics\":{");
+  for (std::size_t op = 0; op < kBookOps; ++op){
+   const HistogramSnapshot& h = report.metrics.ops[op];
+   std::printf("\"%s\":{\"calls\":%llu,\"timed\":%llu,\"mean_ns\":%.1f,\"p50_ns\":%.1f,\"p99_ns\":%.1f,\"max_ns\":%.1f},", kBookOpNames[op],
+    static_cast<unsigned long long>(report.metrics.calls[op]), static_cast<unsigned long long>(h.count), h.Mean() / TscClock::TicksPerNs(), TscClock::ToNs(h.Percentile(0.50)), TscClock::ToNs(h.Percentile(0.99)),
+    TscClock::ToNs(h.max));
+  }
+  for (std::size_t counter = 0; counter < kBookCounters; ++counter){
+   std::printf("\"%s\":%llu%s", kBookCounterNames[counter], static_cast<unsigned long long>(report.metrics.counters[counter]),
+    counter + 1 < kBookCounters ? "," : "");
+  }
+  std::printf("}");
+ }
+ std::printf("}\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ FlowConfig flow_config;
+ std::string backend = "both";
+ bool json = false;
+ bool replace = false;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--events") == 0 && has_value){
+   flow_config.events = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--cancel") == 0 && has_value){
+   flow_config.cancel_ratio = std::atof(argv[++i]);
+  }
+  else if (std::strcmp(argv[i], "--sweep") == 0 && has_value){
+   flow_config.sweep_ratio = std::atof(argv[++i]);
+  }
+  else if (std::strcmp(argv[i], "--modify") == 0 && has_value){
+   flow_config.modify_ratio = std::atof(argv[++i]);
+  }
+  else if (std::strcmp(argv[i], "--decay") == 0 && has_value){
+   flow_config.depth_decay = std::atof(argv[++i]);
+  }
+  else if (std::strcmp(argv[i], "--replace") == 0){
+   replace = true;
+  }
+  else if (std::strcmp(argv[i], "--seed") == 0 && has_value){
+   flow_config.seed = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--backend") == 0 && has_value){
+   backend = argv[++i];
+  }
+  else if (std::strcmp(argv[i], "--json") == 0){
+   json = true;
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--events N] [--cancel R] [--sweep R] [--modify R] [--decay P] [--replace] [--seed S] [--backend map|ladder|ring|both|all] [--json]\n", argv[0]);
+   return 2;
+  }
+ }
+
+ std::vector<FlowEvent> flow = GenerateOrderFlow(flow_config);
+ LevelConfig level_config{flow_config.tick, 4096};
+ std::vector<Report> reports;
+ if (backend == "map" || backend == "both" || backend == "all"){
+  reports.push_back(Run<OrderBook>("map", flow, level_config, replace));
+ }
+ if (backend == "ladder" || backend == "both" || backend == "all"){
+  reports.push_back(Run<LadderOrderBook>("ladder", flow, level_config, replace));
+ }
+ if (backend == "ring" || backend == "all"){
+  reports.push_back(Run<RingOrderBook>("ring", flow, level_config, replace));
+ }
+
+ if (!json){
+  std::printf("flow: %zu events, cancel ratio %.2f, sweep ratio %.2f, modify ratio %.2f%s, depth decay %.2f, seed %llu, TSC %.3f ticks/ns\n",
+   flow_config.events, flow_config.cancel_ratio, flow_config.sweep_ratio, flow_config.modify_ratio, replace ? " (as cancel + new)" : "", flow_config.depth_decay,
+   static_cast<unsigned long long>(flow_config.seed), TscClock::TicksPerNs());
+ }
+ for (const Report& report : reports){
+  if (json){
+   PrintJson(report);
+  }
+  else {
+   PrintTable(report);
+  }
+ }
+ return 0;
+}
@@ -0,0 +1,171 @@
+// Restart benchmark: time to reopen a DurableBook holding millions of resting orders from the journal alone versus from
+// a checkpoint plus a journal tail, and journal throughput against the group-commit size.
+// Usage: bench_restart [--orders N] [--churn K] [--tail T] [--commits C] [--dir PATH] [--seed S]
+//
+// 1. A day of flow goes through the journal: N orders that stay resting (bids below 10000, asks above, so nothing
+//    trades), each followed by K orders that are added and cancelled again, N * (1 + 2K) commands in all. The book is
+//    closed and reopened, replaying the whole day.
+// 2. A checkpoint is written, T more commands (half new orders, half cancels) are journaled, and the book is reopened
+//    again: checkpoint load plus T replayed commands.
+// 3. C new orders are journaled with fdatasync at group sizes 1, 8, 64 and 512.
+// The directory is created under the system temp directory unless --dir is given, and removed afterwards.
+
+#include "../durable_book.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+double Seconds(std::chrono::steady_clock::time_point start){
+ return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+EngineCommand RestingOrder(OrderId order_id, std::mt19937_64& rng){
+ bool buy = rng() & 1;
+ Price offset = static_cast<Price>(1 + rng() % 1000);
+ return EngineCommand{order_id, 0, buy ? 10000 - offset : 10000 + offset, static_cast<Quantity>(1 + rng() % 500),
+  EngineCommandType::NewOrder, buy ? OrderSide::Buy : OrderSide::Sell, OrderType::Goodtillcancel};
+}
+
+std::uintmax_t DirectoryBytes(const std::string& directory, const char* extension){
+ std::uintmax_t bytes = 0;
+ for (const auto& file : std::filesystem::directory_iterator(directory)){
+  if (file.path().extension() == extension){
+   bytes += file.file_size();
+  }
+ }
+ return bytes;
+}
+
+void PrintRecovery(const char* name, const RecoveryStats& recovery){
+ std::printf("%-22s %10zu %10llu %12.3f %12.3f %12.3f\n", name, recovery.checkpoint_orders, static_cast<unsigned long long>(recovery.replayed),
+  recovery.checkpoint_seconds, recovery.replay_seconds, recovery.checkpoint_seconds + recovery.replay_seconds);
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ std::size_t orders = 2000000;
+ std::size_t churn = 2;
+ std::size_t tail = 100000;
+ std::size_t commits = 20000;
+ std::string directory = (std::filesystem::temp_directory_path() / "bench_restart").string();
+ std::uint64_t seed = 42;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--orders") == 0 && has_value){
+   orders = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--churn") == 0 && has_value){
+   churn = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--tail") == 0 && has_value){
+   tail = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--commits") == 0 && has_value){
+   commits = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--dir") == 0 && has_value){
+   directory = argv[++i];
+  }
+  else if (std::strcmp(argv[i], "--seed") == 0 && has_value){
+   seed = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--orders N] [--churn K] [--tail T] [--commits C] [--dir PATH] [--seed S]\n", argv[0]);
+   return 2;
+  }
+ }
+ if (orders == 0){
+  std::fprintf(stderr, "bench_restart: --orders must be positive\n");
+  return 2;
+ }
+
+ std::filesystem::remove_all(directory);
+ DurableConfig config;
+ config.directory = directory;
+ config.levels = LevelConfig{1, 4096};
+ config.capacity_hint = orders;
+ config.journal.group_commit = 4096;
+ config.journal.sync = false; // Loading phase: measure the journal format, not the disk
+
+ std::mt19937_64 rng(seed);
+ {
+  DurableBook<LadderOrderBook> book(config);
+  OrderId transient = static_cast<OrderId>(orders + 1);
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < orders; ++i){
+   book.Apply(RestingOrder(static_cast<OrderId>(i + 1), rng));
+   for (std::size_t k = 0; k < churn; ++k, ++transient){
+    book.Apply(RestingOrder(transient, rng));
+    book.Apply(EngineCommand{transient, 0, 0, 0, EngineCommandType::Cancel, OrderSide::Buy, OrderType::Goodtillcancel});
+   }
+  }
+  book.Commit();
+  double seconds = Seconds(start);
+  std::printf("journaled %llu commands (%zu resting orders) in %.3f s (%.2f M commands/s), journal %.1f MB\n",
+   static_cast<unsigned long long>(book.Sequence()), book.GetBook().Size(), seconds, static_cast<double>(book.Sequence()) / seconds / 1e6,
+   static_cast<double>(DirectoryBytes(directory, ".wal")) / 1e6);
+ }
+
+ std::printf("\n%-22s %10s %10s %12s %12s %12s\n", "restart", "ckpt orders", "replayed", "load (s)", "replay (s)", "total (s)");
+ std::size_t resting = 0;
+ {
+  DurableBook<LadderOrderBook> book(config);
+  PrintRecovery("journal only", book.Recovery());
+
+  auto start = std::chrono::steady_clock::now();
+  std::size_t bytes = book.Checkpoint();
+  double seconds = Seconds(start);
+  std::vector<OrderId> live(orders);
+  for (std::size_t i = 0; i < orders; ++i){
+   live[i] = static_cast<OrderId>(i + 1);
+  }
+  OrderId next_id = static_cast<OrderId>(orders * (1 + churn) + 1);
+  for (std::size_t i = 0; i < tail; ++i){
+   if (i % 2 == 0){
+    book.Apply(RestingOrder(next_id++, rng));
+   }
+   else {
+    book.Apply(EngineCommand{live[rng() % live.size()], 0, 0, 0, EngineCommandType::Cancel, OrderSide::Buy, OrderType::Goodtillcancel});
+   }
+  }
+  resting = book.GetBook().Size();
+  std::printf("checkpoint of %zu orders: %.1f MB written in %.3f s\n", orders, static_cast<double>(bytes) / 1e6, seconds);
+ }
+ {
+  DurableBook<LadderOrderBook> book(config);
+  PrintRecovery("checkpoint + tail", book.Recovery());
+  if (book.GetBook().Size() != resting){
+   std::fprintf(stderr, "bench_restart: reopened book has %zu orders, expected %zu\n", book.GetBook().Size(), resting);
+   return 1;
+  }
+ }
+
+ std::printf("\n%-12s %12s %12s %14s\n", "group size", "commands", "syncs", "commands/s");
+ for (std::size_t group : {1, 8, 64, 512}){
+  std::filesystem::remove_all(directory);
+  DurableConfig sync_config = config;
+  sync_config.capacity_hint = commits;
+  sync_config.journal.group_commit = group;
+  sync_config.journal.sync = true;
+  DurableBook<LadderOrderBook> book(sync_config);
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < commits; ++i){
+   book.Apply(RestingOrder(static_cast<OrderId>(i + 1), rng));
+  }
+  book.Commit();
+  double seconds = Seconds(start);
+  std::printf("%-12zu %12zu %12zu %14.0f\n", group, commits, (commits + group - 1) / group, static_cast<double>(commits) / seconds);
+ }
+ std::filesystem::remove_all(directory);
+ return 0;
+}
@@ -0,0 +1,119 @@
+#ifndef ORDER_FLOW_H
+#define ORDER_FLOW_H
+
+#include "../orders.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+
+// Synthetic order flow for benchmarks.
+// Arrivals are Poisson (exponential inter-arrival times). Each arrival is a passive limit order, a cancel or modify of
+// a previously submitted order, or an aggressive fill-and-kill sweep through several levels. A modify keeps the price
+// with a new quantity (half of them) or moves the order to a new passive price. Passive prices are drawn
+// from a geometric distribution of ticks behind a randomly walking mid, so most orders sit close to the touch; as the
+// mid drifts, some passive orders cross and match.
+
+struct FlowConfig{
+ std::size_t events{2000000};
+ double arrival_rate{1e6};        // Mean arrivals per second (timestamps only)
+ double cancel_ratio{0.45};       // Share of arrivals that cancel a live order
+ double sweep_ratio{0.02};        // Share of arrivals that are aggressive sweeps
+ double modify_ratio{0};          // Share of arrivals that modify a live order (0 keeps the flow of earlier versions)
+ double depth_decay{0.25};        // Geometric parameter: P(price is k ticks behind the touch) ~ (1 - p)^k
+ std::uint32_t sweep_levels{8};   // Levels a sweep prices through
+ Quantity max_quantity{100};
+ Price mid{100000};
+ Price tick{1};
+ double mid_step_probability{0.01};
+ std::uint64_t seed{42};
+};
+
+enum class FlowOp : std::uint8_t{
+ Add,
+ Cancel,
+ Sweep,
+ Modify,
+};
+
+struct FlowEvent{
+ std::uint64_t timestamp_ns;
+ OrderId order_id;         // New id for Add/Sweep, target id for Cancel/Modify
+ Price price;
+ Quantity quantity;
+ OrderSide side;
+ FlowOp op;
+};
+
+inline std::vector<FlowEvent> GenerateOrderFlow(const FlowConfig& config){
+ std::mt19937_64 rng(config.seed);
+ std::exponential_distribution<double> arrival(config.arrival_rate / 1e9);
+ std::uniform_real_distribution<double> uniform(0.0, 1.0);
+ std::geometric_distribution<int> depth(config.depth_decay);
+ std::uniform_int_distribution<Quantity> quantity(1, config.max_quantity);
+
+ std::vector<FlowEvent> events;
+ events.reserve(config.events);
+ struct Submitted{
+  OrderId order_id;
+  Price price;
+  OrderSide side;
+ };
+ std::vector<Submitted> submitted; // Candidates for cancels and modifies; some will already have filled
+ submitted.reserve(config.events);
+
+ double clock_ns = 0;
+ OrderId next_id = 1;
+ Price mid = config.mid;
+ for (std::size_t i = 0; i < config.events; ++i){
+  clock_ns += arrival(rng);
+  if (uniform(rng) < config.mid_step_probability){
+   mid += uniform(rng) < 0.5 ? config.tick : -config.tick;
+  }
+
+  FlowEvent event{};
+  event.timestamp_ns = static_cast<std::uint64_t>(clock_ns);
+  event.side = uniform(rng) < 0.5 ? OrderSide::Buy : OrderSide::Sell;
+  double kind = uniform(rng);
+  if (kind < config.cancel_ratio && !submitted.empty()){
+   std::size_t pick = rng() % submitted.size();
+   event.op = FlowOp::Cancel;
+   event.order_id = submitted[pick].order_id;
+   submitted[pick] = submitted.back();
+   submitted.pop_back();
+  }
+  else if (kind < config.cancel_ratio + config.sweep_ratio){
+   Price through = static_cast<Price>(config.sweep_levels) * config.tick;
+   event.op = FlowOp::Sweep;
+   event.order_id = next_id++;
+   event.price = event.side == OrderSide::Buy ? mid + through : mid - through;
+   event.quantity = quantity(rng) * config.sweep_levels;
+  }
+  else if (kind < config.cancel_ratio + config.sweep_ratio + config.modify_ratio && !submitted.empty()){
+   Submitted& target = submitted[rng() % submitted.size()];
+   event.op = FlowOp::Modify;
+   event.order_id = target.order_id;
+   event.side = target.side;
+   event.quantity = quantity(rng);
+   if (uniform(rng) < 0.5){
+    Price behind = static_cast<Price>(1 + depth(rng)) * config.tick;
+    target.price = target.side == OrderSide::Buy ? mid - behind : mid + behind;
+   }
+   event.price = target.price;
+  }
+  else {
+   Price behind = static_cast<Price>(1 + depth(rng)) * config.tick;
+   event.op = FlowOp::Add;
+   event.order_id = next_id++;
+   event.price = event.side == OrderSide::Buy ? mid - behind : mid + behind;
+   event.quantity = quantity(rng);
+   submitted.push_back(Submitted{event.order_id, event.price, event.side});
+  }
+  events.push_back(event);
+ }
+ return events;
+}
+
+#endif // ORDER_FLOW_H
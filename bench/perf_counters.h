@@ -0,0 +1,105 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+// User-space hardware counters (instructions, branches, branch misses) for the calling thread, read around a whole
+// benchmark pass with perf_event_open. Opened as one group so all three cover exactly the same instructions.
+// Unavailable (Available() == false, all counts 0) off Linux, without a PMU (most VMs and containers) or when
+// kernel.perf_event_paranoid forbids it; benchmarks then print timings only.
+struct CounterValues{
+ std::uint64_t instructions{0};
+ std::uint64_t branches{0};
+ std::uint64_t branch_misses{0};
+};
+
+class HardwareCounters{
+ public:
+  HardwareCounters(){
+#if defined(__linux__)
+   leader_ = Open(PERF_COUNT_HW_INSTRUCTIONS, -1);
+   if (leader_ < 0){
+    return;
+   }
+   branches_ = Open(PERF_COUNT_HW_BRANCH_INSTRUCTIONS, leader_);
+   misses_ = Open(PERF_COUNT_HW_BRANCH_MISSES, leader_);
+   if (branches_ < 0 || misses_ < 0){
+    Close();
+   }
+#endif
+  }
+
+  ~HardwareCounters(){ Close(); }
+
+  HardwareCounters(const HardwareCounters&) = delete;
+  HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+  bool Available() const { return leader_ >= 0; }
+
+  void Start(){
+#if defined(__linux__)
+   if (Available()){
+    ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+   }
+#endif
+  }
+
+  CounterValues Stop(){
+   CounterValues values;
+#if defined(__linux__)
+   if (Available()){
+    ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    std::uint64_t group[4] = {0, 0, 0, 0}; // PERF_FORMAT_GROUP: count, then one value per counter in open order
+    if (read(leader_, group, sizeof(group)) == static_cast<ssize_t>(sizeof(group)) && group[0] == 3){
+     values.instructions = group[1];
+     values.branches = group[2];
+     values.branch_misses = group[3];
+    }
+   }
+#endif
+   return values;
+  }
+
+ private:
+  int leader_{-1};
+  int branches_{-1};
+  int misses_{-1};
+
+#if defined(__linux__)
+  static int Open(std::uint64_t config, int group){
+   perf_event_attr attr;
+   std::memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = PERF_TYPE_HARDWARE;
+   attr.config = config;
+   attr.disabled = group < 0 ? 1 : 0; // Members follow the leader
+   attr.exclude_kernel = 1;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_GROUP;
+   return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+  }
+#endif
+
+  void Close(){
+#if defined(__linux__)
+   for (int* fd : {&misses_, &branches_, &leader_}){
+    if (*fd >= 0){
+     close(*fd);
+     *fd = -1;
+    }
+   }
+#endif
+  }
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,300 @@
+#ifndef BOOK_ANALYTICS_H
+#define BOOK_ANALYTICS_H
+
+#include "orders.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+// Per-event book features over the top N levels: microprice, order-book imbalance, cumulative depth and
+// depth-weighted VWAP.
+// BookAnalytics keeps each side's top N prices and quantities in aligned arrays read straight from the book's level
+// aggregates (BasicOrderBook::GetTopLevels), with no LevelInfos in between. After each event, Update compares the book's
+// per-side TopVersion with the one it read: a side whose top levels did not change is not re-read, and when neither
+// changed the features are not recomputed. The per-side sums run as SIMD kernels, four doubles per step with AVX
+// and two with SSE2 (the x86-64 baseline), or as plain loops elsewhere.
+// FeatureColumns collects one row per event, column by column, and writes them out as a flat columnar file.
+// Prices are in the book's units; a feature of an empty side is NaN.
+
+
+constexpr std::size_t kMaxAnalyticsLevels = 32;   // Deepest N a BookAnalytics can follow
+
+struct BookFeatures{
+ double microprice{std::numeric_limits<double>::quiet_NaN()};   // Best bid and ask weighted by the opposite best quantity
+ double imbalance{0};              // (bid depth - ask depth) / (bid depth + ask depth), in [-1, 1]; 0 for an empty book
+ double bid_depth{0};              // Quantity of the top N levels
+ double ask_depth{0};
+ double bid_vwap{std::numeric_limits<double>::quiet_NaN()};     // Quantity-weighted price of the top N levels
+ double ask_vwap{std::numeric_limits<double>::quiet_NaN()};
+};
+
+
+namespace analytics_detail {
+
+ // Sum of quantities and of price * quantity over n entries; n is a multiple of 4 and both arrays are 32-byte aligned
+ inline void SumAndDot(const double* prices, const double* quantities, std::size_t n, double& depth, double& notional){
+#if defined(__AVX__)
+  __m256d sum = _mm256_setzero_pd();
+  __m256d dot = _mm256_setzero_pd();
+  for (std::size_t i = 0; i < n; i += 4){
+   __m256d quantity = _mm256_load_pd(quantities + i);
+   sum = _mm256_add_pd(sum, quantity);
+   dot = _mm256_add_pd(dot, _mm256_mul_pd(_mm256_load_pd(prices + i), quantity));
+  }
+  __m128d sum2 = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+  __m128d dot2 = _mm_add_pd(_mm256_castpd256_pd128(dot), _mm256_extractf128_pd(dot, 1));
+  depth = _mm_cvtsd_f64(_mm_add_sd(sum2, _mm_unpackhi_pd(sum2, sum2)));
+  notional = _mm_cvtsd_f64(_mm_add_sd(dot2, _mm_unpackhi_pd(dot2, dot2)));
+#elif defined(__SSE2__)
+  __m128d sum = _mm_setzero_pd();
+  __m128d dot = _mm_setzero_pd();
+  for (std::size_t i = 0; i < n; i += 2){
+   __m128d quantity = _mm_load_pd(quantities + i);
+   sum = _mm_add_pd(sum, quantity);
+   dot = _mm_add_pd(dot, _mm_mul_pd(_mm_load_pd(prices + i), quantity));
+  }
+  depth = _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+  notional = _mm_cvtsd_f64(_mm_add_sd(dot, _mm_unpackhi_pd(dot, dot)));
+#else
+  depth = 0;
+  notional = 0;
+  for (std::size_t i = 0; i < n; ++i){
+   depth += quantities[i];
+   notional += prices[i] * quantities[i];
+  }
+#endif
+ }
+
+} // namespace analytics_detail
+
+
+// Features of one book, kept current by calling Update after every event. The book's top-level tracking follows one
+// reader, so attach one BookAnalytics per book.
+template <typename Book>
+class BookAnalytics{
+ public:
+  // levels: N, the depth the features cover (1 to kMaxAnalyticsLevels)
+  explicit BookAnalytics(Book& book, std::size_t levels = 10):
+   book_ {book},
+   levels_ {levels}
+  {
+   if (levels_ == 0 || levels_ > kMaxAnalyticsLevels){
+    throw std::logic_error("BookAnalytics: levels must be between 1 and " + std::to_string(kMaxAnalyticsLevels));
+   }
+  }
+
+  // Bring the features up to date with the book: re-read each side whose top levels changed since the last read, then
+  // recompute. Returns false, having done neither, when no top level changed.
+  bool Update(){
+   ++updates_;
+   bool bids = stale_ || sides_[0].version != book_.TopVersion(OrderSide::Buy);
+   bool asks = stale_ || sides_[1].version != book_.TopVersion(OrderSide::Sell);
+   if (!bids && !asks){
+    return false;
+   }
+   if (bids){
+    Read(OrderSide::Buy, sides_[0]);
+   }
+   if (asks){
+    Read(OrderSide::Sell, sides_[1]);
+   }
+   stale_ = false;
+   Compute();
+   return true;
+  }
+
+  // Make the next Update re-read both sides, e.g. after swapping the book's contents wholesale
+  void Invalidate(){ stale_ = true; }
+
+  const BookFeatures& Features() const { return features_; }
+  std::size_t Levels() const { return levels_; }
+
+  // The levels of one side as last read, best first: Count() entries of each array
+  std::size_t Count(OrderSide side) const { return Of(side).count; }
+  const double* Prices(OrderSide side) const { return Of(side).prices; }
+  const double* Quantities(OrderSide side) const { return Of(side).quantities; }
+  const double* CumulativeQuantities(OrderSide side) const { return Of(side).cumulative; }   // Quantity at this level or better
+
+  std::uint64_t Updates() const { return updates_; }
+  std::uint64_t Reads() const { return reads_; }             // Sides re-read from the book
+  std::uint64_t Recomputes() const { return recomputes_; }
+
+ private:
+  struct SideLevels{
+   alignas(32) double prices[kMaxAnalyticsLevels]{};        // Zero past count, up to a multiple of 4
+   alignas(32) double quantities[kMaxAnalyticsLevels]{};
+   double cumulative[kMaxAnalyticsLevels]{};
+   Price book_prices[kMaxAnalyticsLevels]{};
+   Quantity book_quantities[kMaxAnalyticsLevels]{};
+   std::size_t count{0};
+   double depth{0};
+   double notional{0};
+   std::uint64_t version{0};
+  };
+
+  const SideLevels& Of(OrderSide side) const { return sides_[side == OrderSide::Buy ? 0 : 1]; }
+
+  void Read(OrderSide side, SideLevels& out){
+   ++reads_;
+   out.version = book_.TopVersion(side);
+   std::size_t count = book_.GetTopLevels(side, levels_, out.book_prices, out.book_quantities);
+   std::size_t padded = (std::max(count, out.count) + 3) & ~std::size_t{3};   // Also clears what a deeper read left
+   double cumulative = 0;
+   for (std::size_t i = 0; i < padded; ++i){
+    bool present = i < count;
+    out.prices[i] = present ? static_cast<double>(out.book_prices[i]) : 0.0;
+    out.quantities[i] = present ? static_cast<double>(out.book_quantities[i]) : 0.0;
+    cumulative += out.quantities[i];
+    out.cumulative[i] = cumulative;
+   }
+   out.count = count;
+   analytics_detail::SumAndDot(out.prices, out.quantities, (count + 3) & ~std::size_t{3}, out.depth, out.notional);
+  }
+
+  void Compute(){
+   ++recomputes_;
+   constexpr double kNaN = std::numeric_limits<double>::quiet_NaN();
+   const SideLevels& bids = sides_[0];
+   const SideLevels& asks = sides_[1];
+   features_.bid_depth = bids.depth;
+   features_.ask_depth = asks.depth;
+   features_.bid_vwap = bids.count == 0 ? kNaN : bids.notional / bids.depth;
+   features_.ask_vwap = asks.count == 0 ? kNaN : asks.notional / asks.depth;
+   double total = bids.depth + asks.depth;
+   features_.imbalance = total == 0 ? 0.0 : (bids.depth - asks.depth) / total;
+   if (bids.count == 0 || asks.count == 0){
+    features_.microprice = kNaN;
+   }
+   else {
+    double bid_quantity = bids.quantities[0];
+    double ask_quantity = asks.quantities[0];
+    features_.microprice = (bids.prices[0] * ask_quantity + asks.prices[0] * bid_quantity) / (bid_quantity + ask_quantity);
+   }
+  }
+
+  Book& book_;
+  std::size_t levels_;
+  SideLevels sides_[2];           // Buy, sell
+  BookFeatures features_;
+  bool stale_{true};
+  std::uint64_t updates_{0};
+  std::uint64_t reads_{0};
+  std::uint64_t recomputes_{0};
+};
+
+
+// Columnar feature stream. File layout: a FeatureFileHeader, then one array of `rows` values per FeatureColumn, each
+// starting on a 64-byte boundary at the offset the header gives: the timestamp column is uint64, the others double.
+// The arrays are native byte order, so a column can be memory-mapped straight into an analysis tool.
+
+enum class FeatureColumn : std::uint8_t{
+ Timestamp,
+ Microprice,
+ Imbalance,
+ BidDepth,
+ AskDepth,
+ BidVwap,
+ AskVwap,
+};
+
+constexpr std::size_t kFeatureColumns = 7;
+
+struct FeatureFileHeader{
+ char magic[8];                        // "OBFEAT01"
+ std::uint64_t rows;
+ std::uint64_t offsets[kFeatureColumns];   // From the start of the file, indexed by FeatureColumn
+};
+
+static_assert(sizeof(FeatureFileHeader) == 72, "FeatureFileHeader is an on-disk format");
+
+constexpr char kFeatureMagic[8] = {'O', 'B', 'F', 'E', 'A', 'T', '0', '1'};
+
+class FeatureColumns{
+ public:
+  void Reserve(std::size_t rows){
+   timestamps_.reserve(rows);
+   for (std::vector<double>& column : values_){
+    column.reserve(rows);
+   }
+  }
+
+  void Append(std::uint64_t timestamp_ns, const BookFeatures& features){
+   timestamps_.push_back(timestamp_ns);
+   values_[0].push_back(features.microprice);
+   values_[1].push_back(features.imbalance);
+   values_[2].push_back(features.bid_depth);
+   values_[3].push_back(features.ask_depth);
+   values_[4].push_back(features.bid_vwap);
+   values_[5].push_back(features.ask_vwap);
+  }
+
+  void Clear(){
+   timestamps_.clear();
+   for (std::vector<double>& column : values_){
+    column.clear();
+   }
+  }
+
+  std::size_t Rows() const { return timestamps_.size(); }
+  const std::vector<std::uint64_t>& Timestamps() const { return timestamps_; }
+
+  // One of the feature columns (not FeatureColumn::Timestamp)
+  const std::vector<double>& Values(FeatureColumn column) const {
+   if (column == FeatureColumn::Timestamp){
+    throw std::logic_error("FeatureColumns: timestamps are not a double column");
+   }
+   return values_[static_cast<std::size_t>(column) - 1];
+  }
+
+  // Write every row to path; returns the file size. Throws std::runtime_error if the file cannot be written.
+  std::size_t Write(const std::string& path) const {
+   constexpr std::size_t kAlignment = 64;
+   FeatureFileHeader header{};
+   std::memcpy(header.magic, kFeatureMagic, sizeof(header.magic));
+   header.rows = Rows();
+   std::uint64_t offset = sizeof(header);
+   for (std::size_t i = 0; i < kFeatureColumns; ++i){
+    offset = (offset + kAlignment - 1) / kAlignment * kAlignment;
+    header.offsets[i] = offset;
+    offset += Rows() * sizeof(double);   // Both column types are 8 bytes wide
+   }
+
+   std::FILE* file = std::fopen(path.c_str(), "wb");
+   if (file == nullptr){
+    throw std::runtime_error("FeatureColumns: cannot create " + path);
+   }
+   static const char kPadding[kAlignment] = {};
+   bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+   std::uint64_t written = sizeof(header);
+   for (std::size_t i = 0; i < kFeatureColumns && ok; ++i){
+    const void* data = i == 0 ? static_cast<const void*>(timestamps_.data()) : static_cast<const void*>(values_[i - 1].data());
+    ok = std::fwrite(kPadding, 1, header.offsets[i] - written, file) == header.offsets[i] - written
+     && std::fwrite(data, sizeof(double), Rows(), file) == Rows();
+    written = header.offsets[i] + Rows() * sizeof(double);
+   }
+   ok = std::fclose(file) == 0 && ok;
+   if (!ok){
+    throw std::runtime_error("FeatureColumns: cannot write " + path);
+   }
+   return written;
+  }
+
+ private:
+  std::vector<std::uint64_t> timestamps_;
+  std::vector<double> values_[kFeatureColumns - 1];   // By FeatureColumn - 1
+};
+
+#endif // BOOK_ANALYTICS_H
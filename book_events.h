@@ -0,0 +1,141 @@
+#ifndef BOOK_EVENTS_H
+#define BOOK_EVENTS_H
+
+#include "orders.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+
+// Event sinks for OrderBook.
+// The sink overloads (ProcessNewOrder(order, sink), Modify(modify, sink), TryCancelOrder(id, sink), ReduceOrder(id, qty, sink),
+// ExecuteOrder(id, qty, sink)) report every outcome through a caller-supplied sink instead of returning a Trades vector,
+// so nothing is allocated per call.
+// A sink is any type with these five members; derive from BookEventSink and shadow the ones you need. Calls are
+// resolved at compile time, so unused callbacks cost nothing.
+
+
+enum class RejectReason : std::uint8_t{
+ DuplicateOrderId,   // An order with this id is already resting
+ CannotFill,         // Immediate order with nothing to match against, or fill-or-kill without enough liquidity
+ NotInAuction,       // Fill-or-kill or market order in an auction batch
+ Expired,            // Timed order whose expiry (or, for a day order, the session close) is not after the book's clock
+ InvalidPrice,       // Price the book's levels cannot hold: off the tick grid, or beyond a ladder's maximum window
+};
+
+// One execution. Maker is the resting order, taker the incoming one; price is the maker's price.
+// Taker id is 0 for executions replayed from a feed (ExecuteOrder), where the aggressor is unknown.
+// Auction fills (Uncross/ProcessBatch) all trade at the clearing price and have no aggressor: the ask is reported as
+// maker, the bid as taker, with aggressor_side Buy.
+struct FillEvent{
+ OrderId maker_order_id;
+ OrderId taker_order_id;
+ Price price;
+ Quantity quantity;
+ OrderSide aggressor_side;
+ bool auction{false};      // Fill from an auction uncross
+};
+
+struct BookEventSink{
+ void OnAccepted(const Order&) { }                 // Order passed validation and entered the book
+ void OnModified(const Order&) { }                 // Resting order amended; carries its new side, price and remaining quantity
+ void OnRejected(const Order&, RejectReason) { }   // Order did not enter the book
+ void OnFill(const FillEvent&) { }
+ void OnCancelled(OrderId, Quantity) { }           // Order left the book unfilled; quantity is what was cancelled
+};
+
+
+// Adapter behind the Trades-returning overloads: rebuilds the two-sided Trade records from fills.
+// Each TradeInfo carries the counterparty's price, as the original MatchOrders reported it.
+class TradesSink : public BookEventSink{
+ public:
+  TradesSink(Trades& trades, Price taker_price): trades_ {trades}, taker_price_ {taker_price} { }
+
+  void OnFill(const FillEvent& fill){
+   bool buy_aggressor = fill.aggressor_side == OrderSide::Buy;
+   OrderId bid_id = buy_aggressor ? fill.taker_order_id : fill.maker_order_id;
+   OrderId ask_id = buy_aggressor ? fill.maker_order_id : fill.taker_order_id;
+   Price ask_price = buy_aggressor ? fill.price : taker_price_;
+   Price bid_price = buy_aggressor ? taker_price_ : fill.price;
+   trades_.push_back(Trade(
+    TradeInfo{bid_id, ask_id, ask_price, fill.quantity},
+    TradeInfo{ask_id, bid_id, bid_price, fill.quantity}
+   ));
+  }
+
+ private:
+  Trades& trades_;
+  Price taker_price_;
+};
+
+
+// Tagged book event for queued delivery
+enum class BookEventType : std::uint8_t{
+ Accepted,
+ Rejected,
+ Fill,
+ Cancelled,
+ Modified,
+};
+
+struct BookEvent{
+ BookEventType type;
+ OrderSide side;           // Order side (Accepted/Rejected/Modified), aggressor side (Fill)
+ RejectReason reason;      // Rejected only
+ Price price;
+ Quantity quantity;
+ OrderId order_id;         // Maker id for fills
+ OrderId counterparty_id;  // Taker id for fills
+};
+
+// Preallocated ring of BookEvents: the book pushes, the caller drains with Pop between calls.
+// Capacity must be a power of two. When full, new events are counted in Dropped() instead of overwriting.
+template <std::size_t Capacity>
+class BookEventRing : public BookEventSink{
+ static_assert((Capacity & (Capacity - 1)) == 0, "BookEventRing capacity must be a power of two");
+
+ public:
+  void OnAccepted(const Order& order){
+   Push(BookEvent{BookEventType::Accepted, order.GetOrderSide(), RejectReason{}, order.GetPrice(), order.GetRemainingQuantity(), order.GetOrderId(), 0});
+  }
+  void OnModified(const Order& order){
+   Push(BookEvent{BookEventType::Modified, order.GetOrderSide(), RejectReason{}, order.GetPrice(), order.GetRemainingQuantity(), order.GetOrderId(), 0});
+  }
+  void OnRejected(const Order& order, RejectReason reason){
+   Push(BookEvent{BookEventType::Rejected, order.GetOrderSide(), reason, order.GetPrice(), order.GetRemainingQuantity(), order.GetOrderId(), 0});
+  }
+  void OnFill(const FillEvent& fill){
+   Push(BookEvent{BookEventType::Fill, fill.aggressor_side, RejectReason{}, fill.price, fill.quantity, fill.maker_order_id, fill.taker_order_id});
+  }
+  void OnCancelled(OrderId order_id, Quantity quantity){
+   Push(BookEvent{BookEventType::Cancelled, OrderSide{}, RejectReason{}, 0, quantity, order_id, 0});
+  }
+
+  bool Pop(BookEvent& event){
+   if (tail_ == head_){
+    return false;
+   }
+   event = events_[tail_++ & (Capacity - 1)];
+   return true;
+  }
+
+  bool Empty() const { return tail_ == head_; }
+  std::size_t Size() const { return head_ - tail_; }
+  std::size_t Dropped() const { return dropped_; }
+
+ private:
+  std::array<BookEvent, Capacity> events_{};
+  std::size_t head_{0};
+  std::size_t tail_{0};
+  std::size_t dropped_{0};
+
+  void Push(const BookEvent& event){
+   if (head_ - tail_ == Capacity){
+    ++dropped_;
+    return;
+   }
+   events_[head_++ & (Capacity - 1)] = event;
+  }
+};
+
+#endif // BOOK_EVENTS_H
@@ -0,0 +1,46 @@
+#ifndef BOOK_HASH_H
+#define BOOK_HASH_H
+
+#include "orders.h"
+#include <cstddef>
+#include <cstdint>
+
+
+// Zobrist-style hash of book depth: the XOR over the price levels of one side (or both) of a 64-bit key of
+// (side, price, aggregate quantity). XOR makes it independent of order and incremental: a level whose quantity goes
+// from a to b is updated with LevelHash(a) ^ LevelHash(b), and an absent level (quantity 0) contributes nothing, so
+// creating and erasing a level are the same update. Prices and quantities are unbounded, so the keys are computed
+// by a 64-bit mixer rather than drawn from a random table. Books with the same levels hash the same whatever their
+// order history or level backend; books with different levels collide with probability about 2^-64.
+
+namespace book_hash_detail {
+
+ // splitmix64 finalizer: every input bit affects every output bit
+ inline std::uint64_t Mix(std::uint64_t x){
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+ }
+
+} // namespace book_hash_detail
+
+
+// Key of one level; 0 for an empty one. Price and quantity are packed into one word and mixed once: the mixer is a
+// bijection, so levels of one side never share a key.
+inline std::uint64_t LevelHash(OrderSide side, Price price, Quantity quantity){
+ std::uint64_t level = static_cast<std::uint64_t>(static_cast<std::uint32_t>(price)) << 32 | quantity;
+ return quantity == 0 ? 0 : book_hash_detail::Mix(level ^ (side == OrderSide::Sell ? 0x9E3779B97F4A7C15ULL : 0));
+}
+
+// Hash of `count` levels of one side as parallel arrays (e.g. from GetTopLevels)
+inline std::uint64_t HashLevels(OrderSide side, const Price* prices, const Quantity* quantities, std::size_t count){
+ std::uint64_t hash = 0;
+ for (std::size_t i = 0; i < count; ++i){
+  hash ^= LevelHash(side, prices[i], quantities[i]);
+ }
+ return hash;
+}
+
+#endif // BOOK_HASH_H
@@ -0,0 +1,234 @@
+#ifndef BOOK_METRICS_H
+#define BOOK_METRICS_H
+
+#include "tsc_clock.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+// Hot-path instrumentation for BasicOrderBook, switched at compile time.
+// Build with -DORDERBOOK_METRICS=1 and every book times its adds, sweeps, cancels and level creates/erases with
+// unfenced TSC reads into log-linear histograms, and counts levels created and erased, sweeps, orders matched per sweep
+// and rejected duplicate ids. Without it (the default) BookMetrics is an empty class whose members are empty inline
+// functions, so the book compiles to the same code as before.
+// A TSC read costs 7-25 ns depending on the CPU and hypervisor, more than a whole cancel, so each operation kind is
+// timed once every 2^ORDERBOOK_METRICS_SAMPLE_SHIFT calls (default 64): the histograms hold a uniform sample, while
+// call counts and counters are exact. Set the shift to 0 to time every call.
+// The book's thread is the only writer; it updates each counter with a plain relaxed load and store, no locked
+// instruction. Any other thread may call Read() at any time: each counter is read atomically, but a snapshot taken
+// mid-operation can be one event ahead in some counters and not others.
+// Set the switch identically in every translation unit that includes the book.
+
+#ifndef ORDERBOOK_METRICS
+#define ORDERBOOK_METRICS 0
+#endif
+
+#ifndef ORDERBOOK_METRICS_SAMPLE_SHIFT
+#define ORDERBOOK_METRICS_SAMPLE_SHIFT 6
+#endif
+
+
+enum class BookOp : std::uint8_t{
+ Add,           // ProcessNewOrder, including its sweep and level create
+ Match,         // Sweep of the opposite side by an aggressive order
+ Cancel,        // TryCancelOrder, including its level erase
+ LevelCreate,   // Price level insert (only when the level was new)
+ LevelErase,    // Price level removal once its last order left
+};
+
+enum class BookCounter : std::uint8_t{
+ LevelsCreated,
+ LevelsErased,
+ Sweeps,
+ OrdersMatched,        // Resting orders filled by sweeps, fully or partly
+ DuplicatesRejected,
+};
+
+constexpr std::size_t kBookOps = 5;
+constexpr std::size_t kBookCounters = 5;
+
+
+// Copy of a LogHistogram. Values are in the histogram's unit (TSC ticks for BookOp timings; TscClock::ToNs converts).
+struct HistogramSnapshot{
+ static constexpr std::size_t kSubBits = 3;                              // 8 buckets per power of two
+ static constexpr std::size_t kBuckets = (65 - kSubBits) << kSubBits;    // Covers the whole uint64_t range
+
+ std::uint64_t buckets[kBuckets]{};
+ std::uint64_t count{0};
+ std::uint64_t sum{0};
+ std::uint64_t max{0};
+
+ // Values below 16 get a bucket each; above, each power of two is split into 8 equal buckets, so a bucket is at most
+ // 12.5% wider than its lower bound
+ static std::size_t BucketOf(std::uint64_t value){
+  if (value < (2u << kSubBits)){
+   return static_cast<std::size_t>(value);
+  }
+  std::size_t exponent = 63 - static_cast<std::size_t>(__builtin_clzll(value));
+  return ((exponent - kSubBits) << kSubBits) + static_cast<std::size_t>(value >> (exponent - kSubBits));
+ }
+
+ static std::uint64_t BucketLow(std::size_t bucket){
+  if (bucket < (2u << kSubBits)){
+   return bucket;
+  }
+  std::size_t exponent = (bucket >> kSubBits) + kSubBits - 1;
+  return ((std::uint64_t{1} << kSubBits) + (bucket & ((1u << kSubBits) - 1))) << (exponent - kSubBits);
+ }
+
+ double Mean() const { return count == 0 ? 0 : static_cast<double>(sum) / static_cast<double>(count); }
+
+ // Upper bound of the bucket holding the q-th quantile (0 <= q <= 1), capped at the largest value recorded
+ std::uint64_t Percentile(double q) const {
+  if (count == 0){
+   return 0;
+  }
+  std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(count - 1)) + 1;
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < kBuckets; ++i){
+   seen += buckets[i];
+   if (seen >= rank){
+    std::uint64_t high = i + 1 < kBuckets ? BucketLow(i + 1) - 1 : UINT64_MAX;
+    return high < max ? high : max;
+   }
+  }
+  return max;
+ }
+};
+
+
+// Fixed-size log-linear histogram with one writer thread and lock-free readers
+class LogHistogram{
+ public:
+  // Writer thread only
+  void Record(std::uint64_t value){
+   Bump(buckets_[HistogramSnapshot::BucketOf(value)], 1);
+   Bump(sum_, value);
+   if (value > max_.load(std::memory_order_relaxed)){
+    max_.store(value, std::memory_order_relaxed);
+   }
+  }
+
+  // Any thread
+  void Read(HistogramSnapshot& out) const {
+   out.count = 0;
+   for (std::size_t i = 0; i < HistogramSnapshot::kBuckets; ++i){
+    out.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    out.count += out.buckets[i];
+   }
+   out.sum = sum_.load(std::memory_order_relaxed);
+   out.max = max_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<std::uint64_t> buckets_[HistogramSnapshot::kBuckets]{};
+  std::atomic<std::uint64_t> sum_{0};
+  std::atomic<std::uint64_t> max_{0};
+
+  // Single writer: a plain load and store, no read-modify-write
+  static void Bump(std::atomic<std::uint64_t>& counter, std::uint64_t amount){
+   counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+  }
+
+  friend class BookMetrics;
+};
+
+
+struct MetricsSnapshot{
+ HistogramSnapshot ops[kBookOps];     // Indexed by BookOp, in TSC ticks; sampled (see ORDERBOOK_METRICS_SAMPLE_SHIFT)
+ std::uint64_t calls[kBookOps]{};     // Every call, sampled or not (LevelCreate: level lookups that may create)
+ HistogramSnapshot sweep_matches;     // Orders matched per sweep
+ std::uint64_t counters[kBookCounters]{};
+
+ const HistogramSnapshot& Op(BookOp op) const { return ops[static_cast<std::size_t>(op)]; }
+ std::uint64_t Counter(BookCounter counter) const { return counters[static_cast<std::size_t>(counter)]; }
+};
+
+
+#if ORDERBOOK_METRICS
+
+class BookMetrics{
+ public:
+  static constexpr bool kEnabled = true;
+
+  static constexpr std::uint64_t kSampleMask = (std::uint64_t{1} << ORDERBOOK_METRICS_SAMPLE_SHIFT) - 1;
+
+  // Records the ticks from construction to destruction into histogram, if there is one (the call was sampled)
+  class Timer{
+   public:
+    explicit Timer(LogHistogram* histogram): histogram_ {histogram}, start_ {histogram == nullptr ? 0 : TscClock::Now()} { }
+    ~Timer(){
+     if (histogram_ != nullptr){
+      Finish(histogram_, start_);
+     }
+    }
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+   private:
+    LogHistogram* histogram_;
+    std::uint64_t start_;
+
+    // Out of line: inlining the record into every timed operation cost more than the rare sampled calls it saved
+    __attribute__((noinline)) static void Finish(LogHistogram* histogram, std::uint64_t start){ histogram->Record(TscClock::Now() - start); }
+  };
+
+  // Writer (book) thread only. Sample() counts a call of op and says whether to time it.
+  bool Sample(BookOp op){
+   std::atomic<std::uint64_t>& calls = calls_[static_cast<std::size_t>(op)];
+   std::uint64_t count = calls.load(std::memory_order_relaxed);
+   calls.store(count + 1, std::memory_order_relaxed);
+   return (count & kSampleMask) == 0;
+  }
+  Timer Time(BookOp op){ return Timer(Sample(op) ? &ops_[static_cast<std::size_t>(op)] : nullptr); }
+  void Record(BookOp op, std::uint64_t ticks){ ops_[static_cast<std::size_t>(op)].Record(ticks); }
+  void Count(BookCounter counter, std::uint64_t amount = 1){ LogHistogram::Bump(counters_[static_cast<std::size_t>(counter)], amount); }
+  void RecordSweep(std::uint64_t matched){
+   sweep_matches_.Record(matched);
+   Count(BookCounter::Sweeps);
+   Count(BookCounter::OrdersMatched, matched);
+  }
+
+  // Any thread
+  void Read(MetricsSnapshot& out) const {
+   for (std::size_t i = 0; i < kBookOps; ++i){
+    ops_[i].Read(out.ops[i]);
+    out.calls[i] = calls_[i].load(std::memory_order_relaxed);
+   }
+   sweep_matches_.Read(out.sweep_matches);
+   for (std::size_t i = 0; i < kBookCounters; ++i){
+    out.counters[i] = counters_[i].load(std::memory_order_relaxed);
+   }
+  }
+
+ private:
+  LogHistogram ops_[kBookOps];
+  LogHistogram sweep_matches_;
+  std::atomic<std::uint64_t> calls_[kBookOps]{};
+  std::atomic<std::uint64_t> counters_[kBookCounters]{};
+};
+
+#else
+
+class BookMetrics{
+ public:
+  static constexpr bool kEnabled = false;
+
+  struct Timer{
+   ~Timer(){ }   // Not trivial, so an unused timer draws no warning
+  };
+
+  bool Sample(BookOp){ return false; }
+  Timer Time(BookOp){ return Timer{}; }
+  void Record(BookOp, std::uint64_t){ }
+  void Count(BookCounter, std::uint64_t = 1){ }
+  void RecordSweep(std::uint64_t){ }
+
+  // Leaves out zeroed
+  void Read(MetricsSnapshot& out) const { out = MetricsSnapshot{}; }
+};
+
+#endif // ORDERBOOK_METRICS
+
+#endif // BOOK_METRICS_H
@@ -0,0 +1,168 @@
+#ifndef BOOK_SNAPSHOT_H
+#define BOOK_SNAPSHOT_H
+
+#include "book_events.h"
+#include "orders.h"
+#include "triple_buffer.h"
+#include "tsc_clock.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Fixed-size view of a book for display: top levels, a tape of recent trades and throughput/latency figures.
+// The matching thread fills one through SnapshotRecorder and hands it over a TripleBuffer, so a reader (e.g. the GUI
+// render loop) never blocks it and never sees a half-written snapshot.
+
+
+constexpr std::size_t kSnapshotDepth = 20;   // Levels per side
+constexpr std::size_t kSnapshotTape = 64;    // Most recent trades
+
+struct TapeTrade{
+ std::uint64_t timestamp_ns;   // Feed time of the event that traded
+ Price price;
+ Quantity quantity;
+ OrderSide aggressor_side;
+};
+
+struct PerformanceStats{
+ std::uint64_t events{0};        // Events applied since the recorder started
+ double events_per_sec{0};       // Over the last publish interval
+ double latency_p50_ns{0};       // Per-event apply latency over the recent sample window
+ double latency_p99_ns{0};
+ double latency_p999_ns{0};
+ double latency_max_ns{0};
+};
+
+struct BookSnapshot{
+ std::uint64_t sequence{0};      // Increments with every publish
+ std::uint64_t timestamp_ns{0};  // Feed time of the last applied event
+ std::array<LevelInfo, kSnapshotDepth> bids{};
+ std::array<LevelInfo, kSnapshotDepth> asks{};
+ std::uint32_t bid_levels{0};
+ std::uint32_t ask_levels{0};
+ std::array<TapeTrade, kSnapshotTape> trades{};  // Newest first
+ std::uint32_t trade_count{0};
+ std::size_t resting_orders{0};
+ PerformanceStats performance;
+};
+
+
+// Matching-thread side of a snapshot channel. Pass it as the book's event sink to record fills on the tape, report each
+// event's apply latency with RecordLatency, and call Tick after each event: every publish_interval_ns it builds a
+// snapshot in the channel's write buffer and publishes it. Nothing allocates after construction.
+class SnapshotRecorder : public BookEventSink{
+ public:
+  explicit SnapshotRecorder(TripleBuffer<BookSnapshot>& channel, std::uint64_t publish_interval_ns = 16000000):
+   channel_ {channel},
+   publish_interval_ticks_ {static_cast<std::uint64_t>(publish_interval_ns * TscClock::TicksPerNs())},
+   last_publish_ticks_ {TscClock::Now()}
+  {
+   latency_window_.reserve(kLatencyWindow);
+   latency_scratch_.reserve(kLatencyWindow);
+   depth_.getBids().reserve(kSnapshotDepth);
+   depth_.getAsks().reserve(kSnapshotDepth);
+  }
+
+  void OnFill(const FillEvent& fill){
+   tape_[tape_head_++ % kSnapshotTape] = TapeTrade{timestamp_ns_, fill.price, fill.quantity, fill.aggressor_side};
+  }
+
+  // Feed time of the event about to be applied (stamps trades on the tape)
+  void SetTime(std::uint64_t timestamp_ns){ timestamp_ns_ = timestamp_ns; }
+
+  // Apply latency of one event in TscClock ticks. The most recent kLatencyWindow samples feed the percentiles.
+  void RecordLatency(std::uint64_t ticks){
+   if (latency_window_.size() < kLatencyWindow){
+    latency_window_.push_back(ticks);
+   }
+   else {
+    latency_window_[latency_next_++ % kLatencyWindow] = ticks;
+   }
+  }
+
+  // Count one applied event; publishes a snapshot if the interval has elapsed. Returns true if it published.
+  template <typename Book>
+  bool Tick(const Book& book){
+   ++events_;
+   if ((events_ & (kClockCheckInterval - 1)) != 0){
+    return false; // Read the clock only every few events
+   }
+   if (TscClock::Now() - last_publish_ticks_ < publish_interval_ticks_){
+    return false;
+   }
+   Publish(book);
+   return true;
+  }
+
+  // Build and publish a snapshot now
+  template <typename Book>
+  void Publish(const Book& book){
+   std::uint64_t now = TscClock::Now();
+   BookSnapshot& snapshot = channel_.WriteBuffer();
+   snapshot.sequence = ++sequence_;
+   snapshot.timestamp_ns = timestamp_ns_;
+
+   book.GetDepth(kSnapshotDepth, depth_);
+   snapshot.bid_levels = static_cast<std::uint32_t>(depth_.getBids().size());
+   snapshot.ask_levels = static_cast<std::uint32_t>(depth_.getAsks().size());
+   std::copy(depth_.getBids().begin(), depth_.getBids().end(), snapshot.bids.begin());
+   std::copy(depth_.getAsks().begin(), depth_.getAsks().end(), snapshot.asks.begin());
+   snapshot.resting_orders = book.Size();
+
+   std::size_t trades = std::min<std::size_t>(tape_head_, kSnapshotTape);
+   for (std::size_t i = 0; i < trades; ++i){
+    snapshot.trades[i] = tape_[(tape_head_ - 1 - i) % kSnapshotTape];
+   }
+   snapshot.trade_count = static_cast<std::uint32_t>(trades);
+
+   PerformanceStats& performance = snapshot.performance;
+   double seconds = TscClock::ToNs(now - last_publish_ticks_) / 1e9;
+   performance.events = events_;
+   performance.events_per_sec = seconds > 0 ? static_cast<double>(events_ - last_publish_events_) / seconds : 0;
+   FillPercentiles(performance);
+
+   channel_.Publish();
+   last_publish_ticks_ = now;
+   last_publish_events_ = events_;
+  }
+
+ private:
+  static constexpr std::size_t kLatencyWindow = 8192;
+  static constexpr std::uint64_t kClockCheckInterval = 256; // Power of two
+
+  TripleBuffer<BookSnapshot>& channel_;
+  std::uint64_t publish_interval_ticks_;
+  std::uint64_t last_publish_ticks_;
+  std::uint64_t last_publish_events_{0};
+  std::uint64_t events_{0};
+  std::uint64_t sequence_{0};
+  std::uint64_t timestamp_ns_{0};
+  std::array<TapeTrade, kSnapshotTape> tape_{};
+  std::uint64_t tape_head_{0};
+  std::vector<std::uint64_t> latency_window_;
+  std::vector<std::uint64_t> latency_scratch_;
+  std::size_t latency_next_{0};
+  OrderBookLevelInfos depth_;
+
+  void FillPercentiles(PerformanceStats& performance){
+   if (latency_window_.empty()){
+    performance.latency_p50_ns = performance.latency_p99_ns = performance.latency_p999_ns = performance.latency_max_ns = 0;
+    return;
+   }
+   latency_scratch_.assign(latency_window_.begin(), latency_window_.end());
+   auto at = [this](double quantile){
+    auto nth = latency_scratch_.begin() + static_cast<std::ptrdiff_t>(quantile * static_cast<double>(latency_scratch_.size() - 1));
+    std::nth_element(latency_scratch_.begin(), nth, latency_scratch_.end());
+    return TscClock::ToNs(*nth);
+   };
+   performance.latency_p50_ns = at(0.50);
+   performance.latency_p99_ns = at(0.99);
+   performance.latency_p999_ns = at(0.999);
+   performance.latency_max_ns = TscClock::ToNs(*std::max_element(latency_scratch_.begin(), latency_scratch_.end()));
+  }
+};
+
+#endif // BOOK_SNAPSHOT_H
@@ -0,0 +1,196 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "journal.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+// Binary checkpoint of a book's full L3 state, laid out to be used straight from a read-only mapping:
+//   CheckpointHeader
+//   CheckpointLevel[bid_levels]   bids, best first
+//   CheckpointLevel[ask_levels]   asks, best first
+//   CheckpointOrder[orders]       every resting order, level by level in the order above, each level oldest first
+// Levels carry their aggregates and order count, so a reader can walk depth without touching the orders, and the
+// orders of level i follow those of level i - 1. Restoring appends the orders in file order, which rebuilds every FIFO
+// queue and the id index exactly. `sequence` is the last journal sequence the state includes. The header also keeps the
+// book's clock and session close, and each good-till-date or day order its expiry, so timed orders come back armed.
+
+
+struct CheckpointHeader{
+ char magic[8];               // "OBCKPT02"
+ std::uint64_t sequence;
+ Timestamp now;               // Book clock (Now())
+ Timestamp session_close;
+ std::uint64_t bid_levels;
+ std::uint64_t ask_levels;
+ std::uint64_t orders;
+ std::uint64_t checksum;      // Checksum64 of everything after the header
+};
+
+struct CheckpointLevel{
+ Price price;
+ Quantity total_quantity;
+ std::uint32_t order_count;
+ std::uint32_t reserved;
+};
+
+struct CheckpointOrder{
+ OrderId order_id;
+ Price price;
+ Quantity initial_quantity;
+ Quantity remaining_quantity;
+ OrderSide side;
+ OrderType type;
+ std::uint8_t reserved[2];
+ Timestamp expiry;            // Good-till-date and day orders; 0 otherwise
+};
+
+static_assert(sizeof(CheckpointHeader) == 64, "CheckpointHeader is an on-disk format");
+static_assert(sizeof(CheckpointLevel) == 16, "CheckpointLevel is an on-disk format");
+static_assert(sizeof(CheckpointOrder) == 32, "CheckpointOrder is an on-disk format");
+
+constexpr char kCheckpointMagic[8] = {'O', 'B', 'C', 'K', 'P', 'T', '0', '2'};
+
+
+// Serialize book into path: built in `buffer` (kept by the caller so periodic checkpoints reuse it), written to a
+// temporary file, synced, then renamed over path, so a crash leaves either the old file or the complete new one.
+// Returns the file size.
+template <typename Book>
+std::size_t WriteCheckpoint(const Book& book, std::uint64_t sequence, const std::string& path, std::vector<char>& buffer){
+ std::size_t bid_levels = book.LevelCount(OrderSide::Buy);
+ std::size_t ask_levels = book.LevelCount(OrderSide::Sell);
+ std::size_t levels_bytes = (bid_levels + ask_levels) * sizeof(CheckpointLevel);
+ std::size_t size = sizeof(CheckpointHeader) + levels_bytes + book.Size() * sizeof(CheckpointOrder);
+ buffer.assign(size, 0);
+
+ CheckpointLevel* level_out = reinterpret_cast<CheckpointLevel*>(buffer.data() + sizeof(CheckpointHeader));
+ CheckpointOrder* order_out = reinterpret_cast<CheckpointOrder*>(buffer.data() + sizeof(CheckpointHeader) + levels_bytes);
+ for (OrderSide side : {OrderSide::Buy, OrderSide::Sell}){
+  const void* current = nullptr;
+  book.ForEachOrder(side, [&](const auto& level, const Order& order){
+   if (&level != current){
+    current = &level;
+    *level_out++ = CheckpointLevel{level.price, level.total_quantity, level.order_count, 0};
+   }
+   *order_out++ = CheckpointOrder{order.GetOrderId(), order.GetPrice(), order.GetInitialQuantity(), order.GetRemainingQuantity(),
+    order.GetOrderSide(), order.GetOrderType(), {0, 0}, IsTimed(order.GetOrderType()) ? book.GetExpiry(order.GetOrderId()) : 0};
+  });
+ }
+
+ CheckpointHeader header{};
+ std::memcpy(header.magic, kCheckpointMagic, sizeof(header.magic));
+ header.sequence = sequence;
+ header.now = book.Now();
+ header.session_close = book.SessionClose();
+ header.bid_levels = bid_levels;
+ header.ask_levels = ask_levels;
+ header.orders = book.Size();
+ header.checksum = Checksum64(buffer.data() + sizeof(CheckpointHeader), size - sizeof(CheckpointHeader));
+ std::memcpy(buffer.data(), &header, sizeof(header));
+
+ std::string temporary = path + ".tmp";
+ int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+ if (fd < 0){
+  throw std::runtime_error("WriteCheckpoint: cannot create " + temporary + ": " + std::strerror(errno));
+ }
+ try {
+  journal_detail::WriteAll(fd, buffer.data(), size, temporary);
+ }
+ catch (...){
+  ::close(fd);
+  throw;
+ }
+ bool synced = ::fdatasync(fd) == 0;
+ ::close(fd);
+ if (!synced || ::rename(temporary.c_str(), path.c_str()) != 0){
+  throw std::runtime_error("WriteCheckpoint: cannot commit " + path + ": " + std::strerror(errno));
+ }
+ return size;
+}
+
+
+// Read-only view of a checkpoint file. The constructor checks the magic, the sizes and the checksum, and throws
+// std::runtime_error if any of them is wrong; the arrays are then read in place from the mapping.
+class CheckpointView{
+ public:
+  explicit CheckpointView(const std::string& path):
+   file_ {path.c_str()}
+  {
+   if (file_.Size() < sizeof(CheckpointHeader)){
+    throw std::runtime_error("CheckpointView: " + path + " is truncated");
+   }
+   std::memcpy(&header_, file_.Data(), sizeof(header_));
+   std::size_t expected = sizeof(CheckpointHeader) + (header_.bid_levels + header_.ask_levels) * sizeof(CheckpointLevel)
+    + header_.orders * sizeof(CheckpointOrder);
+   if (std::memcmp(header_.magic, kCheckpointMagic, sizeof(header_.magic)) != 0 || expected != file_.Size()){
+    throw std::runtime_error("CheckpointView: " + path + " is not a complete checkpoint");
+   }
+   if (Checksum64(file_.Data() + sizeof(CheckpointHeader), file_.Size() - sizeof(CheckpointHeader)) != header_.checksum){
+    throw std::runtime_error("CheckpointView: " + path + " fails its checksum");
+   }
+  }
+
+  std::uint64_t Sequence() const { return header_.sequence; }
+  Timestamp Now() const { return header_.now; }
+  Timestamp SessionClose() const { return header_.session_close; }
+  std::size_t LevelCount(OrderSide side) const { return side == OrderSide::Buy ? header_.bid_levels : header_.ask_levels; }
+  std::size_t OrderCount() const { return header_.orders; }
+
+  // Levels of one side, best first
+  const CheckpointLevel* Levels(OrderSide side) const {
+   const CheckpointLevel* levels = reinterpret_cast<const CheckpointLevel*>(file_.Data() + sizeof(CheckpointHeader));
+   return side == OrderSide::Buy ? levels : levels + header_.bid_levels;
+  }
+
+  const CheckpointOrder* Orders() const {
+   return reinterpret_cast<const CheckpointOrder*>(file_.Data() + sizeof(CheckpointHeader)
+    + (header_.bid_levels + header_.ask_levels) * sizeof(CheckpointLevel));
+  }
+
+ private:
+  MappedFile file_;
+  CheckpointHeader header_;
+};
+
+
+// Rebuild a checkpoint into an empty book, clock and session close included. Each level's orders must match its price
+// and order count, and each order must be one the book can restore, otherwise std::runtime_error is thrown.
+template <typename Book>
+void LoadCheckpoint(const CheckpointView& view, Book& book){
+ book.AdvanceTime(view.Now());
+ book.SetSessionClose(view.SessionClose());
+ const CheckpointOrder* order = view.Orders();
+ const CheckpointOrder* end = order + view.OrderCount();
+ for (OrderSide side : {OrderSide::Buy, OrderSide::Sell}){
+  const CheckpointLevel* levels = view.Levels(side);
+  for (std::size_t i = 0; i < view.LevelCount(side); ++i){
+   for (std::uint32_t k = 0; k < levels[i].order_count; ++k, ++order){
+    if (order == end || order->price != levels[i].price || order->side != side || order->remaining_quantity == 0 || order->remaining_quantity > order->initial_quantity){
+     throw std::runtime_error("LoadCheckpoint: orders do not match level " + std::to_string(levels[i].price));
+    }
+    Order restored(order->order_id, order->side, order->price, order->initial_quantity, order->type);
+    restored.Fill(order->initial_quantity - order->remaining_quantity);
+    try {
+     book.Restore(restored, order->expiry);
+    }
+    catch (const std::logic_error& e){
+     throw std::runtime_error(std::string("LoadCheckpoint: ") + e.what());
+    }
+   }
+  }
+ }
+ if (order != end){
+  throw std::runtime_error("LoadCheckpoint: level order counts do not add up to the order count");
+ }
+}
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,219 @@
+#ifndef DURABLE_BOOK_H
+#define DURABLE_BOOK_H
+
+#include "checkpoint.h"
+#include "journal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// Book that survives restarts. Every command is appended to the write-ahead journal before it is applied, and
+// Checkpoint() (or every checkpoint_interval commands) writes the full book to a checkpoint and starts a new journal
+// segment. The directory holds:
+//   checkpoint-<sequence>.ckpt   book state including every command up to <sequence>
+//   journal-<sequence>.wal       commands from <sequence> on
+// Opening the directory loads the newest checkpoint that validates, replays only the journal records after it, cuts off
+// a torn tail left by a crash, and carries on appending. Events from the replay are not reported again.
+// Only committed commands survive a crash: with group commit, publish a command's events only once Durable() covers it
+// (or call Commit() first).
+
+
+struct DurableConfig{
+ std::string directory;
+ LevelConfig levels{};
+ std::size_t capacity_hint{0};           // Expected peak resting orders (a larger checkpoint wins)
+ JournalConfig journal{};
+ std::uint64_t checkpoint_interval{0};   // Commands between automatic checkpoints; 0 checkpoints only on request
+};
+
+// How the last open recovered
+struct RecoveryStats{
+ std::uint64_t checkpoint_sequence{0};   // 0 if no checkpoint was loaded
+ std::size_t checkpoint_orders{0};
+ std::uint64_t replayed{0};              // Journal records applied after the checkpoint
+ std::size_t torn_bytes{0};              // Incomplete tail cut from the last journal segment
+ std::uint64_t failed{0};                // Journal records the book refused with an exception, skipped
+ double checkpoint_seconds{0};
+ double replay_seconds{0};
+};
+
+
+template <typename Book = LadderOrderBook>
+class DurableBook{
+ public:
+  explicit DurableBook(const DurableConfig& config):
+   config_ {config}
+  {
+   Recover();
+  }
+
+  DurableBook(const DurableBook&) = delete;
+  DurableBook& operator=(const DurableBook&) = delete;
+
+  // Journal, then apply. Returns false if the command names an order that is not in the book (see ApplyCommand).
+  // An order at a price the book refuses (see AdmitsCommand) is rejected with InvalidPrice and never journaled.
+  template <typename Sink>
+  bool Apply(const EngineCommand& command, Sink& sink){
+   if (!AdmitsCommand(*book_, command)){
+    sink.OnRejected(Order(command.order_id, command.side, command.price, command.quantity, command.order_type), RejectReason::InvalidPrice);
+    return command.type != EngineCommandType::Modify || book_->FindOrder(command.order_id) != nullptr;
+   }
+   journal_->Append(command);
+   bool known = ApplyCommand(*book_, command, sink);
+   if (config_.checkpoint_interval != 0 && journal_->NextSequence() - checkpoint_sequence_ > config_.checkpoint_interval){
+    Checkpoint();
+   }
+   return known;
+  }
+
+  bool Apply(const EngineCommand& command){
+   BookEventSink sink;
+   return Apply(command, sink);
+  }
+
+  // Make every command applied so far durable
+  void Commit(){ journal_->Commit(); }
+
+  // Commit, write a checkpoint of the current book, start a new journal segment and delete the files it supersedes.
+  // Returns the checkpoint size in bytes (0 if nothing changed since the last one).
+  std::size_t Checkpoint(){
+   journal_->Commit();
+   std::uint64_t sequence = journal_->NextSequence() - 1;
+   if (sequence == checkpoint_sequence_){
+    return 0;
+   }
+   std::size_t size = WriteCheckpoint(*book_, sequence, CheckpointPath(sequence), checkpoint_buffer_);
+   journal_ = std::make_unique<JournalWriter>(SegmentPath(sequence + 1), sequence + 1, config_.journal);
+   journal_detail::SyncDirectory(config_.directory);
+   checkpoint_sequence_ = sequence;
+   // The new checkpoint and segment are durable: older files are no longer needed to recover
+   for (const auto& file : std::filesystem::directory_iterator(config_.directory)){
+    std::uint64_t file_sequence = 0;
+    if ((ParseName(file.path(), "checkpoint-", ".ckpt", file_sequence) && file_sequence < sequence)
+     || (ParseName(file.path(), "journal-", ".wal", file_sequence) && file_sequence <= sequence)){
+     std::filesystem::remove(file.path());
+    }
+   }
+   return size;
+  }
+
+  const Book& GetBook() const { return *book_; }
+  std::uint64_t Sequence() const { return journal_->NextSequence() - 1; }  // Last command applied
+  std::uint64_t Durable() const { return journal_->Committed(); }          // Last command that survives a crash
+  std::uint64_t CheckpointSequence() const { return checkpoint_sequence_; }
+  const RecoveryStats& Recovery() const { return recovery_; }
+
+ private:
+  DurableConfig config_;
+  std::unique_ptr<Book> book_;
+  std::unique_ptr<JournalWriter> journal_;
+  std::uint64_t checkpoint_sequence_{0};
+  std::vector<char> checkpoint_buffer_;
+  RecoveryStats recovery_;
+
+  std::string CheckpointPath(std::uint64_t sequence) const { return FilePath("checkpoint-", sequence, ".ckpt"); }
+  std::string SegmentPath(std::uint64_t sequence) const { return FilePath("journal-", sequence, ".wal"); }
+
+  // Zero-padded so that names sort by sequence
+  std::string FilePath(const char* prefix, std::uint64_t sequence, const char* suffix) const {
+   char name[64];
+   std::snprintf(name, sizeof(name), "%s%020llu%s", prefix, static_cast<unsigned long long>(sequence), suffix);
+   return (std::filesystem::path(config_.directory) / name).string();
+  }
+
+  static bool ParseName(const std::filesystem::path& path, const std::string& prefix, const std::string& suffix, std::uint64_t& sequence){
+   std::string name = path.filename().string();
+   if (name.size() != prefix.size() + 20 + suffix.size() || name.compare(0, prefix.size(), prefix) != 0
+    || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0){
+    return false;
+   }
+   sequence = std::stoull(name.substr(prefix.size(), 20));
+   return true;
+  }
+
+  void Recover(){
+   std::filesystem::create_directories(config_.directory);
+   std::vector<std::uint64_t> checkpoints;
+   std::vector<std::uint64_t> segments;
+   for (const auto& file : std::filesystem::directory_iterator(config_.directory)){
+    std::uint64_t sequence = 0;
+    if (ParseName(file.path(), "checkpoint-", ".ckpt", sequence)){
+     checkpoints.push_back(sequence);
+    }
+    else if (ParseName(file.path(), "journal-", ".wal", sequence)){
+     segments.push_back(sequence);
+    }
+   }
+   std::sort(checkpoints.rbegin(), checkpoints.rend());
+   std::sort(segments.begin(), segments.end());
+
+   // Newest checkpoint that validates; a damaged one falls back to the one before it
+   auto start = std::chrono::steady_clock::now();
+   for (std::uint64_t sequence : checkpoints){
+    try {
+     CheckpointView view(CheckpointPath(sequence));
+     auto book = std::make_unique<Book>(config_.levels, std::max(config_.capacity_hint, view.OrderCount()));
+     LoadCheckpoint(view, *book);
+     book_ = std::move(book);
+     checkpoint_sequence_ = view.Sequence();
+     recovery_.checkpoint_sequence = checkpoint_sequence_;
+     recovery_.checkpoint_orders = view.OrderCount();
+     break;
+    }
+    catch (const std::runtime_error&){
+     continue;
+    }
+   }
+   if (!book_){
+    book_ = std::make_unique<Book>(config_.levels, config_.capacity_hint);
+   }
+   auto loaded = std::chrono::steady_clock::now();
+
+   // Replay the tail. A segment is skipped outright when the next one starts at or before the first needed record.
+   std::uint64_t next = checkpoint_sequence_ + 1;
+   BookEventSink quiet;
+   for (std::size_t i = 0; i < segments.size(); ++i){
+    if (i + 1 < segments.size() && segments[i + 1] <= next){
+     continue;
+    }
+    JournalReader reader(SegmentPath(segments[i]));
+    if (reader.Records() != 0 && reader.FirstSequence() > next){
+     throw std::runtime_error("DurableBook: journal records " + std::to_string(next) + " to "
+      + std::to_string(reader.FirstSequence() - 1) + " are missing");
+    }
+    reader.ForEach([&](const JournalRecord& record){
+     if (record.sequence == next){
+      try {
+       ApplyCommand(*book_, record.Command(), quiet);
+      }
+      catch (const std::logic_error&){
+       ++recovery_.failed; // Refused when it was first applied too; the book is as it was then
+      }
+      ++next;
+      ++recovery_.replayed;
+     }
+    });
+    if (reader.TornBytes() != 0){
+     if (i + 1 != segments.size()){
+      throw std::runtime_error("DurableBook: journal segment " + SegmentPath(segments[i]) + " is damaged before its end");
+     }
+     recovery_.torn_bytes = reader.TornBytes();
+     std::filesystem::resize_file(SegmentPath(segments[i]), reader.ValidBytes());
+    }
+   }
+   recovery_.checkpoint_seconds = std::chrono::duration<double>(loaded - start).count();
+   recovery_.replay_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loaded).count();
+
+   std::string segment = segments.empty() ? SegmentPath(next) : SegmentPath(segments.back());
+   journal_ = std::make_unique<JournalWriter>(segment, next, config_.journal);
+  }
+};
+
+#endif // DURABLE_BOOK_H
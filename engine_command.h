@@ -0,0 +1,77 @@
+#ifndef ENGINE_COMMAND_H
+#define ENGINE_COMMAND_H
+
+#include "ordersApi.h"
+#include <cstdint>
+
+
+// Book command record shared by the matching engine's queues and the write-ahead journal, and the one place that
+// turns a command into a book call.
+
+
+using InstrumentId = std::uint32_t;
+
+enum class EngineCommandType : std::uint8_t{
+ NewOrder,
+ Cancel,
+ Reduce,    // Partial cancel: ReduceOrder(order_id, quantity)
+ Execute,   // Feed execution of a resting order: ExecuteOrder(order_id, quantity)
+ Modify,    // Replace price/quantity/side of a resting order: Modify(ModifyOrder(order_id, side, price, quantity))
+ AdvanceTime,       // Move the book's clock to `time`, expiring the timed orders due by then
+ SetSessionClose,   // Session close for day orders accepted from now on: SetSessionClose(time)
+};
+
+// Fixed-size command record; only the fields the command type needs are read
+struct EngineCommand{
+ OrderId order_id;
+ InstrumentId instrument;
+ Price price;
+ Quantity quantity;
+ EngineCommandType type;
+ OrderSide side;
+ OrderType order_type;
+ Timestamp time;   // NewOrder: good-till-date expiry; AdvanceTime, SetSessionClose: the new clock or close
+};
+
+// Apply one command to a book, reporting outcomes to sink. Clock and session close changes are commands too, so a
+// journal replay decides every expiry as the original run did.
+// Returns false if a Cancel, Reduce, Execute or Modify names an order that is not in the book.
+template <typename Book, typename Sink>
+bool ApplyCommand(Book& book, const EngineCommand& command, Sink& sink){
+ switch (command.type){
+ case EngineCommandType::NewOrder:
+  book.ProcessNewOrder(Order(command.order_id, command.side, command.price, command.quantity, command.order_type), command.time, sink);
+  return true;
+ case EngineCommandType::Cancel:
+  return book.TryCancelOrder(command.order_id, sink);
+ case EngineCommandType::Reduce:
+  return book.ReduceOrder(command.order_id, command.quantity, sink);
+ case EngineCommandType::Execute:
+  return book.ExecuteOrder(command.order_id, command.quantity, sink);
+ case EngineCommandType::Modify:
+  return book.Modify(ModifyOrder(command.order_id, command.side, command.price, command.quantity), sink);
+ case EngineCommandType::AdvanceTime:
+  book.AdvanceTime(command.time, sink);
+  return true;
+ case EngineCommandType::SetSessionClose:
+  book.SetSessionClose(command.time);
+  return true;
+ }
+ return true;
+}
+
+// False for a resting NewOrder, or a Modify that does not cancel, at a price the book's levels refuse (see
+// AdmitsPrice). The book rejects those itself; callers that record or forward commands check first.
+template <typename Book>
+bool AdmitsCommand(const Book& book, const EngineCommand& command){
+ switch (command.type){
+ case EngineCommandType::NewOrder:
+  return !RestsInBook(command.order_type) || book.AdmitsPrice(command.side, command.price);
+ case EngineCommandType::Modify:
+  return command.quantity == 0 || book.AdmitsPrice(command.side, command.price);
+ default:
+  return true;
+ }
+}
+
+#endif // ENGINE_COMMAND_H
@@ -0,0 +1,446 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#include "gateway_protocol.h"
+#include "ordersApi.h"
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// Shared-memory order entry for co-located clients: no sockets, no kernel on the message path.
+// The gateway process creates a POSIX shared memory segment (gateway_protocol.h) with a fixed number of client slots
+// and owns the book. Clients map the segment, claim a slot and write GatewayRequests to its request ring; the gateway
+// polls every connected slot, applies the requests to the book and writes the outcomes to the owning clients'
+// response rings: an Accepted or Rejected for every new order, fills to both sides of every trade, and an error code
+// instead of an exception for anything the book would refuse (an unknown id, a zero quantity, an off-tick price).
+// Prices are untrusted: besides the tick grid, a limit price must lie in the configured band around the reference
+// price and within the reach of the book's price levels (LevelConfig::max_window_ticks for a ladder), so no client can
+// make the book allocate for a price far from the market.
+// Order ids are assigned by the gateway and carry the owner's slot in their low bits, so routing a maker's fill and
+// checking that a cancel comes from the order's owner cost no lookup. A client's resting orders are cancelled when it
+// disconnects, or when the gateway finds its process gone, so a slot is never reused with orders still in the book.
+// A client that stops draining its responses stalls the gateway (backpressure, as in MatchingEngine): size
+// kGatewayRingCapacity for the largest burst a client may leave unread.
+
+
+// POSIX shared memory object mapped read-write into this process
+class SharedMemory{
+ public:
+  // Create the object, replacing a stale one of the same name; the object is unlinked again on destruction
+  SharedMemory(const std::string& name, std::size_t size): name_ {name}, size_ {size}, owner_ {true} {
+   ::shm_unlink(name.c_str());
+   int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+   if (fd < 0){
+    throw std::runtime_error("SharedMemory: cannot create " + name + ": " + std::strerror(errno));
+   }
+   if (::ftruncate(fd, static_cast<off_t>(size)) != 0){
+    ::close(fd);
+    ::shm_unlink(name.c_str());
+    throw std::runtime_error("SharedMemory: cannot size " + name + ": " + std::strerror(errno));
+   }
+   Map(fd, MAP_SHARED | MAP_POPULATE);
+  }
+
+  // Attach to an existing object
+  explicit SharedMemory(const std::string& name): name_ {name} {
+   int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+   if (fd < 0){
+    throw std::runtime_error("SharedMemory: cannot open " + name + ": " + std::strerror(errno));
+   }
+   struct stat info{};
+   if (::fstat(fd, &info) != 0){
+    ::close(fd);
+    throw std::runtime_error("SharedMemory: cannot stat " + name);
+   }
+   size_ = static_cast<std::size_t>(info.st_size);
+   Map(fd, MAP_SHARED);
+  }
+
+  ~SharedMemory(){
+   ::munmap(data_, size_);
+   if (owner_){
+    ::shm_unlink(name_.c_str());
+   }
+  }
+
+  SharedMemory(const SharedMemory&) = delete;
+  SharedMemory& operator=(const SharedMemory&) = delete;
+
+  void* Data() const { return data_; }
+  std::size_t Size() const { return size_; }
+
+ private:
+  std::string name_;
+  void* data_{nullptr};
+  std::size_t size_{0};
+  bool owner_{false};
+
+  void Map(int fd, int flags){
+   void* mapping = size_ == 0 ? MAP_FAILED : ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, flags, fd, 0);
+   ::close(fd); // The mapping keeps the object alive
+   if (mapping == MAP_FAILED){
+    if (owner_){
+     ::shm_unlink(name_.c_str());
+    }
+    throw std::runtime_error("SharedMemory: cannot mmap " + name_);
+   }
+   data_ = mapping;
+  }
+};
+
+
+namespace gateway_detail {
+
+ inline GatewayClientSlot& SlotAt(void* segment, std::size_t index){
+  return reinterpret_cast<GatewayClientSlot*>(static_cast<char*>(segment) + kGatewaySlotsOffset)[index];
+ }
+
+ inline std::size_t CheckClients(std::size_t clients){
+  if (clients == 0 || clients > kGatewayMaxClients){
+   throw std::logic_error("Gateway: clients must be between 1 and " + std::to_string(kGatewayMaxClients));
+  }
+  return clients;
+ }
+
+} // namespace gateway_detail
+
+
+struct GatewayConfig{
+ std::string name{"/orderbook_gateway"};   // Shared memory object name
+ std::size_t clients{16};                  // Client slots, at most kGatewayMaxClients
+ std::size_t batch{64};                    // Requests taken from one client per turn, so no client starves the others
+ LevelConfig levels{};
+ std::size_t capacity_hint{0};
+ Price reference_price{0};                 // Centre of the price band
+ Price price_band{0};                      // Limit prices further than this from reference_price are refused; 0: no band
+};
+
+// Written by the gateway thread only; read them between Polls or after Run
+struct GatewayStats{
+ std::uint64_t requests{0};
+ std::uint64_t rejects{0};
+ std::uint64_t fills{0};
+ std::uint64_t response_stalls{0};     // Times a full response ring made the gateway wait
+ std::uint64_t disconnects{0};
+ std::uint64_t orphans_cancelled{0};   // Resting orders of disconnected clients
+};
+
+
+template <typename Book = LadderOrderBook>
+class Gateway{
+ public:
+  explicit Gateway(const GatewayConfig& config):
+   config_ {config},
+   clients_ {gateway_detail::CheckClients(config.clients)},
+   memory_ {config.name, GatewaySegmentSize(clients_)},
+   book_ {config.levels, config.capacity_hint}
+  {
+   header_ = new (memory_.Data()) GatewaySegmentHeader;
+   std::memcpy(header_->magic, kGatewayMagic, sizeof(kGatewayMagic));
+   header_->version = kGatewayVersion;
+   header_->clients = static_cast<std::uint32_t>(clients_);
+   for (std::size_t i = 0; i < clients_; ++i){
+    new (&Slot(i)) GatewayClientSlot;
+   }
+   header_->ready.store(1, std::memory_order_release);
+  }
+
+  ~Gateway(){ header_->ready.store(0, std::memory_order_release); }
+
+  Gateway(const Gateway&) = delete;
+  Gateway& operator=(const Gateway&) = delete;
+
+  // One pass over the slots: serve up to config.batch requests of every connected client and release the slots of
+  // clients that left. Returns the requests served.
+  std::size_t Poll(){
+   std::size_t served = 0;
+   for (std::size_t i = 0; i < clients_; ++i){
+    GatewayClientSlot& slot = Slot(i);
+    GatewaySlotState state = slot.state.load(std::memory_order_acquire);
+    if (state == GatewaySlotState::Connected){
+     GatewayRequest request;
+     for (std::size_t n = 0; n < config_.batch && slot.requests.TryPop(request); ++n){
+      Serve(i, request);
+      ++served;
+     }
+    }
+    else if (state == GatewaySlotState::Closing){
+     Release(i);
+    }
+   }
+   return served;
+  }
+
+  // Poll until stop is set, backing off while idle. Now and then checks that connected clients are still alive.
+  void Run(const std::atomic<bool>& stop){
+   SpinBackoff backoff;
+   std::uint32_t idle = 0;
+   while (!stop.load(std::memory_order_relaxed)){
+    if (Poll() != 0){
+     backoff.Reset();
+     continue;
+    }
+    if ((++idle & kReapInterval) == 0){
+     Reap();
+    }
+    backoff.Wait();
+   }
+  }
+
+  // Mark the slots of clients whose process has exited as closing; the next Poll cancels their orders
+  void Reap(){
+   for (std::size_t i = 0; i < clients_; ++i){
+    GatewayClientSlot& slot = Slot(i);
+    std::int32_t pid = slot.pid.load(std::memory_order_relaxed);
+    if (slot.state.load(std::memory_order_acquire) == GatewaySlotState::Connected && pid > 0 && ::kill(pid, 0) != 0 && errno == ESRCH){
+     GatewaySlotState connected = GatewaySlotState::Connected;
+     slot.state.compare_exchange_strong(connected, GatewaySlotState::Closing, std::memory_order_acq_rel);
+    }
+   }
+  }
+
+  const Book& GetBook() const { return book_; }
+  const GatewayStats& Stats() const { return stats_; }
+  std::size_t Clients() const { return clients_; }
+
+ private:
+  static constexpr std::uint32_t kReapInterval = (1u << 16) - 1;   // Idle polls between liveness checks, minus one
+
+  // Reports the book's outcomes for one request: to the requesting client, and to the maker's client on fills
+  class ResponseSink : public BookEventSink{
+   public:
+    ResponseSink(Gateway& gateway, std::size_t client, std::uint64_t tag): gateway_ {gateway}, client_ {client}, tag_ {tag} { }
+
+    void OnAccepted(const Order& order){ Reply(GatewayResponseType::Accepted, order); }
+    void OnModified(const Order& order){ Reply(GatewayResponseType::Modified, order); }
+    void OnRejected(const Order& order, RejectReason reason){
+     GatewayResponse response = Response(tag_, order.GetOrderId(), GatewayResponseType::Rejected, order.GetPrice(), order.GetRemainingQuantity(), order.GetOrderSide());
+     response.error = reason == RejectReason::CannotFill ? GatewayError::CannotFill
+      : reason == RejectReason::InvalidPrice ? GatewayError::InvalidPrice : GatewayError::Internal;
+     ++gateway_.stats_.rejects;
+     Send(client_, response);
+    }
+    void OnFill(const FillEvent& fill){
+     OrderSide maker_side = fill.aggressor_side == OrderSide::Buy ? OrderSide::Sell : OrderSide::Buy;
+     GatewayResponse maker = Response(0, fill.maker_order_id, GatewayResponseType::Fill, fill.price, fill.quantity, maker_side);
+     maker.maker = true;
+     ++gateway_.stats_.fills;
+     Send(OwnerOf(fill.maker_order_id), maker);
+     Send(client_, Response(tag_, fill.taker_order_id, GatewayResponseType::Fill, fill.price, fill.quantity, fill.aggressor_side));
+    }
+    void OnCancelled(OrderId order_id, Quantity quantity){
+     GatewayResponse response = Response(tag_, order_id, GatewayResponseType::Cancelled, 0, quantity, OrderSide::Buy);
+     Send(client_, response);
+    }
+
+    std::size_t Sent() const { return sent_; }
+
+   private:
+    Gateway& gateway_;
+    std::size_t client_;
+    std::uint64_t tag_;
+    std::size_t sent_{0};
+
+    void Reply(GatewayResponseType type, const Order& order){
+     Send(client_, Response(tag_, order.GetOrderId(), type, order.GetPrice(), order.GetRemainingQuantity(), order.GetOrderSide()));
+    }
+    void Send(std::size_t client, const GatewayResponse& response){
+     ++sent_;
+     gateway_.Send(client, response);
+    }
+  };
+
+  GatewayConfig config_;
+  std::size_t clients_;
+  SharedMemory memory_;
+  GatewaySegmentHeader* header_{nullptr};
+  Book book_;
+  std::uint64_t next_sequence_{1};   // Id 0 is never assigned
+  GatewayStats stats_;
+  std::vector<OrderId> orphans_;
+
+  GatewayClientSlot& Slot(std::size_t index){ return gateway_detail::SlotAt(memory_.Data(), index); }
+
+  static std::size_t OwnerOf(OrderId order_id){ return static_cast<std::size_t>(order_id & (kGatewayMaxClients - 1)); }
+
+  static GatewayResponse Response(std::uint64_t tag, OrderId order_id, GatewayResponseType type, Price price, Quantity quantity, OrderSide side){
+   GatewayResponse response{};
+   response.client_tag = tag;
+   response.order_id = order_id;
+   response.price = price;
+   response.quantity = quantity;
+   response.type = type;
+   response.side = side;
+   return response;
+  }
+
+  bool ValidPrice(OrderSide side, Price price) const {
+   if (price <= 0 || price % config_.levels.tick_size != 0){
+    return false;
+   }
+   std::int64_t distance = static_cast<std::int64_t>(price) - config_.reference_price;
+   if (config_.price_band != 0 && (distance > config_.price_band || distance < -static_cast<std::int64_t>(config_.price_band))){
+    return false;
+   }
+   return book_.AdmitsPrice(side, price);
+  }
+
+  static bool ValidSide(OrderSide side){ return side == OrderSide::Buy || side == OrderSide::Sell; }
+
+  void Serve(std::size_t client, const GatewayRequest& request){
+   ++stats_.requests;
+   ResponseSink sink(*this, client, request.client_tag);
+   GatewayError error = GatewayError::Internal;
+   try {
+    error = Apply(client, request, sink);
+   }
+   catch (const std::exception&){ // The book refuses before it changes anything, so the gateway can carry on
+   }
+   if (error != GatewayError::None){
+    GatewayResponse response = Response(request.client_tag, request.order_id, GatewayResponseType::Rejected, request.price, request.quantity, request.side);
+    response.error = error;
+    ++stats_.rejects;
+    Send(client, response);
+   }
+  }
+
+  // Returns the error to report, or None once the book has reported the outcome through the sink
+  GatewayError Apply(std::size_t client, const GatewayRequest& request, ResponseSink& sink){
+   switch (request.type){
+   case GatewayRequestType::NewOrder: {
+    if (!ValidSide(request.side) || static_cast<std::uint8_t>(request.order_type) > static_cast<std::uint8_t>(OrderType::Market)){
+     return GatewayError::InvalidMessage;
+    }
+    if (request.quantity == 0){
+     return GatewayError::InvalidQuantity;
+    }
+    bool market = request.order_type == OrderType::Market;
+    if (!market && !ValidPrice(request.side, request.price)){
+     return GatewayError::InvalidPrice;
+    }
+    OrderId order_id = (next_sequence_++ << kGatewayClientBits) | client;
+    book_.ProcessNewOrder(Order(order_id, request.side, market ? 0 : request.price, request.quantity, request.order_type), sink);
+    return GatewayError::None;
+   }
+   case GatewayRequestType::Cancel:
+    if (OwnerOf(request.order_id) != client || !book_.TryCancelOrder(request.order_id, sink)){
+     return GatewayError::UnknownOrder;
+    }
+    return GatewayError::None;
+   case GatewayRequestType::Modify:
+    if (!ValidSide(request.side)){
+     return GatewayError::InvalidMessage;
+    }
+    if (request.quantity != 0 && !ValidPrice(request.side, request.price)){
+     return GatewayError::InvalidPrice;
+    }
+    if (OwnerOf(request.order_id) != client || !book_.Modify(ModifyOrder(request.order_id, request.side, request.price, request.quantity), sink)){
+     return GatewayError::UnknownOrder;
+    }
+    if (sink.Sent() == 0){ // Unchanged: the book reports nothing, the client still gets its answer
+     Send(client, Response(request.client_tag, request.order_id, GatewayResponseType::Modified, request.price, request.quantity, request.side));
+    }
+    return GatewayError::None;
+   }
+   return GatewayError::InvalidMessage;
+  }
+
+  void Send(std::size_t client, const GatewayResponse& response){
+   GatewayClientSlot& slot = Slot(client);
+   if (slot.responses.TryPush(response)){
+    return;
+   }
+   ++stats_.response_stalls;
+   SpinBackoff backoff;
+   while (!slot.responses.TryPush(response)){
+    if (slot.state.load(std::memory_order_acquire) != GatewaySlotState::Connected){
+     return; // Client gone: nobody left to tell
+    }
+    backoff.Wait();
+   }
+  }
+
+  // Cancel the departed client's resting orders, then empty its rings and free the slot
+  void Release(std::size_t client){
+   orphans_.clear();
+   for (OrderSide side : {OrderSide::Buy, OrderSide::Sell}){
+    book_.ForEachOrder(side, [&](const auto&, const Order& order){
+     if (OwnerOf(order.GetOrderId()) == client){
+      orphans_.push_back(order.GetOrderId());
+     }
+    });
+   }
+   for (OrderId order_id : orphans_){
+    book_.TryCancelOrder(order_id);
+   }
+   stats_.orphans_cancelled += orphans_.size();
+   ++stats_.disconnects;
+   GatewayClientSlot& slot = Slot(client);
+   slot.requests.Reset();
+   slot.responses.Reset();
+   slot.pid.store(0, std::memory_order_relaxed);
+   slot.state.store(GatewaySlotState::Free, std::memory_order_release);
+  }
+};
+
+
+// A client process's connection: one claimed slot of a running gateway
+class GatewayClient{
+ public:
+  // Attach to the gateway's segment and claim a free slot. Throws std::runtime_error if there is no gateway of that
+  // name, it is not ready, or every slot is taken.
+  explicit GatewayClient(const std::string& name): memory_ {name} {
+   auto* header = static_cast<GatewaySegmentHeader*>(memory_.Data());
+   if (memory_.Size() < sizeof(GatewaySegmentHeader) || header->ready.load(std::memory_order_acquire) == 0){
+    throw std::runtime_error("GatewayClient: gateway " + name + " is not ready");
+   }
+   if (std::memcmp(header->magic, kGatewayMagic, sizeof(kGatewayMagic)) != 0 || header->version != kGatewayVersion
+    || memory_.Size() < GatewaySegmentSize(header->clients)){
+    throw std::runtime_error("GatewayClient: " + name + " is not a compatible gateway segment");
+   }
+   for (std::size_t i = 0; i < header->clients; ++i){
+    GatewayClientSlot& slot = gateway_detail::SlotAt(memory_.Data(), i);
+    GatewaySlotState free = GatewaySlotState::Free;
+    if (slot.state.compare_exchange_strong(free, GatewaySlotState::Connected, std::memory_order_acq_rel)){
+     slot.pid.store(static_cast<std::int32_t>(::getpid()), std::memory_order_relaxed);
+     slot_ = &slot;
+     index_ = i;
+     return;
+    }
+   }
+   throw std::runtime_error("GatewayClient: no free client slot on " + name);
+  }
+
+  // Leaves the slot; the gateway cancels this client's resting orders
+  ~GatewayClient(){ slot_->state.store(GatewaySlotState::Closing, std::memory_order_release); }
+
+  GatewayClient(const GatewayClient&) = delete;
+  GatewayClient& operator=(const GatewayClient&) = delete;
+
+  // False if the request ring is full: drain responses and retry
+  bool TrySend(const GatewayRequest& request){ return slot_->requests.TryPush(request); }
+  bool TryReceive(GatewayResponse& out){ return slot_->responses.TryPop(out); }
+
+  std::size_t Slot() const { return index_; }
+
+ private:
+  SharedMemory memory_;
+  GatewayClientSlot* slot_{nullptr};
+  std::size_t index_{0};
+};
+
+#endif // GATEWAY_H
@@ -0,0 +1,173 @@
+#ifndef GATEWAY_PROTOCOL_H
+#define GATEWAY_PROTOCOL_H
+
+#include "lockfree_queue.h"
+#include "orders.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+
+// Wire format of the shared-memory order gateway (gateway.h).
+// A client talks to the gateway through a slot of one shared memory segment: a request ring it writes and a response
+// ring the gateway writes, each a single-producer single-consumer ring of fixed-size, trivially copyable records.
+// The segment holds no pointers, so every process may map it at a different address.
+// Outcomes are error codes in the responses: no request, however malformed, makes the gateway throw.
+
+
+constexpr std::uint32_t kGatewayVersion = 1;
+constexpr std::size_t kGatewayRingCapacity = 4096;   // Records per ring; power of two
+constexpr std::size_t kGatewayClientBits = 8;        // Low bits of a gateway order id: the owning client's slot
+constexpr std::size_t kGatewayMaxClients = std::size_t{1} << kGatewayClientBits;
+
+enum class GatewayRequestType : std::uint8_t{
+ NewOrder = 1,
+ Cancel,
+ Modify,      // New side, price and remaining quantity of a resting order; quantity 0 cancels it
+};
+
+enum class GatewayResponseType : std::uint8_t{
+ Accepted = 1,   // New order entered the book; carries the gateway's order id
+ Rejected,       // Request had no effect; error says why
+ Fill,
+ Cancelled,      // Order left the book: cancel request, modify to 0, or the unfilled rest of an immediate order
+ Modified,       // Resting order now has these terms
+};
+
+enum class GatewayError : std::uint8_t{
+ None,
+ UnknownOrder,      // Cancel or modify of an id that is not resting, or that belongs to another client
+ CannotFill,        // Immediate order with nothing to match, or fill-or-kill without enough liquidity
+ InvalidQuantity,   // New order with quantity 0
+ InvalidPrice,      // Limit order or modify with a price that is not positive, off the tick grid or outside the price band
+ InvalidMessage,    // Unknown request type, side or order type
+ Internal,          // The book failed; the order may have been partly processed
+};
+
+inline const char* ToString(GatewayError error){
+ switch (error){
+ case GatewayError::None: return "none";
+ case GatewayError::UnknownOrder: return "unknown order";
+ case GatewayError::CannotFill: return "cannot fill";
+ case GatewayError::InvalidQuantity: return "invalid quantity";
+ case GatewayError::InvalidPrice: return "invalid price";
+ case GatewayError::InvalidMessage: return "invalid message";
+ case GatewayError::Internal: return "internal error";
+ }
+ return "?";
+}
+
+// Client to gateway. Fields a request type does not use are ignored.
+struct GatewayRequest{
+ std::uint64_t client_tag;    // Any value; echoed in every response to this request (a client order id, a timestamp)
+ OrderId order_id;            // Cancel, Modify: the id from the Accepted response
+ Price price;                 // Ignored for market orders
+ Quantity quantity;
+ GatewayRequestType type;
+ OrderSide side;
+ OrderType order_type;        // NewOrder only
+ std::uint8_t reserved[5];
+};
+
+// Gateway to client
+struct GatewayResponse{
+ std::uint64_t client_tag;    // Of the request that caused it; 0 on fills of a resting order, which another client caused
+ OrderId order_id;            // The recipient's order
+ Price price;                 // Accepted, Modified: the order's price. Fill: the execution price
+ Quantity quantity;           // Accepted, Modified: remaining. Fill: executed. Cancelled: what was cancelled
+ GatewayResponseType type;
+ GatewayError error;          // Rejected only
+ OrderSide side;
+ bool maker;                  // Fill: the recipient's order was resting
+ std::uint8_t reserved[4];
+};
+
+static_assert(sizeof(GatewayRequest) == 32 && std::is_trivially_copyable<GatewayRequest>::value, "GatewayRequest is a 32-byte wire record");
+static_assert(sizeof(GatewayResponse) == 32 && std::is_trivially_copyable<GatewayResponse>::value, "GatewayResponse is a 32-byte wire record");
+
+
+// SpscQueue laid out in place: fixed capacity, no heap, each index on its own cache line next to the producer's or
+// consumer's cached copy of the other index. Lock-free atomics are address-free, so the ring works across processes.
+template <typename T, std::size_t Capacity>
+struct ShmRing{
+ static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "ShmRing: capacity must be a power of two");
+ static_assert(std::is_trivially_copyable<T>::value, "ShmRing: records must be trivially copyable");
+ static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "ShmRing: indices must be lock-free to be shared between processes");
+
+ static constexpr std::uint64_t kMask = Capacity - 1;
+
+ alignas(kCacheLineSize) std::atomic<std::uint64_t> head{0};   // Written by the producer
+ std::uint64_t cached_tail{0};
+ alignas(kCacheLineSize) std::atomic<std::uint64_t> tail{0};   // Written by the consumer
+ std::uint64_t cached_head{0};
+ alignas(kCacheLineSize) T slots[Capacity];
+
+ // Producer only
+ bool TryPush(const T& value){
+  std::uint64_t index = head.load(std::memory_order_relaxed);
+  if (index - cached_tail > kMask){
+   cached_tail = tail.load(std::memory_order_acquire);
+   if (index - cached_tail > kMask){
+    return false;
+   }
+  }
+  slots[index & kMask] = value;
+  head.store(index + 1, std::memory_order_release);
+  return true;
+ }
+
+ // Consumer only
+ bool TryPop(T& out){
+  std::uint64_t index = tail.load(std::memory_order_relaxed);
+  if (index == cached_head){
+   cached_head = head.load(std::memory_order_acquire);
+   if (index == cached_head){
+    return false;
+   }
+  }
+  out = slots[index & kMask];
+  tail.store(index + 1, std::memory_order_release);
+  return true;
+ }
+
+ // Empty the ring. Neither side may be using it.
+ void Reset(){
+  head.store(0, std::memory_order_relaxed);
+  tail.store(0, std::memory_order_relaxed);
+  cached_tail = 0;
+  cached_head = 0;
+ }
+};
+
+
+enum class GatewaySlotState : std::uint32_t{
+ Free,        // A connecting client may claim it
+ Connected,   // Owned by a client; the gateway serves its requests
+ Closing,     // Client left; the gateway empties the rings and frees the slot
+};
+
+struct GatewayClientSlot{
+ alignas(kCacheLineSize) std::atomic<GatewaySlotState> state{GatewaySlotState::Free};
+ std::atomic<std::int32_t> pid{0};                                 // Of the connected client; 0 until it has written it
+ ShmRing<GatewayRequest, kGatewayRingCapacity> requests;           // Client to gateway
+ ShmRing<GatewayResponse, kGatewayRingCapacity> responses;         // Gateway to client
+};
+
+struct GatewaySegmentHeader{
+ char magic[8];
+ std::uint32_t version;
+ std::uint32_t clients;                      // Slots following the header
+ std::atomic<std::uint32_t> ready{0};        // Set once every slot is initialised; clients wait for it
+};
+
+constexpr char kGatewayMagic[8] = {'O', 'B', 'G', 'A', 'T', 'E', 'W', 'Y'};
+
+// Byte offset of the slots in the segment, and the segment size for a number of clients
+constexpr std::size_t kGatewaySlotsOffset = (sizeof(GatewaySegmentHeader) + alignof(GatewayClientSlot) - 1) / alignof(GatewayClientSlot) * alignof(GatewayClientSlot);
+
+constexpr std::size_t GatewaySegmentSize(std::size_t clients){
+ return kGatewaySlotsOffset + clients * sizeof(GatewayClientSlot);
+}
+
+#endif // GATEWAY_PROTOCOL_H
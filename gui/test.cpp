@@ -1,5 +1,12 @@
-// Dear ImGui: standalone example application for GLFW + OpenGL 3, using programmable pipeline
-// (GLFW is a cross-platform general purpose library for handling windows, inputs, OpenGL/Vulkan/Metal graphics context creation, etc.)
+// Live order book viewer: Dear ImGui on GLFW + OpenGL 3 (based on the Dear ImGui GLFW/OpenGL3 example).
+// Usage: example_glfw_opengl3 [message.csv] [--tick N] [--scale S]
+//   message.csv  LOBSTER message file to replay (default: synthetic order flow)
+//   --tick N     ladder tick size in feed price units (default 100 for LOBSTER, 1 for synthetic flow)
+//   --scale S    feed price units per displayed unit (default 10000: LOBSTER prices are dollars * 10000)
+//
+// A replay thread applies the feed to a LadderOrderBook and publishes a BookSnapshot (top levels, recent trades,
+// events/sec, apply latency percentiles) through a TripleBuffer. The render loop takes the newest snapshot each frame
+// without ever blocking the replay thread.
 
 // Learn about Dear ImGui:
 // - FAQ                  https://dearimgui.com/faq
@@ -11,6 +18,16 @@
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
+#include "../book_snapshot.h"
+#include "../lobster_replay.h"
+#include "../bench/order_flow.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <thread>
 #include <stdio.h>
 #define GL_SILENCE_DEPRECATION
 #if defined(IMGUI_IMPL_OPENGL_ES2)
@@ -35,9 +52,266 @@ static void glfw_error_callback(int error, const char* description)
     fprintf(stderr, "GLFW Error %d: %s\n", error, description);
 }
 
+// Shared between the render loop and the replay thread
+struct ReplayControl
+{
+    std::atomic<bool> stop{false};
+    std::atomic<bool> paused{false};
+    std::atomic<float> speed{0.0f};     // Multiple of feed time; 0 = as fast as possible
+    std::atomic<bool> finished{false};
+    std::string error;                  // Written before finished is set
+};
+
+// Sleep while paused or while ahead of the requested pace, publishing so the GUI stays current. A pause moves both
+// pacing origins to now, so feed time is measured from them only after the pause.
+template <typename Book>
+static void Pace(ReplayControl& control, SnapshotRecorder& recorder, const Book& book,
+                 std::chrono::steady_clock::time_point& wall_start, std::uint64_t& feed_start_ns, std::uint64_t feed_now_ns)
+{
+    while (control.paused.load(std::memory_order_relaxed) && !control.stop.load(std::memory_order_relaxed))
+    {
+        recorder.Publish(book);
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        wall_start = std::chrono::steady_clock::now(); // Restart pacing from here after a pause
+        feed_start_ns = feed_now_ns;
+    }
+    float speed = control.speed.load(std::memory_order_relaxed);
+    if (speed <= 0.0f)
+        return;
+    std::uint64_t feed_elapsed_ns = feed_now_ns - feed_start_ns;
+    auto target = wall_start + std::chrono::nanoseconds(static_cast<std::int64_t>(feed_elapsed_ns / speed));
+    if (target > std::chrono::steady_clock::now() + std::chrono::milliseconds(1))
+    {
+        recorder.Publish(book);
+        std::this_thread::sleep_until(target);
+    }
+}
+
+static void RunLobster(const char* path, LevelConfig config, TripleBuffer<BookSnapshot>& channel, ReplayControl& control)
+{
+    LadderOrderBook book(config, 1 << 20);
+    LobsterReplay<LadderOrderBook> replay(book);
+    SnapshotRecorder recorder(channel);
+    LobsterMessageReader reader(path);
+    LobsterEvent event{};
+    auto wall_start = std::chrono::steady_clock::now();
+    std::uint64_t feed_start_ns = 0;
+    bool first = true;
+    float last_speed = 0.0f;
+    while (!control.stop.load(std::memory_order_relaxed) && reader.Next(event))
+    {
+        float speed = control.speed.load(std::memory_order_relaxed);
+        if (first || speed != last_speed)
+        {
+            wall_start = std::chrono::steady_clock::now(); // Restart pacing when the speed changes
+            feed_start_ns = event.timestamp_ns;
+            first = false;
+            last_speed = speed;
+        }
+        Pace(control, recorder, book, wall_start, feed_start_ns, event.timestamp_ns);
+        recorder.SetTime(event.timestamp_ns);
+        std::uint64_t start = TscClock::Now();
+        replay.Apply(event, recorder);
+        recorder.RecordLatency(TscClock::Now() - start);
+        recorder.Tick(book);
+    }
+    recorder.Publish(book);
+}
+
+static void RunSynthetic(LevelConfig config, TripleBuffer<BookSnapshot>& channel, ReplayControl& control)
+{
+    FlowConfig flow_config;
+    flow_config.events = 5000000;
+    std::vector<FlowEvent> flow = GenerateOrderFlow(flow_config);
+    LadderOrderBook book(config, flow.size());
+    SnapshotRecorder recorder(channel);
+    auto wall_start = std::chrono::steady_clock::now();
+    std::uint64_t feed_start_ns = 0;
+    float last_speed = 0.0f;
+    for (std::size_t i = 0; i < flow.size() && !control.stop.load(std::memory_order_relaxed); ++i)
+    {
+        const FlowEvent& event = flow[i];
+        float speed = control.speed.load(std::memory_order_relaxed);
+        if (i == 0 || speed != last_speed)
+        {
+            wall_start = std::chrono::steady_clock::now();
+            feed_start_ns = event.timestamp_ns;
+            last_speed = speed;
+        }
+        Pace(control, recorder, book, wall_start, feed_start_ns, event.timestamp_ns);
+        recorder.SetTime(event.timestamp_ns);
+        std::uint64_t start = TscClock::Now();
+        if (event.op == FlowOp::Cancel)
+            book.TryCancelOrder(event.order_id, recorder);
+        else
+            book.ProcessNewOrder(Order(event.order_id, event.side, event.price, event.quantity,
+                                       event.op == FlowOp::Sweep ? OrderType::Fillandkill : OrderType::Goodtillcancel), recorder);
+        recorder.RecordLatency(TscClock::Now() - start);
+        recorder.Tick(book);
+    }
+    recorder.Publish(book);
+}
+
+static void ReplayThread(const char* path, LevelConfig config, TripleBuffer<BookSnapshot>* channel, ReplayControl* control)
+{
+    try
+    {
+        if (path != nullptr)
+            RunLobster(path, config, *channel, *control);
+        else
+            RunSynthetic(config, *channel, *control);
+    }
+    catch (const std::exception& e)
+    {
+        control->error = e.what();
+    }
+    control->finished.store(true, std::memory_order_release);
+}
+
+// Feed time (nanoseconds after midnight) as HH:MM:SS.mmm
+static void FormatFeedTime(std::uint64_t ns, char* out, size_t size)
+{
+    std::uint64_t ms = ns / 1000000;
+    snprintf(out, size, "%02llu:%02llu:%02llu.%03llu", (unsigned long long)(ms / 3600000), (unsigned long long)(ms / 60000 % 60),
+             (unsigned long long)(ms / 1000 % 60), (unsigned long long)(ms % 1000));
+}
+
+static void ShowLadderRow(const LevelInfo& level, double scale, Quantity max_quantity, const ImVec4& color)
+{
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::TextColored(color, "%.4f", level.price / scale);
+    ImGui::TableNextColumn();
+    ImGui::Text("%u", level.quantity);
+    ImGui::TableNextColumn();
+    ImGui::Text("%u", level.order_count);
+    ImGui::TableNextColumn();
+    ImGui::PushStyleColor(ImGuiCol_PlotHistogram, color);
+    ImGui::ProgressBar(max_quantity == 0 ? 0.0f : (float)level.quantity / (float)max_quantity, ImVec2(-FLT_MIN, 0), "");
+    ImGui::PopStyleColor();
+}
+
+static void ShowLadder(const BookSnapshot& snapshot, double scale)
+{
+    const ImVec4 bid_color(0.30f, 0.85f, 0.40f, 1.0f);
+    const ImVec4 ask_color(0.95f, 0.35f, 0.35f, 1.0f);
+    Quantity max_quantity = 0;
+    for (std::uint32_t i = 0; i < snapshot.bid_levels; ++i)
+        max_quantity = std::max(max_quantity, snapshot.bids[i].quantity);
+    for (std::uint32_t i = 0; i < snapshot.ask_levels; ++i)
+        max_quantity = std::max(max_quantity, snapshot.asks[i].quantity);
+
+    ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(460, 780), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Depth ladder");
+    if (snapshot.bid_levels != 0 && snapshot.ask_levels != 0)
+        ImGui::Text("Spread %.4f", (snapshot.asks[0].price - snapshot.bids[0].price) / scale);
+    if (ImGui::BeginTable("ladder", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_ScrollY))
+    {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Price");
+        ImGui::TableSetupColumn("Quantity");
+        ImGui::TableSetupColumn("Orders");
+        ImGui::TableSetupColumn("Depth", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableHeadersRow();
+        for (std::uint32_t i = snapshot.ask_levels; i-- > 0; ) // Worst ask at the top, best ask just above the bids
+            ShowLadderRow(snapshot.asks[i], scale, max_quantity, ask_color);
+        for (std::uint32_t i = 0; i < snapshot.bid_levels; ++i)
+            ShowLadderRow(snapshot.bids[i], scale, max_quantity, bid_color);
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+static void ShowTape(const BookSnapshot& snapshot, double scale)
+{
+    ImGui::SetNextWindowPos(ImVec2(480, 10), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(360, 780), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Trades");
+    if (ImGui::BeginTable("tape", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY))
+    {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Time");
+        ImGui::TableSetupColumn("Side");
+        ImGui::TableSetupColumn("Price");
+        ImGui::TableSetupColumn("Quantity");
+        ImGui::TableHeadersRow();
+        char time[32];
+        for (std::uint32_t i = 0; i < snapshot.trade_count; ++i)
+        {
+            const TapeTrade& trade = snapshot.trades[i];
+            bool buy = trade.aggressor_side == OrderSide::Buy;
+            FormatFeedTime(trade.timestamp_ns, time, sizeof(time));
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted(time);
+            ImGui::TableNextColumn();
+            ImGui::TextColored(buy ? ImVec4(0.30f, 0.85f, 0.40f, 1.0f) : ImVec4(0.95f, 0.35f, 0.35f, 1.0f), buy ? "BUY" : "SELL");
+            ImGui::TableNextColumn();
+            ImGui::Text("%.4f", trade.price / scale);
+            ImGui::TableNextColumn();
+            ImGui::Text("%u", trade.quantity);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+static void ShowPerformance(const BookSnapshot& snapshot, ReplayControl& control, const char* source, float framerate)
+{
+    ImGui::SetNextWindowPos(ImVec2(850, 10), ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowSize(ImVec2(420, 260), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Performance");
+    ImGui::Text("Source: %s", source);
+    char time[32];
+    FormatFeedTime(snapshot.timestamp_ns, time, sizeof(time));
+    ImGui::Text("Feed time %s   snapshot #%llu", time, (unsigned long long)snapshot.sequence);
+    if (control.finished.load(std::memory_order_acquire))
+        ImGui::TextColored(ImVec4(1.0f, 0.8f, 0.3f, 1.0f), "%s", control.error.empty() ? "Replay finished" : control.error.c_str());
+    ImGui::Separator();
+
+    const PerformanceStats& performance = snapshot.performance;
+    ImGui::Text("Events applied   %llu", (unsigned long long)performance.events);
+    ImGui::Text("Events/sec       %.2f M", performance.events_per_sec / 1e6);
+    ImGui::Text("Resting orders   %zu", snapshot.resting_orders);
+    ImGui::Text("Apply latency (ns, last %zu events)", (size_t)8192);
+    ImGui::Text("  p50 %8.0f   p99 %8.0f", performance.latency_p50_ns, performance.latency_p99_ns);
+    ImGui::Text("  p99.9 %6.0f   max %8.0f", performance.latency_p999_ns, performance.latency_max_ns);
+    ImGui::Separator();
+
+    bool paused = control.paused.load(std::memory_order_relaxed);
+    if (ImGui::Checkbox("Pause", &paused))
+        control.paused.store(paused, std::memory_order_relaxed);
+    float speed = control.speed.load(std::memory_order_relaxed);
+    if (ImGui::SliderFloat("Speed (x feed time, 0 = max)", &speed, 0.0f, 1000.0f, "%.1f", ImGuiSliderFlags_Logarithmic))
+        control.speed.store(speed, std::memory_order_relaxed);
+    ImGui::Text("Render %.3f ms/frame (%.1f FPS)", 1000.0f / framerate, framerate);
+    ImGui::End();
+}
+
 // Main code
-int main(int, char**)
+int main(int argc, char** argv)
 {
+    const char* path = nullptr;
+    LevelConfig level_config{0, 4096};
+    double scale = 10000.0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--tick") == 0 && i + 1 < argc)
+            level_config.tick_size = static_cast<Price>(atoi(argv[++i]));
+        else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc)
+            scale = atof(argv[++i]);
+        else if (argv[i][0] != '-')
+            path = argv[i];
+        else
+        {
+            fprintf(stderr, "usage: %s [message.csv] [--tick N] [--scale S]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (level_config.tick_size == 0)
+        level_config.tick_size = path != nullptr ? 100 : 1;
+
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit())
         return 1;
@@ -73,7 +347,7 @@ int main(int, char**)
 
     // Create window with graphics context
     float main_scale = ImGui_ImplGlfw_GetContentScaleForMonitor(glfwGetPrimaryMonitor()); // Valid on GLFW 3.3+ only
-    GLFWwindow* window = glfwCreateWindow((int)(1280 * main_scale), (int)(800 * main_scale), "Dear ImGui GLFW+OpenGL3 example", nullptr, nullptr);
+    GLFWwindow* window = glfwCreateWindow((int)(1280 * main_scale), (int)(800 * main_scale), "Order book", nullptr, nullptr);
     if (window == nullptr)
         return 1;
     glfwMakeContextCurrent(window);
@@ -122,9 +396,10 @@ int main(int, char**)
     //IM_ASSERT(font != nullptr);
 
     // Our state
-    bool show_demo_window = true;
-    bool show_another_window = false;
-    ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+    ImVec4 clear_color = ImVec4(0.10f, 0.11f, 0.13f, 1.00f);
+    static TripleBuffer<BookSnapshot> channel; // ~3 snapshots of a few KB each: keep off the stack
+    ReplayControl control;
+    std::thread replay_thread(ReplayThread, path, level_config, &channel, &control);
 
     // Main loop
 #ifdef __EMSCRIPTEN__
@@ -153,40 +428,12 @@ int main(int, char**)
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        // 1. Show the big demo window (Most of the sample code is in ImGui::ShowDemoWindow()! You can browse its code to learn more about Dear ImGui!).
-        // if (show_demo_window)
-        //     ImGui::ShowDemoWindow(&show_demo_window);
-
-        // 2. Show a simple window that we create ourselves. We use a Begin/End pair to create a named window.
-        {
-            static float f = 0.0f;
-            static int counter = 0;
-
-            ImGui::Begin("Order book demo");                          // Create a window called "Hello, world!" and append into it.
-            ImGui::Checkbox("Demo Window", &show_demo_window);      // Edit bools storing our window open/close state
-            ImGui::Checkbox("Another Window", &show_another_window);
-
-            ImGui::SliderFloat("float", &f, 0.0f, 1.0f);            // Edit 1 float using a slider from 0.0f to 1.0f
-            ImGui::ColorEdit3("clear color", (float*)&clear_color); // Edit 3 floats representing a color
-
-            if (ImGui::Button("Button"))                            // Buttons return true when clicked (most widgets return true when edited/activated)
-                counter++;
-            ImGui::SameLine();
-            ImGui::Text("counter = %d", counter);
-
-            ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
-            ImGui::End();
-        }
-
-        // 3. Show another simple window.
-        if (show_another_window)
-        {
-            ImGui::Begin("Another Window", &show_another_window);   // Pass a pointer to our bool variable (the window will have a closing button that will clear the bool when clicked)
-            ImGui::Text("Hello from another window!");
-            if (ImGui::Button("Close Me"))
-                show_another_window = false;
-            ImGui::End();
-        }
+        // Newest snapshot from the replay thread; keeps the previous one if nothing new was published
+        channel.Update();
+        const BookSnapshot& snapshot = channel.ReadBuffer();
+        ShowLadder(snapshot, scale);
+        ShowTape(snapshot, scale);
+        ShowPerformance(snapshot, control, path != nullptr ? path : "synthetic order flow", io.Framerate);
 
         // Rendering
         ImGui::Render();
@@ -204,6 +451,8 @@ int main(int, char**)
 #endif
 
     // Cleanup
+    control.stop.store(true, std::memory_order_relaxed);
+    replay_thread.join();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -0,0 +1,239 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "engine_command.h"
+#include "lobster_parser.h"
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+// Append-only write-ahead journal of book commands.
+// A segment file is a JournalHeader followed by fixed-size JournalRecords with consecutive sequence numbers, each
+// carrying a checksum, so a torn or half-written tail is detected on restart and cut off. The writer buffers records
+// and makes a whole group durable with one write and one fdatasync (group commit); a command is durable once the
+// Commit that covers it has returned. See durable_book.h for how segments and checkpoints fit together.
+
+
+// 64-bit checksum of `size` bytes (a multiple of 8), one multiply per word
+inline std::uint64_t Checksum64(const void* data, std::size_t size, std::uint64_t seed = 0xcbf29ce484222325ULL){
+ const char* bytes = static_cast<const char*>(data);
+ std::uint64_t hash = seed;
+ for (std::size_t offset = 0; offset < size; offset += 8){
+  std::uint64_t word;
+  std::memcpy(&word, bytes + offset, 8);
+  hash = (hash ^ word) * 0x100000001b3ULL;
+  hash ^= hash >> 29;
+ }
+ return hash;
+}
+
+struct JournalHeader{
+ char magic[8];                 // "OBJRNL02"
+ std::uint64_t first_sequence;  // Sequence of the segment's first record
+};
+
+struct JournalRecord{
+ std::uint64_t sequence;
+ OrderId order_id;
+ InstrumentId instrument;
+ Price price;
+ Quantity quantity;
+ EngineCommandType type;
+ OrderSide side;
+ OrderType order_type;
+ std::uint8_t reserved;
+ Timestamp time;
+ std::uint64_t checksum;        // Checksum64 of the fields above
+
+ EngineCommand Command() const { return EngineCommand{order_id, instrument, price, quantity, type, side, order_type, time}; }
+};
+
+static_assert(sizeof(JournalHeader) == 16, "JournalHeader is an on-disk format");
+static_assert(sizeof(JournalRecord) == 48, "JournalRecord is an on-disk format");
+
+constexpr char kJournalMagic[8] = {'O', 'B', 'J', 'R', 'N', 'L', '0', '2'};
+constexpr std::size_t kJournalChecksummed = offsetof(JournalRecord, checksum);
+
+
+namespace journal_detail {
+
+ inline void WriteAll(int fd, const char* data, std::size_t size, const std::string& path){
+  while (size != 0){
+   ssize_t written = ::write(fd, data, size);
+   if (written < 0){
+    if (errno == EINTR){
+     continue;
+    }
+    throw std::runtime_error("Journal: cannot write " + path + ": " + std::strerror(errno));
+   }
+   data += written;
+   size -= static_cast<std::size_t>(written);
+  }
+ }
+
+ // Make a rename or unlink in `directory` durable
+ inline void SyncDirectory(const std::string& directory){
+  int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0){
+   throw std::runtime_error("Journal: cannot open directory " + directory);
+  }
+  ::fsync(fd);
+  ::close(fd);
+ }
+
+} // namespace journal_detail
+
+
+struct JournalConfig{
+ std::size_t group_commit{64};  // Records per write + fdatasync; 1 makes every command durable on its own
+ bool sync{true};               // false: write without fdatasync (survives a process crash, not a power loss)
+};
+
+class JournalWriter{
+ public:
+  // Appends to the segment at path, creating it with a header if it is missing or empty. next_sequence is the
+  // sequence the first appended record gets.
+  JournalWriter(const std::string& path, std::uint64_t next_sequence, const JournalConfig& config = {}):
+   path_ {path},
+   config_ {config},
+   next_sequence_ {next_sequence},
+   committed_ {next_sequence - 1}
+  {
+   if (config_.group_commit == 0){
+    throw std::logic_error("JournalWriter: group_commit must be at least 1");
+   }
+   fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT, 0644);
+   if (fd_ < 0){
+    throw std::runtime_error("JournalWriter: cannot open " + path_ + ": " + std::strerror(errno));
+   }
+   off_t end = ::lseek(fd_, 0, SEEK_END);
+   if (end == 0){
+    JournalHeader header{};
+    std::memcpy(header.magic, kJournalMagic, sizeof(header.magic));
+    header.first_sequence = next_sequence;
+    journal_detail::WriteAll(fd_, reinterpret_cast<const char*>(&header), sizeof(header), path_);
+    Sync();
+   }
+   buffer_.reserve(config_.group_commit);
+  }
+
+  ~JournalWriter(){
+   try {
+    Commit();
+   }
+   catch (const std::runtime_error&){
+    // Nothing to report to from a destructor; the buffered tail is lost as if the process had crashed
+   }
+   ::close(fd_);
+  }
+
+  JournalWriter(const JournalWriter&) = delete;
+  JournalWriter& operator=(const JournalWriter&) = delete;
+
+  // Buffer one command; commits the group once it is full. Returns the command's sequence number.
+  std::uint64_t Append(const EngineCommand& command){
+   JournalRecord record{next_sequence_, command.order_id, command.instrument, command.price, command.quantity,
+    command.type, command.side, command.order_type, 0, command.time, 0};
+   record.checksum = Checksum64(&record, kJournalChecksummed);
+   buffer_.push_back(record);
+   if (buffer_.size() >= config_.group_commit){
+    Commit();
+   }
+   return next_sequence_++;
+  }
+
+  // Write and sync every buffered record
+  void Commit(){
+   if (buffer_.empty()){
+    return;
+   }
+   journal_detail::WriteAll(fd_, reinterpret_cast<const char*>(buffer_.data()), buffer_.size() * sizeof(JournalRecord), path_);
+   Sync();
+   committed_ = buffer_.back().sequence;
+   buffer_.clear();
+  }
+
+  std::uint64_t NextSequence() const { return next_sequence_; }
+  std::uint64_t Committed() const { return committed_; }   // Last sequence known to be durable
+  std::uint64_t Syncs() const { return syncs_; }
+
+ private:
+  std::string path_;
+  JournalConfig config_;
+  int fd_{-1};
+  std::vector<JournalRecord> buffer_;
+  std::uint64_t next_sequence_;
+  std::uint64_t committed_;
+  std::uint64_t syncs_{0};
+
+  void Sync(){
+   if (!config_.sync){
+    return;
+   }
+   if (::fdatasync(fd_) != 0){
+    throw std::runtime_error("JournalWriter: cannot sync " + path_ + ": " + std::strerror(errno));
+   }
+   ++syncs_;
+  }
+};
+
+
+// Intact records of one segment, read in place through a read-only mapping. Records are valid up to the first one
+// that is short, fails its checksum or breaks the sequence; everything after it is a torn tail.
+class JournalReader{
+ public:
+  explicit JournalReader(const std::string& path):
+   file_ {path.c_str()}
+  {
+   if (file_.Size() < sizeof(JournalHeader)){
+    return; // Crashed while creating the segment: nothing in it
+   }
+   JournalHeader header;
+   std::memcpy(&header, file_.Data(), sizeof(header));
+   if (std::memcmp(header.magic, kJournalMagic, sizeof(header.magic)) != 0){
+    throw std::runtime_error("JournalReader: " + path + " is not a journal segment");
+   }
+   first_sequence_ = header.first_sequence;
+   valid_bytes_ = sizeof(JournalHeader);
+   std::uint64_t expected = first_sequence_;
+   while (valid_bytes_ + sizeof(JournalRecord) <= file_.Size()){
+    JournalRecord record;
+    std::memcpy(&record, file_.Data() + valid_bytes_, sizeof(record));
+    if (record.sequence != expected || record.checksum != Checksum64(&record, kJournalChecksummed)){
+     break;
+    }
+    valid_bytes_ += sizeof(JournalRecord);
+    ++expected;
+   }
+  }
+
+  std::uint64_t FirstSequence() const { return first_sequence_; }
+  std::size_t Records() const { return valid_bytes_ <= sizeof(JournalHeader) ? 0 : (valid_bytes_ - sizeof(JournalHeader)) / sizeof(JournalRecord); }
+  std::size_t ValidBytes() const { return valid_bytes_; }
+  std::size_t TornBytes() const { return file_.Size() - valid_bytes_; }
+
+  // fn(const JournalRecord&) for every intact record, in sequence order
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+   for (std::size_t offset = sizeof(JournalHeader); offset < valid_bytes_; offset += sizeof(JournalRecord)){
+    JournalRecord record;
+    std::memcpy(&record, file_.Data() + offset, sizeof(record));
+    fn(record);
+   }
+  }
+
+ private:
+  MappedFile file_;
+  std::uint64_t first_sequence_{0};
+  std::size_t valid_bytes_{0};
+};
+
+#endif // JOURNAL_H
@@ -0,0 +1,131 @@
+#ifndef LOBSTER_BATCH_H
+#define LOBSTER_BATCH_H
+
+#include "lobster_replay.h"
+#include "work_stealing_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <numeric>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <time.h>
+
+
+// Replays many LOBSTER message files (one per ticker and day) at once, each into its own book, on a WorkStealingPool.
+// Files are scheduled largest first by size on disk, so the longest replays start at once and the short ones fill
+// the gaps at the end. A file that fails to open or parse is reported with its error; the others carry on.
+
+
+struct BatchConfig{
+ std::size_t threads{0};          // 0: one per hardware thread
+ LevelConfig levels{};
+ std::size_t capacity_hint{0};    // Per book
+};
+
+struct FileReplayStats{
+ std::string path;
+ std::uintmax_t bytes{0};
+ std::size_t rank{0};             // Position in the largest-first schedule
+ std::size_t worker{0};
+ ReplayStats replay;
+ std::size_t resting_orders{0};   // Left in the book at the end of the file
+ double seconds{0};
+ double cpu_seconds{0};           // Thread CPU time; below seconds when workers outnumber free cores
+ std::string error;               // Empty if the file replayed
+};
+
+struct BatchStats{
+ std::vector<FileReplayStats> files;   // In the order given
+ ReplayStats total;                    // Merged over the files that replayed (see MergeReplayStats)
+ std::size_t failed{0};
+ std::size_t threads{0};
+ std::uint64_t steals{0};
+ double wall_seconds{0};
+ double cpu_seconds{0};                // Summed over files; cpu_seconds / wall_seconds is the parallelism achieved
+};
+
+namespace batch_detail {
+
+ inline double ThreadCpuSeconds(){
+  timespec now{};
+  ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) * 1e-9;
+ }
+
+} // namespace batch_detail
+
+// Counts add up and depths take the maximum. Timestamps and the halt flag describe a single day and are left alone.
+inline void MergeReplayStats(ReplayStats& total, const ReplayStats& file){
+ total.events += file.events;
+ total.malformed_rows += file.malformed_rows;
+ for (std::size_t type = 0; type < 8; ++type){
+  total.by_type[type] += file.by_type[type];
+ }
+ total.unknown_orders += file.unknown_orders;
+ total.rejected_orders += file.rejected_orders;
+ total.executed_quantity += file.executed_quantity;
+ total.hidden_quantity += file.hidden_quantity;
+ total.book_trades += file.book_trades;
+ total.halts += file.halts;
+ total.halt_cancelled += file.halt_cancelled;
+ total.max_bid_levels = std::max(total.max_bid_levels, file.max_bid_levels);
+ total.max_ask_levels = std::max(total.max_ask_levels, file.max_ask_levels);
+}
+
+// Replay every file into a fresh Book(config.levels, config.capacity_hint)
+template <typename Book>
+BatchStats ReplayLobsterFiles(const std::vector<std::string>& paths, const BatchConfig& config){
+ BatchStats batch;
+ batch.files.resize(paths.size());
+ for (std::size_t i = 0; i < paths.size(); ++i){
+  std::error_code error;
+  std::uintmax_t bytes = std::filesystem::file_size(paths[i], error);
+  batch.files[i].path = paths[i];
+  batch.files[i].bytes = error ? 0 : bytes;   // A missing file goes last and fails when it is opened
+ }
+ std::vector<std::size_t> schedule(paths.size());
+ std::iota(schedule.begin(), schedule.end(), std::size_t{0});
+ std::stable_sort(schedule.begin(), schedule.end(), [&](std::size_t a, std::size_t b){ return batch.files[a].bytes > batch.files[b].bytes; });
+
+ WorkStealingPool pool(config.threads);
+ auto start = std::chrono::steady_clock::now();
+ pool.Run(schedule.size(), [&](std::size_t task, std::size_t worker){
+  FileReplayStats& file = batch.files[schedule[task]];
+  file.rank = task;
+  file.worker = worker;
+  auto file_start = std::chrono::steady_clock::now();
+  double cpu_start = batch_detail::ThreadCpuSeconds();
+  try {
+   Book book(config.levels, config.capacity_hint);
+   file.replay = ReplayLobsterFile(file.path.c_str(), book);
+   file.resting_orders = book.Size();
+  }
+  catch (const std::exception& e){
+   file.error = e.what();
+  }
+  file.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - file_start).count();
+  file.cpu_seconds = batch_detail::ThreadCpuSeconds() - cpu_start;
+ });
+ batch.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+ batch.threads = pool.Threads();
+ batch.steals = pool.Steals();
+
+ for (const FileReplayStats& file : batch.files){
+  batch.cpu_seconds += file.cpu_seconds;
+  if (file.error.empty()){
+   MergeReplayStats(batch.total, file.replay);
+  }
+  else {
+   ++batch.failed;
+  }
+ }
+ return batch;
+}
+
+#endif // LOBSTER_BATCH_H
@@ -0,0 +1,304 @@
+#ifndef LOBSTER_COLUMNAR_H
+#define LOBSTER_COLUMNAR_H
+
+#include "lobster_parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// Columnar binary form of a LOBSTER message file, for replaying the same day many times without re-parsing CSV.
+// Layout: a ColumnarHeader, then one array per message field, each starting on a 64-byte boundary:
+//   Timestamp  uint64 ns after midnight     OrderId    uint64
+//   Type       uint8 LobsterEventType       Size       uint32
+//   Direction  int8 (1 buy, -1 sell)        Price      int32
+// A column is either Raw (fixed width, read in place through the mapping) or DeltaVarint (zigzag delta from the previous
+// row, LEB128 encoded), chosen per column when converting. Type and Direction are always Raw.
+// Converting goes through ParseLobsterMessage, so a columnar file replays exactly the events of its CSV.
+
+
+enum class LobsterColumn : std::uint8_t{
+ Timestamp,
+ Type,
+ OrderId,
+ Size,
+ Price,
+ Direction,
+};
+
+constexpr std::size_t kLobsterColumns = 6;
+
+enum class ColumnEncoding : std::uint8_t{
+ Raw,
+ DeltaVarint,
+};
+
+struct ColumnarColumn{
+ std::uint64_t offset;     // From the start of the file
+ std::uint64_t bytes;
+ ColumnEncoding encoding;
+ std::uint8_t width;       // Bytes per value when decoded
+ std::uint8_t reserved[6];
+};
+
+struct ColumnarHeader{
+ char magic[8];            // "OBLOBC01"
+ std::uint64_t events;
+ ColumnarColumn columns[kLobsterColumns];   // Indexed by LobsterColumn
+};
+
+static_assert(sizeof(ColumnarColumn) == 24, "ColumnarColumn is an on-disk format");
+static_assert(sizeof(ColumnarHeader) == 160, "ColumnarHeader is an on-disk format");
+
+constexpr char kColumnarMagic[8] = {'O', 'B', 'L', 'O', 'B', 'C', '0', '1'};
+constexpr std::size_t kColumnAlignment = 64;
+constexpr std::uint8_t kColumnWidths[kLobsterColumns] = {8, 1, 8, 4, 4, 1};
+
+// Per-column encoding for LobsterColumnarWriter::Write; everything Raw by default
+struct ColumnarOptions{
+ ColumnEncoding encoding[kLobsterColumns]{};
+
+ ColumnarOptions& Delta(LobsterColumn column){
+  if (column == LobsterColumn::Type || column == LobsterColumn::Direction){
+   throw std::logic_error("ColumnarOptions: type and direction columns are always raw");
+  }
+  encoding[static_cast<std::size_t>(column)] = ColumnEncoding::DeltaVarint;
+  return *this;
+ }
+};
+
+
+namespace columnar_detail {
+
+ inline void AppendVarint(std::vector<char>& out, std::uint64_t value){
+  while (value >= 0x80){
+   out.push_back(static_cast<char>(value | 0x80));
+   value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+ }
+
+ template <typename T>
+ void Encode(const std::vector<T>& values, ColumnEncoding encoding, std::vector<char>& out){
+  if (encoding == ColumnEncoding::Raw){
+   out.resize(values.size() * sizeof(T));
+   if (!values.empty()){
+    std::memcpy(out.data(), values.data(), out.size());
+   }
+   return;
+  }
+  out.clear();
+  std::uint64_t previous = 0;
+  for (T value : values){
+   std::uint64_t current = static_cast<std::uint64_t>(static_cast<std::int64_t>(value));
+   std::int64_t delta = static_cast<std::int64_t>(current - previous);
+   AppendVarint(out, (static_cast<std::uint64_t>(delta) << 1) ^ static_cast<std::uint64_t>(delta >> 63));
+   previous = current;
+  }
+ }
+
+ // Sequential decoder for one column
+ class Cursor{
+  public:
+   Cursor() = default;
+   Cursor(const char* data, const char* end, ColumnEncoding encoding): data_ {data}, end_ {end}, encoding_ {encoding} { }
+
+   template <typename T>
+   T Next(){
+    if (encoding_ == ColumnEncoding::Raw){
+     T value;
+     std::memcpy(&value, data_, sizeof(T)); // In bounds: raw column sizes are checked when the file is opened
+     data_ += sizeof(T);
+     return value;
+    }
+    std::uint64_t encoded = 0;
+    for (unsigned shift = 0; ; shift += 7){
+     if (data_ == end_ || shift > 63){
+      throw std::runtime_error("LobsterColumnarReader: truncated varint column");
+     }
+     std::uint8_t byte = static_cast<std::uint8_t>(*data_++);
+     encoded |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+     if (byte < 0x80){
+      break;
+     }
+    }
+    previous_ += (encoded >> 1) ^ (~(encoded & 1) + 1); // Undo zigzag, then the delta
+    return static_cast<T>(previous_);
+   }
+
+  private:
+   const char* data_{nullptr};
+   const char* end_{nullptr};
+   ColumnEncoding encoding_{ColumnEncoding::Raw};
+   std::uint64_t previous_{0};
+ };
+
+} // namespace columnar_detail
+
+
+// Collects events column by column and writes them out in the columnar format
+class LobsterColumnarWriter{
+ public:
+  void Add(const LobsterEvent& event){
+   timestamps_.push_back(event.timestamp_ns);
+   types_.push_back(static_cast<std::uint8_t>(event.type));
+   order_ids_.push_back(event.order_id);
+   sizes_.push_back(event.size);
+   prices_.push_back(event.price);
+   directions_.push_back(event.side == OrderSide::Sell ? -1 : 1);
+  }
+
+  std::size_t Events() const { return timestamps_.size(); }
+
+  // Write every event added so far to path. Returns the file size; column sizes are left in header.
+  std::size_t Write(const std::string& path, const ColumnarOptions& options, ColumnarHeader& header) const {
+   std::vector<char> columns[kLobsterColumns];
+   columnar_detail::Encode(timestamps_, options.encoding[0], columns[0]);
+   columnar_detail::Encode(types_, ColumnEncoding::Raw, columns[1]);
+   columnar_detail::Encode(order_ids_, options.encoding[2], columns[2]);
+   columnar_detail::Encode(sizes_, options.encoding[3], columns[3]);
+   columnar_detail::Encode(prices_, options.encoding[4], columns[4]);
+   columnar_detail::Encode(directions_, ColumnEncoding::Raw, columns[5]);
+
+   header = ColumnarHeader{};
+   std::memcpy(header.magic, kColumnarMagic, sizeof(header.magic));
+   header.events = Events();
+   std::uint64_t offset = sizeof(ColumnarHeader);
+   for (std::size_t i = 0; i < kLobsterColumns; ++i){
+    offset = (offset + kColumnAlignment - 1) / kColumnAlignment * kColumnAlignment;
+    bool raw = i == 1 || i == 5 || options.encoding[i] == ColumnEncoding::Raw;
+    header.columns[i] = ColumnarColumn{offset, columns[i].size(), raw ? ColumnEncoding::Raw : ColumnEncoding::DeltaVarint, kColumnWidths[i], {}};
+    offset += columns[i].size();
+   }
+
+   std::FILE* file = std::fopen(path.c_str(), "wb");
+   if (file == nullptr){
+    throw std::runtime_error("LobsterColumnarWriter: cannot create " + path);
+   }
+   static const char kPadding[kColumnAlignment] = {};
+   bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+   std::uint64_t written = sizeof(ColumnarHeader);
+   for (std::size_t i = 0; i < kLobsterColumns && ok; ++i){
+    ok = std::fwrite(kPadding, 1, header.columns[i].offset - written, file) == header.columns[i].offset - written
+     && std::fwrite(columns[i].data(), 1, columns[i].size(), file) == columns[i].size();
+    written = header.columns[i].offset + columns[i].size();
+   }
+   ok = std::fclose(file) == 0 && ok;
+   if (!ok){
+    throw std::runtime_error("LobsterColumnarWriter: cannot write " + path);
+   }
+   return written;
+  }
+
+  std::size_t Write(const std::string& path, const ColumnarOptions& options = {}) const {
+   ColumnarHeader header;
+   return Write(path, options, header);
+  }
+
+ private:
+  std::vector<std::uint64_t> timestamps_;
+  std::vector<std::uint8_t> types_;
+  std::vector<OrderId> order_ids_;
+  std::vector<Quantity> sizes_;
+  std::vector<Price> prices_;
+  std::vector<std::int8_t> directions_;
+};
+
+// Convert a LOBSTER message CSV into a columnar file; returns the number of events
+inline std::size_t ConvertLobsterMessages(const char* csv_path, const std::string& out_path, const ColumnarOptions& options = {}){
+ LobsterMessageReader reader(csv_path);
+ LobsterColumnarWriter writer;
+ LobsterEvent event{};
+ while (reader.Next(event)){
+  writer.Add(event);
+ }
+ writer.Write(out_path, options);
+ return writer.Events();
+}
+
+
+// Iterates a columnar file in place through a read-only mapping. Same Next interface as LobsterMessageReader, so the
+// replay driver takes either. Throws std::runtime_error on open failure or a malformed file.
+class LobsterColumnarReader{
+ public:
+  explicit LobsterColumnarReader(const char* path):
+   file_ {path}
+  {
+   if (file_.Size() < sizeof(ColumnarHeader)){
+    throw std::runtime_error(std::string("LobsterColumnarReader: ") + path + " is too short");
+   }
+   std::memcpy(&header_, file_.Data(), sizeof(header_));
+   if (std::memcmp(header_.magic, kColumnarMagic, sizeof(header_.magic)) != 0 || header_.events > file_.Size()){
+    throw std::runtime_error(std::string("LobsterColumnarReader: ") + path + " is not a columnar LOBSTER file");
+   }
+   for (std::size_t i = 0; i < kLobsterColumns; ++i){
+    const ColumnarColumn& column = header_.columns[i];
+    bool raw = column.encoding == ColumnEncoding::Raw;
+    if (column.width != kColumnWidths[i] || column.offset % kColumnAlignment != 0 || column.offset > file_.Size()
+     || column.bytes > file_.Size() - column.offset || (raw && column.bytes != header_.events * column.width)
+     || (!raw && (column.encoding != ColumnEncoding::DeltaVarint || i == 1 || i == 5))){
+     throw std::runtime_error(std::string("LobsterColumnarReader: bad column ") + std::to_string(i) + " in " + path);
+    }
+    cursors_[i] = columnar_detail::Cursor(file_.Data() + column.offset, file_.Data() + column.offset + column.bytes, column.encoding);
+   }
+  }
+
+  // Decode the next row into event; false after the last one
+  bool Next(LobsterEvent& event){
+   if (index_ == header_.events){
+    return false;
+   }
+   ++index_;
+   event.timestamp_ns = cursors_[0].Next<std::uint64_t>();
+   std::uint8_t type = cursors_[1].Next<std::uint8_t>();
+   if (type < 1 || type > 7){
+    throw std::runtime_error("LobsterColumnarReader: bad event type at row " + std::to_string(index_));
+   }
+   event.type = static_cast<LobsterEventType>(type);
+   event.order_id = cursors_[2].Next<OrderId>();
+   event.size = cursors_[3].Next<Quantity>();
+   event.price = cursors_[4].Next<Price>();
+   event.side = cursors_[5].Next<std::int8_t>() < 0 ? OrderSide::Sell : OrderSide::Buy;
+   return true;
+  }
+
+  std::size_t Events() const { return header_.events; }
+  std::size_t Malformed() const { return 0; } // Converting kept only the rows that parsed
+  std::size_t BytesTotal() const { return file_.Size(); }
+  const ColumnarColumn& Column(LobsterColumn column) const { return header_.columns[static_cast<std::size_t>(column)]; }
+
+  // A raw column read in place (e.g. RawColumn<std::uint64_t>(LobsterColumn::Timestamp)), or nullptr if it is delta
+  // encoded. T must have the column's width.
+  template <typename T>
+  const T* RawColumn(LobsterColumn column) const {
+   const ColumnarColumn& info = Column(column);
+   if (sizeof(T) != info.width){
+    throw std::logic_error("LobsterColumnarReader: column type has the wrong width");
+   }
+   return info.encoding == ColumnEncoding::Raw ? reinterpret_cast<const T*>(file_.Data() + info.offset) : nullptr;
+  }
+
+ private:
+  MappedFile file_;
+  ColumnarHeader header_;
+  columnar_detail::Cursor cursors_[kLobsterColumns];
+  std::uint64_t index_{0};
+};
+
+// True if path starts with the columnar magic (so it can be handed to LobsterColumnarReader rather than parsed as CSV)
+inline bool IsLobsterColumnar(const char* path){
+ char magic[sizeof(kColumnarMagic)] = {};
+ std::FILE* file = std::fopen(path, "rb");
+ if (file == nullptr){
+  return false;
+ }
+ bool columnar = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic) && std::memcmp(magic, kColumnarMagic, sizeof(magic)) == 0;
+ std::fclose(file);
+ return columnar;
+}
+
+#endif // LOBSTER_COLUMNAR_H
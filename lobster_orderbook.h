@@ -0,0 +1,348 @@
+#ifndef LOBSTER_ORDERBOOK_H
+#define LOBSTER_ORDERBOOK_H
+
+#include "book_hash.h"
+#include "lobster_parser.h"
+#include "lobster_replay.h"
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// LOBSTER *_orderbook_LEVEL.csv files (see data/LOBSTER_SampleFiles_ReadMe.txt): row k is the book after message k,
+// "AskPrice1,AskSize1,BidPrice1,BidSize1,AskPrice2,..." for LEVEL levels per side. Levels the book does not have are
+// padded with price 9999999999 (asks) or -9999999999 (bids) and size 0.
+
+constexpr std::int64_t kLobsterNoAsk = 9999999999LL;
+constexpr std::int64_t kLobsterNoBid = -9999999999LL;
+
+
+// Hash one orderbook row per side the way BasicOrderBook::DepthHash hashes levels (padding hashes to nothing), in one
+// pass without storing it. Sets levels to the row's levels per side and leaves cursor at the start of the next row.
+// Returns false for a malformed row.
+inline bool HashLobsterBookRow(const char*& cursor, const char* end, std::uint64_t& bid_hash, std::uint64_t& ask_hash, std::size_t& levels){
+ using namespace lobster_detail;
+ bid_hash = ask_hash = 0;
+ levels = 0;
+ while (true){
+  Price ask_price = static_cast<Price>(ParseSignedWide(cursor, end));
+  if (!Expect(cursor, end, ',')){
+   return false;
+  }
+  ask_hash ^= LevelHash(OrderSide::Sell, ask_price, static_cast<Quantity>(ParseUnsignedWide(cursor, end))); // Size 0 (padding): price never used
+  if (!Expect(cursor, end, ',')){
+   return false;
+  }
+  Price bid_price = static_cast<Price>(ParseSignedWide(cursor, end));
+  if (!Expect(cursor, end, ',')){
+   return false;
+  }
+  bid_hash ^= LevelHash(OrderSide::Buy, bid_price, static_cast<Quantity>(ParseUnsignedWide(cursor, end)));
+  ++levels;
+  if (!Expect(cursor, end, ',')){
+   break;
+  }
+ }
+ Expect(cursor, end, '\r');
+ return cursor == end || Expect(cursor, end, '\n');
+}
+
+// Parse one orderbook row into depth, best first, without the padding. Order counts are 0: LOBSTER does not give them.
+inline bool ParseLobsterBookRow(const char*& cursor, const char* end, OrderBookLevelInfos& depth){
+ using namespace lobster_detail;
+ LevelInfos& bids = depth.getBids();
+ LevelInfos& asks = depth.getAsks();
+ bids.clear();
+ asks.clear();
+ while (true){
+  std::int64_t ask_price = ParseSigned(cursor, end);
+  if (!Expect(cursor, end, ',')){
+   return false;
+  }
+  std::uint64_t ask_size = ParseUnsigned(cursor, end);
+  if (!Expect(cursor, end, ',')){
+   return false;
+  }
+  std::int64_t bid_price = ParseSigned(cursor, end);
+  if (!Expect(cursor, end, ',')){
+   return false;
+  }
+  std::uint64_t bid_size = ParseUnsigned(cursor, end);
+  if (ask_size != 0){
+   asks.push_back(LevelInfo{static_cast<Price>(ask_price), static_cast<Quantity>(ask_size)});
+  }
+  if (bid_size != 0){
+   bids.push_back(LevelInfo{static_cast<Price>(bid_price), static_cast<Quantity>(bid_size)});
+  }
+  if (!Expect(cursor, end, ',')){
+   break;
+  }
+ }
+ Expect(cursor, end, '\r');
+ return cursor == end || Expect(cursor, end, '\n');
+}
+
+
+// Iterates the rows of an orderbook file, hashing each; the current row can also be parsed in full. Throws
+// std::runtime_error on open failure, a malformed row or a row whose number of levels differs from the first.
+class LobsterBookReader{
+ public:
+  explicit LobsterBookReader(const char* path):
+   file_ {path},
+   cursor_ {file_.Data()},
+   end_ {file_.Data() + file_.Size()}
+  { }
+
+  // Hash the next row per side; false at end of file
+  bool Next(std::uint64_t& bid_hash, std::uint64_t& ask_hash){
+   while (cursor_ < end_ && (*cursor_ == '\n' || *cursor_ == '\r')){
+    ++cursor_;
+   }
+   if (cursor_ >= end_){
+    return false;
+   }
+   ++line_;
+   row_ = cursor_;
+   std::size_t levels = 0;
+   if (!HashLobsterBookRow(cursor_, end_, bid_hash, ask_hash, levels) || (levels_ != 0 && levels != levels_)){
+    throw std::runtime_error("LobsterBookReader: malformed row at line " + std::to_string(line_));
+   }
+   levels_ = levels;
+   return true;
+  }
+
+  // The row last returned by Next
+  void Parse(OrderBookLevelInfos& depth) const {
+   const char* cursor = row_;
+   ParseLobsterBookRow(cursor, end_, depth); // Already checked by Next
+  }
+
+  std::size_t Levels() const { return levels_; }   // Per side, 0 before the first row
+  std::size_t Line() const { return line_; }
+
+ private:
+  MappedFile file_;
+  const char* cursor_;
+  const char* end_;
+  const char* row_{nullptr};
+  std::size_t levels_{0};
+  std::size_t line_{0};
+};
+
+
+// Writes a book's top levels per side as orderbook rows, padded as LOBSTER pads them, e.g. to record one engine's
+// replay as the reference for another. Throws std::runtime_error if the file cannot be created or written.
+class LobsterBookWriter{
+ public:
+  LobsterBookWriter(const char* path, std::size_t levels): path_ {path}, levels_ {levels} {
+   file_ = std::fopen(path, "wb");
+   if (file_ == nullptr){
+    throw std::runtime_error("LobsterBookWriter: cannot create " + path_);
+   }
+   buffer_.reserve(kFlushBytes + levels * 4 * 12);
+  }
+
+  ~LobsterBookWriter(){
+   if (file_ != nullptr){
+    std::fclose(file_);
+   }
+  }
+
+  LobsterBookWriter(const LobsterBookWriter&) = delete;
+  LobsterBookWriter& operator=(const LobsterBookWriter&) = delete;
+
+  template <typename Book>
+  void Add(const Book& book){
+   book.GetDepth(levels_, depth_);
+   const LevelInfos& bids = depth_.getBids();
+   const LevelInfos& asks = depth_.getAsks();
+   for (std::size_t i = 0; i < levels_; ++i){
+    if (i != 0){
+     buffer_ += ',';
+    }
+    Append(i < asks.size() ? asks[i].price : kLobsterNoAsk);
+    buffer_ += ',';
+    Append(i < asks.size() ? asks[i].quantity : 0);
+    buffer_ += ',';
+    Append(i < bids.size() ? bids[i].price : kLobsterNoBid);
+    buffer_ += ',';
+    Append(i < bids.size() ? bids[i].quantity : 0);
+   }
+   buffer_ += '\n';
+   ++rows_;
+   if (buffer_.size() >= kFlushBytes){
+    Flush();
+   }
+  }
+
+  // Write out the rest and close the file; returns the rows written
+  std::size_t Close(){
+   Flush();
+   bool ok = std::fclose(file_) == 0;
+   file_ = nullptr;
+   if (!ok){
+    throw std::runtime_error("LobsterBookWriter: cannot write " + path_);
+   }
+   return rows_;
+  }
+
+ private:
+  static constexpr std::size_t kFlushBytes = 1 << 20;
+
+  void Append(std::int64_t value){
+   char digits[24];
+   char* last = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+   buffer_.append(digits, last);
+  }
+
+  void Flush(){
+   if (std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()){
+    throw std::runtime_error("LobsterBookWriter: cannot write " + path_);
+   }
+   buffer_.clear();
+  }
+
+  std::string path_;
+  std::size_t levels_;
+  std::FILE* file_{nullptr};
+  std::string buffer_;
+  OrderBookLevelInfos depth_;
+  std::size_t rows_{0};
+};
+
+
+// One level at which the book and an orderbook row disagree. A side with fewer levels reads as price and quantity 0.
+struct DepthMismatch{
+ std::uint64_t event;          // Message number, from 1
+ std::uint64_t timestamp_ns;
+ OrderSide side;
+ std::size_t level;            // 0: best
+ LevelInfo book;
+ LevelInfo file;
+};
+
+struct ValidationStats{
+ std::uint64_t events{0};
+ std::uint64_t mismatched_events{0};   // Events after which the book and the row disagree, each diffed in full
+ std::uint64_t first_mismatch{0};      // Message number, 0 if none
+ std::uint64_t top_reads{0};           // Side hashes recomputed from the book's top levels
+ std::size_t levels{0};                // Per side, from the orderbook file
+};
+
+
+// Checks a LOBSTER replay against the matching orderbook file after every event. The row's hash is compared with
+// the book's, and only if they differ are both depths read and compared level by level. The row holds only the top
+// LEVEL levels, so the book's hash of a side is its rolling DepthHash while it has no more levels than that, O(1);
+// a deeper side is hashed from GetTopLevels, re-read only when its TopVersion shows that its top levels changed
+// (the book then serves no other TopVersion reader, such as BookAnalytics). With full_diff every event is compared
+// level by level instead, as a validation without hashes would.
+template <typename Book>
+class LobsterValidator{
+ public:
+  explicit LobsterValidator(Book& book, std::size_t max_reported = 16, bool full_diff = false):
+   book_ {book}, max_reported_ {max_reported}, full_diff_ {full_diff}
+  { }
+
+  // Compare the book with rows' next row, for the event just applied; returns true if they agree
+  bool Check(const LobsterEvent& event, LobsterBookReader& rows){
+   std::uint64_t bid_hash = 0;
+   std::uint64_t ask_hash = 0;
+   if (!rows.Next(bid_hash, ask_hash)){
+    throw std::runtime_error("LobsterValidator: orderbook file ends at row " + std::to_string(rows.Line()));
+   }
+   ++stats_.events;
+   if (rows.Levels() != stats_.levels){
+    stats_.levels = rows.Levels();
+    prices_.resize(stats_.levels);
+    quantities_.resize(stats_.levels);
+    sides_[0].valid = sides_[1].valid = false;
+   }
+   if (!full_diff_ && SideHash(OrderSide::Buy) == bid_hash && SideHash(OrderSide::Sell) == ask_hash){
+    return true;
+   }
+   rows.Parse(file_depth_);
+   book_.GetDepth(stats_.levels, book_depth_);
+   bool bids_agree = Diff(event, OrderSide::Buy, book_depth_.getBids(), file_depth_.getBids());
+   bool asks_agree = Diff(event, OrderSide::Sell, book_depth_.getAsks(), file_depth_.getAsks());
+   if (bids_agree && asks_agree){
+    return true;
+   }
+   if (stats_.mismatched_events++ == 0){
+    stats_.first_mismatch = stats_.events;
+   }
+   return false;
+  }
+
+  const ValidationStats& Stats() const { return stats_; }
+  const std::vector<DepthMismatch>& Mismatches() const { return mismatches_; }   // The first max_reported
+
+ private:
+  struct SideState{
+   std::uint64_t version{0};
+   std::uint64_t hash{0};
+   bool valid{false};
+  };
+
+  std::uint64_t SideHash(OrderSide side){
+   SideState& state = sides_[side == OrderSide::Buy ? 0 : 1];
+   if (book_.LevelCount(side) <= stats_.levels){
+    state.valid = false; // Not tracking TopVersion meanwhile: re-read if the side grows deeper again
+    return book_.DepthHash(side);
+   }
+   if (!state.valid || state.version != book_.TopVersion(side)){
+    state.version = book_.TopVersion(side);
+    std::size_t count = book_.GetTopLevels(side, stats_.levels, prices_.data(), quantities_.data());
+    state.hash = HashLevels(side, prices_.data(), quantities_.data(), count);
+    state.valid = true;
+    ++stats_.top_reads;
+   }
+   return state.hash;
+  }
+
+  // Record the levels of one side that disagree; returns true if there are none
+  bool Diff(const LobsterEvent& event, OrderSide side, const LevelInfos& book, const LevelInfos& file){
+   bool agree = true;
+   for (std::size_t i = 0; i < std::max(book.size(), file.size()); ++i){
+    LevelInfo in_book = i < book.size() ? book[i] : LevelInfo{0, 0};
+    LevelInfo in_file = i < file.size() ? file[i] : LevelInfo{0, 0};
+    if (in_book.price == in_file.price && in_book.quantity == in_file.quantity){
+     continue;
+    }
+    agree = false;
+    if (mismatches_.size() < max_reported_){
+     mismatches_.push_back(DepthMismatch{stats_.events, event.timestamp_ns, side, i, in_book, in_file});
+    }
+   }
+   return agree;
+  }
+
+  Book& book_;
+  std::size_t max_reported_;
+  bool full_diff_;
+  SideState sides_[2];
+  std::vector<Price> prices_;
+  std::vector<Quantity> quantities_;
+  OrderBookLevelInfos book_depth_;
+  OrderBookLevelInfos file_depth_;
+  std::vector<DepthMismatch> mismatches_;
+  ValidationStats stats_;
+};
+
+// Replay every event of a reader into book, checking the book against rows after each one
+template <typename Reader, typename Book>
+ReplayStats ValidateEvents(Reader& reader, Book& book, LobsterBookReader& rows, LobsterValidator<Book>& validator){
+ LobsterReplay<Book> replay(book);
+ LobsterEvent event{};
+ while (reader.Next(event)){
+  replay.Apply(event);
+  validator.Check(event, rows);
+ }
+ return replay.Stats();
+}
+
+#endif // LOBSTER_ORDERBOOK_H
@@ -1,13 +1,25 @@
-// #ifdef LOBSTER_PARSER_H
-// #define LOBSTER_PARSER_H
+#ifndef LOBSTER_PARSER_H
+#define LOBSTER_PARSER_H
 
 #include "orders.h"
-#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
 #include <string>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 
-enum class LobsterEventType {
+// Streaming reader for LOBSTER *_message_LEVEL.csv files (see data/LOBSTER_SampleFiles_ReadMe.txt).
+// The file is mmapped and parsed in place with hand-written integer parsers: no iostreams, no std::string and no
+// floating point. Each line decodes straight into a LobsterEvent.
+
+
+enum class LobsterEventType : std::uint8_t {
     NewOrder = 1,           // Submission of new limit order
     PartialCancel = 2,      // Partial cancellation
     FullCancel = 3,         // Full deletion/cancellation
@@ -18,17 +30,241 @@ enum class LobsterEventType {
 };
 
 
-struct lobster_orderhttps://github.com/archie-brown3/order-book-cpp.git
+// One message-file row. Time is nanoseconds after midnight (the CSV has seconds with up to 9 decimals).
+// Price is the LOBSTER integer price (dollars * 10000). For TradingHalt rows price is -1 (halt), 0 (quote only) or 1 (resume).
+struct LobsterEvent
 {
-
-    double timestamp;
-    LobsterEventType type;     // Csv uses int 1-7 to represent order types
+    std::uint64_t timestamp_ns;
     OrderId order_id;
     Quantity size;
     Price price;
-    int OrderSide;
-    
+    LobsterEventType type;     // Csv uses int 1-7 to represent order types
+    OrderSide side;            // Csv uses 1 = buy, -1 = sell
+};
+
+
+// Read-only memory mapping of a whole file
+class MappedFile{
+ public:
+  explicit MappedFile(const char* path){
+   int fd = ::open(path, O_RDONLY);
+   if (fd < 0){
+    throw std::runtime_error(std::string("MappedFile: cannot open ") + path);
+   }
+   struct stat info{};
+   if (::fstat(fd, &info) != 0){
+    ::close(fd);
+    throw std::runtime_error(std::string("MappedFile: cannot stat ") + path);
+   }
+   size_ = static_cast<std::size_t>(info.st_size);
+   if (size_ != 0){
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED){
+     ::close(fd);
+     throw std::runtime_error(std::string("MappedFile: cannot mmap ") + path);
+    }
+    ::madvise(mapping, size_, MADV_SEQUENTIAL); // Read-ahead aggressively, drop pages behind the cursor
+    data_ = static_cast<const char*>(mapping);
+   }
+   ::close(fd); // The mapping keeps the file alive
+  }
+
+  ~MappedFile(){
+   if (data_ != nullptr){
+    ::munmap(const_cast<char*>(data_), size_);
+   }
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* Data() const { return data_; }
+  std::size_t Size() const { return size_; }
+
+ private:
+  const char* data_{nullptr};
+  std::size_t size_{0};
+};
+
+
+namespace lobster_detail {
 
+ // Unsigned decimal integer; advances cursor past the digits
+ inline std::uint64_t ParseUnsigned(const char*& cursor, const char* end){
+  std::uint64_t value = 0;
+  while (cursor < end && static_cast<unsigned>(*cursor - '0') < 10){
+   value = value * 10 + static_cast<unsigned>(*cursor - '0');
+   ++cursor;
+  }
+  return value;
+ }
+
+ inline std::int64_t ParseSigned(const char*& cursor, const char* end){
+  bool negative = cursor < end && *cursor == '-';
+  if (negative){
+   ++cursor;
+  }
+  std::int64_t value = static_cast<std::int64_t>(ParseUnsigned(cursor, end));
+  return negative ? -value : value;
+ }
+
+ // ParseUnsigned taking up to eight digits per step (SWAR, little-endian): one 8-byte load, the digit run's length
+ // from the first byte that is not a digit, and the digits combined pairwise by three multiplies. For wide rows of
+ // short numbers, such as orderbook files, where the byte loop's multiply chain dominates.
+ inline std::uint64_t ParseUnsignedWide(const char*& cursor, const char* end){
+  std::uint64_t value = 0;
+  while (end - cursor >= 8){
+   std::uint64_t chunk;
+   std::memcpy(&chunk, cursor, 8);
+   chunk -= 0x3030303030303030ULL; // Borrows only corrupt bytes after the first non-digit
+   std::uint64_t non_digits = (chunk | (chunk + 0x0606060606060606ULL)) & 0xF0F0F0F0F0F0F0F0ULL;
+   unsigned digits = non_digits == 0 ? 8 : static_cast<unsigned>(__builtin_ctzll(non_digits)) / 8;
+   if (digits == 0){
+    return value;
+   }
+   chunk <<= 8 * (8 - digits); // Drop what follows the digits; the vacated low bytes read as leading zeros
+   chunk = chunk * 10 + (chunk >> 8);
+   chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) + (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+   static constexpr std::uint64_t kScale[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+   value = value * kScale[digits] + chunk;
+   cursor += digits;
+   if (digits < 8){
+    return value;
+   }
+  }
+  while (cursor < end && static_cast<unsigned>(*cursor - '0') < 10){ // Last few bytes of the buffer
+   value = value * 10 + static_cast<unsigned>(*cursor - '0');
+   ++cursor;
+  }
+  return value;
+ }
+
+ inline std::int64_t ParseSignedWide(const char*& cursor, const char* end){
+  bool negative = cursor < end && *cursor == '-';
+  if (negative){
+   ++cursor;
+  }
+  std::int64_t value = static_cast<std::int64_t>(ParseUnsignedWide(cursor, end));
+  return negative ? -value : value;
+ }
+
+ // "34200.004241176" -> 34200004241176 ns. Fractions shorter than 9 digits are scaled up; extra digits are dropped.
+ inline std::uint64_t ParseTimestampNs(const char*& cursor, const char* end){
+  static constexpr std::uint64_t kScale[10] = {1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1};
+  std::uint64_t seconds = ParseUnsigned(cursor, end);
+  std::uint64_t fraction = 0;
+  unsigned digits = 0;
+  if (cursor < end && *cursor == '.'){
+   ++cursor;
+   while (cursor < end && static_cast<unsigned>(*cursor - '0') < 10){
+    if (digits < 9){
+     fraction = fraction * 10 + static_cast<unsigned>(*cursor - '0');
+     ++digits;
+    }
+    ++cursor;
+   }
+  }
+  return seconds * 1000000000ULL + fraction * kScale[digits];
+ }
+
+ // True if a number starts at cursor: a digit, after an optional minus sign. The parsers above read an empty field as
+ // 0, so each field is checked first.
+ inline bool AtNumber(const char* cursor, const char* end){
+  if (cursor < end && *cursor == '-'){
+   ++cursor;
+  }
+  return cursor < end && static_cast<unsigned>(*cursor - '0') < 10;
+ }
+
+ inline bool Expect(const char*& cursor, const char* end, char c){
+  if (cursor < end && *cursor == c){
+   ++cursor;
+   return true;
+  }
+  return false;
+ }
+
+} // namespace lobster_detail
+
+
+// Parse one "Time,Type,OrderID,Size,Price,Direction" row starting at cursor. On success cursor is left at the start of
+// the next row. Returns false for a malformed row: an empty or non-numeric field, a negative time, type, id or size, a
+// type outside 1-7 or a direction other than 1 or -1.
+inline bool ParseLobsterMessage(const char*& cursor, const char* end, LobsterEvent& event){
+ using namespace lobster_detail;
+ if (!AtNumber(cursor, end) || *cursor == '-'){
+  return false;
+ }
+ event.timestamp_ns = ParseTimestampNs(cursor, end);
+ if (!Expect(cursor, end, ',') || !AtNumber(cursor, end) || *cursor == '-'){
+  return false;
+ }
+ std::uint64_t type = ParseUnsigned(cursor, end);
+ if (type < 1 || type > 7 || !Expect(cursor, end, ',') || !AtNumber(cursor, end) || *cursor == '-'){
+  return false;
+ }
+ event.type = static_cast<LobsterEventType>(type);
+ event.order_id = ParseUnsigned(cursor, end);
+ if (!Expect(cursor, end, ',') || !AtNumber(cursor, end) || *cursor == '-'){
+  return false;
+ }
+ event.size = static_cast<Quantity>(ParseUnsigned(cursor, end));
+ if (!Expect(cursor, end, ',') || !AtNumber(cursor, end)){
+  return false;
+ }
+ event.price = static_cast<Price>(ParseSigned(cursor, end));
+ if (!Expect(cursor, end, ',') || !AtNumber(cursor, end)){
+  return false;
+ }
+ std::int64_t direction = ParseSigned(cursor, end);
+ if (direction != 1 && direction != -1){
+  return false;
+ }
+ event.side = direction < 0 ? OrderSide::Sell : OrderSide::Buy;
+ Expect(cursor, end, '\r');
+ return cursor == end || Expect(cursor, end, '\n');
 }
 
-#endif //LOBSTER_PARSER_H
\ No newline at end of file
+
+// Iterates the rows of a message file. Throws std::runtime_error on open failure. A malformed row is skipped and counted
+// in Malformed(), so one bad line does not end a day's replay.
+class LobsterMessageReader{
+ public:
+  explicit LobsterMessageReader(const char* path):
+   file_ {path},
+   cursor_ {file_.Data()},
+   end_ {file_.Data() + file_.Size()}
+  { }
+
+  // Decode the next well-formed row into event; false at end of file
+  bool Next(LobsterEvent& event){
+   while (true){
+    while (cursor_ < end_ && (*cursor_ == '\n' || *cursor_ == '\r')){
+     ++cursor_; // Tolerate blank lines, e.g. a trailing empty line
+    }
+    if (cursor_ >= end_){
+     return false;
+    }
+    ++line_;
+    if (ParseLobsterMessage(cursor_, end_, event)){
+     return true;
+    }
+    ++malformed_;
+    const char* newline = static_cast<const char*>(std::memchr(cursor_, '\n', static_cast<std::size_t>(end_ - cursor_)));
+    cursor_ = newline != nullptr ? newline + 1 : end_;
+   }
+  }
+
+  std::size_t Line() const { return line_; }
+  std::size_t Malformed() const { return malformed_; }
+  std::size_t BytesTotal() const { return file_.Size(); }
+
+ private:
+  MappedFile file_;
+  const char* cursor_;
+  const char* end_;
+  std::size_t line_{0};
+  std::size_t malformed_{0};
+};
+
+#endif //LOBSTER_PARSER_H
@@ -0,0 +1,394 @@
+#ifndef LOBSTER_PIPELINE_H
+#define LOBSTER_PIPELINE_H
+
+#include "lobster_batch.h"
+#include "lobster_replay.h"
+#include "lockfree_queue.h"
+#include "tsc_clock.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+// Replays a LOBSTER message file as a three-stage pipeline, one thread per stage:
+//  parse:    mmaps the file (CSV or columnar) and decodes it into LobsterEvents
+//  match:    applies the events to the book with LobsterReplay; emits every fill, and a depth snapshot every
+//            snapshot_interval events
+//  publish:  hands those records to a publisher (OnTrade / OnSnapshot)
+// The stages are joined by bounded SpscQueues and move up to `batch` records per queue operation. A stage whose next
+// queue is full waits for room (backpressure), so a slow publisher slows the replay down rather than losing records.
+// Each stage splits its wall time on the TSC into busy, starved (waiting for input) and blocked (waiting for room
+// downstream). The stage that is busy nearly all the time is the bottleneck; the others show it as starved or blocked.
+
+
+constexpr std::size_t kPipelineDepth = 5;   // Levels per side in a snapshot record
+
+enum class PipelineRecordType : std::uint8_t { Trade, Snapshot };
+
+// Matcher output: one fill, or the top of the book after `events` events
+struct PipelineRecord{
+ PipelineRecordType type;
+ std::uint8_t bid_levels;              // Snapshot: entries used in bids and asks
+ std::uint8_t ask_levels;
+ std::uint64_t timestamp_ns;           // Of the event that produced the record
+ std::uint64_t events;                 // Events applied so far
+ FillEvent fill;                       // Trade
+ LevelInfo bids[kPipelineDepth];       // Snapshot, best first
+ LevelInfo asks[kPipelineDepth];
+};
+
+struct PipelineConfig{
+ std::size_t event_capacity{1 << 16};    // Parse -> match queue; power of two
+ std::size_t record_capacity{1 << 14};   // Match -> publish queue; power of two
+ std::size_t batch{256};                 // Records per queue operation
+ std::size_t snapshot_interval{1024};    // Events between snapshots; 0: none. The last event always gets one.
+ bool pin_threads{true};                 // Pin stage i (parse, match, publish) to core (first_core + i) % hardware cores
+ std::size_t first_core{0};
+};
+
+struct PipelineStageStats{
+ std::uint64_t items{0};          // Events parsed, events matched, records published
+ std::uint64_t batches{0};
+ double busy_seconds{0};
+ double starved_seconds{0};       // Waiting for the stage before
+ double blocked_seconds{0};       // Waiting for room in the queue after
+ double cpu_seconds{0};           // Thread CPU time; below the wall time when stages outnumber free cores
+
+ double Utilization(double wall_seconds) const { return wall_seconds > 0 ? busy_seconds / wall_seconds : 0; }
+};
+
+struct PipelineStats{
+ ReplayStats replay;
+ PipelineStageStats parse;
+ PipelineStageStats match;
+ PipelineStageStats publish;
+ std::uint64_t trades{0};
+ std::uint64_t snapshots{0};
+ double wall_seconds{0};
+};
+
+// Publisher that keeps running totals and the latest snapshot
+struct PipelineSummary{
+ std::uint64_t trades{0};
+ std::uint64_t traded_quantity{0};
+ double notional{0};
+ std::uint64_t snapshots{0};
+ PipelineRecord last_snapshot{};
+
+ void OnTrade(const PipelineRecord& record){
+  ++trades;
+  traded_quantity += record.fill.quantity;
+  notional += static_cast<double>(record.fill.price) * record.fill.quantity;
+ }
+ void OnSnapshot(const PipelineRecord& record){
+  ++snapshots;
+  last_snapshot = record;
+ }
+ double Vwap() const { return traded_quantity == 0 ? 0 : notional / static_cast<double>(traded_quantity); }
+};
+
+
+namespace pipeline_detail {
+
+ // Charges the time since the previous mark to the state the stage was in
+ class StageClock{
+  public:
+   StageClock(): last_ {TscClock::Now()} { }
+
+   void Busy() { Charge(busy_); }
+   void Starved() { Charge(starved_); }
+   void Blocked() { Charge(blocked_); }
+
+   void Finish(PipelineStageStats& stats){
+    Busy();
+    stats.busy_seconds = TscClock::ToNs(busy_) * 1e-9;
+    stats.starved_seconds = TscClock::ToNs(starved_) * 1e-9;
+    stats.blocked_seconds = TscClock::ToNs(blocked_) * 1e-9;
+   }
+
+  private:
+   void Charge(std::uint64_t& ticks){
+    std::uint64_t now = TscClock::Now();
+    ticks += now - last_;
+    last_ = now;
+   }
+
+   std::uint64_t last_;
+   std::uint64_t busy_{0};
+   std::uint64_t starved_{0};
+   std::uint64_t blocked_{0};
+ };
+
+ // Push all of values, waiting for room; false if another stage failed meanwhile
+ template <typename T>
+ bool PushAll(SpscQueue<T>& queue, const T* values, std::size_t count, const std::atomic<bool>& failed, StageClock& clock){
+  std::size_t pushed = queue.TryPushBatch(values, count);
+  if (pushed == count){
+   return true;
+  }
+  clock.Busy();
+  SpinBackoff backoff;
+  while (pushed != count){
+   if (failed.load(std::memory_order_relaxed)){
+    return false;
+   }
+   backoff.Wait();
+   pushed += queue.TryPushBatch(values + pushed, count - pushed);
+  }
+  clock.Blocked();
+  return true;
+ }
+
+ // Hand up to batch queued records to fn, waiting for input; 0 once the stage before has finished and the queue is
+ // drained, or another stage failed
+ template <typename T, typename Fn>
+ std::size_t PopOrWait(SpscQueue<T>& queue, Fn& fn, std::size_t batch, const std::atomic<bool>& upstream_done,
+  const std::atomic<bool>& failed, StageClock& clock){
+  std::size_t count = queue.PopBatch(fn, batch);
+  if (count != 0){
+   return count;
+  }
+  clock.Busy();
+  SpinBackoff backoff;
+  while (queue.Empty()){
+   bool done = upstream_done.load(std::memory_order_acquire); // Set after the last push, so empty now means finished
+   if ((done && queue.Empty()) || failed.load(std::memory_order_relaxed)){
+    clock.Starved();
+    return 0;
+   }
+   backoff.Wait();
+  }
+  clock.Starved();
+  return queue.PopBatch(fn, batch);
+ }
+
+} // namespace pipeline_detail
+
+
+// One run over one file. Run starts the three stage threads and returns when every record has been published.
+template <typename Book, typename Publisher>
+class LobsterPipeline{
+ public:
+  LobsterPipeline(const char* path, Book& book, Publisher& publisher, const PipelineConfig& config):
+   path_ {path},
+   book_ {book},
+   publisher_ {publisher},
+   config_ {config},
+   events_ {config.event_capacity},
+   records_ {config.record_capacity}
+  {
+   if (config_.batch == 0){
+    throw std::logic_error("ReplayLobsterPipelined: batch must be at least 1");
+   }
+  }
+
+  PipelineStats Run(){
+   auto start = std::chrono::steady_clock::now();
+   std::thread publish([this]{ Stage(2, [this]{ Publish(); }); });
+   std::thread match([this]{ Stage(1, [this]{ Match(); }); });
+   std::thread parse([this]{ Stage(0, [this]{ Parse(); }); });
+   parse.join();
+   match.join();
+   publish.join();
+   stats_.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   stats_.replay.malformed_rows = malformed_rows_; // The matcher thread fills in the rest of replay
+   for (const std::exception_ptr& error : errors_){
+    if (error){
+     std::rethrow_exception(error);
+    }
+   }
+   return stats_;
+  }
+
+ private:
+  // Runs one stage body on its thread; an exception stops the whole pipeline and is rethrown by Run
+  template <typename Body>
+  void Stage(std::size_t index, Body body){
+   if (config_.pin_threads){
+    PinCurrentThread(config_.first_core + index);
+   }
+   try {
+    body();
+   }
+   catch (...){
+    errors_[index] = std::current_exception();
+    failed_.store(true, std::memory_order_relaxed);
+   }
+   (index == 0 ? parsed_ : matched_).store(true, std::memory_order_release);
+  }
+
+  void Parse(){
+   if (IsLobsterColumnar(path_)){
+    LobsterColumnarReader reader(path_);
+    Parse(reader);
+   }
+   else {
+    LobsterMessageReader reader(path_);
+    Parse(reader);
+   }
+  }
+
+  template <typename Reader>
+  void Parse(Reader& reader){
+   double cpu_start = batch_detail::ThreadCpuSeconds();
+   pipeline_detail::StageClock clock;
+   PipelineStageStats stage;
+   std::vector<LobsterEvent> buffer(config_.batch);
+   while (true){
+    std::size_t count = 0;
+    while (count < buffer.size() && reader.Next(buffer[count])){
+     ++count;
+    }
+    if (count != 0){
+     if (!pipeline_detail::PushAll(events_, buffer.data(), count, failed_, clock)){
+      break;
+     }
+     stage.items += count;
+     ++stage.batches;
+    }
+    if (count < buffer.size()){
+     break;
+    }
+   }
+   clock.Finish(stage);
+   stage.cpu_seconds = batch_detail::ThreadCpuSeconds() - cpu_start;
+   stats_.parse = stage;
+   malformed_rows_ = reader.Malformed();
+  }
+
+  // Collects the matcher's records and pushes them downstream a batch at a time
+  struct RecordSink : BookEventSink{
+   LobsterPipeline& pipeline;
+   pipeline_detail::StageClock& clock;
+   std::vector<PipelineRecord> pending;
+   std::uint64_t timestamp_ns{0};
+   std::uint64_t events{0};
+   std::uint64_t trades{0};
+   std::uint64_t snapshots{0};
+   bool failed{false};
+
+   RecordSink(LobsterPipeline& owner, pipeline_detail::StageClock& stage_clock): pipeline {owner}, clock {stage_clock} {
+    pending.reserve(owner.config_.batch);
+   }
+
+   void OnFill(const FillEvent& fill){
+    PipelineRecord& record = Add(PipelineRecordType::Trade);
+    record.fill = fill;
+    ++trades;
+   }
+
+   PipelineRecord& Add(PipelineRecordType type){
+    if (pending.size() == pipeline.config_.batch){
+     Flush();
+    }
+    pending.emplace_back();
+    PipelineRecord& record = pending.back();
+    record.type = type;
+    record.timestamp_ns = timestamp_ns;
+    record.events = events;
+    return record;
+   }
+
+   void Flush(){
+    if (!pending.empty() && !failed){
+     failed = !pipeline_detail::PushAll(pipeline.records_, pending.data(), pending.size(), pipeline.failed_, clock);
+    }
+    pending.clear();
+   }
+  };
+
+  void Snapshot(RecordSink& sink){
+   book_.GetDepth(kPipelineDepth, depth_);
+   PipelineRecord& record = sink.Add(PipelineRecordType::Snapshot);
+   record.bid_levels = static_cast<std::uint8_t>(depth_.getBids().size());
+   record.ask_levels = static_cast<std::uint8_t>(depth_.getAsks().size());
+   std::copy(depth_.getBids().begin(), depth_.getBids().end(), record.bids);
+   std::copy(depth_.getAsks().begin(), depth_.getAsks().end(), record.asks);
+   ++sink.snapshots;
+  }
+
+  void Match(){
+   double cpu_start = batch_detail::ThreadCpuSeconds();
+   pipeline_detail::StageClock clock;
+   PipelineStageStats stage;
+   LobsterReplay<Book> replay(book_);
+   RecordSink sink(*this, clock);
+   std::uint64_t interval = config_.snapshot_interval;
+   auto apply = [&](const LobsterEvent& event){
+    sink.timestamp_ns = event.timestamp_ns;
+    sink.events = replay.Stats().events + 1;
+    replay.Apply(event, sink);
+    if (interval != 0 && sink.events % interval == 0){
+     Snapshot(sink);
+    }
+   };
+   std::size_t count;
+   while (!sink.failed && (count = pipeline_detail::PopOrWait(events_, apply, config_.batch, parsed_, failed_, clock)) != 0){
+    stage.items += count;
+    ++stage.batches;
+    sink.Flush();
+   }
+   if (!failed_.load(std::memory_order_relaxed) && replay.Stats().events != 0 && (interval == 0 || sink.events % interval != 0)){
+    Snapshot(sink); // Final state of the book
+    sink.Flush();
+   }
+   stats_.replay = replay.Stats();
+   clock.Finish(stage);
+   stage.cpu_seconds = batch_detail::ThreadCpuSeconds() - cpu_start;
+   stats_.match = stage;
+   stats_.trades = sink.trades;
+   stats_.snapshots = sink.snapshots;
+  }
+
+  void Publish(){
+   double cpu_start = batch_detail::ThreadCpuSeconds();
+   pipeline_detail::StageClock clock;
+   PipelineStageStats stage;
+   auto publish = [this](const PipelineRecord& record){
+    if (record.type == PipelineRecordType::Trade){
+     publisher_.OnTrade(record);
+    }
+    else {
+     publisher_.OnSnapshot(record);
+    }
+   };
+   std::size_t count;
+   while ((count = pipeline_detail::PopOrWait(records_, publish, config_.batch, matched_, failed_, clock)) != 0){
+    stage.items += count;
+    ++stage.batches;
+   }
+   clock.Finish(stage);
+   stage.cpu_seconds = batch_detail::ThreadCpuSeconds() - cpu_start;
+   stats_.publish = stage;
+  }
+
+  const char* path_;
+  Book& book_;
+  Publisher& publisher_;
+  PipelineConfig config_;
+  SpscQueue<LobsterEvent> events_;
+  SpscQueue<PipelineRecord> records_;
+  OrderBookLevelInfos depth_;          // Matcher's reused snapshot buffer
+  PipelineStats stats_;                // Each stage stores its own fields once, when it ends
+  std::uint64_t malformed_rows_{0};   // Parser's count, moved into stats_.replay once every stage has ended
+  std::exception_ptr errors_[3];
+  std::atomic<bool> parsed_{false};    // Parser has pushed its last event
+  std::atomic<bool> matched_{false};   // Matcher has pushed its last record
+  std::atomic<bool> failed_{false};
+};
+
+// Replay a message file (CSV or columnar) into book on three threads, publishing fills and snapshots to publisher.
+// Throws the first stage's exception, e.g. runtime_error for a file that cannot be opened.
+template <typename Book, typename Publisher>
+PipelineStats ReplayLobsterPipelined(const char* path, Book& book, Publisher& publisher, const PipelineConfig& config = {}){
+ LobsterPipeline<Book, Publisher> pipeline(path, book, publisher, config);
+ return pipeline.Run();
+}
+
+#endif // LOBSTER_PIPELINE_H
@@ -0,0 +1,152 @@
+#ifndef LOBSTER_REPLAY_H
+#define LOBSTER_REPLAY_H
+
+#include "lobster_columnar.h"
+#include "lobster_parser.h"
+#include "ordersApi.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+
+// Drives an OrderBook from LOBSTER message events.
+// LOBSTER reports executions against the resting order (the aggressor is not in the feed), so visible executions are
+// applied with ExecuteOrder rather than by submitting a crossing order. Cancels and executions that reference orders
+// submitted before the file starts are counted as unknown and skipped.
+
+// What a trading halt (type 7, price -1) does to the resting orders
+enum class HaltPolicy : std::uint8_t{
+ CancelAll,   // Cancel every resting order through Book::CancelAll, reporting each to the sink (default)
+ Keep         // Only mark the replay halted, for feeds whose orders survive the halt
+};
+
+struct ReplayStats{
+ std::uint64_t events{0};
+ std::uint64_t malformed_rows{0};     // Rows the reader skipped (see LobsterMessageReader)
+ std::uint64_t by_type[8]{};          // Indexed by LobsterEventType value
+ std::uint64_t unknown_orders{0};     // Cancels/executions of orders not in the book
+ std::uint64_t rejected_orders{0};    // New orders the book refused, e.g. a price beyond a ladder's maximum window
+ std::uint64_t executed_quantity{0};  // Visible executions applied to the book
+ std::uint64_t hidden_quantity{0};    // Hidden executions and crosses (no book change)
+ std::uint64_t book_trades{0};        // Trades produced by the book itself (0 for a consistent LOBSTER file)
+ std::uint64_t halts{0};
+ std::uint64_t halt_cancelled{0};     // Orders cancelled by halts under HaltPolicy::CancelAll
+ bool halted{false};
+ std::size_t max_bid_levels{0};       // Deepest each side got (levels only appear on a new order)
+ std::size_t max_ask_levels{0};
+ std::uint64_t first_timestamp_ns{0};
+ std::uint64_t last_timestamp_ns{0};
+};
+
+template <typename Book>
+class LobsterReplay{
+ public:
+  explicit LobsterReplay(Book& book, HaltPolicy halt_policy = HaltPolicy::CancelAll): book_ {book}, halt_policy_ {halt_policy} { }
+
+  void Apply(const LobsterEvent& event){
+   BookEventSink sink;
+   Apply(event, sink);
+  }
+
+  // Book outcomes, including the fills of visible executions, are reported to sink
+  template <typename Sink>
+  void Apply(const LobsterEvent& event, Sink& sink){
+   if (stats_.events++ == 0){
+    stats_.first_timestamp_ns = event.timestamp_ns;
+   }
+   stats_.last_timestamp_ns = event.timestamp_ns;
+   ++stats_.by_type[static_cast<std::uint8_t>(event.type)];
+
+   switch (event.type){
+   case LobsterEventType::NewOrder:
+    {
+     TradeCounter<Sink> counter{sink, stats_.book_trades, stats_.rejected_orders};
+     book_.ProcessNewOrder(Order(event.order_id, event.side, event.price, event.size, OrderType::Goodtillcancel), counter);
+     std::size_t& max_levels = event.side == OrderSide::Buy ? stats_.max_bid_levels : stats_.max_ask_levels;
+     max_levels = std::max(max_levels, book_.LevelCount(event.side));
+    }
+    break;
+   case LobsterEventType::PartialCancel:
+    if (!book_.ReduceOrder(event.order_id, event.size, sink)){
+     ++stats_.unknown_orders;
+    }
+    break;
+   case LobsterEventType::FullCancel:
+    if (!book_.TryCancelOrder(event.order_id, sink)){
+     ++stats_.unknown_orders;
+    }
+    break;
+   case LobsterEventType::VisibleExecution:
+    {
+     Quantity executed = 0;
+     if (!book_.ExecuteOrder(event.order_id, event.size, sink, executed)){
+      ++stats_.unknown_orders;
+     }
+     stats_.executed_quantity += executed;
+    }
+    break;
+   case LobsterEventType::HiddenExecution:
+   case LobsterEventType::Cross:
+    stats_.hidden_quantity += event.size;
+    break;
+   case LobsterEventType::TradingHalt:
+    // Price -1: halt, 0: quoting resumes, 1: trading resumes
+    if (event.price == -1){
+     stats_.halted = true;
+     ++stats_.halts;
+     if (halt_policy_ == HaltPolicy::CancelAll){
+      stats_.halt_cancelled += book_.CancelAll(sink);
+     }
+    }
+    else if (event.price == 1){
+     stats_.halted = false;
+    }
+    break;
+   }
+  }
+
+  const ReplayStats& Stats() const { return stats_; }
+
+ private:
+  // Counts trades the book generates itself (visible executions are applied with ExecuteOrder instead) and refused orders
+  template <typename Sink>
+  struct TradeCounter{
+   Sink& sink;
+   std::uint64_t& trades;
+   std::uint64_t& rejects;
+   void OnAccepted(const Order& order) { sink.OnAccepted(order); }
+   void OnRejected(const Order& order, RejectReason reason) { ++rejects; sink.OnRejected(order, reason); }
+   void OnFill(const FillEvent& fill) { ++trades; sink.OnFill(fill); }
+   void OnCancelled(OrderId order_id, Quantity quantity) { sink.OnCancelled(order_id, quantity); }
+  };
+
+  Book& book_;
+  HaltPolicy halt_policy_;
+  ReplayStats stats_;
+};
+
+// Replay every event of a reader (LobsterMessageReader or LobsterColumnarReader) into book
+template <typename Reader, typename Book>
+ReplayStats ReplayEvents(Reader& reader, Book& book, HaltPolicy halt_policy = HaltPolicy::CancelAll){
+ LobsterReplay<Book> replay(book, halt_policy);
+ LobsterEvent event{};
+ while (reader.Next(event)){
+  replay.Apply(event);
+ }
+ ReplayStats stats = replay.Stats();
+ stats.malformed_rows = reader.Malformed();
+ return stats;
+}
+
+// Replay a whole message file into book: a LOBSTER CSV, or its columnar conversion (see lobster_columnar.h)
+template <typename Book>
+ReplayStats ReplayLobsterFile(const char* path, Book& book, HaltPolicy halt_policy = HaltPolicy::CancelAll){
+ if (IsLobsterColumnar(path)){
+  LobsterColumnarReader reader(path);
+  return ReplayEvents(reader, book, halt_policy);
+ }
+ LobsterMessageReader reader(path);
+ return ReplayEvents(reader, book, halt_policy);
+}
+
+#endif // LOBSTER_REPLAY_H
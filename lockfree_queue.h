@@ -0,0 +1,250 @@
+#ifndef LOCKFREE_QUEUE_H
+#define LOCKFREE_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+// Bounded lock-free queues for passing fixed-size records between threads.
+//  SpscQueue: one producer thread, one consumer thread. Each side caches the other's index, so a push or pop touches
+//             the shared indices only when the cached view says the queue is full or empty. TryPushBatch and
+//             PopBatch move many records per index update.
+//  MpscQueue: any number of producers, one consumer. Per-slot sequence numbers (Vyukov's bounded queue): producers
+//             claim a slot with one CAS, the consumer never writes a shared index.
+// Capacity is fixed at construction and must be a power of two. TryPush returns false when full; nothing blocks.
+
+
+constexpr std::size_t kCacheLineSize = 64;
+
+// Spin-wait hint: lets the sibling hyperthread run and saves power while polling
+inline void CpuRelax(){
+#if defined(__x86_64__) || defined(__i386__)
+ _mm_pause();
+#elif defined(__aarch64__)
+ asm volatile("yield");
+#endif
+}
+
+// Escalating wait for a polling loop: spin with CpuRelax, then yield the core. Call Reset() after useful work.
+class SpinBackoff{
+ public:
+  void Wait(){
+   if (spins_ < kSpinLimit){
+    ++spins_;
+    CpuRelax();
+   }
+   else {
+    std::this_thread::yield(); // Give the core away, e.g. when threads outnumber cores
+   }
+  }
+  void Reset(){ spins_ = 0; }
+
+ private:
+  static constexpr std::uint32_t kSpinLimit = 256;
+  std::uint32_t spins_{0};
+};
+
+
+// Pin the calling thread to core % hardware cores (Linux only). Best effort: a restricted cpuset leaves it unpinned.
+inline void PinCurrentThread(std::size_t core){
+#if defined(__linux__)
+ std::size_t cores = std::thread::hardware_concurrency();
+ if (cores == 0){
+  return;
+ }
+ cpu_set_t set;
+ CPU_ZERO(&set);
+ CPU_SET(static_cast<int>(core % cores), &set);
+ pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+ (void)core;
+#endif
+}
+
+
+namespace queue_detail {
+
+ inline std::size_t CheckCapacity(std::size_t capacity, const char* name){
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0){
+   throw std::logic_error(std::string(name) + ": capacity must be a power of two");
+  }
+  return capacity;
+ }
+
+} // namespace queue_detail
+
+
+template <typename T>
+class SpscQueue{
+ public:
+  explicit SpscQueue(std::size_t capacity):
+   mask_ {queue_detail::CheckCapacity(capacity, "SpscQueue") - 1},
+   slots_(capacity)
+  { }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // Producer thread only
+  bool TryPush(const T& value){
+   std::size_t head = head_.load(std::memory_order_relaxed);
+   if (head - cached_tail_ > mask_){
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    if (head - cached_tail_ > mask_){
+     return false;
+    }
+   }
+   slots_[head & mask_] = value;
+   head_.store(head + 1, std::memory_order_release);
+   return true;
+  }
+
+  // Producer thread only: copy as many of values[0, count) as fit, publishing them once at the end
+  std::size_t TryPushBatch(const T* values, std::size_t count){
+   std::size_t head = head_.load(std::memory_order_relaxed);
+   std::size_t room = mask_ + 1 - (head - cached_tail_);
+   if (room < count){
+    cached_tail_ = tail_.load(std::memory_order_acquire);
+    room = mask_ + 1 - (head - cached_tail_);
+   }
+   if (count > room){
+    count = room;
+   }
+   for (std::size_t i = 0; i < count; ++i){
+    slots_[(head + i) & mask_] = values[i];
+   }
+   if (count != 0){
+    head_.store(head + count, std::memory_order_release);
+   }
+   return count;
+  }
+
+  // Consumer thread only
+  bool TryPop(T& out){
+   std::size_t tail = tail_.load(std::memory_order_relaxed);
+   if (tail == cached_head_){
+    cached_head_ = head_.load(std::memory_order_acquire);
+    if (tail == cached_head_){
+     return false;
+    }
+   }
+   out = slots_[tail & mask_];
+   tail_.store(tail + 1, std::memory_order_release);
+   return true;
+  }
+
+  // Consumer thread only: hand up to max_count queued values to fn, publishing the freed slots once at the end
+  template <typename Fn>
+  std::size_t PopBatch(Fn&& fn, std::size_t max_count){
+   std::size_t tail = tail_.load(std::memory_order_relaxed);
+   std::size_t available = cached_head_ - tail;
+   if (available == 0){
+    cached_head_ = head_.load(std::memory_order_acquire);
+    available = cached_head_ - tail;
+    if (available == 0){
+     return 0;
+    }
+   }
+   std::size_t count = available < max_count ? available : max_count;
+   for (std::size_t i = 0; i < count; ++i){
+    fn(slots_[(tail + i) & mask_]);
+   }
+   tail_.store(tail + count, std::memory_order_release);
+   return count;
+  }
+
+  // Approximate when called while the other side is running
+  std::size_t Size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+  bool Empty() const { return Size() == 0; }
+  std::size_t Capacity() const { return mask_ + 1; }
+
+ private:
+  const std::size_t mask_;
+  std::vector<T> slots_;
+  alignas(kCacheLineSize) std::atomic<std::size_t> head_{0}; // Written by the producer
+  std::size_t cached_tail_{0};                                // Producer's view of tail_
+  alignas(kCacheLineSize) std::atomic<std::size_t> tail_{0}; // Written by the consumer
+  std::size_t cached_head_{0};                                // Consumer's view of head_
+};
+
+
+template <typename T>
+class MpscQueue{
+ public:
+  explicit MpscQueue(std::size_t capacity):
+   mask_ {queue_detail::CheckCapacity(capacity, "MpscQueue") - 1},
+   cells_ {new Cell[capacity]}
+  {
+   for (std::size_t i = 0; i < capacity; ++i){
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+   }
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  // Any thread
+  bool TryPush(const T& value){
+   std::size_t head = head_.load(std::memory_order_relaxed);
+   while (true){
+    Cell& cell = cells_[head & mask_];
+    std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    std::intptr_t lag = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(head);
+    if (lag == 0){
+     if (head_.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)){
+      cell.value = value;
+      cell.sequence.store(head + 1, std::memory_order_release); // Publish to the consumer
+      return true;
+     }
+    }
+    else if (lag < 0){
+     return false; // Slot still holds a value from the previous lap: full
+    }
+    else {
+     head = head_.load(std::memory_order_relaxed); // Another producer claimed it
+    }
+   }
+  }
+
+  // Consumer thread only
+  bool TryPop(T& out){
+   Cell& cell = cells_[tail_ & mask_];
+   if (cell.sequence.load(std::memory_order_acquire) != tail_ + 1){
+    return false; // Empty, or the claiming producer has not finished writing
+   }
+   out = cell.value;
+   cell.sequence.store(tail_ + mask_ + 1, std::memory_order_release); // Free the slot for the next lap
+   ++tail_;
+   return true;
+  }
+
+  std::size_t Capacity() const { return mask_ + 1; }
+
+ private:
+  struct Cell{
+   std::atomic<std::size_t> sequence{0};
+   T value{};
+  };
+
+  const std::size_t mask_;
+  std::unique_ptr<Cell[]> cells_;
+  alignas(kCacheLineSize) std::atomic<std::size_t> head_{0}; // Next slot to claim, shared by producers
+  alignas(kCacheLineSize) std::size_t tail_{0};              // Consumer only
+};
+
+#endif // LOCKFREE_QUEUE_H
@@ -0,0 +1,528 @@
+#ifndef MARKET_DATA_H
+#define MARKET_DATA_H
+
+#include "book_events.h"
+#include "order_index.h"
+#include "orders.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// Incremental market data: a book's changes as a compact binary stream, and a decoder that rebuilds the book from it.
+// MarketDataEncoder is a book event sink. It turns the book's callbacks into
+//  L3 messages, one per order change: added (only the part that rests, after any fills), executed, reduced in place,
+//     deleted. A taker that never rests, like an IOC, appears only as the executions of the orders it hit.
+//  L2 messages: the new aggregate quantity and order count of each price level that changed (0 orders: level gone).
+// Messages go into a buffer allocated once, framed in batches: call EndBatch() after each command or group of
+// commands, then hand Data()/Size() downstream and Clear(). With conflation on, the L2 updates of a batch are
+// collapsed to one per level that changed, written at EndBatch with the level's final state.
+// Attach the encoder to an empty book: it keeps its own table of resting orders and levels to fill in what the
+// callbacks leave out (a cancel carries only the id; a level update needs its total).
+//
+// Wire format, native byte order, no padding; every message starts with its type byte:
+//  Batch          sequence u64, message count u32             13 bytes
+//  OrderAdded     id u64, side u8, price i32, quantity u32     18 bytes
+//  OrderExecuted  id u64, price i32, quantity u32              17 bytes (price: the execution price)
+//  OrderReduced   id u64, remaining u32                        13 bytes
+//  OrderDeleted   id u64                                        9 bytes
+//  LevelUpdate    side u8, price i32, quantity u32, orders u32 14 bytes
+
+
+enum class MarketDataType : std::uint8_t{
+ Batch = 1,
+ OrderAdded,
+ OrderExecuted,
+ OrderReduced,
+ OrderDeleted,
+ LevelUpdate,
+};
+
+constexpr std::size_t kMarketDataTypes = 7;   // Indexed by MarketDataType value
+
+// Encoded size of a message of this type, 0 for an unknown type
+inline std::size_t MarketDataMessageSize(std::uint8_t type){
+ static constexpr std::size_t sizes[kMarketDataTypes] = {0, 13, 18, 17, 13, 9, 14};
+ return type < kMarketDataTypes ? sizes[type] : 0;
+}
+
+struct MarketDataConfig{
+ bool l3{true};
+ bool l2{true};
+ bool conflate{false};                  // One L2 update per changed level per batch
+ std::size_t buffer_bytes{1 << 20};     // Must hold the largest batch; messages that do not fit are dropped and counted
+};
+
+// Same levels, quantities and order counts on both sides
+inline bool SameDepth(const OrderBookLevelInfos& a, const OrderBookLevelInfos& b){
+ auto same = [](const LevelInfos& x, const LevelInfos& y){
+  if (x.size() != y.size()){
+   return false;
+  }
+  for (std::size_t i = 0; i < x.size(); ++i){
+   if (x[i].price != y[i].price || x[i].quantity != y[i].quantity || x[i].order_count != y[i].order_count){
+    return false;
+   }
+  }
+  return true;
+ };
+ return same(a.getBids(), b.getBids()) && same(a.getAsks(), b.getAsks());
+}
+
+
+namespace market_data_detail {
+
+ template <typename T>
+ char* Put(char* out, T value){
+  std::memcpy(out, &value, sizeof(T));
+  return out + sizeof(T);
+ }
+
+ template <typename T>
+ T Get(const char*& in){
+  T value;
+  std::memcpy(&value, in, sizeof(T));
+  in += sizeof(T);
+  return value;
+ }
+
+ struct FeedOrder{
+  Price price;
+  Quantity remaining;
+  OrderSide side;
+ };
+
+ // One flat table for both sides' levels: the side above the price bits
+ constexpr std::uint64_t LevelKey(OrderSide side, Price price){
+  return static_cast<std::uint64_t>(side) << 32 | static_cast<std::uint32_t>(price);
+ }
+
+} // namespace market_data_detail
+
+
+class MarketDataEncoder : public BookEventSink{
+ public:
+  explicit MarketDataEncoder(const MarketDataConfig& config = MarketDataConfig{}, std::size_t capacity_hint = 0):
+   config_ {config},
+   buffer_(config.buffer_bytes),
+   orders_ {capacity_hint}
+  { }
+
+  MarketDataEncoder(const MarketDataEncoder&) = delete;
+  MarketDataEncoder& operator=(const MarketDataEncoder&) = delete;
+
+  // Book callbacks. An accepted order is held back until its fills are known: what is left then is the added order.
+  void OnAccepted(const Order& order){
+   Finalize();
+   Hold(order.GetOrderId(), order.GetOrderSide(), order.GetPrice(), order.GetRemainingQuantity());
+  }
+
+  void OnModified(const Order& order){
+   Finalize();
+   FeedOrder* entry = orders_.Find(order.GetOrderId());
+   if (entry == nullptr){
+    return;
+   }
+   if (entry->side == order.GetOrderSide() && entry->price == order.GetPrice() && order.GetRemainingQuantity() < entry->remaining){
+    Quantity reduced = entry->remaining - order.GetRemainingQuantity();
+    entry->remaining = order.GetRemainingQuantity();
+    if (char* out = Reserve(MarketDataType::OrderReduced)){
+     out = market_data_detail::Put(out, order.GetOrderId());
+     market_data_detail::Put(out, entry->remaining);
+    }
+    ChangeLevel(entry->side, entry->price, -static_cast<std::int64_t>(reduced), 0);
+    return;
+   }
+   // Larger, repriced or switched side: the order loses its place, so it is deleted and added again once any fills
+   // of its new terms are known
+   Delete(order.GetOrderId());
+   Hold(order.GetOrderId(), order.GetOrderSide(), order.GetPrice(), order.GetRemainingQuantity());
+  }
+
+  void OnFill(const FillEvent& fill){
+   if (fill.auction){ // Both orders were resting
+    Finalize();
+    Execute(fill.maker_order_id, fill.price, fill.quantity);
+    Execute(fill.taker_order_id, fill.price, fill.quantity);
+    return;
+   }
+   if (held_active_ && fill.taker_order_id == held_id_){
+    held_.remaining -= fill.quantity;
+   }
+   else {
+    Finalize();
+   }
+   Execute(fill.maker_order_id, fill.price, fill.quantity);
+  }
+
+  void OnCancelled(OrderId order_id, Quantity){
+   if (held_active_ && order_id == held_id_){ // Unfilled rest of an immediate order: nothing was published for it
+    held_active_ = false;
+    return;
+   }
+   Finalize();
+   Delete(order_id);
+  }
+
+  // Close the batch: write the held order, the conflated level updates and the batch's message count
+  void EndBatch(){
+   Finalize();
+   for (const auto& [side, price] : dirty_){
+    FeedLevel& level = *levels_.Find(LevelKey(side, price));
+    level.dirty = false;
+    WriteLevel(side, price, level);
+    if (level.orders == 0){
+     levels_.Erase(LevelKey(side, price));
+    }
+   }
+   dirty_.clear();
+   if (batch_open_){
+    char* header = buffer_.data() + batch_start_ + 1 + sizeof(std::uint64_t);
+    market_data_detail::Put(header, batch_count_);
+    batch_open_ = false;
+    ++sequence_;
+   }
+  }
+
+  // Encoded batches waiting to be sent. Clear() between batches, once they have been taken.
+  const char* Data() const { return buffer_.data(); }
+  std::size_t Size() const { return size_; }
+  void Clear(){
+   if (batch_open_){
+    throw std::logic_error("MarketDataEncoder: Clear inside an open batch");
+   }
+   size_ = 0;
+  }
+
+  std::uint64_t Count(MarketDataType type) const { return counts_[static_cast<std::size_t>(type)]; }
+  std::uint64_t Messages() const { return messages_; }   // Batch headers excluded
+  std::uint64_t Dropped() const { return dropped_; }
+  std::uint64_t Sequence() const { return sequence_; }   // Of the next batch
+
+ private:
+  using FeedOrder = market_data_detail::FeedOrder;
+  static constexpr auto LevelKey = market_data_detail::LevelKey;
+
+  struct FeedLevel{
+   std::uint64_t quantity{0};
+   std::uint32_t orders{0};
+   bool dirty{false};
+  };
+
+  MarketDataConfig config_;
+  std::vector<char> buffer_;
+  std::size_t size_{0};
+  OrderIdMap<FeedOrder> orders_;
+  OrderIdMap<FeedLevel> levels_;                       // Keyed by LevelKey(side, price)
+  std::vector<std::pair<OrderSide, Price>> dirty_;     // Levels changed in this batch (conflation)
+  FeedOrder held_{};                                   // Accepted order whose fills are not all known yet
+  OrderId held_id_{0};
+  bool held_active_{false};
+  bool batch_open_{false};
+  std::size_t batch_start_{0};
+  std::uint32_t batch_count_{0};
+  std::uint64_t sequence_{0};
+  std::uint64_t messages_{0};
+  std::uint64_t dropped_{0};
+  std::uint64_t counts_[kMarketDataTypes]{};
+
+  void Hold(OrderId order_id, OrderSide side, Price price, Quantity remaining){
+   held_ = FeedOrder{price, remaining, side};
+   held_id_ = order_id;
+   held_active_ = true;
+  }
+
+  // The held order's fills are all known: what is left rests in the book
+  void Finalize(){
+   if (!held_active_){
+    return;
+   }
+   held_active_ = false;
+   if (held_.remaining == 0){
+    return;
+   }
+   orders_.Insert(held_id_, held_);
+   if (char* out = Reserve(MarketDataType::OrderAdded)){
+    out = market_data_detail::Put(out, held_id_);
+    out = market_data_detail::Put(out, held_.side);
+    out = market_data_detail::Put(out, held_.price);
+    market_data_detail::Put(out, held_.remaining);
+   }
+   ChangeLevel(held_.side, held_.price, held_.remaining, 1);
+  }
+
+  void Execute(OrderId order_id, Price price, Quantity quantity){
+   FeedOrder* entry = orders_.Find(order_id);
+   if (entry == nullptr){
+    return;
+   }
+   FeedOrder order = *entry;
+   entry->remaining -= quantity;
+   bool gone = entry->remaining == 0;
+   if (gone){
+    orders_.Erase(order_id);
+   }
+   if (char* out = Reserve(MarketDataType::OrderExecuted)){
+    out = market_data_detail::Put(out, order_id);
+    out = market_data_detail::Put(out, price);
+    market_data_detail::Put(out, quantity);
+   }
+   ChangeLevel(order.side, order.price, -static_cast<std::int64_t>(quantity), gone ? -1 : 0);
+  }
+
+  void Delete(OrderId order_id){
+   FeedOrder order;
+   if (!orders_.Extract(order_id, order)){
+    return;
+   }
+   if (char* out = Reserve(MarketDataType::OrderDeleted)){
+    market_data_detail::Put(out, order_id);
+   }
+   ChangeLevel(order.side, order.price, -static_cast<std::int64_t>(order.remaining), -1);
+  }
+
+  void ChangeLevel(OrderSide side, Price price, std::int64_t quantity, int orders){
+   if (!config_.l2){
+    return;
+   }
+   FeedLevel& level = *levels_.TryEmplace(LevelKey(side, price)).first;
+   level.quantity = static_cast<std::uint64_t>(static_cast<std::int64_t>(level.quantity) + quantity);
+   level.orders = static_cast<std::uint32_t>(static_cast<std::int64_t>(level.orders) + orders);
+   if (config_.conflate){
+    if (!level.dirty){
+     level.dirty = true;
+     dirty_.emplace_back(side, price);
+    }
+    return;
+   }
+   WriteLevel(side, price, level);
+   if (level.orders == 0){
+    levels_.Erase(LevelKey(side, price));
+   }
+  }
+
+  void WriteLevel(OrderSide side, Price price, const FeedLevel& level){
+   if (char* out = Reserve(MarketDataType::LevelUpdate)){
+    out = market_data_detail::Put(out, side);
+    out = market_data_detail::Put(out, price);
+    out = market_data_detail::Put(out, static_cast<Quantity>(level.quantity));
+    market_data_detail::Put(out, level.orders);
+   }
+  }
+
+  // Space for one message of this type, opening a batch if none is open; nullptr if it is not wanted or does not fit
+  char* Reserve(MarketDataType type){
+   bool l2 = type == MarketDataType::LevelUpdate;
+   if (l2 ? !config_.l2 : !config_.l3){
+    return nullptr;
+   }
+   std::size_t bytes = MarketDataMessageSize(static_cast<std::uint8_t>(type));
+   std::size_t header = batch_open_ ? 0 : MarketDataMessageSize(static_cast<std::uint8_t>(MarketDataType::Batch));
+   if (size_ + header + bytes > buffer_.size()){
+    ++dropped_;
+    return nullptr;
+   }
+   if (!batch_open_){
+    batch_open_ = true;
+    batch_start_ = size_;
+    batch_count_ = 0;
+    char* out = market_data_detail::Put(buffer_.data() + size_, MarketDataType::Batch);
+    out = market_data_detail::Put(out, sequence_);
+    market_data_detail::Put(out, std::uint32_t{0});
+    size_ += header;
+   }
+   char* out = market_data_detail::Put(buffer_.data() + size_, type);
+   size_ += bytes;
+   ++batch_count_;
+   ++messages_;
+   ++counts_[static_cast<std::size_t>(type)];
+   return out;
+  }
+};
+
+
+// Rebuilds a book from an encoded stream: the resting orders and their levels from L3 messages, and separately the
+// levels as published by L2 messages. Either view can be compared with the source book's GetDepth.
+class MarketDataDecoder{
+ public:
+  explicit MarketDataDecoder(std::size_t capacity_hint = 0): orders_ {capacity_hint} { }
+
+  // Apply every batch in [data, data + size), which must hold whole batches. Returns the messages applied.
+  // Throws std::runtime_error on a malformed stream, a sequence gap, or an order message that does not fit the mirror.
+  std::size_t Decode(const char* data, std::size_t size){
+   const char* cursor = data;
+   const char* end = data + size;
+   std::size_t applied = 0;
+   while (cursor < end){
+    Need(cursor, end, MarketDataType::Batch);
+    ++cursor;
+    std::uint64_t sequence = market_data_detail::Get<std::uint64_t>(cursor);
+    std::uint32_t count = market_data_detail::Get<std::uint32_t>(cursor);
+    if (sequence != sequence_){
+     throw std::runtime_error("MarketDataDecoder: expected batch " + std::to_string(sequence_) + ", got " + std::to_string(sequence));
+    }
+    ++sequence_;
+    for (std::uint32_t i = 0; i < count; ++i){
+     Apply(cursor, end);
+    }
+    applied += count;
+   }
+   return applied;
+  }
+
+  // Top levels per side, best first, as published by L2 messages
+  void GetDepth(std::size_t levels, OrderBookLevelInfos& out) const {
+   Fill(l2_bids_, levels, out.getBids());
+   Fill(l2_asks_, levels, out.getAsks());
+  }
+
+  // Top levels per side, best first, aggregated from the L3 mirror's orders
+  void GetOrderDepth(std::size_t levels, OrderBookLevelInfos& out) const {
+   Fill(l3_bids_, levels, out.getBids());
+   Fill(l3_asks_, levels, out.getAsks());
+  }
+
+  std::size_t Orders() const { return orders_.Size(); }
+  std::uint64_t Sequence() const { return sequence_; }   // Of the next batch expected
+
+ private:
+  using FeedOrder = market_data_detail::FeedOrder;
+  using Bids = std::map<Price, LevelInfo, std::greater<Price>>;
+  using Asks = std::map<Price, LevelInfo, std::less<Price>>;
+
+  OrderIdMap<FeedOrder> orders_;
+  Bids l3_bids_;
+  Asks l3_asks_;
+  Bids l2_bids_;
+  Asks l2_asks_;
+  std::uint64_t sequence_{0};
+
+  static void Need(const char* cursor, const char* end, MarketDataType type){
+   if (static_cast<std::size_t>(end - cursor) < MarketDataMessageSize(static_cast<std::uint8_t>(type))
+    || static_cast<MarketDataType>(*cursor) != type){
+    throw std::runtime_error("MarketDataDecoder: expected a batch header");
+   }
+  }
+
+  void Apply(const char*& cursor, const char* end){
+   std::uint8_t type = static_cast<std::uint8_t>(*cursor);
+   std::size_t bytes = MarketDataMessageSize(type);
+   if (bytes == 0 || type == static_cast<std::uint8_t>(MarketDataType::Batch) || static_cast<std::size_t>(end - cursor) < bytes){
+    throw std::runtime_error("MarketDataDecoder: bad or truncated message of type " + std::to_string(type));
+   }
+   ++cursor;
+   switch (static_cast<MarketDataType>(type)){
+   case MarketDataType::OrderAdded: {
+    OrderId order_id = market_data_detail::Get<OrderId>(cursor);
+    FeedOrder order{};
+    order.side = market_data_detail::Get<OrderSide>(cursor);
+    order.price = market_data_detail::Get<Price>(cursor);
+    order.remaining = market_data_detail::Get<Quantity>(cursor);
+    if (!orders_.Insert(order_id, order)){
+     throw std::runtime_error("MarketDataDecoder: order " + std::to_string(order_id) + " added twice");
+    }
+    ChangeOrderLevel(order, order.remaining, 1);
+    break;
+   }
+   case MarketDataType::OrderExecuted: {
+    OrderId order_id = market_data_detail::Get<OrderId>(cursor);
+    market_data_detail::Get<Price>(cursor);
+    Quantity quantity = market_data_detail::Get<Quantity>(cursor);
+    FeedOrder& order = Lookup(order_id, quantity);
+    order.remaining -= quantity;
+    FeedOrder changed = order;
+    if (order.remaining == 0){
+     orders_.Erase(order_id);
+    }
+    ChangeOrderLevel(changed, -static_cast<std::int64_t>(quantity), changed.remaining == 0 ? -1 : 0);
+    break;
+   }
+   case MarketDataType::OrderReduced: {
+    OrderId order_id = market_data_detail::Get<OrderId>(cursor);
+    Quantity remaining = market_data_detail::Get<Quantity>(cursor);
+    FeedOrder& order = Lookup(order_id, remaining + 1);
+    std::int64_t reduced = static_cast<std::int64_t>(order.remaining) - remaining;
+    order.remaining = remaining;
+    ChangeOrderLevel(order, -reduced, 0);
+    break;
+   }
+   case MarketDataType::OrderDeleted: {
+    OrderId order_id = market_data_detail::Get<OrderId>(cursor);
+    FeedOrder order = Lookup(order_id, 0);
+    orders_.Erase(order_id);
+    ChangeOrderLevel(order, -static_cast<std::int64_t>(order.remaining), -1);
+    break;
+   }
+   case MarketDataType::LevelUpdate: {
+    OrderSide side = market_data_detail::Get<OrderSide>(cursor);
+    LevelInfo level{};
+    level.price = market_data_detail::Get<Price>(cursor);
+    level.quantity = market_data_detail::Get<Quantity>(cursor);
+    level.order_count = market_data_detail::Get<std::uint32_t>(cursor);
+    if (side == OrderSide::Buy){
+     SetLevel(l2_bids_, level);
+    }
+    else {
+     SetLevel(l2_asks_, level);
+    }
+    break;
+   }
+   case MarketDataType::Batch:
+    break;
+   }
+  }
+
+  // The resting order, which must hold at least `quantity`
+  FeedOrder& Lookup(OrderId order_id, Quantity quantity){
+   FeedOrder* order = orders_.Find(order_id);
+   if (order == nullptr || order->remaining < quantity){
+    throw std::runtime_error("MarketDataDecoder: order " + std::to_string(order_id) + " is not in the mirror with that quantity");
+   }
+   return *order;
+  }
+
+  void ChangeOrderLevel(const FeedOrder& order, std::int64_t quantity, int orders){
+   if (order.side == OrderSide::Buy){
+    ChangeLevel(l3_bids_, order.price, quantity, orders);
+   }
+   else {
+    ChangeLevel(l3_asks_, order.price, quantity, orders);
+   }
+  }
+
+  template <typename Levels>
+  static void ChangeLevel(Levels& levels, Price price, std::int64_t quantity, int orders){
+   LevelInfo& level = levels.try_emplace(price, LevelInfo{price, 0, 0}).first->second;
+   level.quantity = static_cast<Quantity>(static_cast<std::int64_t>(level.quantity) + quantity);
+   level.order_count = static_cast<std::uint32_t>(static_cast<std::int64_t>(level.order_count) + orders);
+   if (level.order_count == 0){
+    levels.erase(price);
+   }
+  }
+
+  template <typename Levels>
+  static void SetLevel(Levels& levels, const LevelInfo& level){
+   if (level.order_count == 0){
+    levels.erase(level.price);
+   }
+   else {
+    levels[level.price] = level;
+   }
+  }
+
+  template <typename Levels>
+  static void Fill(const Levels& levels, std::size_t count, LevelInfos& out){
+   out.clear();
+   for (auto it = levels.begin(); it != levels.end() && out.size() < count; ++it){
+    out.push_back(it->second);
+   }
+  }
+};
+
+#endif // MARKET_DATA_H
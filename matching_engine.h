@@ -0,0 +1,325 @@
+#ifndef MATCHING_ENGINE_H
+#define MATCHING_ENGINE_H
+
+#include "engine_command.h"
+#include "lockfree_queue.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Multi-instrument matching engine.
+// Each instrument has its own book. Instruments are spread round-robin over shards, and each shard's books are
+// touched only by that shard's worker thread, so books need no locking. Commands reach a worker through two lock-free
+// queues: an SpscQueue for the engine's single feeding thread (TrySubmit/Submit) and an MpscQueue that any thread may
+// use (TrySubmitShared). The worker reports accepts, rejects, modifies, fills and cancels on its own SpscQueue of
+// EngineEvents, which one consumer thread drains with PollEvents. When an output queue is full the worker waits for the
+// consumer (backpressure) instead of dropping events.
+
+
+struct EngineEvent{
+ InstrumentId instrument;
+ BookEvent event;
+};
+
+struct EngineConfig{
+ std::size_t shards{1};
+ bool pin_threads{true};              // Pin shard i to core (first_core + i) % hardware cores (Linux only)
+ std::size_t first_core{0};
+ std::size_t command_capacity{1 << 16};  // Per shard, per input queue; power of two
+ std::size_t event_capacity{1 << 16};    // Per shard; power of two
+ LevelConfig levels{};                   // Level configuration for every book
+ std::size_t orders_per_instrument{0};   // Capacity hint for each book
+};
+
+// Per-shard counters. Read them after Flush or Stop; they are written only by the worker.
+struct ShardStats{
+ std::uint64_t commands{0};
+ std::uint64_t unknown_orders{0};   // Cancel/Reduce/Execute of an id not in the book
+ std::uint64_t failed_commands{0};  // Commands the book threw on; each is dropped and the worker carries on
+ std::uint64_t output_stalls{0};    // Times the worker waited for the consumer to drain events
+};
+
+
+template <typename Book = LadderOrderBook>
+class MatchingEngine{
+ public:
+  explicit MatchingEngine(const EngineConfig& config):
+   config_ {config}
+  {
+   if (config_.shards == 0){
+    throw std::logic_error("MatchingEngine: at least one shard is required");
+   }
+   for (std::size_t i = 0; i < config_.shards; ++i){
+    shards_.push_back(std::make_unique<Shard>(config_));
+   }
+  }
+
+  ~MatchingEngine(){ Stop(); }
+
+  MatchingEngine(const MatchingEngine&) = delete;
+  MatchingEngine& operator=(const MatchingEngine&) = delete;
+
+  // Register an instrument before Start. Instrument ids index a routing table, so keep them dense.
+  void AddInstrument(InstrumentId instrument){
+   if (running_){
+    throw std::logic_error("MatchingEngine: instruments must be added before Start");
+   }
+   if (instrument >= routes_.size()){
+    routes_.resize(static_cast<std::size_t>(instrument) + 1, kNoShard);
+   }
+   if (routes_[instrument] != kNoShard){
+    throw std::logic_error("MatchingEngine: instrument " + std::to_string(instrument) + " already added");
+   }
+   std::uint32_t shard = static_cast<std::uint32_t>(instrument_count_++ % shards_.size());
+   routes_[instrument] = shard;
+   Shard& owner = *shards_[shard];
+   if (instrument >= owner.books.size()){
+    owner.books.resize(static_cast<std::size_t>(instrument) + 1);
+   }
+   owner.books[instrument] = std::make_unique<Book>(config_.levels, config_.orders_per_instrument);
+  }
+
+  std::size_t ShardCount() const { return shards_.size(); }
+  std::size_t InstrumentCount() const { return instrument_count_; }
+  std::size_t ShardOf(InstrumentId instrument) const { return Route(instrument); }
+
+  void Start(){
+   if (running_){
+    return;
+   }
+   running_ = true;
+   for (std::size_t i = 0; i < shards_.size(); ++i){
+    Shard& shard = *shards_[i];
+    shard.done.store(false, std::memory_order_relaxed);
+    shard.running.store(true, std::memory_order_release);
+    shard.worker = std::thread([this, i]{ RunShard(i); });
+   }
+  }
+
+  // Workers finish every queued command before exiting
+  void Stop(){
+   if (!running_){
+    return;
+   }
+   for (auto& shard : shards_){
+    shard->running.store(false, std::memory_order_release);
+   }
+   for (auto& shard : shards_){
+    // A worker blocked on a full output queue needs the consumer; drain so it can finish
+    while (shard->worker.joinable() && !shard->done.load(std::memory_order_acquire)){
+     PollEvents([](const EngineEvent&){ });
+     std::this_thread::yield();
+    }
+    shard->worker.join();
+   }
+   running_ = false;
+  }
+
+  // Feeding thread only. Returns false if the shard's command queue is full.
+  bool TrySubmit(const EngineCommand& command){
+   Shard& shard = *shards_[Route(command.instrument)];
+   if (!shard.commands.TryPush(command)){
+    return false;
+   }
+   ++shard.submitted;
+   return true;
+  }
+
+  // Feeding thread that also drains events: waits for queue space, passing events to fn meanwhile
+  template <typename Fn>
+  void Submit(const EngineCommand& command, Fn&& fn){
+   SpinBackoff backoff;
+   while (!TrySubmit(command)){
+    if (PollEvents(fn) == 0){
+     backoff.Wait();
+    }
+   }
+  }
+
+  // Any thread. Returns false if the shard's shared command queue is full.
+  bool TrySubmitShared(const EngineCommand& command){
+   Shard& shard = *shards_[Route(command.instrument)];
+   if (!shard.shared_commands.TryPush(command)){
+    return false;
+   }
+   shard.shared_submitted.fetch_add(1, std::memory_order_relaxed);
+   return true;
+  }
+
+  // Event consumer thread only: hand queued events to fn, shard by shard; returns how many were delivered
+  template <typename Fn>
+  std::size_t PollEvents(Fn&& fn, std::size_t max_per_shard = SIZE_MAX){
+   std::size_t delivered = 0;
+   for (auto& shard : shards_){
+    delivered += shard->events.PopBatch(fn, max_per_shard);
+   }
+   return delivered;
+  }
+
+  // Wait until every command submitted so far has been applied, passing events to fn meanwhile. Call from the thread
+  // that feeds Submit and drains events; shared submitters must have finished.
+  template <typename Fn>
+  void Flush(Fn&& fn){
+   SpinBackoff backoff;
+   for (auto& shard : shards_){
+    std::uint64_t target = shard->submitted + shard->shared_submitted.load(std::memory_order_relaxed);
+    while (shard->applied.load(std::memory_order_acquire) < target){
+     if (PollEvents(fn) == 0){
+      backoff.Wait();
+     }
+     else {
+      backoff.Reset();
+     }
+    }
+   }
+   PollEvents(fn);
+  }
+
+  const ShardStats& Stats(std::size_t shard) const { return shards_[shard]->stats; }
+
+  // Direct book access. Only safe while no commands for the instrument are in flight (after Flush or Stop).
+  const Book* FindBook(InstrumentId instrument) const {
+   if (instrument >= routes_.size() || routes_[instrument] == kNoShard){
+    return nullptr;
+   }
+   return shards_[routes_[instrument]]->books[instrument].get();
+  }
+
+ private:
+  static constexpr std::uint32_t kNoShard = UINT32_MAX;
+  static constexpr std::size_t kCommandBatch = 64; // Commands applied between publications of the applied counter
+
+  // Publishes book events for the instrument being processed onto the shard's output queue
+  class ShardSink : public BookEventSink{
+   public:
+    ShardSink(SpscQueue<EngineEvent>& events, ShardStats& stats): events_ {events}, stats_ {stats} { }
+
+    void SetInstrument(InstrumentId instrument){ instrument_ = instrument; }
+
+    void OnAccepted(const Order& order){
+     Push(BookEvent{BookEventType::Accepted, order.GetOrderSide(), RejectReason{}, order.GetPrice(), order.GetRemainingQuantity(), order.GetOrderId(), 0});
+    }
+    void OnModified(const Order& order){
+     Push(BookEvent{BookEventType::Modified, order.GetOrderSide(), RejectReason{}, order.GetPrice(), order.GetRemainingQuantity(), order.GetOrderId(), 0});
+    }
+    void OnRejected(const Order& order, RejectReason reason){
+     Push(BookEvent{BookEventType::Rejected, order.GetOrderSide(), reason, order.GetPrice(), order.GetRemainingQuantity(), order.GetOrderId(), 0});
+    }
+    void OnFill(const FillEvent& fill){
+     Push(BookEvent{BookEventType::Fill, fill.aggressor_side, RejectReason{}, fill.price, fill.quantity, fill.maker_order_id, fill.taker_order_id});
+    }
+    void OnCancelled(OrderId order_id, Quantity quantity){
+     Push(BookEvent{BookEventType::Cancelled, OrderSide{}, RejectReason{}, 0, quantity, order_id, 0});
+    }
+
+   private:
+    SpscQueue<EngineEvent>& events_;
+    ShardStats& stats_;
+    InstrumentId instrument_{0};
+
+    void Push(const BookEvent& event){
+     EngineEvent record{instrument_, event};
+     if (events_.TryPush(record)){
+      return;
+     }
+     ++stats_.output_stalls;
+     SpinBackoff backoff;
+     while (!events_.TryPush(record)){
+      backoff.Wait();
+     }
+    }
+  };
+
+  struct Shard{
+   explicit Shard(const EngineConfig& config):
+    commands {config.command_capacity},
+    shared_commands {config.command_capacity},
+    events {config.event_capacity}
+   { }
+
+   SpscQueue<EngineCommand> commands;
+   MpscQueue<EngineCommand> shared_commands;
+   SpscQueue<EngineEvent> events;
+   std::vector<std::unique_ptr<Book>> books;    // Indexed by InstrumentId; null for other shards' instruments
+   ShardStats stats;
+   std::thread worker;
+   std::uint64_t submitted{0};                              // Feeding thread only
+   alignas(kCacheLineSize) std::atomic<std::uint64_t> shared_submitted{0};
+   alignas(kCacheLineSize) std::atomic<std::uint64_t> applied{0};     // Published by the worker
+   std::atomic<bool> running{false};
+   std::atomic<bool> done{false};
+  };
+
+  EngineConfig config_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::vector<std::uint32_t> routes_;   // InstrumentId -> shard
+  std::size_t instrument_count_{0};
+  bool running_{false};
+
+  std::size_t Route(InstrumentId instrument) const {
+   if (instrument >= routes_.size() || routes_[instrument] == kNoShard){
+    throw std::logic_error("MatchingEngine: unknown instrument " + std::to_string(instrument));
+   }
+   return routes_[instrument];
+  }
+
+  void Pin(std::size_t index){
+   if (config_.pin_threads){
+    PinCurrentThread(config_.first_core + index);
+   }
+  }
+
+  void Apply(Shard& shard, ShardSink& sink, const EngineCommand& command){
+   sink.SetInstrument(command.instrument);
+   try {
+    if (!ApplyCommand(*shard.books[command.instrument], command, sink)){
+     ++shard.stats.unknown_orders;
+    }
+   }
+   catch (const std::exception&){ // One bad command must not take down the worker and every book on the shard
+    ++shard.stats.failed_commands;
+   }
+  }
+
+  void RunShard(std::size_t index){
+   Pin(index);
+   Shard& shard = *shards_[index];
+   ShardSink sink(shard.events, shard.stats);
+   SpinBackoff backoff;
+   std::uint64_t applied = 0;
+   bool stopping = false;
+   auto apply = [&](const EngineCommand& command){ Apply(shard, sink, command); };
+   while (true){
+    std::size_t count = shard.commands.PopBatch(apply, kCommandBatch);
+    EngineCommand command;
+    while (count < kCommandBatch && shard.shared_commands.TryPop(command)){
+     apply(command);
+     ++count;
+    }
+    if (count != 0){
+     applied += count;
+     shard.stats.commands = applied;
+     shard.applied.store(applied, std::memory_order_release);
+     backoff.Reset();
+     continue;
+    }
+    if (stopping){
+     break; // Queues were empty on a pass that started after Stop
+    }
+    if (!shard.running.load(std::memory_order_acquire)){
+     stopping = true; // One more pass: everything submitted before Stop is now visible
+     continue;
+    }
+    backoff.Wait();
+   }
+   shard.done.store(true, std::memory_order_release);
+  }
+};
+
+#endif // MATCHING_ENGINE_H
@@ -0,0 +1,221 @@
+#ifndef ORDER_INDEX_H
+#define ORDER_INDEX_H
+
+#include "orders.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+
+// Exchange order ids are dense and roughly increasing. Fibonacci hashing (multiply by 2^64 / golden ratio, take the
+// top bits) spreads any run of consecutive ids almost evenly over the table (three-gap theorem), so a dense id range
+// produces far fewer collisions than random keys would. Plain low-bit indexing would instead pack live ids into one
+// long cluster that newer ids wrap onto, which is pathological for linear probing.
+struct DenseOrderIdHash{
+ std::uint64_t operator()(OrderId id) const { return id * 0x9E3779B97F4A7C15ULL; }
+};
+
+
+// Flat open-addressing map OrderId -> Value with Robin Hood linear probing. The home slot is the top bits of Hash.
+// Deletion shifts the following run back one slot (no tombstones), so probe lengths stay short under heavy cancel
+// traffic. Every operation is a single probe sequence: TryEmplace finds-or-inserts, Extract finds-and-erases.
+// Pointers returned by Find/TryEmplace are invalidated by the next insert or erase.
+template <typename Value, typename Hash = DenseOrderIdHash>
+class OrderIdMap{
+ public:
+  explicit OrderIdMap(std::size_t capacity_hint = 0){
+   Rehash(CapacityFor(capacity_hint));
+  }
+
+  std::size_t Size() const { return size_; }
+  bool Empty() const { return size_ == 0; }
+  std::size_t Capacity() const { return slots_.size(); }
+
+  void Reserve(std::size_t count){
+   if (CapacityFor(count) > slots_.size()){
+    Rehash(CapacityFor(count));
+   }
+  }
+
+  void Clear(){
+   for (auto& slot : slots_){
+    slot.distance = 0;
+   }
+   size_ = 0;
+  }
+
+  Value* Find(OrderId key){
+   std::size_t index = Home(key);
+   for (std::uint32_t distance = 1; ; ++distance){
+    Slot& slot = slots_[index];
+    if (slot.distance < distance){
+     return nullptr; // Empty slot, or a richer entry: key cannot be further along
+    }
+    if (slot.key == key){
+     return &slot.value;
+    }
+    index = (index + 1) & mask_;
+   }
+  }
+
+  const Value* Find(OrderId key) const { return const_cast<OrderIdMap*>(this)->Find(key); }
+
+  bool Contains(OrderId key) const { return Find(key) != nullptr; }
+
+  // Returns {pointer to value, true} if key was inserted (value default-constructed), or {existing value, false}
+  std::pair<Value*, bool> TryEmplace(OrderId key){
+   if ((size_ + 1) * kMaxLoadDen > slots_.size() * kMaxLoadNum){
+    Rehash(slots_.size() * 2);
+   }
+   std::size_t index = Home(key);
+   for (std::uint32_t distance = 1; ; ++distance){
+    Slot& slot = slots_[index];
+    if (slot.distance == 0){
+     slot = Slot{key, Value{}, distance};
+     ++size_;
+     return {&slot.value, true};
+    }
+    if (slot.key == key){
+     return {&slot.value, false};
+    }
+    if (slot.distance < distance){
+     // Steal from the rich: our key takes this slot, the displaced run is pushed along
+     Slot carry = slot;
+     slot = Slot{key, Value{}, distance};
+     Displace(carry, (index + 1) & mask_);
+     ++size_;
+     return {&slot.value, true};
+    }
+    index = (index + 1) & mask_;
+   }
+  }
+
+  bool Insert(OrderId key, const Value& value){
+   auto [slot, inserted] = TryEmplace(key);
+   if (inserted){
+    *slot = value;
+   }
+   return inserted;
+  }
+
+  // Find and erase in one probe; copies the value out before it is removed
+  bool Extract(OrderId key, Value& out){
+   std::size_t index = Home(key);
+   for (std::uint32_t distance = 1; ; ++distance){
+    Slot& slot = slots_[index];
+    if (slot.distance < distance){
+     return false;
+    }
+    if (slot.key == key){
+     out = slot.value;
+     EraseAt(index);
+     return true;
+    }
+    index = (index + 1) & mask_;
+   }
+  }
+
+  bool Erase(OrderId key){
+   Value discarded;
+   return Extract(key, discarded);
+  }
+
+  // Visits every (key, value) in slot order
+  template <typename Fn>
+  void ForEach(Fn&& fn) const {
+   for (const auto& slot : slots_){
+    if (slot.distance != 0){
+     fn(slot.key, slot.value);
+    }
+   }
+  }
+
+ private:
+  struct Slot{
+   OrderId key{0};
+   Value value{};
+   std::uint32_t distance{0}; // 0 = empty, otherwise 1 + distance from the home slot
+  };
+
+  static constexpr std::size_t kMinCapacity = 16;
+  static constexpr std::size_t kMaxLoadNum = 7; // Grow beyond 7/8 full
+  static constexpr std::size_t kMaxLoadDen = 8;
+
+  std::vector<Slot> slots_;
+  std::size_t mask_{0};
+  unsigned shift_{64}; // 64 - log2(capacity)
+  std::size_t size_{0};
+
+  static std::size_t CapacityFor(std::size_t count){
+   std::size_t needed = count * kMaxLoadDen / kMaxLoadNum + 1;
+   std::size_t capacity = kMinCapacity;
+   while (capacity < needed){
+    capacity *= 2;
+   }
+   return capacity;
+  }
+
+  std::size_t Home(OrderId key) const { return static_cast<std::size_t>(Hash{}(key) >> shift_); }
+
+  // Continue inserting a displaced slot from `index`, swapping with any entry closer to home
+  void Displace(Slot carry, std::size_t index){
+   ++carry.distance;
+   while (true){
+    Slot& slot = slots_[index];
+    if (slot.distance == 0){
+     slot = carry;
+     return;
+    }
+    if (slot.distance < carry.distance){
+     std::swap(slot, carry);
+    }
+    ++carry.distance;
+    index = (index + 1) & mask_;
+   }
+  }
+
+  // Backward-shift deletion: pull the following run one slot towards home until an empty or home-positioned slot
+  void EraseAt(std::size_t index){
+   std::size_t next = (index + 1) & mask_;
+   while (slots_[next].distance > 1){
+    slots_[index] = slots_[next];
+    --slots_[index].distance;
+    index = next;
+    next = (next + 1) & mask_;
+   }
+   slots_[index].distance = 0;
+   --size_;
+  }
+
+  // Builds the new table off to the side and swaps it in, so a failed allocation leaves the map unchanged. Keys in the
+  // old table are unique, so each entry is placed with a plain Robin Hood walk, without TryEmplace's key checks.
+  void Rehash(std::size_t capacity){
+   std::vector<Slot> slots(capacity);
+   std::size_t mask = capacity - 1;
+   unsigned shift = 64;
+   for (std::size_t bits = capacity; bits > 1; bits >>= 1){
+    --shift;
+   }
+   for (const auto& slot : slots_){
+    if (slot.distance == 0){
+     continue;
+    }
+    Slot carry{slot.key, slot.value, 1};
+    std::size_t index = static_cast<std::size_t>(Hash{}(slot.key) >> shift);
+    while (slots[index].distance != 0){
+     if (slots[index].distance < carry.distance){
+      std::swap(slots[index], carry);
+     }
+     ++carry.distance;
+     index = (index + 1) & mask;
+    }
+    slots[index] = carry;
+   }
+   slots_.swap(slots);
+   mask_ = mask;
+   shift_ = shift;
+  }
+};
+
+#endif // ORDER_INDEX_H
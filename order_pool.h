@@ -0,0 +1,263 @@
+#ifndef ORDER_POOL_H
+#define ORDER_POOL_H
+
+#include "orders.h"
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+
+// Slab of Order records addressed by 32-bit handles.
+// Slots are reused through an intrusive free list (threaded through Order::next_), so once the slab has grown to the
+// peak number of live orders, Allocate/Release never touch the heap. Handles stay valid while the slab grows;
+// Order& references do not, so re-fetch through the handle after any Allocate.
+class OrderPool{
+ public:
+  explicit OrderPool(std::size_t capacity = 0){
+   slots_.reserve(capacity);
+  }
+
+  OrderHandle Allocate(const Order& order){
+   OrderHandle handle;
+   if (free_head_ != kInvalidHandle){
+    handle = free_head_;
+    free_head_ = slots_[handle].next_;
+    slots_[handle] = order;
+   }
+   else {
+    if (slots_.size() >= kInvalidHandle){
+     throw std::length_error("OrderPool: handle space exhausted");
+    }
+    handle = static_cast<OrderHandle>(slots_.size());
+    slots_.push_back(order);
+   }
+   slots_[handle].prev_ = kInvalidHandle;
+   slots_[handle].next_ = kInvalidHandle;
+   ++live_;
+   return handle;
+  }
+
+  void Release(OrderHandle handle){
+   slots_[handle].next_ = free_head_;
+   free_head_ = handle;
+   --live_;
+  }
+
+  Order& operator[](OrderHandle handle) { return slots_[handle]; }
+  const Order& operator[](OrderHandle handle) const { return slots_[handle]; }
+
+  std::size_t Live() const { return live_; }
+  std::size_t Capacity() const { return slots_.capacity(); }
+
+  // Forget every order at once, keeping the capacity: handles are handed out from 0 again. Every outstanding handle
+  // becomes invalid.
+  void Clear(){
+   slots_.clear();
+   free_head_ = kInvalidHandle;
+   live_ = 0;
+  }
+
+ private:
+  std::vector<Order> slots_;
+  OrderHandle free_head_{kInvalidHandle};
+  std::size_t live_{0};
+};
+
+
+// FIFO of pooled orders at one price level, linked through Order::prev_/next_.
+// Push, pop and erase from the middle are O(1) and allocation-free.
+class OrderQueue{
+ public:
+  bool empty() const { return head_ == kInvalidHandle; }
+  OrderHandle front() const { return head_; }
+  OrderHandle back() const { return tail_; }
+  void clear() { head_ = tail_ = kInvalidHandle; }
+
+  void push_back(OrderPool& pool, OrderHandle handle){
+   Order& order = pool[handle];
+   order.prev_ = tail_;
+   order.next_ = kInvalidHandle;
+   if (tail_ != kInvalidHandle){
+    pool[tail_].next_ = handle;
+   }
+   else {
+    head_ = handle;
+   }
+   tail_ = handle;
+  }
+
+  void erase(OrderPool& pool, OrderHandle handle){
+   Order& order = pool[handle];
+   if (order.prev_ != kInvalidHandle){
+    pool[order.prev_].next_ = order.next_;
+   }
+   else {
+    head_ = order.next_;
+   }
+   if (order.next_ != kInvalidHandle){
+    pool[order.next_].prev_ = order.prev_;
+   }
+   else {
+    tail_ = order.prev_;
+   }
+   order.prev_ = order.next_ = kInvalidHandle;
+  }
+
+  void pop_front(OrderPool& pool){ erase(pool, head_); }
+
+  static OrderHandle next(const OrderPool& pool, OrderHandle handle) { return pool[handle].next_; }
+
+  // fn(handle) for every order, oldest first
+  template <typename Fn>
+  void ForEach(const OrderPool& pool, Fn&& fn) const {
+   for (OrderHandle handle = head_; handle != kInvalidHandle; handle = pool[handle].next_){
+    fn(handle);
+   }
+  }
+
+  // Empty the queue in one go: fn(handle) for every order, oldest first, without unlinking them one by one. fn may
+  // release the order's slot; the order's links are left stale.
+  template <typename Fn>
+  void Drain(OrderPool& pool, Fn&& fn){
+   for (OrderHandle handle = head_; handle != kInvalidHandle; ){
+    OrderHandle next = pool[handle].next_;
+    fn(handle);
+    handle = next;
+   }
+   clear();
+  }
+
+ private:
+  OrderHandle head_{kInvalidHandle};
+  OrderHandle tail_{kInvalidHandle};
+};
+
+
+// FIFO of pooled orders at one price level as a contiguous ring of handles, so walking a level reads one array rather
+// than following a link through each order's pool slot.
+// Positions are free-running 32-bit counters (a slot is position & mask) and each order keeps its position in its
+// prev_ link, so erase from the middle is O(1): the slot becomes a tombstone and no neighbour is touched. Tombstones at
+// either end are trimmed at once; the ones in between are skipped by front() and ForEach. Compaction moves the live
+// orders together, keeping their order, and rewrites the position of each one that moved: a write to its pool slot,
+// as costly as the link updates a cancel saves. So it runs only when it pays for itself: in place once tombstones
+// outnumber live orders kCompactRatio to one (at most 1/kCompactRatio rewrites per cancel), or when a push finds the
+// ring full and at least half of it tombstones (at most one rewrite per slot freed); a full ring with fewer doubles.
+// Same interface as OrderQueue, except next().
+class RingOrderQueue{
+ public:
+  bool empty() const { return head_ == tail_; }
+  OrderHandle front() const { return empty() ? kInvalidHandle : slots_[head_ & mask_]; }    // Never a tombstone
+  OrderHandle back() const { return empty() ? kInvalidHandle : slots_[(tail_ - 1) & mask_]; }
+  void clear() { head_ = tail_ = dead_ = 0; }   // Keeps the ring's capacity for the level's next orders
+
+  std::size_t Tombstones() const { return dead_; }
+  std::size_t Capacity() const { return slots_.size(); }
+
+  void push_back(OrderPool& pool, OrderHandle handle){
+   if (tail_ - head_ == slots_.size()){
+    // Full: squeeze out the tombstones if they are half the ring, else double
+    if (slots_.empty()){
+     Rebuild(pool, kInitialCapacity);
+    }
+    else {
+     Rebuild(pool, dead_ * 2 >= slots_.size() ? slots_.size() : slots_.size() * 2);
+    }
+   }
+   Order& order = pool[handle];
+   order.prev_ = tail_;
+   order.next_ = kInvalidHandle;
+   slots_[tail_++ & mask_] = handle;
+  }
+
+  void erase(OrderPool& pool, OrderHandle handle){
+   Order& order = pool[handle];
+   std::uint32_t position = order.prev_;
+   order.prev_ = order.next_ = kInvalidHandle;
+   slots_[position & mask_] = kInvalidHandle;
+   if (position == head_){
+    for (++head_; head_ != tail_ && slots_[head_ & mask_] == kInvalidHandle; ++head_){
+     --dead_;
+    }
+   }
+   else if (position + 1 == tail_){
+    for (--tail_; slots_[(tail_ - 1) & mask_] == kInvalidHandle; --tail_){   // The head is live, so this stops there
+     --dead_;
+    }
+   }
+   else {
+    ++dead_;
+    if (dead_ >= kCompactMinimum && dead_ > kCompactRatio * (tail_ - head_ - dead_)){
+     Rebuild(pool, slots_.size());
+    }
+   }
+  }
+
+  void pop_front(OrderPool& pool){
+   Order& order = pool[slots_[head_ & mask_]];
+   order.prev_ = order.next_ = kInvalidHandle;
+   for (++head_; head_ != tail_ && slots_[head_ & mask_] == kInvalidHandle; ++head_){   // The old head's slot is outside the ring now
+    --dead_;
+   }
+  }
+
+  // fn(handle) for every order, oldest first
+  template <typename Fn>
+  void ForEach(const OrderPool&, Fn&& fn) const {
+   for (std::uint32_t position = head_; position != tail_; ++position){
+    OrderHandle handle = slots_[position & mask_];
+    if (handle != kInvalidHandle){
+     fn(handle);
+    }
+   }
+  }
+
+  // As OrderQueue::Drain
+  template <typename Fn>
+  void Drain(OrderPool& pool, Fn&& fn){
+   ForEach(pool, fn);
+   clear();
+  }
+
+ private:
+  static constexpr std::size_t kInitialCapacity = 8;
+  static constexpr std::uint32_t kCompactMinimum = 8;   // Fewer tombstones than this are cheaper to skip than to compact
+  static constexpr std::uint32_t kCompactRatio = 4;     // Tombstones per live order that trigger an in-place compaction
+
+  // Move the live orders, in order, to consecutive positions from head_ in a ring of `capacity` slots (a power of two,
+  // at least the live count), renumbering those that moved. At the same capacity this is an in-place compaction: the
+  // write position never passes the read position.
+  void Rebuild(OrderPool& pool, std::size_t capacity){
+   std::vector<OrderHandle> grown;
+   if (capacity != slots_.size()){
+    grown.assign(capacity, kInvalidHandle);
+   }
+   std::vector<OrderHandle>& out = grown.empty() ? slots_ : grown;
+   std::uint32_t mask = static_cast<std::uint32_t>(capacity - 1);
+   std::uint32_t write = head_;
+   for (std::uint32_t read = head_; read != tail_; ++read){
+    OrderHandle handle = slots_[read & mask_];
+    if (handle == kInvalidHandle){
+     continue;
+    }
+    if (write != read){
+     pool[handle].prev_ = write;
+    }
+    out[write++ & mask] = handle;
+   }
+   if (!grown.empty()){
+    slots_.swap(grown);
+   }
+   mask_ = mask;
+   tail_ = write;
+   dead_ = 0;
+  }
+
+  std::vector<OrderHandle> slots_;   // kInvalidHandle marks a tombstone
+  std::uint32_t mask_{0};
+  std::uint32_t head_{0};            // Position of the oldest live order
+  std::uint32_t tail_{0};            // Position after the newest order
+  std::uint32_t dead_{0};            // Tombstones between head_ and tail_
+};
+
+#endif // ORDER_POOL_H
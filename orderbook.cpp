@@ -7,13 +7,27 @@
 #include <stdexcept>
 #include <string>
 #include <queue>
+#include <thread>
 #include "orders.h"
 #include "ordersApi.h"
+#include "lobster_replay.h"
+#include "matching_engine.h"
+#include "book_snapshot.h"
+#include "durable_book.h"
+#include "lobster_batch.h"
+#include "gateway.h"
+#include "market_data.h"
+#include "lobster_pipeline.h"
+#include "book_analytics.h"
+#include "lobster_orderbook.h"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 
-int main() {
-    OrderBook book;
-    
+// Runs the same scenarios against any OrderBook level backend
+template <typename Book>
+void RunScenarios(Book& book) {
     // Test Case 1: Partial fill
     std::cout << "Test 1: Partial Fill\n";
     auto buy1 = std::make_shared<Order>(1, OrderSide::Buy, 100, 100, OrderType::Goodtillcancel);
@@ -21,7 +35,8 @@ int main() {
     
     book.ProcessNewOrder(buy1);
     Trades trades1 = book.ProcessNewOrder(sell1);
-    std::cout << "Trades: " << trades1.size() << " (Expected: 1)\n\n";
+    std::cout << "Trades: " << trades1.size() << " (Expected: 1)\n";
+    std::cout << "Order 1 remaining: " << book.FindOrder(1)->GetRemainingQuantity() << " (Expected: 50)\n\n";
     
     // Test Case 2: No match (prices don't cross)
     std::cout << "Test 2: No Match\n";
@@ -34,7 +49,7 @@ int main() {
     
     // Test Case 3: FOK rejected
     std::cout << "Test 3: FOK Rejected\n";
-    auto fok = std::make_shared<Order>(5, OrderSide::Buy, 110, 1000, OrderType::Fillandkill);
+    auto fok = std::make_shared<Order>(5, OrderSide::Buy, 110, 1000, OrderType::Fillorkill);
     Trades trades3 = book.ProcessNewOrder(fok);
     std::cout << "Trades: " << trades3.size() << " (Expected: 0)\n\n";
     
@@ -46,7 +61,892 @@ int main() {
     } catch (const std::exception& e) {
         std::cout << "Error: " << e.what() << "\n";
     }
-    
+}
+
+int main() {
+    std::cout << "=== std::map levels ===\n";
+    OrderBook book;
+    RunScenarios(book);
+
+    std::cout << "\n=== Ladder levels ===\n";
+    LadderOrderBook ladder_book;
+    RunScenarios(ladder_book);
+
+    std::cout << "\n=== Ring queue levels ===\n";
+    RingOrderBook ring_book;
+    RunScenarios(ring_book);
+
+    // Test Case 5: Ladder recentres when prices drift outside its window
+    std::cout << "\nTest 5: Ladder Recentre\n";
+    LadderOrderBook drift_book(LevelConfig{1, 64});
+    drift_book.ProcessNewOrder(std::make_shared<Order>(10, OrderSide::Sell, 1000, 10, OrderType::Goodtillcancel));
+    drift_book.ProcessNewOrder(std::make_shared<Order>(11, OrderSide::Sell, 1500, 10, OrderType::Goodtillcancel)); // Far outside a 64-tick window
+    drift_book.ProcessNewOrder(std::make_shared<Order>(12, OrderSide::Sell, 900, 10, OrderType::Goodtillcancel));
+    Trades trades5 = drift_book.ProcessNewOrder(std::make_shared<Order>(13, OrderSide::Buy, 1500, 30, OrderType::Goodtillcancel));
+    std::cout << "Trades: " << trades5.size() << " (Expected: 3)\n";
+    std::cout << "First trade price: " << trades5.front().GetBidTradeInfo().price << " (Expected: 900)\n";
+    std::cout << "Resting orders: " << drift_book.Size() << " (Expected: 0)\n";
+    LadderOrderBook capped_book(LevelConfig{1, 64, 1024});
+    capped_book.ProcessNewOrder(Order(20, OrderSide::Buy, 1, 10, OrderType::Goodtillcancel));
+    BookEventRing<16> capped_events;
+    capped_book.ProcessNewOrder(Order(21, OrderSide::Buy, 50000000, 10, OrderType::Goodtillcancel), capped_events);
+    BookEvent capped_event{};
+    capped_events.Pop(capped_event);
+    bool far_refused = capped_event.type == BookEventType::Rejected && capped_event.reason == RejectReason::InvalidPrice;
+    capped_book.ProcessNewOrder(Order(22, OrderSide::Buy, 2, 10, OrderType::Goodtillcancel)); // The book is intact after the refusal
+    std::cout << "Far bid refused " << far_refused << ", admits 1000 " << capped_book.AdmitsPrice(OrderSide::Buy, 1000) << ", resting "
+              << capped_book.Size() << ", bid levels " << capped_book.LevelCount(OrderSide::Buy) << " (Expected: Far bid refused 1, admits 1000 1, resting 2, bid levels 2)\n";
+    std::vector<Order> capped_batch{Order(23, OrderSide::Buy, 105, 10, OrderType::Goodtillcancel), Order(24, OrderSide::Sell, 100, 10, OrderType::Goodtillcancel),
+                                    Order(25, OrderSide::Buy, 50000000, 10, OrderType::Goodtillcancel)};
+    AuctionResult capped_auction = capped_book.ProcessBatch(capped_batch.data(), capped_batch.size(), capped_events);
+    int batch_refused = 0;
+    while (capped_events.Pop(capped_event)) {
+        batch_refused += capped_event.type == BookEventType::Rejected && capped_event.reason == RejectReason::InvalidPrice;
+    }
+    std::cout << "Batch with a far bid: refused " << batch_refused << ", accepted " << capped_auction.accepted << ", volume " << capped_auction.volume
+              << ", ask levels " << capped_book.LevelCount(OrderSide::Sell) << " (Expected: refused 1, accepted 2, volume 10, ask levels 0)\n";
+    LadderPriceLevels<OrderSide::Buy> shrinking(LevelConfig{1, 64, 4096});
+    shrinking.GetOrCreate(1000);
+    shrinking.GetOrCreate(3000); // Span 2001: grows 64 -> 4096
+    std::size_t grown_window = shrinking.WindowTicks();
+    shrinking.Erase(3000);
+    shrinking.Erase(1000);       // Empty: back to the configured window
+    std::cout << "Window grown " << grown_window << ", after emptying " << shrinking.WindowTicks() << " (Expected: Window grown 4096, after emptying 64)\n";
+
+    // Test Case 6: LOBSTER rows drive the book (new, partial cancel, execution, delete)
+    std::cout << "\nTest 6: LOBSTER Replay\n";
+    const char rows[] =
+        "34200.004241176,1,16113575,18,5853300,1\n"
+        "34200.025552,1,16120456,100,5859100,-1\n"
+        "34200.201743,2,16113575,8,5853300,1\n"
+        "34200.201744,4,16120456,40,5859100,-1\n"
+        "34200.301000,3,16113575,10,5853300,1\n"
+        "34200.401000,3,999,10,5853300,1\n";
+    OrderBook lobster_book;
+    LobsterReplay<OrderBook> replay(lobster_book);
+    LobsterEvent event{};
+    const char* cursor = rows;
+    const char* end = rows + sizeof(rows) - 1;
+    while (cursor < end && ParseLobsterMessage(cursor, end, event)) {
+        replay.Apply(event);
+    }
+    std::cout << "First timestamp ns: " << replay.Stats().first_timestamp_ns << " (Expected: 34200004241176)\n";
+    std::cout << "Events: " << replay.Stats().events << " (Expected: 6)\n";
+    std::cout << "Unknown orders: " << replay.Stats().unknown_orders << " (Expected: 1)\n";
+    std::cout << "Ask 16120456 remaining: " << lobster_book.FindOrder(16120456)->GetRemainingQuantity() << " (Expected: 60)\n";
+    std::cout << "Resting orders: " << lobster_book.Size() << " (Expected: 1)\n";
+    LobsterEvent zero_execution{};
+    zero_execution.type = LobsterEventType::VisibleExecution;
+    zero_execution.order_id = 16120456;
+    zero_execution.size = 0;
+    replay.Apply(zero_execution);
+    std::cout << "Zero-size execution of a known order: unknown " << replay.Stats().unknown_orders << ", executed " << replay.Stats().executed_quantity
+              << ", remaining " << lobster_book.FindOrder(16120456)->GetRemainingQuantity() << " (Expected: unknown 1, executed 40, remaining 60)\n";
+    std::string malformed_path = (std::filesystem::temp_directory_path() / "orderbook_test6.csv").string();
+    {
+        std::ofstream malformed_file(malformed_path, std::ios::binary | std::ios::trunc);
+        malformed_file << "34200.1,1,1,100,5853300,1\n"
+                          "34200.2,1,2,,5853300,1\n"        // Empty size
+                          "34200.3,1,3,100,5853300,0\n"     // Direction 0
+                          "34200.4,1,4,100,5853300,2\n"     // Direction 2
+                          "34200.5,1,x5,100,5853300,-1\n"   // Non-numeric id
+                          "34200.6,1,6,100,5859100,-1\n";
+    }
+    OrderBook malformed_book;
+    ReplayStats malformed_stats = ReplayLobsterFile(malformed_path.c_str(), malformed_book);
+    std::cout << "Malformed rows skipped: events " << malformed_stats.events << ", malformed " << malformed_stats.malformed_rows
+              << ", resting " << malformed_book.Size() << " (Expected: events 2, malformed 4, resting 2)\n";
+    std::filesystem::remove(malformed_path);
+    LobsterEvent halt{};
+    halt.type = LobsterEventType::TradingHalt;
+    halt.price = -1;
+    std::size_t halt_resting[2] = {0, 0};
+    for (HaltPolicy policy : {HaltPolicy::CancelAll, HaltPolicy::Keep}) {
+        OrderBook halt_book;
+        LobsterReplay<OrderBook> halt_replay(halt_book, policy);
+        halt_replay.Apply({34200000000000, 1, 100, 5853300, LobsterEventType::NewOrder, OrderSide::Buy});
+        halt_replay.Apply({34200000000001, 2, 100, 5859100, LobsterEventType::NewOrder, OrderSide::Sell});
+        halt_replay.Apply(halt);
+        halt_resting[policy == HaltPolicy::Keep] = halt_book.Size();
+        if (policy == HaltPolicy::CancelAll) {
+            std::cout << "Halt cancels the book: halts " << halt_replay.Stats().halts << ", cancelled " << halt_replay.Stats().halt_cancelled
+                      << " (Expected: halts 1, cancelled 2)\n";
+        }
+    }
+    std::cout << "Resting after halt (cancel all / keep): " << halt_resting[0] << " / " << halt_resting[1] << " (Expected: 0 / 2)\n";
+
+    // Test Case 7: Event sink reports accept, reject, fills and the fill-and-kill remainder
+    std::cout << "\nTest 7: Event Sink\n";
+    OrderBook sink_book;
+    BookEventRing<64> events;
+    sink_book.ProcessNewOrder(Order(20, OrderSide::Sell, 101, 30, OrderType::Goodtillcancel), events);
+    sink_book.ProcessNewOrder(Order(21, OrderSide::Sell, 102, 30, OrderType::Goodtillcancel), events);
+    sink_book.ProcessNewOrder(Order(21, OrderSide::Sell, 103, 30, OrderType::Goodtillcancel), events); // Duplicate id
+    sink_book.ProcessNewOrder(Order(22, OrderSide::Buy, 102, 100, OrderType::Fillandkill), events);
+    int counts[4] = {0, 0, 0, 0};
+    BookEvent event_out{};
+    Quantity cancelled = 0;
+    while (events.Pop(event_out)) {
+        ++counts[static_cast<int>(event_out.type)];
+        if (event_out.type == BookEventType::Cancelled) {
+            cancelled = event_out.quantity;
+        }
+    }
+    std::cout << "Accepted: " << counts[0] << " (Expected: 3)\n";
+    std::cout << "Rejected: " << counts[1] << " (Expected: 1)\n";
+    std::cout << "Fills: " << counts[2] << " (Expected: 2)\n";
+    std::cout << "Cancelled remainder: " << cancelled << " (Expected: 40)\n";
+
+    // Test 8: Level aggregates follow adds, partial fills, reduces and cancels
+    std::cout << "\nTest 8: Depth Snapshot\n";
+    LadderOrderBook depth_book;
+    depth_book.ProcessNewOrder(Order(30, OrderSide::Buy, 99, 10, OrderType::Goodtillcancel));
+    depth_book.ProcessNewOrder(Order(31, OrderSide::Buy, 99, 20, OrderType::Goodtillcancel));
+    depth_book.ProcessNewOrder(Order(32, OrderSide::Buy, 98, 5, OrderType::Goodtillcancel));
+    depth_book.ProcessNewOrder(Order(33, OrderSide::Sell, 101, 40, OrderType::Goodtillcancel));
+    depth_book.ProcessNewOrder(Order(34, OrderSide::Sell, 102, 15, OrderType::Goodtillcancel));
+    depth_book.ProcessNewOrder(Order(35, OrderSide::Sell, 99, 12, OrderType::Goodtillcancel)); // Fills 10 of 30, 2 of 31
+    depth_book.ReduceOrder(33, 10);
+    depth_book.CancelOrder(34);
+    OrderBookLevelInfos depth;
+    depth_book.GetDepth(1, depth);
+    std::cout << "Best bid: " << depth.getBids()[0].quantity << " @ " << depth.getBids()[0].price << " in " << depth.getBids()[0].order_count << " order(s) (Expected: 18 @ 99 in 1 order(s))\n";
+    depth_book.GetSnapshot(depth);
+    std::cout << "Bid levels: " << depth.getBids().size() << " (Expected: 2)\n";
+    std::cout << "Second bid: " << depth.getBids()[1].quantity << " @ " << depth.getBids()[1].price << " (Expected: 5 @ 98)\n";
+    std::cout << "Ask levels: " << depth.getAsks().size() << ", best " << depth.getAsks()[0].quantity << " @ " << depth.getAsks()[0].price << " (Expected: 1, best 30 @ 101)\n";
+
+    // Test 9: Sharded engine, one book per instrument, commands and events over lock-free queues
+    std::cout << "\nTest 9: Matching Engine\n";
+    EngineConfig engine_config;
+    engine_config.shards = 2;
+    engine_config.pin_threads = false;
+    MatchingEngine<> engine(engine_config);
+    for (InstrumentId instrument = 0; instrument < 3; ++instrument) {
+        engine.AddInstrument(instrument);
+    }
+    engine.Start();
+    int engine_fills = 0;
+    int engine_cancels = 0;
+    int engine_price_rejects = 0;
+    auto on_event = [&](const EngineEvent& e) {
+        engine_fills += e.event.type == BookEventType::Fill;
+        engine_cancels += e.event.type == BookEventType::Cancelled;
+        engine_price_rejects += e.event.type == BookEventType::Rejected && e.event.reason == RejectReason::InvalidPrice;
+    };
+    for (InstrumentId instrument = 0; instrument < 3; ++instrument) {
+        engine.Submit(EngineCommand{1, instrument, 100, 10, EngineCommandType::NewOrder, OrderSide::Sell, OrderType::Goodtillcancel}, on_event);
+        engine.Submit(EngineCommand{2, instrument, 100, 4, EngineCommandType::NewOrder, OrderSide::Buy, OrderType::Goodtillcancel}, on_event);
+    }
+    std::thread other_thread([&engine] {
+        engine.TrySubmitShared(EngineCommand{1, 2, 0, 0, EngineCommandType::Cancel, OrderSide::Sell, OrderType::Goodtillcancel});
+    });
+    other_thread.join();
+    engine.Submit(EngineCommand{3, 0, 50000000, 10, EngineCommandType::NewOrder, OrderSide::Sell, OrderType::Goodtillcancel}, on_event); // Beyond the ladder's reach
+    engine.Flush(on_event);
+    LevelInfo engine_ask{};
+    engine.FindBook(1)->GetBestLevel(OrderSide::Sell, engine_ask);
+    std::cout << "Fills: " << engine_fills << " (Expected: 3)\n";
+    std::cout << "Cancelled from another thread: " << engine_cancels << " (Expected: 1)\n";
+    std::cout << "Instrument 1 best ask: " << engine_ask.quantity << " @ " << engine_ask.price << " (Expected: 6 @ 100)\n";
+    std::cout << "Instrument 2 resting orders: " << engine.FindBook(2)->Size() << " (Expected: 0)\n";
+    std::cout << "Far-priced order: rejected " << engine_price_rejects << ", failed " << engine.Stats(0).failed_commands << " (Expected: rejected 1, failed 0)\n";
+    engine.Stop();
+
+    // Test 10: Snapshot channel for the GUI: recorder publishes depth and trades, reader takes the newest copy
+    std::cout << "\nTest 10: Book Snapshot\n";
+    static TripleBuffer<BookSnapshot> channel;
+    SnapshotRecorder recorder(channel);
+    LadderOrderBook snapshot_book;
+    recorder.SetTime(34200000000000ULL);
+    snapshot_book.ProcessNewOrder(Order(40, OrderSide::Sell, 105, 10, OrderType::Goodtillcancel), recorder);
+    snapshot_book.ProcessNewOrder(Order(41, OrderSide::Buy, 100, 7, OrderType::Goodtillcancel), recorder);
+    snapshot_book.ProcessNewOrder(Order(42, OrderSide::Buy, 105, 4, OrderType::Goodtillcancel), recorder);
+    bool stale = channel.Update();
+    recorder.Publish(snapshot_book);
+    bool fresh = channel.Update();
+    const BookSnapshot& view = channel.ReadBuffer();
+    std::cout << "Nothing new before publish: " << !stale << " (Expected: 1)\n";
+    std::cout << "New snapshot after publish: " << fresh << " (Expected: 1)\n";
+    std::cout << "Levels: " << view.bid_levels << " bid, " << view.ask_levels << " ask; best ask " << view.asks[0].quantity << " @ " << view.asks[0].price << " (Expected: 1 bid, 1 ask; best ask 6 @ 105)\n";
+    std::cout << "Tape: " << view.trade_count << " trade, " << view.trades[0].quantity << " @ " << view.trades[0].price << " (Expected: 1 trade, 4 @ 105)\n";
+
+    // Test 11: Batch enters a crossed book without matching, then one uncross at the volume-maximising price
+    std::cout << "\nTest 11: Call Auction\n";
+    LadderOrderBook auction_book;
+    std::vector<Order> batch{
+        Order(50, OrderSide::Buy, 102, 10, OrderType::Goodtillcancel),
+        Order(51, OrderSide::Buy, 101, 10, OrderType::Goodtillcancel),
+        Order(52, OrderSide::Buy, 100, 10, OrderType::Goodtillcancel),
+        Order(53, OrderSide::Sell, 99, 5, OrderType::Goodtillcancel),
+        Order(54, OrderSide::Sell, 100, 10, OrderType::Goodtillcancel),
+        Order(55, OrderSide::Sell, 103, 10, OrderType::Goodtillcancel),
+        Order(56, OrderSide::Buy, 98, 4, OrderType::Fillandkill),      // Below the clearing price: cancelled after the uncross
+        Order(53, OrderSide::Buy, 105, 1, OrderType::Goodtillcancel)   // Duplicate id
+    };
+    BookEventRing<64> auction_events;
+    AuctionResult auction = auction_book.ProcessBatch(batch, auction_events);
+    int auction_fills = 0;
+    int auction_cancels = 0;
+    bool all_at_clearing = true;
+    while (auction_events.Pop(event_out)) {
+        auction_fills += event_out.type == BookEventType::Fill;
+        auction_cancels += event_out.type == BookEventType::Cancelled;
+        all_at_clearing &= event_out.type != BookEventType::Fill || event_out.price == auction.clearing_price;
+    }
+    auction_book.GetSnapshot(depth);
+    std::cout << "Clearing price: " << auction.clearing_price << ", volume " << auction.volume << " (Expected: 101, volume 15)\n";
+    std::cout << "Accepted: " << auction.accepted << " (Expected: 7)\n";
+    std::cout << "Fills: " << auction_fills << ", all at clearing price: " << all_at_clearing << " (Expected: 3, all at clearing price: 1)\n";
+    std::cout << "Fill-and-kill cancelled: " << auction_cancels << " (Expected: 1)\n";
+    std::cout << "Bids: " << depth.getBids()[0].quantity << " @ " << depth.getBids()[0].price << ", " << depth.getBids()[1].quantity << " @ " << depth.getBids()[1].price << "; best ask " << depth.getAsks()[0].quantity << " @ " << depth.getAsks()[0].price << " (Expected: 5 @ 101, 10 @ 100; best ask 10 @ 103)\n";
+    std::cout << "Crossed after uncross: " << auction_book.IndicativeUncross().volume << " (Expected: 0)\n";
+
+    // Test 12: Modify shrinks in place keeping priority, or relinks the same pooled order at a new price
+    std::cout << "\nTest 12: Modify Order\n";
+    LadderOrderBook modify_book;
+    BookEventRing<64> modify_events;
+    modify_book.ProcessNewOrder(Order(61, OrderSide::Buy, 100, 10, OrderType::Goodtillcancel));
+    modify_book.ProcessNewOrder(Order(62, OrderSide::Buy, 100, 10, OrderType::Goodtillcancel));
+    modify_book.ProcessNewOrder(Order(63, OrderSide::Buy, 99, 5, OrderType::Goodtillcancel));
+    modify_book.ProcessNewOrder(Order(64, OrderSide::Sell, 103, 10, OrderType::Goodtillcancel));
+    modify_book.Modify(ModifyOrder(61, OrderSide::Buy, 100, 4));     // Smaller: stays ahead of 62
+    LevelInfo modify_bid{};
+    modify_book.GetBestLevel(OrderSide::Buy, modify_bid);
+    std::cout << "Bid after reduce: " << modify_bid.quantity << " @ " << modify_bid.price << " in " << modify_bid.order_count << " order(s) (Expected: 14 @ 100 in 2 order(s))\n";
+    modify_book.Modify(ModifyOrder(63, OrderSide::Buy, 103, 5), modify_events); // Repriced through the ask: trades
+    modify_book.ProcessNewOrder(Order(65, OrderSide::Sell, 100, 6, OrderType::Goodtillcancel), modify_events);
+    OrderId first_maker = 0;
+    Quantity repriced_fill = 0;
+    while (modify_events.Pop(event_out)) {
+        if (event_out.type == BookEventType::Fill && event_out.counterparty_id == 63) {
+            repriced_fill = event_out.quantity;
+        }
+        if (event_out.type == BookEventType::Fill && event_out.counterparty_id == 65 && first_maker == 0) {
+            first_maker = event_out.order_id;
+        }
+    }
+    std::cout << "Repriced order filled: " << repriced_fill << ", ask 64 remaining " << modify_book.FindOrder(64)->GetRemainingQuantity() << " (Expected: 5, ask 64 remaining 5)\n";
+    std::cout << "First maker hit at 100: " << first_maker << ", order 62 remaining " << modify_book.FindOrder(62)->GetRemainingQuantity() << " (Expected: 61, order 62 remaining 8)\n";
+    const Order* before_relink = modify_book.FindOrder(62);
+    modify_book.Modify(ModifyOrder(62, OrderSide::Buy, 101, 20));
+    std::cout << "Same pooled order after reprice: " << (modify_book.FindOrder(62) == before_relink) << ", now " << before_relink->GetRemainingQuantity() << " @ " << before_relink->GetPrice() << " (Expected: 1, now 20 @ 101)\n";
+    std::cout << "Unknown id: " << modify_book.Modify(ModifyOrder(999, OrderSide::Buy, 100, 1)) << " (Expected: 0)\n";
+
+    // Test 13: Immediate orders sweep many levels in one pass; fill-or-kill checks the whole quantity first
+    std::cout << "\nTest 13: Multi-level Sweep\n";
+    LadderOrderBook sweep_book;
+    BookEventRing<256> sweep_events;
+    for (OrderId id = 0; id < 25; ++id) {
+        sweep_book.ProcessNewOrder(Order(100 + id, OrderSide::Sell, 100 + static_cast<Price>(id), 10, OrderType::Goodtillcancel));
+    }
+    auto drain = [&](std::size_t& fills, Quantity& cancelled) {
+        fills = 0;
+        cancelled = 0;
+        while (sweep_events.Pop(event_out)) {
+            fills += event_out.type == BookEventType::Fill;
+            cancelled += event_out.type == BookEventType::Cancelled ? event_out.quantity : 0;
+        }
+    };
+    std::size_t sweep_fills = 0;
+    Quantity sweep_cancelled = 0;
+    bool fok_accepted = sweep_book.ProcessNewOrder(Order(200, OrderSide::Buy, 124, 300, OrderType::Fillorkill), sweep_events);
+    drain(sweep_fills, sweep_cancelled);
+    std::cout << "FOK for 300 against 250: accepted " << fok_accepted << ", fills " << sweep_fills << ", ask levels " << sweep_book.LevelCount(OrderSide::Sell) << " (Expected: accepted 0, fills 0, ask levels 25)\n";
+    sweep_book.ProcessNewOrder(Order(201, OrderSide::Buy, 110, 95, OrderType::Fillorkill), sweep_events);
+    drain(sweep_fills, sweep_cancelled);
+    LevelInfo sweep_ask{};
+    sweep_book.GetBestLevel(OrderSide::Sell, sweep_ask);
+    std::cout << "FOK for 95 up to 110: fills " << sweep_fills << ", best ask " << sweep_ask.quantity << " @ " << sweep_ask.price << " (Expected: fills 10, best ask 5 @ 109)\n";
+    sweep_book.ProcessNewOrder(Order(202, OrderSide::Buy, 110, 20, OrderType::Fillandkill), sweep_events);
+    drain(sweep_fills, sweep_cancelled);
+    std::cout << "IOC for 20 up to 110: fills " << sweep_fills << ", cancelled " << sweep_cancelled << " (Expected: fills 2, cancelled 5)\n";
+    bool market_accepted = sweep_book.ProcessNewOrder(Order(203, OrderSide::Sell, 0, 10, OrderType::Market), sweep_events);
+    drain(sweep_fills, sweep_cancelled);
+    std::cout << "Market sell with no bids: accepted " << market_accepted << " (Expected: accepted 0)\n";
+    sweep_book.ProcessNewOrder(Order(204, OrderSide::Buy, 0, 200, OrderType::Market), sweep_events);
+    drain(sweep_fills, sweep_cancelled);
+    std::cout << "Market buy for 200: fills " << sweep_fills << ", cancelled " << sweep_cancelled << ", resting " << sweep_book.Size() << " (Expected: fills 14, cancelled 60, resting 0)\n";
+    for (OrderId id = 0; id < 25; ++id) {
+        sweep_book.ProcessNewOrder(Order(300 + id, OrderSide::Sell, 200 + static_cast<Price>(id), 10, OrderType::Goodtillcancel));
+    }
+    sweep_book.ProcessNewOrder(Order(400, OrderSide::Buy, 224, 300, OrderType::Goodtillcancel), sweep_events);
+    drain(sweep_fills, sweep_cancelled);
+    LevelInfo sweep_bid{};
+    sweep_book.GetBestLevel(OrderSide::Buy, sweep_bid);
+    std::cout << "Limit buy through 25 levels: fills " << sweep_fills << ", resting bid " << sweep_bid.quantity << " @ " << sweep_bid.price << ", ask levels " << sweep_book.LevelCount(OrderSide::Sell) << " (Expected: fills 25, resting bid 50 @ 224, ask levels 0)\n";
+
+    // Test 14: Journal and checkpoint: a reopened book has the same levels, queue order and fills as before
+    std::cout << "\nTest 14: Journal and Checkpoint\n";
+    std::string durable_dir = (std::filesystem::temp_directory_path() / "orderbook_test14").string();
+    std::filesystem::remove_all(durable_dir);
+    DurableConfig durable_config;
+    durable_config.directory = durable_dir;
+    durable_config.journal.group_commit = 4;
+    {
+        DurableBook<LadderOrderBook> durable(durable_config);
+        for (OrderId id = 70; id < 76; ++id) {
+            durable.Apply(EngineCommand{id, 0, 100 + static_cast<Price>(id % 3), 10, EngineCommandType::NewOrder, OrderSide::Sell, OrderType::Goodtillcancel});
+        }
+        durable.Apply(EngineCommand{80, 0, 100, 4, EngineCommandType::NewOrder, OrderSide::Buy, OrderType::Goodtillcancel}); // Partly fills 72
+        durable.Checkpoint();
+        durable.Apply(EngineCommand{81, 0, 95, 7, EngineCommandType::NewOrder, OrderSide::Buy, OrderType::Goodtillcancel});
+        durable.Apply(EngineCommand{73, 0, 0, 0, EngineCommandType::Cancel, OrderSide::Sell, OrderType::Goodtillcancel});
+        durable.Apply(EngineCommand{70, 0, 100, 3, EngineCommandType::Modify, OrderSide::Sell, OrderType::Goodtillcancel}); // 101 -> back of 100
+        std::cout << "Durable before closing: " << durable.Durable() << " of " << durable.Sequence() << " (Expected: 7 of 10)\n";
+    }
+    {
+        std::ofstream torn(durable_dir + "/journal-00000000000000000008.wal", std::ios::binary | std::ios::app);
+        torn.write("partial", 7); // A record cut short by a crash
+    }
+    DurableBook<LadderOrderBook> reopened(durable_config);
+    const RecoveryStats& recovery = reopened.Recovery();
+    std::cout << "Recovered from checkpoint " << recovery.checkpoint_sequence << " with " << recovery.checkpoint_orders << " orders, replayed " << recovery.replayed << ", torn bytes " << recovery.torn_bytes << " (Expected: 7 with 6 orders, replayed 3, torn bytes 7)\n";
+    LevelInfo durable_ask{};
+    reopened.GetBook().GetBestLevel(OrderSide::Sell, durable_ask);
+    std::cout << "Best ask: " << durable_ask.quantity << " @ " << durable_ask.price << ", order 72 remaining " << reopened.GetBook().FindOrder(72)->GetRemainingQuantity() << ", order 73 gone " << (reopened.GetBook().FindOrder(73) == nullptr) << " (Expected: 19 @ 100, order 72 remaining 6, order 73 gone 1)\n";
+    BookEventRing<16> durable_events;
+    reopened.Apply(EngineCommand{82, 0, 100, 20, EngineCommandType::NewOrder, OrderSide::Buy, OrderType::Goodtillcancel}, durable_events);
+    std::vector<OrderId> makers;
+    while (durable_events.Pop(event_out)) {
+        if (event_out.type == BookEventType::Fill) {
+            makers.push_back(event_out.order_id);
+        }
+    }
+    std::cout << "Makers in order:";
+    for (OrderId maker : makers) {
+        std::cout << " " << maker;
+    }
+    std::cout << " (Expected: 72 75 70)\n";
+    std::filesystem::remove_all(durable_dir);
+    {
+        DurableBook<LadderOrderBook> timed(durable_config);
+        timed.Apply(EngineCommand{0, 0, 0, 0, EngineCommandType::SetSessionClose, OrderSide::Buy, OrderType::Day, 1000});
+        timed.Apply(EngineCommand{0, 0, 0, 0, EngineCommandType::AdvanceTime, OrderSide::Buy, OrderType::Day, 100});
+        timed.Apply(EngineCommand{90, 0, 101, 10, EngineCommandType::NewOrder, OrderSide::Sell, OrderType::Goodtilldate, 500});
+        timed.Apply(EngineCommand{91, 0, 99, 5, EngineCommandType::NewOrder, OrderSide::Buy, OrderType::Day});
+        timed.Apply(EngineCommand{0, 0, 0, 0, EngineCommandType::AdvanceTime, OrderSide::Buy, OrderType::Day, 600}); // Expires 90
+    }
+    DurableBook<LadderOrderBook> timed_reopened(durable_config);
+    std::cout << "Replayed timed orders: resting " << timed_reopened.GetBook().Size() << ", order 91 expiry " << timed_reopened.GetBook().GetExpiry(91)
+              << ", clock " << timed_reopened.GetBook().Now() << " (Expected: resting 1, order 91 expiry 1000, clock 600)\n";
+    std::filesystem::remove_all(durable_dir);
+    durable_config.levels = LevelConfig{1, 64, 1024};
+    BookEventRing<16> refused_events;
+    {
+        DurableBook<LadderOrderBook> capped(durable_config);
+        capped.Apply(EngineCommand{95, 0, 1, 10, EngineCommandType::NewOrder, OrderSide::Buy, OrderType::Goodtillcancel});
+        capped.Apply(EngineCommand{96, 0, 50000000, 10, EngineCommandType::NewOrder, OrderSide::Buy, OrderType::Goodtillcancel}, refused_events);
+        std::cout << "Refused order journaled: " << (capped.Sequence() != 1) << " (Expected: 0)\n";
+    }
+    refused_events.Pop(event_out);
+    DurableBook<LadderOrderBook> capped_reopened(durable_config);
+    std::cout << "Refused order: reason invalid price " << (event_out.reason == RejectReason::InvalidPrice) << ", reopened resting "
+              << capped_reopened.GetBook().Size() << ", failed " << capped_reopened.Recovery().failed << " (Expected: reason invalid price 1, reopened resting 1, failed 0)\n";
+    std::filesystem::remove_all(durable_dir);
+
+    // Test 15: Columnar LOBSTER file (raw and delta-encoded) replays the same events as the CSV rows of Test 6
+    std::cout << "\nTest 15: Columnar Replay\n";
+    LobsterColumnarWriter columnar_writer;
+    cursor = rows;
+    while (cursor < end && ParseLobsterMessage(cursor, end, event)) {
+        columnar_writer.Add(event);
+    }
+    std::string columnar_path = (std::filesystem::temp_directory_path() / "orderbook_test15.lobc").string();
+    for (bool delta : {false, true}) {
+        ColumnarOptions columnar_options;
+        if (delta) {
+            columnar_options.Delta(LobsterColumn::Timestamp).Delta(LobsterColumn::OrderId).Delta(LobsterColumn::Size).Delta(LobsterColumn::Price);
+        }
+        columnar_writer.Write(columnar_path, columnar_options);
+        OrderBook columnar_book;
+        ReplayStats columnar_stats = ReplayLobsterFile(columnar_path.c_str(), columnar_book);
+        std::cout << (delta ? "Delta" : "Raw") << " events: " << columnar_stats.events << ", first timestamp " << columnar_stats.first_timestamp_ns
+                  << ", unknown " << columnar_stats.unknown_orders << ", ask 16120456 remaining " << columnar_book.FindOrder(16120456)->GetRemainingQuantity()
+                  << " (Expected: 6, first timestamp 34200004241176, unknown 1, ask 16120456 remaining 60)\n";
+    }
+    LobsterColumnarReader columnar_reader(columnar_path.c_str());
+    std::cout << "Delta order id column has no raw view: " << (columnar_reader.RawColumn<OrderId>(LobsterColumn::OrderId) == nullptr)
+              << ", raw type column first " << static_cast<int>(columnar_reader.RawColumn<std::uint8_t>(LobsterColumn::Type)[0]) << " (Expected: 1, raw type column first 1)\n";
+    std::filesystem::remove(columnar_path);
+
+    // Test 16: Parallel multi-file replay: largest file first, failures isolated, stats merged
+    std::cout << "\nTest 16: Batch Replay\n";
+    std::filesystem::path batch_dir = std::filesystem::temp_directory_path() / "orderbook_test16";
+    std::filesystem::create_directories(batch_dir);
+    std::vector<std::string> batch_paths = {(batch_dir / "short_message_1.csv").string(), (batch_dir / "day.lobc").string(),
+                                            (batch_dir / "full_message_1.csv").string(), (batch_dir / "missing_message_1.csv").string()};
+    std::ofstream(batch_paths[0]) << std::string(rows, 79);   // First two rows
+    columnar_writer.Write(batch_paths[1], ColumnarOptions{});
+    std::ofstream(batch_paths[2]) << rows;
+    BatchConfig batch_config;
+    batch_config.threads = 2;
+    BatchStats batch_stats = ReplayLobsterFiles<OrderBook>(batch_paths, batch_config);
+    std::cout << "Files failed: " << batch_stats.failed << ", missing file error reported: " << !batch_stats.files[3].error.empty() << " (Expected: 1, missing file error reported: 1)\n";
+    std::cout << "Schedule ranks: " << batch_stats.files[0].rank << " " << batch_stats.files[1].rank << " " << batch_stats.files[2].rank << " " << batch_stats.files[3].rank
+              << " (Expected: 2 0 1 3)\n";
+    std::cout << "Events: " << batch_stats.total.events << ", unknown " << batch_stats.total.unknown_orders << ", visible executions " << batch_stats.total.by_type[4]
+              << " (Expected: 14, unknown 2, visible executions 2)\n";
+    std::cout << "Max depth: " << batch_stats.total.max_bid_levels << "/" << batch_stats.total.max_ask_levels << ", short file resting " << batch_stats.files[0].resting_orders
+              << " (Expected: 1/1, short file resting 2)\n";
+    std::filesystem::remove_all(batch_dir);
+
+    // Test 18: Shared-memory gateway: two clients in this process, served by explicit polls
+    std::cout << "\nTest 18: Order Gateway\n";
+    GatewayConfig gateway_config;
+    gateway_config.name = "/orderbook_test18_" + std::to_string(::getpid());
+    gateway_config.clients = 4;
+    gateway_config.reference_price = 100;
+    gateway_config.price_band = 50;
+    Gateway<OrderBook> gateway(gateway_config);
+    GatewayClient alice(gateway_config.name);
+    auto bob = std::make_unique<GatewayClient>(gateway_config.name);
+    auto request = [](GatewayRequestType type, std::uint64_t tag, OrderId id, OrderSide side, Price price, Quantity quantity) {
+        GatewayRequest r{};
+        r.client_tag = tag;
+        r.order_id = id;
+        r.price = price;
+        r.quantity = quantity;
+        r.type = type;
+        r.side = side;
+        r.order_type = OrderType::Goodtillcancel;
+        return r;
+    };
+    // Serve everything sent so far and describe each response as type[:error]/quantity
+    auto replies = [&gateway](GatewayClient& client, std::vector<GatewayResponse>* out = nullptr) {
+        static const char* names[] = {"?", "accepted", "rejected", "fill", "cancelled", "modified"};
+        gateway.Poll();
+        std::string text;
+        GatewayResponse response{};
+        while (client.TryReceive(response)) {
+            text += std::string(text.empty() ? "" : " ") + names[static_cast<int>(response.type)];
+            if (response.type == GatewayResponseType::Rejected) {
+                text += std::string(":") + ToString(response.error);
+            }
+            text += "/" + std::to_string(response.quantity);
+            if (out != nullptr) {
+                out->push_back(response);
+            }
+        }
+        return text;
+    };
+    std::vector<GatewayResponse> alice_acks;
+    alice.TrySend(request(GatewayRequestType::NewOrder, 1, 0, OrderSide::Sell, 101, 10));
+    std::cout << "Alice sells 10: " << replies(alice, &alice_acks) << " (Expected: accepted/10)\n";
+    OrderId alice_order = alice_acks.at(0).order_id;
+    bob->TrySend(request(GatewayRequestType::NewOrder, 2, 0, OrderSide::Buy, 101, 4));
+    std::string bob_fill = replies(*bob);
+    std::cout << "Bob buys 4: " << bob_fill << ", Alice gets " << replies(alice, &alice_acks)
+              << " maker " << alice_acks.back().maker << " tag " << alice_acks.back().client_tag
+              << " (Expected: accepted/4 fill/4, Alice gets fill/4 maker 1 tag 0)\n";
+    bob->TrySend(request(GatewayRequestType::Cancel, 3, alice_order, OrderSide::Sell, 0, 0));
+    bob->TrySend(request(GatewayRequestType::NewOrder, 4, 0, OrderSide::Buy, 100, 0));
+    bob->TrySend(request(GatewayRequestType::NewOrder, 5, 0, OrderSide::Buy, 0, 5));
+    std::cout << "Bob cancels Alice's order, sends qty 0, price 0: " << replies(*bob)
+              << " (Expected: rejected:unknown order/0 rejected:invalid quantity/0 rejected:invalid price/5)\n";
+    bob->TrySend(request(GatewayRequestType::NewOrder, 10, 0, OrderSide::Buy, 2000000000, 5));
+    std::cout << "Bob bids far outside the band: " << replies(*bob) << " (Expected: rejected:invalid price/5)\n";
+    alice.TrySend(request(GatewayRequestType::Modify, 6, alice_order, OrderSide::Sell, 102, 8));
+    alice.TrySend(request(GatewayRequestType::Cancel, 7, alice_order, OrderSide::Sell, 0, 0));
+    alice.TrySend(request(GatewayRequestType::Cancel, 8, alice_order, OrderSide::Sell, 0, 0));
+    std::cout << "Alice modifies, cancels twice: " << replies(alice)
+              << " (Expected: modified/8 cancelled/8 rejected:unknown order/0)\n";
+    bob->TrySend(request(GatewayRequestType::NewOrder, 9, 0, OrderSide::Buy, 99, 5));
+    replies(*bob);
+    std::size_t resting = gateway.GetBook().Size();
+    bob.reset(); // Disconnect: the gateway cancels Bob's resting order and frees the slot
+    gateway.Poll();
+    std::cout << "Resting before/after Bob leaves: " << resting << "/" << gateway.GetBook().Size()
+              << ", orphans cancelled " << gateway.Stats().orphans_cancelled << ", requests " << gateway.Stats().requests
+              << ", rejects " << gateway.Stats().rejects << " (Expected: 1/0, orphans cancelled 1, requests 10, rejects 5)\n";
+
+    // Test 19: Incremental market data: L3 and L2 messages, conflation, and a mirror rebuilt by the decoder
+    std::cout << "\nTest 19: Market Data Feed\n";
+    for (bool conflate : {false, true}) {
+        MarketDataConfig feed_config;
+        feed_config.conflate = conflate;
+        MarketDataEncoder encoder(feed_config);
+        OrderBook feed_book;
+        feed_book.ProcessNewOrder(Order(1, OrderSide::Sell, 101, 10, OrderType::Goodtillcancel), encoder);
+        feed_book.ProcessNewOrder(Order(2, OrderSide::Sell, 101, 5, OrderType::Goodtillcancel), encoder);
+        feed_book.ProcessNewOrder(Order(3, OrderSide::Sell, 102, 7, OrderType::Goodtillcancel), encoder);
+        feed_book.ProcessNewOrder(Order(4, OrderSide::Buy, 101, 12, OrderType::Fillandkill), encoder);   // Executes 10 of 1, 2 of 2
+        feed_book.ProcessNewOrder(Order(5, OrderSide::Buy, 100, 4, OrderType::Goodtillcancel), encoder);
+        feed_book.ReduceOrder(5, 1, encoder);
+        feed_book.TryCancelOrder(3, encoder);
+        encoder.EndBatch();
+        std::string first_batch(encoder.Data(), encoder.Size());
+        MarketDataDecoder decoder;
+        decoder.Decode(encoder.Data(), encoder.Size());
+        encoder.Clear();
+        feed_book.Modify(ModifyOrder(2, OrderSide::Buy, 100, 3), encoder);   // Switches side: deleted and added again
+        encoder.EndBatch();
+        std::size_t second = decoder.Decode(encoder.Data(), encoder.Size());
+        OrderBookLevelInfos book_depth = feed_book.GetSnapshot();
+        OrderBookLevelInfos l2_depth;
+        OrderBookLevelInfos l3_depth;
+        decoder.GetDepth(SIZE_MAX, l2_depth);
+        decoder.GetOrderDepth(SIZE_MAX, l3_depth);
+        std::string gap = "none";
+        try {
+            decoder.Decode(first_batch.data(), first_batch.size());
+        } catch (const std::runtime_error& e) {
+            gap = e.what();
+        }
+        std::cout << (conflate ? "Conflated" : "Plain") << ": L3 " << encoder.Messages() - encoder.Count(MarketDataType::LevelUpdate)
+                  << ", L2 " << encoder.Count(MarketDataType::LevelUpdate) << ", first batch " << first_batch.size() << " bytes, second "
+                  << second << " messages (Expected: L3 10, L2 " << (conflate ? "5, first batch 183" : "10, first batch 253") << " bytes, second 4 messages)\n";
+        std::cout << "Mirror orders " << decoder.Orders() << ", L2 matches book " << SameDepth(l2_depth, book_depth)
+                  << ", L3 matches book " << SameDepth(l3_depth, book_depth) << ", bid 100 qty " << l3_depth.getBids().at(0).quantity
+                  << " (Expected: Mirror orders 2, L2 matches book 1, L3 matches book 1, bid 100 qty 6)\n";
+        std::cout << "Replayed batch 0: " << gap << " (Expected: MarketDataDecoder: expected batch 2, got 0)\n";
+    }
+
+    // Test 20: Pipelined replay of the rows of Test 6, with queues of two records so every stage hits backpressure
+    std::cout << "\nTest 20: Pipelined Replay\n";
+    std::string pipeline_path = (std::filesystem::temp_directory_path() / "orderbook_test20_message_1.csv").string();
+    std::ofstream(pipeline_path) << rows;
+    PipelineConfig pipeline_config;
+    pipeline_config.event_capacity = 2;
+    pipeline_config.record_capacity = 2;
+    pipeline_config.batch = 2;
+    pipeline_config.snapshot_interval = 4;
+    pipeline_config.pin_threads = false;
+    OrderBook pipeline_book;
+    PipelineSummary summary;
+    PipelineStats pipeline_stats = ReplayLobsterPipelined(pipeline_path.c_str(), pipeline_book, summary, pipeline_config);
+    std::cout << "Events: " << pipeline_stats.replay.events << ", unknown " << pipeline_stats.replay.unknown_orders << ", resting " << pipeline_book.Size()
+              << ", ask 16120456 remaining " << pipeline_book.FindOrder(16120456)->GetRemainingQuantity()
+              << " (Expected: 6, unknown 1, resting 1, ask 16120456 remaining 60)\n";
+    std::cout << "Trades: " << summary.trades << ", quantity " << summary.traded_quantity << ", vwap " << static_cast<long long>(summary.Vwap())
+              << " (Expected: 1, quantity 40, vwap 5859100)\n";
+    std::cout << "Snapshots: " << summary.snapshots << ", last at event " << summary.last_snapshot.events << ", levels "
+              << static_cast<int>(summary.last_snapshot.bid_levels) << "/" << static_cast<int>(summary.last_snapshot.ask_levels) << ", best ask qty "
+              << summary.last_snapshot.asks[0].quantity << " (Expected: 2, last at event 6, levels 0/1, best ask qty 60)\n";
+    std::cout << "Stage items: " << pipeline_stats.parse.items << " " << pipeline_stats.match.items << " " << pipeline_stats.publish.items
+              << " (Expected: 6 6 3)\n";
+    std::filesystem::remove(pipeline_path);
+    std::string pipeline_error = "none";
+    try {
+        OrderBook missing_book;
+        ReplayLobsterPipelined("/nonexistent/orderbook_test20.csv", missing_book, summary, pipeline_config);
+    } catch (const std::runtime_error& e) {
+        pipeline_error = e.what();
+    }
+    std::cout << "Missing file: " << pipeline_error << " (Expected: MappedFile: cannot open /nonexistent/orderbook_test20.csv)\n";
+
+    // Test 21: Good-till-date and day orders expire on the book's clock through the cancel path
+    std::cout << "\nTest 21: Order Expiry\n";
+    OrderBook expiry_book;
+    BookEventRing<64> expiry_events;
+    expiry_book.SetSessionClose(1000);
+    expiry_book.AdvanceTime(100);
+    expiry_book.ProcessNewOrder(Order(1, OrderSide::Sell, 101, 10, OrderType::Goodtilldate), 500, expiry_events);
+    expiry_book.ProcessNewOrder(Order(2, OrderSide::Sell, 102, 10, OrderType::Goodtilldate), 50, expiry_events);   // Already past
+    expiry_book.ProcessNewOrder(Order(3, OrderSide::Sell, 102, 10, OrderType::Goodtilldate), expiry_events);       // No expiry given
+    expiry_book.ProcessNewOrder(Order(4, OrderSide::Buy, 99, 5, OrderType::Day), expiry_events);
+    expiry_book.ProcessNewOrder(Order(5, OrderSide::Buy, 98, 5, OrderType::Day), expiry_events);
+    expiry_book.ProcessNewOrder(Order(6, OrderSide::Sell, 101, 10, OrderType::Goodtilldate), 300, expiry_events);
+    expiry_book.ProcessNewOrder(Order(7, OrderSide::Buy, 101, 12, OrderType::Fillandkill), expiry_events);   // Fills 1, 2 of 6
+    expiry_book.TryCancelOrder(5, expiry_events);
+    int expiry_rejects = 0;
+    while (expiry_events.Pop(event_out)) {
+        expiry_rejects += event_out.type == BookEventType::Rejected && event_out.reason == RejectReason::Expired;
+    }
+    std::cout << "Expired rejects: " << expiry_rejects << ", timed orders resting " << expiry_book.TimedOrders() << " (Expected: 2, timed orders resting 2)\n";
+    std::size_t expired_early = expiry_book.AdvanceTime(299, expiry_events);
+    std::size_t expired_gtd = expiry_book.AdvanceTime(300, expiry_events);
+    expiry_events.Pop(event_out);
+    std::cout << "Expired at 299/300: " << expired_early << "/" << expired_gtd << ", cancelled " << event_out.order_id << " qty " << event_out.quantity
+              << " (Expected: 0/1, cancelled 6 qty 8)\n";
+    std::size_t expired_day = expiry_book.AdvanceTime(5000, expiry_events);
+    expiry_events.Pop(event_out);
+    std::cout << "Expired at close: " << expired_day << ", cancelled " << event_out.order_id << ", resting " << expiry_book.Size() << ", clock "
+              << expiry_book.Now() << " (Expected: 1, cancelled 4, resting 0, clock 5000)\n";
+    LadderOrderBook timed_book;
+    timed_book.SetSessionClose(1000);
+    timed_book.AdvanceTime(100);
+    timed_book.ProcessNewOrder(Order(1, OrderSide::Sell, 101, 10, OrderType::Goodtilldate), 500, expiry_events);
+    timed_book.ProcessNewOrder(Order(2, OrderSide::Buy, 99, 5, OrderType::Day), expiry_events);
+    timed_book.ProcessNewOrder(Order(3, OrderSide::Buy, 98, 5, OrderType::Goodtillcancel), expiry_events);
+    timed_book.SetSessionClose(2000);   // Order 2 keeps the close it was accepted under
+    const std::string timed_path = (std::filesystem::temp_directory_path() / "orderbook_test21.ckpt").string();
+    std::vector<char> timed_buffer;
+    WriteCheckpoint(timed_book, 0, timed_path, timed_buffer);
+    LadderOrderBook restored_book;
+    LoadCheckpoint(CheckpointView(timed_path), restored_book);
+    std::filesystem::remove(timed_path);
+    std::cout << "Checkpointed timed orders: " << restored_book.TimedOrders() << ", expiries " << restored_book.GetExpiry(1) << "/"
+              << restored_book.GetExpiry(2) << "/" << restored_book.GetExpiry(3) << ", clock " << restored_book.Now() << ", close "
+              << restored_book.SessionClose() << " (Expected: 2, expiries 500/1000/0, clock 100, close 2000)\n";
+    std::size_t restored_gtd = restored_book.AdvanceTime(500);
+    std::size_t restored_day = restored_book.AdvanceTime(1000);
+    std::cout << "Restored expiries at 500/1000: " << restored_gtd << "/" << restored_day << ", resting " << restored_book.Size()
+              << " (Expected: 1/1, resting 1)\n";
+    TimingWheel wheel;
+    std::vector<std::uint32_t> fired;
+    wheel.Schedule(0, 1ULL << 40);
+    wheel.Schedule(1, 70000);
+    wheel.Schedule(2, 5);
+    wheel.Schedule(3, 70000);
+    wheel.Schedule(4, 900);
+    wheel.Cancel(4);
+    std::size_t fired_early = wheel.Advance(69999, [&](std::uint32_t index) { fired.push_back(index); });
+    wheel.Advance(1ULL << 40, [&](std::uint32_t index) { fired.push_back(index); });
+    std::cout << "Wheel fired " << fired_early << " by 69999, order:";
+    for (std::uint32_t index : fired) {
+        std::cout << " " << index;
+    }
+    std::cout << ", left " << wheel.Size() << " (Expected: Wheel fired 1 by 69999, order: 2 1 3 0, left 0)\n";
+
+    // Test 22: Top-of-book features, re-read only when a change reaches the levels they cover
+    std::cout << "\nTest 22: Book Analytics\n";
+    LadderOrderBook analytics_book;
+    BookAnalytics<LadderOrderBook> analytics(analytics_book, 2);
+    analytics_book.ProcessNewOrder(Order(1, OrderSide::Buy, 99, 30, OrderType::Goodtillcancel));
+    analytics_book.ProcessNewOrder(Order(2, OrderSide::Buy, 98, 10, OrderType::Goodtillcancel));
+    analytics_book.ProcessNewOrder(Order(3, OrderSide::Buy, 97, 50, OrderType::Goodtillcancel));
+    analytics_book.ProcessNewOrder(Order(4, OrderSide::Sell, 101, 10, OrderType::Goodtillcancel));
+    analytics.Update();
+    const BookFeatures& features = analytics.Features();
+    std::cout << "Microprice " << features.microprice << ", imbalance " << features.imbalance << ", bid vwap " << features.bid_vwap
+              << ", ask vwap " << features.ask_vwap << " (Expected: Microprice 100.5, imbalance 0.6, bid vwap 98.75, ask vwap 101)\n";
+    std::cout << "Bid depth " << features.bid_depth << ", cumulative " << analytics.CumulativeQuantities(OrderSide::Buy)[0] << " "
+              << analytics.CumulativeQuantities(OrderSide::Buy)[1] << ", levels " << analytics.Count(OrderSide::Buy) << "/"
+              << analytics.Count(OrderSide::Sell) << " (Expected: Bid depth 40, cumulative 30 40, levels 2/1)\n";
+    analytics_book.ProcessNewOrder(Order(5, OrderSide::Buy, 96, 5, OrderType::Goodtillcancel));   // Below the top 2
+    analytics_book.ReduceOrder(3, 20);
+    bool below_changed = analytics.Update();
+    analytics_book.ProcessNewOrder(Order(6, OrderSide::Sell, 102, 30, OrderType::Goodtillcancel));   // Second ask level
+    bool ask_changed = analytics.Update();
+    std::cout << "Recomputed after deep/ask changes: " << below_changed << "/" << ask_changed << ", reads " << analytics.Reads()
+              << ", ask depth " << features.ask_depth << ", imbalance " << features.imbalance << " (Expected: 0/1, reads 3, ask depth 40, imbalance 0)\n";
+    analytics_book.CancelOrder(1);   // The deeper level moves up into the top 2
+    analytics.Update();
+    std::cout << "After best bid cancel: bid vwap " << features.bid_vwap << ", bid depth " << features.bid_depth
+              << " (Expected: bid vwap 97.25, bid depth 40)\n";
+    FeatureColumns feature_columns;
+    feature_columns.Append(1000, features);
+    analytics_book.CancelOrder(4);
+    analytics_book.CancelOrder(6);
+    analytics.Update();
+    feature_columns.Append(2000, features);
+    const std::string features_path = (std::filesystem::temp_directory_path() / "orderbook_test22.feat").string();
+    std::size_t feature_bytes = feature_columns.Write(features_path);
+    FeatureFileHeader feature_header{};
+    std::ifstream features_in(features_path, std::ios::binary);
+    features_in.read(reinterpret_cast<char*>(&feature_header), sizeof(feature_header));
+    double last_ask_vwap = 0;
+    features_in.seekg(static_cast<std::streamoff>(feature_header.offsets[static_cast<std::size_t>(FeatureColumn::AskVwap)] + sizeof(double)));
+    features_in.read(reinterpret_cast<char*>(&last_ask_vwap), sizeof(last_ask_vwap));
+    std::cout << "Feature file: " << feature_header.rows << " rows, " << feature_bytes << " bytes, empty-side ask vwap "
+              << (std::isnan(last_ask_vwap) ? "NaN" : "set") << ", microprice " << (std::isnan(features.microprice) ? "NaN" : "set")
+              << " (Expected: 2 rows, 528 bytes, empty-side ask vwap NaN, microprice NaN)\n";
+    std::filesystem::remove(features_path);
+
+    // Test 23: Ring-buffer level queues tombstone cancels, skip them when matching and compact when they pile up
+    std::cout << "\nTest 23: Ring Queues\n";
+    OrderPool ring_pool;
+    RingOrderQueue ring_queue;
+    std::vector<OrderHandle> ring_handles;
+    for (OrderId id = 1; id <= 40; ++id) {
+        ring_handles.push_back(ring_pool.Allocate(Order(id, OrderSide::Buy, 100, 1, OrderType::Goodtillcancel)));
+        ring_queue.push_back(ring_pool, ring_handles.back());
+    }
+    auto ring_erase = [&](OrderId id) { ring_queue.erase(ring_pool, ring_handles[id - 1]); };
+    ring_erase(5);
+    ring_erase(6);
+    ring_erase(20);
+    std::cout << "Capacity " << ring_queue.Capacity() << ", tombstones " << ring_queue.Tombstones() << " (Expected: Capacity 64, tombstones 3)\n";
+    ring_erase(1);    // At the head: the head moves past it
+    ring_erase(40);   // At the tail: trimmed, not tombstoned
+    std::cout << "Tombstones after head/tail cancels: " << ring_queue.Tombstones() << ", front " << ring_pool[ring_queue.front()].GetOrderId()
+              << " (Expected: 3, front 2)\n";
+    ring_erase(2);    // The head skips the tombstones behind it too
+    ring_erase(3);
+    ring_erase(4);
+    std::cout << "Front after three more head cancels: " << ring_pool[ring_queue.front()].GetOrderId() << ", tombstones " << ring_queue.Tombstones()
+              << " (Expected: 7, 1)\n";
+    for (OrderId id = 8; id <= 33; ++id) {
+        if (id != 20) {
+            ring_erase(id);
+        }
+    }
+    std::cout << "Tombstones after 25 middle cancels: " << ring_queue.Tombstones() << " (Expected: 26)\n";
+    ring_erase(34);   // 27 tombstones to 6 live orders: past four to one, compacted
+    std::vector<OrderId> ring_ids;
+    ring_queue.ForEach(ring_pool, [&](OrderHandle handle) { ring_ids.push_back(ring_pool[handle].GetOrderId()); });
+    std::cout << "Tombstones " << ring_queue.Tombstones() << ", orders " << ring_ids.size() << ": " << ring_ids[0] << " " << ring_ids[1]
+              << " ... " << ring_ids.back() << " (Expected: Tombstones 0, orders 6: 7 35 ... 39)\n";
+    auto ring_push = [&](OrderId id) {
+        ring_handles.push_back(ring_pool.Allocate(Order(id, OrderSide::Buy, 100, 1, OrderType::Goodtillcancel)));
+        ring_queue.push_back(ring_pool, ring_handles.back());
+    };
+    for (OrderId id = 41; id <= 98; ++id) {
+        ring_push(id);   // Fills the ring
+    }
+    for (OrderId id = 50; id <= 81; ++id) {
+        ring_erase(id);
+    }
+    ring_push(99);   // Full with half of it tombstones: compacted rather than grown
+    std::cout << "After push into a half-dead full ring: capacity " << ring_queue.Capacity() << ", tombstones " << ring_queue.Tombstones()
+              << " (Expected: capacity 64, tombstones 0)\n";
+    std::size_t ring_popped = 0;
+    OrderId ring_last = 0;
+    for (; !ring_queue.empty(); ++ring_popped) {
+        ring_last = ring_pool[ring_queue.front()].GetOrderId();
+        ring_queue.pop_front(ring_pool);
+    }
+    std::cout << "Popped " << ring_popped << ", last " << ring_last << " (Expected: Popped 33, last 99)\n";
+
+    RingOrderBook ring_queue_book;
+    for (OrderId id = 1; id <= 6; ++id) {
+        ring_queue_book.ProcessNewOrder(Order(id, OrderSide::Buy, 100, 1, OrderType::Goodtillcancel));
+    }
+    ring_queue_book.CancelOrder(2);
+    ring_queue_book.CancelOrder(4);
+    ring_queue_book.Modify(ModifyOrder(1, OrderSide::Buy, 100, 5));   // Larger: to the back
+    Trades ring_trades = ring_queue_book.ProcessNewOrder(std::make_shared<Order>(50, OrderSide::Sell, 100, 4, OrderType::Fillandkill));
+    std::cout << "Sweep fills " << ring_trades.size() << ": " << ring_trades[0].GetBidTradeInfo().bid_order_id << " "
+              << ring_trades[1].GetBidTradeInfo().bid_order_id << " " << ring_trades[2].GetBidTradeInfo().bid_order_id << " "
+              << ring_trades[3].GetBidTradeInfo().bid_order_id << ", resting " << ring_queue_book.Size()
+              << " (Expected: Sweep fills 4: 3 5 6 1, resting 1)\n";
+
+    // Test 24: Mass cancels drain whole levels; an emptied book resets its storage and keeps trading
+    std::cout << "\nTest 24: Mass Cancel\n";
+    LadderOrderBook mass_book;
+    BookEventRing<64> mass_events;
+    mass_book.SetSessionClose(2000);
+    mass_book.ProcessNewOrder(Order(1, OrderSide::Buy, 100, 10, OrderType::Goodtillcancel));
+    mass_book.ProcessNewOrder(Order(2, OrderSide::Buy, 100, 5, OrderType::Goodtillcancel));
+    mass_book.ProcessNewOrder(Order(3, OrderSide::Buy, 99, 7, OrderType::Goodtillcancel));
+    mass_book.ProcessNewOrder(Order(4, OrderSide::Buy, 97, 3, OrderType::Goodtilldate), 1000, mass_events);
+    mass_book.ProcessNewOrder(Order(5, OrderSide::Buy, 95, 2, OrderType::Goodtillcancel));
+    mass_book.ProcessNewOrder(Order(6, OrderSide::Sell, 101, 4, OrderType::Goodtillcancel));
+    mass_book.ProcessNewOrder(Order(7, OrderSide::Sell, 102, 6, OrderType::Goodtillcancel));
+    mass_book.ProcessNewOrder(Order(8, OrderSide::Sell, 104, 1, OrderType::Day), mass_events);
+    while (mass_events.Pop(event_out)) {   // Acceptances of the timed orders
+    }
+    std::size_t range_cancelled = mass_book.CancelRange(OrderSide::Buy, 96, 99, mass_events);
+    std::cout << "Range 96-99 cancelled " << range_cancelled << ":";
+    while (mass_events.Pop(event_out)) {
+        std::cout << " " << event_out.order_id << "x" << event_out.quantity;
+    }
+    std::cout << ", bid levels " << mass_book.GetSnapshot().getBids().size() << ", timed " << mass_book.TimedOrders()
+              << " (Expected: Range 96-99 cancelled 2: 3x7 4x3, bid levels 2, timed 1)\n";
+    std::size_t side_cancelled = mass_book.CancelSide(OrderSide::Sell);
+    std::cout << "Asks cancelled " << side_cancelled << ", resting " << mass_book.Size() << ", timed " << mass_book.TimedOrders()
+              << ", order 7 known " << mass_book.TryCancelOrder(7) << " (Expected: Asks cancelled 3, resting 3, timed 0, order 7 known 0)\n";
+    Trades mass_trades = mass_book.ProcessNewOrder(Order(9, OrderSide::Sell, 100, 12, OrderType::Goodtillcancel));
+    std::cout << "Sell 12 at 100 fills " << mass_trades.size() << ", best bid " << mass_book.GetSnapshot().getBids()[0].price << " qty "
+              << mass_book.GetSnapshot().getBids()[0].quantity << " (Expected: fills 2, best bid 100 qty 3)\n";
+    std::size_t all_cancelled = mass_book.CancelAll(mass_events);   // Empties the book: events in index order
+    Quantity all_quantity = 0;
+    while (mass_events.Pop(event_out)) {
+        all_quantity += event_out.quantity;
+    }
+    std::cout << "All cancelled " << all_cancelled << ", quantity " << all_quantity << ", resting " << mass_book.Size() << ", order 5 known "
+              << mass_book.TryCancelOrder(5) << " (Expected: All cancelled 2, quantity 5, resting 0, order 5 known 0)\n";
+    mass_book.ProcessNewOrder(Order(10, OrderSide::Buy, 100, 4, OrderType::Goodtillcancel));
+    mass_book.ProcessNewOrder(Order(11, OrderSide::Buy, 100, 4, OrderType::Goodtillcancel));
+    mass_trades = mass_book.ProcessNewOrder(Order(12, OrderSide::Sell, 100, 6, OrderType::Goodtillcancel));
+    std::cout << "After reset: fills " << mass_trades.size() << ", resting " << mass_book.Size() << ", bid qty "
+              << mass_book.GetSnapshot().getBids()[0].quantity << " (Expected: fills 2, resting 1, bid qty 2)\n";
+    OrderBook mass_map_book;
+    for (OrderId id = 1; id <= 10; ++id) {
+        mass_map_book.ProcessNewOrder(Order(id, OrderSide::Sell, 100 + static_cast<Price>(id % 5), 1, OrderType::Goodtillcancel));
+    }
+    std::size_t map_cancelled = mass_map_book.CancelRange(OrderSide::Sell, 101, 103);
+    std::cout << "Map asks 101-103 cancelled " << map_cancelled << ", ask levels " << mass_map_book.GetSnapshot().getAsks().size()
+              << ", best ask " << mass_map_book.GetSnapshot().getAsks()[0].price << " (Expected: cancelled 6, ask levels 2, best ask 100)\n";
+
+    // Test 25: Rolling depth hash agrees across backends and with LOBSTER orderbook rows; validation finds a divergence
+    std::cout << "\nTest 25: Depth Hash\n";
+    OrderBook hash_map_book;
+    LadderOrderBook hash_ladder_book;
+    RingOrderBook hash_ring_book;
+    auto hash_ops = [](auto& book) {
+        book.ProcessNewOrder(Order(1, OrderSide::Buy, 100, 10, OrderType::Goodtillcancel));
+        book.ProcessNewOrder(Order(2, OrderSide::Buy, 100, 5, OrderType::Goodtillcancel));
+        book.ProcessNewOrder(Order(3, OrderSide::Buy, 99, 7, OrderType::Goodtillcancel));
+        book.ProcessNewOrder(Order(4, OrderSide::Sell, 101, 4, OrderType::Goodtillcancel));
+        book.ProcessNewOrder(Order(5, OrderSide::Sell, 102, 6, OrderType::Goodtillcancel));
+        book.ProcessNewOrder(Order(6, OrderSide::Sell, 100, 8, OrderType::Goodtillcancel));   // Fills 1 partly
+        book.Modify(ModifyOrder(3, OrderSide::Buy, 99, 3));
+        book.CancelOrder(5);
+        book.ProcessNewOrder(Order(7, OrderSide::Sell, 102, 6, OrderType::Goodtillcancel));
+    };
+    hash_ops(hash_map_book);
+    hash_ops(hash_ladder_book);
+    hash_ops(hash_ring_book);
+    auto snapshot_hash = [](const OrderBookLevelInfos& depth) {
+        std::uint64_t hash = 0;
+        for (const LevelInfo& level : depth.getBids()) {
+            hash ^= LevelHash(OrderSide::Buy, level.price, level.quantity);
+        }
+        for (const LevelInfo& level : depth.getAsks()) {
+            hash ^= LevelHash(OrderSide::Sell, level.price, level.quantity);
+        }
+        return hash;
+    };
+    std::cout << "Backends agree: " << (hash_map_book.DepthHash() == hash_ladder_book.DepthHash() && hash_map_book.DepthHash() == hash_ring_book.DepthHash())
+              << ", matches snapshot " << (hash_map_book.DepthHash() == snapshot_hash(hash_map_book.GetSnapshot()))
+              << ", sides differ " << (hash_map_book.DepthHash(OrderSide::Buy) != hash_map_book.DepthHash(OrderSide::Sell))
+              << " (Expected: Backends agree: 1, matches snapshot 1, sides differ 1)\n";
+    const char hash_row[] = "101,4,100,7,102,6,99,3,9999999999,0,-9999999999,0\n";
+    const char* hash_cursor = hash_row;
+    std::uint64_t row_bids = 0;
+    std::uint64_t row_asks = 0;
+    std::size_t row_levels = 0;
+    bool row_ok = HashLobsterBookRow(hash_cursor, hash_row + sizeof(hash_row) - 1, row_bids, row_asks, row_levels);
+    std::cout << "Row parsed " << row_ok << ", levels " << row_levels << ", bids match " << (row_bids == hash_ladder_book.DepthHash(OrderSide::Buy))
+              << ", asks match " << (row_asks == hash_ladder_book.DepthHash(OrderSide::Sell)) << " (Expected: Row parsed 1, levels 3, bids match 1, asks match 1)\n";
+    hash_ring_book.CancelOrder(4);
+    std::uint64_t ring_without_4 = hash_ring_book.DepthHash();
+    hash_ring_book.ProcessNewOrder(Order(4, OrderSide::Sell, 101, 4, OrderType::Goodtillcancel));
+    hash_ladder_book.CancelAll();
+    std::cout << "Cancel changes hash " << (ring_without_4 != hash_map_book.DepthHash() && ring_without_4 != 0) << ", re-add restores "
+              << (hash_ring_book.DepthHash() == hash_map_book.DepthHash()) << ", emptied book hash " << hash_ladder_book.DepthHash()
+              << " (Expected: Cancel changes hash 1, re-add restores 1, emptied book hash 0)\n";
+
+    // The map backend's replay of Test 6's rows is the reference orderbook file; the ladder replay gets an extra ask after event 3
+    std::string book_rows_path = (std::filesystem::temp_directory_path() / "orderbook_test25_orderbook_2.csv").string();
+    OrderBook reference_book;
+    LobsterReplay<OrderBook> reference_replay(reference_book);
+    LobsterBookWriter book_writer(book_rows_path.c_str(), 2);
+    cursor = rows;
+    while (cursor < end && ParseLobsterMessage(cursor, end, event)) {
+        reference_replay.Apply(event);
+        book_writer.Add(reference_book);
+    }
+    std::size_t rows_written = book_writer.Close();
+    for (bool inject : {false, true}) {
+        LadderOrderBook checked_book;
+        LobsterReplay<LadderOrderBook> checked_replay(checked_book);
+        LobsterValidator<LadderOrderBook> validator(checked_book);
+        LobsterBookReader book_rows(book_rows_path.c_str());
+        cursor = rows;
+        while (cursor < end && ParseLobsterMessage(cursor, end, event)) {
+            if (inject && checked_replay.Stats().events == 3) {
+                checked_book.ProcessNewOrder(Order(77, OrderSide::Sell, 5859200, 5, OrderType::Goodtillcancel));
+            }
+            checked_replay.Apply(event);
+            validator.Check(event, book_rows);
+        }
+        const ValidationStats& validation = validator.Stats();
+        std::cout << (inject ? "Injected" : "Clean") << ": rows " << rows_written << ", levels " << validation.levels << ", checked "
+                  << validation.events << ", mismatched " << validation.mismatched_events << ", first " << validation.first_mismatch;
+        if (inject) {
+            const DepthMismatch& mismatch = validator.Mismatches()[0];
+            std::cout << ", ask level " << mismatch.level << " book " << mismatch.book.price << "x" << mismatch.book.quantity << " file "
+                      << mismatch.file.quantity << " (Expected: Injected: rows 6, levels 2, checked 6, mismatched 3, first 4, ask level 1 book 5859200x5 file 0)\n";
+        }
+        else {
+            std::cout << " (Expected: Clean: rows 6, levels 2, checked 6, mismatched 0, first 0)\n";
+        }
+    }
+    std::filesystem::remove(book_rows_path);
+
     return 0;
 }
 
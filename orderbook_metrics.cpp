@@ -0,0 +1,40 @@
+// Checks for the hot-path metrics (book_metrics.h). Built separately from orderbook.cpp, which tests the default
+// build with metrics compiled out; here every call is timed.
+#define ORDERBOOK_METRICS 1
+#define ORDERBOOK_METRICS_SAMPLE_SHIFT 0
+
+#include "ordersApi.h"
+#include <cstdint>
+#include <iostream>
+
+int main() {
+    // Test 17: Hot-path metrics: call counts, counters and log-linear histograms
+    std::cout << "\nTest 17: Book Metrics\n";
+    OrderBook metrics_book;
+    metrics_book.ProcessNewOrder(Order(90, OrderSide::Sell, 101, 10, OrderType::Goodtillcancel));
+    metrics_book.ProcessNewOrder(Order(91, OrderSide::Sell, 102, 10, OrderType::Goodtillcancel));
+    metrics_book.ProcessNewOrder(Order(92, OrderSide::Sell, 102, 10, OrderType::Goodtillcancel));
+    metrics_book.ProcessNewOrder(Order(91, OrderSide::Sell, 103, 5, OrderType::Goodtillcancel));   // Duplicate id
+    metrics_book.ProcessNewOrder(Order(93, OrderSide::Buy, 102, 15, OrderType::Fillandkill));      // Fills 90 and 5 of 91
+    metrics_book.CancelOrder(92);
+    metrics_book.CancelOrder(91);
+    MetricsSnapshot metrics;
+    metrics_book.ReadMetrics(metrics);
+    std::cout << "Calls add/match/cancel: " << metrics.calls[0] << "/" << metrics.calls[1] << "/" << metrics.calls[2] << ", timed adds " << metrics.Op(BookOp::Add).count
+              << " (Expected: 5/1/2, timed adds 5)\n";
+    std::cout << "Levels created/erased: " << metrics.Counter(BookCounter::LevelsCreated) << "/" << metrics.Counter(BookCounter::LevelsErased)
+              << ", sweeps " << metrics.Counter(BookCounter::Sweeps) << ", orders matched " << metrics.Counter(BookCounter::OrdersMatched)
+              << ", duplicates " << metrics.Counter(BookCounter::DuplicatesRejected) << " (Expected: 2/2, sweeps 1, orders matched 2, duplicates 1)\n";
+    std::size_t bucket_1000 = HistogramSnapshot::BucketOf(1000);
+    std::cout << "Buckets of 15, 16, 17: " << HistogramSnapshot::BucketOf(15) << " " << HistogramSnapshot::BucketOf(16) << " " << HistogramSnapshot::BucketOf(17)
+              << ", 1000 in [" << HistogramSnapshot::BucketLow(bucket_1000) << ", " << HistogramSnapshot::BucketLow(bucket_1000 + 1) - 1 << "] (Expected: 15 16 16, 1000 in [960, 1023])\n";
+    LogHistogram histogram;
+    for (std::uint64_t value = 1; value <= 100; ++value) {
+        histogram.Record(value);
+    }
+    HistogramSnapshot histogram_read;
+    histogram.Read(histogram_read);
+    std::cout << "1..100: count " << histogram_read.count << ", mean " << histogram_read.Mean() << ", p50 " << histogram_read.Percentile(0.5)
+              << ", p99 " << histogram_read.Percentile(0.99) << " (Expected: count 100, mean 50.5, p50 51, p99 100)\n";
+    return 0;
+}
@@ -5,6 +5,7 @@
 #include <list>
 #include <memory>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 
@@ -12,15 +13,32 @@
 using Price =  std::int32_t;
 using Quantity = std::uint32_t;
 using OrderId = std::uint64_t;
+using Timestamp = std::uint64_t;     // Book clock for order expiry, in the caller's unit (e.g. ns after midnight)
+using OrderHandle = std::uint32_t;   // Stable index of an order slot in OrderPool
+constexpr OrderHandle kInvalidHandle = UINT32_MAX;
 using LevelInfos = std::vector<struct LevelInfo>;
 
 // Enum for order types and sides
-enum class OrderType{
-    Goodtillcancel,
-    Fillandkill,
+enum class OrderType : std::uint8_t{
+    Goodtillcancel,   // Rests until filled or cancelled
+    Fillandkill,      // Immediate-or-cancel: fills what it can up to its limit, the rest is cancelled
+    Fillorkill,       // Fills its whole quantity up to its limit at once, or is rejected without trading
+    Market,           // Immediate-or-cancel at any price; the order's price is ignored
+    Goodtilldate,     // Rests until filled, cancelled or its expiry time
+    Day,              // Rests until filled, cancelled or the session close
 };
 
-enum class OrderSide{
+// Types that rest in the book once their marketable part has traded
+constexpr bool RestsInBook(OrderType type){
+    return type == OrderType::Goodtillcancel || type == OrderType::Goodtilldate || type == OrderType::Day;
+}
+
+// Resting types the book expires on its clock (BasicOrderBook::AdvanceTime)
+constexpr bool IsTimed(OrderType type){
+    return type == OrderType::Goodtilldate || type == OrderType::Day;
+}
+
+enum class OrderSide : std::uint8_t{
     Buy,
     Sell,
 };
@@ -31,17 +49,18 @@ enum class OrderSide{
 struct LevelInfo {
  Price price;
  Quantity quantity;
+ std::uint32_t order_count{0};
 };
 
 
 class Order{
  public:
   Order(OrderId id, OrderSide side, Price price, Quantity quantity, OrderType type):
+   remaining_quantity_ {quantity},   // Remaining quantity = initial quantity at order creation
+   price_ {price},
    id_ {id},
+   initial_quantity_ {quantity},
    side_ {side},
-   price_ {price},
-   initial_quantity_ {quantity},     // Remaining quantity = initial quantity at order creation
-   remaining_quantity_ {quantity},
    order_type_ {type}
    { }
 
@@ -62,18 +81,46 @@ class Order{
        remaining_quantity_ -= quantity;
    }
 
+   // Cancel part of the order: initial and remaining shrink together so the filled quantity is unchanged
+   void Reduce(Quantity quantity){
+       if(quantity > remaining_quantity_){
+           throw std::logic_error("Order (" + std::to_string(GetOrderId()) + ") Reduce quantity exceeds remaining quantity");
+       }
+       initial_quantity_ -= quantity;
+       remaining_quantity_ -= quantity;
+   }
+
+   // Replace the order's terms (modify): remaining becomes `quantity`; the filled quantity is unchanged.
+   // Only for an order that is not linked into a level, since its price and side decide where it rests.
+   void Amend(OrderSide side, Price price, Quantity quantity){
+       initial_quantity_ = GetFilledQuantity() + quantity;
+       remaining_quantity_ = quantity;
+       price_ = price;
+       side_ = side;
+   }
+
  private:
- OrderType order_type_;
- OrderId id_;
- OrderSide side_;
+ friend class OrderPool;   // Owns the intrusive links below
+ friend class OrderQueue;
+ friend class RingOrderQueue;
+
+ // Hot fields first: matching touches quantity, price and links together (16 bytes, one cache line with the id)
+ Quantity remaining_quantity_;
  Price price_;
+ OrderHandle prev_ {kInvalidHandle};   // Intrusive FIFO links within the price level (free-list link when pooled slot is free); position in a RingOrderQueue
+ OrderHandle next_ {kInvalidHandle};
+ OrderId id_;
  Quantity initial_quantity_;
- Quantity remaining_quantity_;
+ OrderSide side_;
+ OrderType order_type_;
 };
+static_assert(sizeof(Order) == 32, "Order should stay at 32 bytes (two per cache line)");
 
 class OrderBookLevelInfos{
 
  public:
+   OrderBookLevelInfos() = default;
+
    // Constructor for OrderBookLevelInfos
    OrderBookLevelInfos(const LevelInfos& bids, const LevelInfos& asks): 
    bids_ {bids},
@@ -84,6 +131,10 @@ class OrderBookLevelInfos{
    const LevelInfos& getBids() const { return bids_; }
    const LevelInfos& getAsks() const { return asks_; }
 
+   // Mutable access for refilling in place: clearing keeps the vectors' capacity, so a reused snapshot stops allocating
+   LevelInfos& getBids() { return bids_; }
+   LevelInfos& getAsks() { return asks_; }
+
  private:
    LevelInfos bids_;
    LevelInfos asks_;
@@ -95,7 +146,7 @@ class OrderBookLevelInfos{
 //copies increment a reference count, and the Order is deleted when the last shared_ptr goes away.
 
 using OrderPointer = std::shared_ptr<Order>; 
-using OrderPointers = std::list<OrderPointer>;   // Uses a doubly linked list to store orders at the same price level (can use a vector if we want to optimize for cache locality
+using OrderPointers = std::list<OrderPointer>;   // No longer used by the book: its levels queue pooled orders (OrderQueue, or the contiguous RingOrderQueue; order_pool.h)
 
 
 // Reperesent an matched object between two orders with a trade object: use object for bid and ask orders
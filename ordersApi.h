@@ -1,12 +1,32 @@
+#ifndef ORDERS_API_H
+#define ORDERS_API_H
+
 #include "orders.h"
-#include <map>
-#include <unordered_map>
+#include "book_events.h"
+#include "book_hash.h"
+#include "book_metrics.h"
+#include "order_index.h"
+#include "order_pool.h"
+#include "price_levels.h"
+#include "timing_wheel.h"
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
 
 
 
 // Contains order related methods for OrderBook class
 
 
+// Outcome of an auction uncross
+struct AuctionResult{
+ Price clearing_price{0};
+ std::uint64_t volume{0};   // Quantity executed (0: the book was not crossed and clearing_price is meaningless)
+ std::size_t accepted{0};   // Orders from the batch that entered the book (ProcessBatch only)
+};
+
+
 class ModifyOrder{
  public:
   ModifyOrder(OrderId id, OrderSide side, Price price, Quantity quantity):
@@ -25,192 +45,1112 @@ class ModifyOrder{
    return std::make_shared<Order>(id_, side_, price_, quantity_, OrderType::Goodtillcancel);
   }
 
+  Order toOrder() const { return Order(id_, side_, price_, quantity_, OrderType::Goodtillcancel); } // No heap allocation
+
  private:
   OrderId id_;
-  Price price_;
   OrderSide side_;
+  Price price_;
   Quantity quantity_;
 };
 
 
 
-// Use map to represent bids and asks 
+// Bids and asks are kept in a price level container chosen by LevelPolicy (see price_levels.h):
+//  MapLevels    -> std::map per side (O(log N) level insert/erase)
+//  LadderLevels -> tick-indexed ladder with an occupancy bitmap (O(1) best price)
+//  RingLevels   -> the same ladder, each level's FIFO a contiguous ring of handles with tombstoned cancels
+// Orders live in an OrderPool and are linked into their level's FIFO by handle, so adding and cancelling orders
+// does not allocate once the pool has grown to the peak number of live orders.
+// Good-till-date and day orders also sit on a TimingWheel under their pool handle; AdvanceTime expires them.
+// Each side keeps a rolling hash of its levels' aggregates (DepthHash), so depth can be compared in O(1).
 // Access a given order by its OrderId in O(1) time
-class OrderBook{
+template <typename LevelPolicy>
+class BasicOrderBook{
  // represent order / location in order book:
  private: 
   struct OrderEntry{
-   OrderPointer order_pointer{nullptr};  // shared pointer to the order
-   OrderPointers::iterator location_;  // iterator to the order's position in the list at its price level
+   OrderHandle handle_{kInvalidHandle};  // slot in pool_; the order's links give its position in the level queue
   };
 
+  using Level = typename LevelPolicy::Level;   // PriceLevel, or a ring-queue level for RingLevels
+  using BidLevels = typename LevelPolicy::template Levels<OrderSide::Buy>;
+  using AskLevels = typename LevelPolicy::template Levels<OrderSide::Sell>;
+
   // Data members
-  std::map<Price, OrderPointers, std::greater<Price>> bids_ ; // Map of price levels to lists of buy orders (highest price first), std::greater for descending order
-  std::map<Price, OrderPointers, std::less<Price>> asks_ ; // Map of price levels to lists of sell orders (lowest price first)  
-  std::unordered_map<OrderId, OrderEntry> order_map_ ; // Map of OrderId to OrderEntry for quick access
+  OrderPool pool_ ; // Storage for every resting order
+  BidLevels bids_ ; // Price levels of buy orders (highest price first)
+  AskLevels asks_ ; // Price levels of sell orders (lowest price first)
+  OrderIdMap<OrderEntry> order_map_ ; // Flat open-addressing map of OrderId to OrderEntry for quick access
+  BookMetrics metrics_ ; // Hot-path timings and counters; empty unless built with ORDERBOOK_METRICS (see book_metrics.h)
+  TimingWheel expiries_ ; // Timers of resting timed orders, keyed by pool handle; holds the book's clock
+  Timestamp session_close_ {0} ; // Expiry given to day orders
+  std::uint64_t top_versions_[2] {} ; // Per side (buy, sell): changes at or better than the watch price, see TopVersion
+  Price top_watches_[2] {SideTraits<OrderSide::Sell>::kMarketLimit, SideTraits<OrderSide::Buy>::kMarketLimit} ; // Deepest level last read by GetTopLevels; worst price until then
+  std::uint64_t depth_hashes_[2] {} ; // Per side (buy, sell): XOR of LevelHash over the side's levels, see DepthHash
+
+  // Levels of one side, picked at compile time
+  template <OrderSide Side>
+  auto& LevelsFor(){
+   if constexpr (Side == OrderSide::Buy){
+    return bids_;
+   }
+   else {
+    return asks_;
+   }
+  }
+
+  template <OrderSide Side>
+  const auto& LevelsFor() const {
+   if constexpr (Side == OrderSide::Buy){
+    return bids_;
+   }
+   else {
+    return asks_;
+   }
+  }
 
   // Match method to match incoming orders against existing orders
   // Canmatch: FOK orders only match if they can be fully filled immediately
-  bool CanMatch(OrderSide side, Price price)const 
-  {
-  if (side == OrderSide::Buy) {
-       if (asks_.empty()) {
-           return false; // No asks available to match
-       }
-       // Check if price >= best ask price
-       const auto& best_ask = asks_.begin(); // Lowest ask price
-       return price >= best_ask->first;
-  }
-  else 
+  template <OrderSide Side>
+  bool CanMatch(Price price) const 
   {
-  if (bids_.empty()) {
-       return false; // No bids available to match
-   } 
-   const auto& best_bid = bids_.begin(); // Highest bid price
-    return price <= best_bid->first;
+   const auto& opposite = LevelsFor<SideTraits<Side>::kOpposite>();
+   if (opposite.Empty()){
+    return false; // Nothing to trade against
+   }
+   return SideTraits<Side>::Crosses(price, opposite.Best().price); // Buy: price >= best ask, sell: price <= best bid
+ }
+
+ // Unlink a filled or cancelled order from the index and return its slot to the pool
+ void ReleaseOrder(OrderHandle handle){
+  order_map_.Erase(pool_[handle].GetOrderId());
+  Disarm(handle);
+  pool_.Release(handle);
+ }
+
+ // Stop the expiry timer of an order leaving the book (a no-op once the timer has fired)
+ void Disarm(OrderHandle handle){
+  if (IsTimed(pool_[handle].GetOrderType())){
+   expiries_.Cancel(handle);
+  }
+ }
+
+ // Expiry of a timed order: the session close for a day order, `expiry` for good-till-date
+ Timestamp ExpiryOf(OrderType type, Timestamp expiry) const { return type == OrderType::Day ? session_close_ : expiry; }
+
+ // Record a change to one side's level at `price`. Levels worse than the deepest one the top-level reader holds cannot
+ // change what it read, so they do not bump the version.
+ template <OrderSide Side>
+ void TouchLevel(Price price){
+  constexpr std::size_t side = Side == OrderSide::Buy ? 0 : 1;
+  if (!SideTraits<Side>::Better(top_watches_[side], price)){
+   ++top_versions_[side];
+  }
+ }
+
+ // Fold a change of one level's aggregate quantity into its side's depth hash (quantity 0: no level)
+ void RehashLevel(OrderSide side, Price price, Quantity before, Quantity after){
+  depth_hashes_[side == OrderSide::Buy ? 0 : 1] ^= LevelHash(side, price, before) ^ LevelHash(side, price, after);
+ }
+
+ void TouchLevel(const Order& order){
+  if (order.GetOrderSide() == OrderSide::Buy){
+   TouchLevel<OrderSide::Buy>(order.GetPrice());
+  }
+  else {
+   TouchLevel<OrderSide::Sell>(order.GetPrice());
   }
  }
+
+ // Level insert and removal go through these three so that metrics can time them
+ template <OrderSide Side>
+ Level& GetOrCreateLevel(Price price){
+  auto& levels = LevelsFor<Side>();
+  if constexpr (BookMetrics::kEnabled){
+   std::size_t before = levels.Size();
+   bool sampled = metrics_.Sample(BookOp::LevelCreate);
+   std::uint64_t start = sampled ? TscClock::Now() : 0;
+   Level& level = levels.GetOrCreate(price);
+   if (levels.Size() != before){ // Finding an existing level is not a create and is not recorded
+    if (sampled){
+     metrics_.Record(BookOp::LevelCreate, TscClock::Now() - start);
+    }
+    metrics_.Count(BookCounter::LevelsCreated);
+   }
+   return level;
+  }
+  else {
+   return levels.GetOrCreate(price);
+  }
+ }
+
+ template <typename Levels>
+ void EraseLevel(Levels& levels, Price price){
+  auto timer = metrics_.Time(BookOp::LevelErase);
+  levels.Erase(price);
+  metrics_.Count(BookCounter::LevelsErased);
+ }
+
+ template <typename Levels>
+ void EraseBestLevel(Levels& levels){
+  auto timer = metrics_.Time(BookOp::LevelErase);
+  levels.EraseBest();
+  metrics_.Count(BookCounter::LevelsErased);
+ }
  
  
  
 
- // Match method to match incoming orders against existing orders
- 
- Trades MatchOrders()
- {
-  Trades trades;
-  trades.reserve(order_map_.size()); // Pre-allocate space for trades to minimize reallocations with empty vector 
-  
-  while(true){
-   if (bids_.empty() || asks_.empty()){
-    break; // No more possible matches
-   }
+ // Fill the front orders of two crossing levels against each other until one level is empty, all at `price`
+ template <OrderSide Aggressor, typename Sink>
+ void MatchLevels(Level& bid_level, Level& ask_level, Price price, bool auction, Sink& sink){
+  constexpr bool buy_aggressor = Aggressor == OrderSide::Buy;
+  TouchLevel<OrderSide::Buy>(bid_level.price);
+  TouchLevel<OrderSide::Sell>(ask_level.price);
+  Quantity bid_before = bid_level.total_quantity;
+  Quantity ask_before = ask_level.total_quantity;
+  while (!bid_level.orders.empty() && !ask_level.orders.empty()){
+   OrderHandle bid_handle = bid_level.orders.front(); // get the first order at the best bid price
+   OrderHandle ask_handle = ask_level.orders.front(); // get the first order at the best ask price
+   Order& bid = pool_[bid_handle];
+   Order& ask = pool_[ask_handle];
+   
+   Quantity quantity = std::min(bid.GetRemainingQuantity(), ask.GetRemainingQuantity()); // eg; Bid wants 100, Ask wants 70 → trade 70
+   
+   // Fill both orders
+   bid.Fill(quantity);  
+   ask.Fill(quantity);  
+   bid_level.total_quantity -= quantity;
+   ask_level.total_quantity -= quantity;
 
-   // Get best prices
-   auto& [bid_price, bid_orders] = *bids_.begin(); 
-   auto& [ask_price, ask_orders] = *asks_.begin(); 
+   sink.OnFill(FillEvent{
+    buy_aggressor ? ask.GetOrderId() : bid.GetOrderId(),
+    buy_aggressor ? bid.GetOrderId() : ask.GetOrderId(),
+    price,
+    quantity,
+    Aggressor,
+    auction
+   });
+   
+   // remove filled orders from order book and index
+   if (bid.IsFilled())
+   {
+       bid_level.orders.pop_front(pool_);
+       --bid_level.order_count;
+       ReleaseOrder(bid_handle);
+   }
+   if (ask.IsFilled())
+   {
+       ask_level.orders.pop_front(pool_);
+       --ask_level.order_count;
+       ReleaseOrder(ask_handle);
+   }
+  }
+  RehashLevel(OrderSide::Buy, bid_level.price, bid_before, bid_level.total_quantity); // Once per level, not per fill
+  RehashLevel(OrderSide::Sell, ask_level.price, ask_before, ask_level.total_quantity);
+ }
 
-   if (bid_price < ask_price){
-    break;  // Prices don't cross - no match possible
+ // Sweep kernel for an aggressive order: walk the opposite levels best first while they cross `limit`, filling their
+ // FIFO queues at each level's price, and erase each emptied level at the best position. One pass, however many levels it
+ // crosses. The taker itself is not in the book. Returns its unfilled quantity.
+ template <OrderSide Side, typename Sink>
+ Quantity Sweep(OrderId taker_id, Price limit, Quantity quantity, Sink& sink){
+  auto timer = metrics_.Time(BookOp::Match);
+  std::uint64_t matched = 0;
+  auto& opposite = LevelsFor<SideTraits<Side>::kOpposite>();
+  while (quantity > 0 && !opposite.Empty()){
+   Level& level = opposite.Best();
+   if (!SideTraits<Side>::Crosses(limit, level.price)){
+    break;
    }
-   
-   while (!bid_orders.empty() && !ask_orders.empty()){
-    auto& bid = bid_orders.front(); // get the first order at the best bid price
-    auto& ask = ask_orders.front(); // get the first order at the best ask price
-    
-    Quantity quantity = std::min(bid->GetRemainingQuantity(), ask->GetRemainingQuantity()); // eg; Bid wants 100, Ask wants 70 → trade 70
-    
-    // Fill both orders
-    bid->Fill(quantity);  
-    ask->Fill(quantity);  
-    
-    // remove filled orders from order book
-    if (bid->IsFilled())
-    {
-        bid_orders.pop_front();
-    }
-    if (ask->IsFilled())
-    {
-        ask_orders.pop_front();
-    }
-    
-    // Remove price levels if no orders remain
-    if (bid_orders.empty())
-    {
-        bids_.erase(bid_price);
-    }
-    if (ask_orders.empty())
-    {
-        asks_.erase(ask_price);
+   TouchLevel<SideTraits<Side>::kOpposite>(level.price);
+   Quantity before = level.total_quantity;
+   while (quantity > 0 && !level.orders.empty()){
+    OrderHandle maker_handle = level.orders.front();
+    Order& maker = pool_[maker_handle];
+    Quantity fill = std::min(quantity, maker.GetRemainingQuantity());
+    maker.Fill(fill);
+    quantity -= fill;
+    level.total_quantity -= fill;
+    sink.OnFill(FillEvent{maker.GetOrderId(), taker_id, level.price, fill, Side});
+    ++matched;
+    if (maker.IsFilled()){
+     level.orders.pop_front(pool_);
+     --level.order_count;
+     ReleaseOrder(maker_handle);
     }
+   }
+   RehashLevel(SideTraits<Side>::kOpposite, level.price, before, level.total_quantity);
+   if (level.orders.empty()){
+    EraseBestLevel(opposite);
+   }
+  }
+  metrics_.RecordSweep(matched);
+  return quantity;
+ }
 
-    // Create a trade object and add to trades vector
-    trades.push_back(Trade(
-     TradeInfo{bid->GetOrderId(), ask->GetOrderId(), ask_price, quantity },
-     TradeInfo{ask->GetOrderId(), bid->GetOrderId(), bid_price, quantity }
-    ));
- }  
-
- if (!bids_.empty()){
-    auto& [bid_price_level, bid_orders_level] = *bids_.begin();
-    auto& Order = bid_orders_level.front();
-    if (Order->GetOrderType() == OrderType::Fillandkill){
-        CancelOrder(Order->GetOrderId()); // Implement CancelOrder method to remove order from order book
-    }
+ // Fill-or-kill feasibility: is there at least `quantity` on the opposite side at prices crossing `limit`?
+ // Reads the level aggregates only, best first, stopping as soon as the answer is known.
+ template <OrderSide Side>
+ bool CanFill(Price limit, Quantity quantity) const {
+  std::uint64_t available = 0;
+  LevelsFor<SideTraits<Side>::kOpposite>().ForEachLevel([&](const Level& level){
+   if (!SideTraits<Side>::Crosses(limit, level.price)){
+    return false;
+   }
+   available += level.total_quantity;
+   return available < quantity;
+  });
+  return available >= quantity;
  }
- if (!asks_.empty()){
-    auto& [ask_price_level, ask_orders_level] = *asks_.begin();
-    auto& Order = ask_orders_level.front();
-    if (Order->GetOrderType() == OrderType::Fillandkill){
-        CancelOrder(Order->GetOrderId()); // Implement CancelOrder method to remove order from order book
-    } 
-  } 
-}
-return trades;
-} // End MatchOrders method
 
 
 public:
 
- Trades ProcessNewOrder(OrderPointer order){
-  if (order_map_.find(order->GetOrderId()) != order_map_.end()){
-   return {}; // Break if duplicate order id's
+ // capacity_hint: expected peak number of resting orders, preallocated up front
+ explicit BasicOrderBook(const LevelConfig& config = {}, std::size_t capacity_hint = 0):
+  pool_ {capacity_hint},
+  bids_ {config},
+  asks_ {config},
+  order_map_ {capacity_hint},
+  expiries_ {1, capacity_hint}
+ { }
+
+ std::size_t Size() const { return order_map_.Size(); }
+
+ // Number of price levels on one side
+ std::size_t LevelCount(OrderSide side) const { return side == OrderSide::Buy ? bids_.Size() : asks_.Size(); }
+
+ // Whether an order of this side may rest at `price`: always for map levels; on the tick grid and within the ladder's
+ // maximum window of the resting levels for a ladder. A new order, batch order or modify at a refused price is
+ // rejected through the sink with RejectReason::InvalidPrice and changes nothing; Restore throws std::logic_error.
+ bool AdmitsPrice(OrderSide side, Price price) const { return side == OrderSide::Buy ? bids_.Admits(price) : asks_.Admits(price); }
+
+ // Hot-path timings and counters, readable from any thread while the book runs (all zero unless built with
+ // ORDERBOOK_METRICS=1, see book_metrics.h)
+ void ReadMetrics(MetricsSnapshot& out) const { metrics_.Read(out); }
+
+ // Resting order by id, or nullptr if it is not in the book (filled, cancelled or never added)
+ const Order* FindOrder(OrderId order_id) const {
+  const OrderEntry* entry = order_map_.Find(order_id);
+  return entry == nullptr ? nullptr : &pool_[entry->handle_];
+ }
+
+ // A crossing order first sweeps the opposite side; a good-till-cancel remainder is then copied into the pool and rests.
+ // Immediate orders (fill-and-kill, fill-or-kill, market) never enter the book.
+ // Outcomes (accept/reject, fills, immediate remainder cancel) go to sink; returns whether the order was accepted.
+ template <typename Sink>
+ bool ProcessNewOrder(const Order& order, Sink& sink){ return ProcessNewOrder(order, 0, sink); }
+
+ // Same, with the expiry time of a good-till-date order (ignored for other types). A timed order whose expiry is not
+ // after Now() is rejected with RejectReason::Expired; so is a good-till-date order submitted without an expiry.
+ template <typename Sink>
+ bool ProcessNewOrder(const Order& order, Timestamp expiry, Sink& sink){
+  auto timer = metrics_.Time(BookOp::Add);
+  // The only runtime side test on this path: everything below is generated per side
+  return order.GetOrderSide() == OrderSide::Buy
+   ? AddOrder<OrderSide::Buy>(order, expiry, sink)
+   : AddOrder<OrderSide::Sell>(order, expiry, sink);
+ }
+
+ // Call auction: insert every order in the batch without matching, then uncross once at the single price that executes
+ // the most volume (see Uncross). Duplicate ids are rejected as in ProcessNewOrder. Fill-and-kill orders take part in the
+ // uncross and any unfilled remainder is cancelled afterwards; fill-or-kill and market orders are rejected. Day orders
+ // rest until the session close; good-till-date orders are rejected as Expired, since a batch carries no expiry times.
+ template <typename Sink>
+ AuctionResult ProcessBatch(const Order* orders, std::size_t count, Sink& sink){
+  AuctionResult result;
+  bool has_fill_and_kill = false;
+  for (std::size_t i = 0; i < count; ++i){
+   const Order& order = orders[i];
+   if (order.GetOrderType() == OrderType::Fillorkill || order.GetOrderType() == OrderType::Market){
+    sink.OnRejected(order, RejectReason::NotInAuction);
+    continue;
+   }
+   Timestamp expiry = ExpiryOf(order.GetOrderType(), 0);
+   if (IsTimed(order.GetOrderType()) && expiry <= Now()){
+    sink.OnRejected(order, RejectReason::Expired); // Only day orders can take part: a batch carries no expiry times
+    continue;
+   }
+   if (!AdmitsPrice(order.GetOrderSide(), order.GetPrice())){
+    sink.OnRejected(order, RejectReason::InvalidPrice); // Only this order: the rest of the batch still uncrosses
+    continue;
+   }
+   auto [entry, inserted] = order_map_.TryEmplace(order.GetOrderId());
+   if (!inserted){
+    metrics_.Count(BookCounter::DuplicatesRejected);
+    sink.OnRejected(order, RejectReason::DuplicateOrderId);
+    continue;
+   }
+   sink.OnAccepted(order);
+   if (order.GetOrderSide() == OrderSide::Buy){
+    Rest<OrderSide::Buy>(order, order.GetRemainingQuantity(), *entry, expiry);
+   }
+   else {
+    Rest<OrderSide::Sell>(order, order.GetRemainingQuantity(), *entry, expiry);
+   }
+   has_fill_and_kill |= order.GetOrderType() == OrderType::Fillandkill;
+   ++result.accepted;
   }
+  AuctionResult uncross = Uncross(sink);
+  result.clearing_price = uncross.clearing_price;
+  result.volume = uncross.volume;
+  if (has_fill_and_kill){
+   for (std::size_t i = 0; i < count; ++i){
+    const Order* resting = FindOrder(orders[i].GetOrderId());
+    if (resting != nullptr && resting->GetOrderType() == OrderType::Fillandkill){
+     TryCancelOrder(orders[i].GetOrderId(), sink);
+    }
+   }
+  }
+  return result;
+ }
 
-  if (order->GetOrderType() == OrderType::Fillandkill && !CanMatch(order->GetOrderSide(), order->GetPrice())){
-   return {}; // FOK order cannot be matched, so ignore it
+ template <typename Sink>
+ AuctionResult ProcessBatch(const std::vector<Order>& orders, Sink& sink){ return ProcessBatch(orders.data(), orders.size(), sink); }
+
+ AuctionResult ProcessBatch(const std::vector<Order>& orders){
+  BookEventSink sink;
+  return ProcessBatch(orders.data(), orders.size(), sink);
+ }
+
+ // Clearing price and volume the book would uncross at now, without trading (the indicative auction price).
+ // The clearing price is the level price that maximises executable volume min(demand at or above p, supply at or below p);
+ // ties go to the smallest imbalance between the two, then to the middle of the remaining candidates.
+ // Volume is 0 if the book is not crossed.
+ AuctionResult IndicativeUncross() const {
+  AuctionResult result;
+  if (bids_.Empty() || asks_.Empty() || bids_.Best().price < asks_.Best().price){
+   return result;
   }
+  Price low = asks_.Best().price;
+  Price high = bids_.Best().price;
+  std::vector<AuctionLevel>& levels = auction_levels_;
+  levels.clear();
+  std::uint64_t demand = 0;
+  bids_.ForEachLevel([&](const Level& level){
+   if (level.price < low){
+    return false; // Cannot trade with any ask
+   }
+   levels.push_back(AuctionLevel{level.price, level.total_quantity, 0});
+   demand += level.total_quantity;
+   return true;
+  });
+  asks_.ForEachLevel([&](const Level& level){
+   if (level.price > high){
+    return false;
+   }
+   levels.push_back(AuctionLevel{level.price, 0, level.total_quantity});
+   return true;
+  });
+  std::sort(levels.begin(), levels.end(), [](const AuctionLevel& lhs, const AuctionLevel& rhs){ return lhs.price < rhs.price; });
 
-  OrderPointers::iterator iterator;
+  // Walk prices upwards: supply accumulates the asks at or below p, demand drops the bids below p
+  std::uint64_t supply = 0;
+  std::uint64_t best_volume = 0;
+  std::uint64_t best_imbalance = UINT64_MAX;
+  std::size_t candidates = 0;
+  for (std::size_t i = 0; i < levels.size(); ){
+   Price price = levels[i].price;
+   std::uint64_t bids_here = 0;
+   for (; i < levels.size() && levels[i].price == price; ++i){ // A price can be both a bid and an ask level
+    supply += levels[i].ask_quantity;
+    bids_here += levels[i].bid_quantity;
+   }
+   std::uint64_t volume = std::min(demand, supply);
+   std::uint64_t imbalance = demand > supply ? demand - supply : supply - demand;
+   if (volume > best_volume || (volume == best_volume && imbalance < best_imbalance)){
+    best_volume = volume;
+    best_imbalance = imbalance;
+    candidates = 0;
+   }
+   if (volume == best_volume && imbalance == best_imbalance){
+    levels[candidates++].price = price; // Reuse the scanned prefix to keep the tied prices
+   }
+   demand -= bids_here;
+  }
+  result.clearing_price = levels[(candidates - 1) / 2].price;
+  result.volume = best_volume;
+  return result;
+ }
 
-  if (order->GetOrderSide() == OrderSide::Buy){
-   auto& orders = bids_[order->GetPrice()]; // Access or create list of orders at this price level
-   orders.push_back(order); // Add order to the list
-   iterator = std::prev(orders.end()); // Get iterator to the newly added order
+ // Execute the auction uncross: every bid at or above the clearing price trades against every ask at or below it, in
+ // price-time priority, all at the clearing price. The book is left uncrossed.
+ template <typename Sink>
+ AuctionResult Uncross(Sink& sink){
+  AuctionResult result = IndicativeUncross();
+  if (result.volume == 0){
+   return result;
   }
-  else {
-   auto& orders = asks_[order->GetPrice()]; // Access or create list of orders at this price level
-   orders.push_back(order); // Add order to the list
-   iterator = std::prev(orders .end()); // Get iterator to the newly added order
+  Price price = result.clearing_price;
+  while (!bids_.Empty() && !asks_.Empty() && bids_.Best().price >= price && asks_.Best().price <= price){
+   Level& bid_level = bids_.Best();
+   Level& ask_level = asks_.Best();
+   MatchLevels<OrderSide::Buy>(bid_level, ask_level, price, true, sink);
+   if (bid_level.orders.empty()){
+    EraseBestLevel(bids_);
+   }
+   if (ask_level.orders.empty()){
+    EraseBestLevel(asks_);
+   }
   }
-  order_map_.insert({order->GetOrderId(), OrderEntry{order, iterator}}); // Insert into order map for quick access
-  return MatchOrders(); // Attempt to match orders after adding the new order
+  return result;
+ }
+
+ AuctionResult Uncross(){
+  BookEventSink sink;
+  return Uncross(sink);
+ }
+
+ // Trades-returning adapter; the vector only allocates when something trades
+ Trades ProcessNewOrder(const Order& order){
+  Trades trades;
+  TradesSink sink(trades, order.GetPrice());
+  ProcessNewOrder(order, sink);
+  return trades;
+ }
+
+ // Adapter for callers that still build orders with std::make_shared
+ Trades ProcessNewOrder(const OrderPointer& order){
+  return ProcessNewOrder(*order);
  }
 
 
 
 void CancelOrder(OrderId order_id){
- if (order_map_.find(order_id) == order_map_.end()){
+ if (!TryCancelOrder(order_id)){
    throw std::logic_error("CancelOrder: Order ID " + std::to_string(order_id) + " does not exist");
  }
- const auto& [order, orderiterator] = order_map_.at(order_id);
- order_map_.erase(order_id);
+}
+
+ // Non-throwing cancel for feeds that may reference orders we never saw; returns false if the id is unknown
+ template <typename Sink>
+ bool TryCancelOrder(OrderId order_id, Sink& sink){
+  auto timer = metrics_.Time(BookOp::Cancel);
+  OrderEntry entry;
+  if (!order_map_.Extract(order_id, entry)){ // One probe: find and erase
+   return false;
+  }
+  sink.OnCancelled(order_id, pool_[entry.handle_].GetRemainingQuantity());
+  RemoveFromLevel(entry.handle_);
+  return true;
+ }
+
+ bool TryCancelOrder(OrderId order_id){
+  BookEventSink sink;
+  return TryCancelOrder(order_id, sink);
+ }
+
+ // Order expiry. The book's clock moves only through AdvanceTime, in whatever unit the caller uses for expiry times.
+ // Day orders take the session close in force when they are accepted.
+ void SetSessionClose(Timestamp close){ session_close_ = close; }
+ Timestamp SessionClose() const { return session_close_; }
+ Timestamp Now() const { return expiries_.Now(); }
+ std::size_t TimedOrders() const { return expiries_.Size(); }   // Resting good-till-date and day orders
+
+ // Expiry of a resting timed order (for a day order, the session close when it was accepted); 0 for any other order
+ Timestamp GetExpiry(OrderId order_id) const {
+  const OrderEntry* entry = order_map_.Find(order_id);
+  return entry == nullptr ? 0 : expiries_.Expiry(entry->handle_);
+ }
+
+ // Move the clock to `now` and cancel every timed order due by then, through the same path as TryCancelOrder
+ // (OnCancelled with the remaining quantity). Amortized O(1) per expired order, whatever the time jump. Returns how
+ // many expired.
+ template <typename Sink>
+ std::size_t AdvanceTime(Timestamp now, Sink& sink){
+  return expiries_.Advance(now, [this, &sink](OrderHandle handle){ TryCancelOrder(pool_[handle].GetOrderId(), sink); });
+ }
+
+ std::size_t AdvanceTime(Timestamp now){
+  BookEventSink sink;
+  return AdvanceTime(now, sink);
+ }
+
+ // Mass cancels, for a kill switch or a session reset. Each returns how many orders it cancelled, each of which gets
+ // OnCancelled with its remaining quantity. O(levels + orders cancelled):
+ //  - Each level in scope is drained in one pass and erased once: its orders' timers are stopped and their slots and
+ //    index entries freed, but they are never unlinked from the queue or taken off the level's totals. Events come
+ //    best level first, oldest order first within a level.
+ //  - A cancel that empties the book does not walk the queues, whose links lead from one cache miss to the next.
+ //    It visits the orders in index order instead (a sequential pass; their pool reads do not depend on each other),
+ //    then erases the levels, resets the pool and clears the index. Orders are not visited at all when there are
+ //    neither events to send (the no-op BookEventSink) nor timers to stop. Used while the index has at most
+ //    kIndexClearRatio slots per order, so the pass stays proportional to the orders.
+ template <typename Sink>
+ std::size_t CancelAll(Sink& sink){
+  if (IndexClearCheap()){
+   return ClearBook(sink);
+  }
+  return DrainSide<OrderSide::Buy>(sink) + DrainSide<OrderSide::Sell>(sink);
+ }
+
+ std::size_t CancelAll(){
+  BookEventSink sink;
+  return CancelAll(sink);
+ }
+
+ template <typename Sink>
+ std::size_t CancelSide(OrderSide side, Sink& sink){
+  return side == OrderSide::Buy ? CancelSide<OrderSide::Buy>(sink) : CancelSide<OrderSide::Sell>(sink);
+ }
+
+ std::size_t CancelSide(OrderSide side){
+  BookEventSink sink;
+  return CancelSide(side, sink);
+ }
+
+ // Orders of one side priced from low to high inclusive
+ template <typename Sink>
+ std::size_t CancelRange(OrderSide side, Price low, Price high, Sink& sink){
+  return side == OrderSide::Buy ? CancelRange<OrderSide::Buy>(low, high, sink) : CancelRange<OrderSide::Sell>(low, high, sink);
+ }
 
- if (order->GetOrderSide() == OrderSide::Buy){
-   auto& orders = bids_[order->GetPrice()]; // Access list of orders at this price level
-   orders.erase(orderiterator); // Remove order from the list at its price level
-   if (orders.empty()){
-       bids_.erase(order->GetPrice()); // Remove price level if no orders remain
+ std::size_t CancelRange(OrderSide side, Price low, Price high){
+  BookEventSink sink;
+  return CancelRange(side, low, high, sink);
+ }
+
+ // Amend a resting order from a replace message. The order keeps its id, type and pool slot; quantity is its new
+ // remaining quantity, and 0 cancels it. Returns false if the id is unknown.
+ //  - Same side and price, smaller quantity: shrinks in place in O(1) and keeps its queue position.
+ //  - Same side and price, larger quantity: moves to the back of the same level's queue.
+ //  - New price or side: relinked at the back of its new level without reallocating the order or touching the index,
+ //    and trades like a new arrival if it now crosses.
+ // Every change is reported with OnModified (the new terms); an unchanged modify reports nothing. A new price the
+ // levels refuse (see AdmitsPrice) is reported with OnRejected and InvalidPrice, and the order stays as it was.
+ template <typename Sink>
+ bool Modify(const ModifyOrder& modify, Sink& sink){
+  OrderEntry* entry = order_map_.Find(modify.GetOrderId());
+  if (entry == nullptr){
+   return false;
+  }
+  if (modify.GetQuantity() == 0){
+   return TryCancelOrder(modify.GetOrderId(), sink);
+  }
+  OrderHandle handle = entry->handle_;
+  Order& order = pool_[handle];
+  if (order.GetOrderSide() == modify.GetOrderSide() && order.GetPrice() == modify.GetPrice()){
+   Level& level = LevelOf(order);
+   Quantity remaining = order.GetRemainingQuantity();
+   if (modify.GetQuantity() == remaining){
+    return true; // Nothing to change
+   }
+   if (modify.GetQuantity() < remaining){
+    order.Reduce(remaining - modify.GetQuantity());
+   }
+   else {
+    level.orders.erase(pool_, handle); // Larger size at the same price: to the back of the same queue, no level churn
+    level.orders.push_back(pool_, handle);
+    order.Amend(order.GetOrderSide(), order.GetPrice(), modify.GetQuantity());
+   }
+   Quantity total = level.total_quantity - remaining + modify.GetQuantity();
+   RehashLevel(order.GetOrderSide(), order.GetPrice(), level.total_quantity, total);
+   level.total_quantity = total;
+   TouchLevel(order);
+   sink.OnModified(order);
+   return true;
+  }
+  if (!AdmitsPrice(modify.GetOrderSide(), modify.GetPrice())){
+   sink.OnRejected(modify.toOrder(), RejectReason::InvalidPrice); // Checked before unlinking: the order stays where it was
+   return true;
+  }
+  UnlinkFromLevel(handle);
+  order.Amend(modify.GetOrderSide(), modify.GetPrice(), modify.GetQuantity());
+  if (modify.GetOrderSide() == OrderSide::Buy){
+   Relink<OrderSide::Buy>(handle, sink);
+  }
+  else {
+   Relink<OrderSide::Sell>(handle, sink);
+  }
+  return true;
+ }
+
+ bool Modify(const ModifyOrder& modify){
+  BookEventSink sink;
+  return Modify(modify, sink);
+ }
+
+ // Partial cancellation: shrink the order in place, keeping its queue position. Cancelling the whole remainder removes it.
+ // Reported as OnModified with the new remaining quantity, or OnCancelled once nothing is left. Returns false if the id is unknown.
+ template <typename Sink>
+ bool ReduceOrder(OrderId order_id, Quantity quantity, Sink& sink){
+  OrderEntry* entry = order_map_.Find(order_id);
+  if (entry == nullptr){
+   return false;
+  }
+  Order& order = pool_[entry->handle_];
+  if (quantity >= order.GetRemainingQuantity()){
+   return TryCancelOrder(order_id, sink);
+  }
+  order.Reduce(quantity);
+  ReduceLevel(order, quantity);
+  TouchLevel(order);
+  sink.OnModified(order);
+  return true;
+ }
+
+ bool ReduceOrder(OrderId order_id, Quantity quantity){
+  BookEventSink sink;
+  return ReduceOrder(order_id, quantity, sink);
+ }
+
+ // Execute a resting order directly, e.g. when replaying an exchange execution whose aggressor is not in the feed.
+ // executed is set to the quantity filled, at most the order's remainder; a fully executed order leaves the book, and
+ // a zero quantity changes and reports nothing. Returns false if the id is unknown.
+ template <typename Sink>
+ bool ExecuteOrder(OrderId order_id, Quantity quantity, Sink& sink, Quantity& executed){
+  executed = 0;
+  OrderEntry* entry = order_map_.Find(order_id);
+  if (entry == nullptr){
+   return false;
+  }
+  OrderHandle handle = entry->handle_;
+  Order& order = pool_[handle];
+  quantity = std::min(quantity, order.GetRemainingQuantity());
+  if (quantity == 0){
+   return true;
+  }
+  order.Fill(quantity);
+  ReduceLevel(order, quantity);
+  TouchLevel(order);
+  OrderSide aggressor_side = order.GetOrderSide() == OrderSide::Buy ? OrderSide::Sell : OrderSide::Buy;
+  sink.OnFill(FillEvent{order_id, 0, order.GetPrice(), quantity, aggressor_side});
+  if (order.IsFilled()){
+   order_map_.Erase(order_id);
+   RemoveFromLevel(handle);
+  }
+  executed = quantity;
+  return true;
+ }
+
+ template <typename Sink>
+ bool ExecuteOrder(OrderId order_id, Quantity quantity, Sink& sink){
+  Quantity executed = 0;
+  return ExecuteOrder(order_id, quantity, sink, executed);
+ }
+
+ bool ExecuteOrder(OrderId order_id, Quantity quantity){
+  BookEventSink sink;
+  return ExecuteOrder(order_id, quantity, sink);
+ }
+
+ // Top `levels` price levels per side, best first, written into out (previous contents are discarded).
+ // O(levels) from the maintained level aggregates; once out has grown to the requested depth it is refilled without allocating.
+ void GetDepth(std::size_t levels, OrderBookLevelInfos& out) const {
+  FillLevels(bids_, levels, out.getBids());
+  FillLevels(asks_, levels, out.getAsks());
+ }
+
+ OrderBookLevelInfos GetDepth(std::size_t levels) const {
+  OrderBookLevelInfos depth;
+  GetDepth(levels, depth);
+  return depth;
+ }
+
+ // Every price level on both sides
+ void GetSnapshot(OrderBookLevelInfos& out) const { GetDepth(SIZE_MAX, out); }
+
+ OrderBookLevelInfos GetSnapshot() const { return GetDepth(SIZE_MAX); }
+
+ // Best level of one side; returns false if that side is empty
+ bool GetBestLevel(OrderSide side, LevelInfo& out) const {
+  const Level* level = nullptr;
+  if (side == OrderSide::Buy){
+   level = bids_.Empty() ? nullptr : &bids_.Best();
+  }
+  else {
+   level = asks_.Empty() ? nullptr : &asks_.Best();
+  }
+  if (level == nullptr){
+   return false;
+  }
+  out = LevelInfo{level->price, level->total_quantity, level->order_count};
+  return true;
+ }
+
+ // Top `levels` levels of one side, best first, as parallel price and quantity arrays; returns how many were written.
+ // The deepest level written becomes the side's watch price for TopVersion, so a book serves one such reader.
+ std::size_t GetTopLevels(OrderSide side, std::size_t levels, Price* prices, Quantity* quantities){
+  return side == OrderSide::Buy ? FillTopLevels<OrderSide::Buy>(levels, prices, quantities) : FillTopLevels<OrderSide::Sell>(levels, prices, quantities);
+ }
+
+ // Change count of one side's top levels: bumped by every change to a level at or better than the deepest level the
+ // last GetTopLevels call wrote, and by every change before the first call. While it is unchanged, the levels read
+ // are still the side's top levels.
+ std::uint64_t TopVersion(OrderSide side) const { return top_versions_[side == OrderSide::Buy ? 0 : 1]; }
+
+ // Rolling hash of every level of one side, or of both: the XOR of LevelHash(side, price, aggregate quantity) over
+ // the levels (book_hash.h), kept up to date in O(1) on every add, fill, reduce and cancel. Books with the same depth
+ // have the same hash, so comparing two books, or a book with a depth snapshot, is one comparison.
+ std::uint64_t DepthHash(OrderSide side) const { return depth_hashes_[side == OrderSide::Buy ? 0 : 1]; }
+ std::uint64_t DepthHash() const { return depth_hashes_[0] ^ depth_hashes_[1]; }
+
+ // Every resting order of one side in priority order: levels best first, each level's queue oldest first.
+ // fn(level, const Order&) is called once per order with the order's price level; used to serialize the book (see checkpoint.h).
+ template <typename Fn>
+ void ForEachOrder(OrderSide side, Fn&& fn) const {
+  auto visit = [this, &fn](const Level& level){
+   level.orders.ForEach(pool_, [&](OrderHandle handle){ fn(level, pool_[handle]); });
+   return true;
+  };
+  if (side == OrderSide::Buy){
+   bids_.ForEachLevel(visit);
+  }
+  else {
+   asks_.ForEachLevel(visit);
+  }
+ }
+
+ // Append a resting order at the back of its level without matching or reporting anything, e.g. when reloading a
+ // checkpoint; its filled quantity is kept. A good-till-date or day order is armed to expire at `expiry` (set the
+ // clock with AdvanceTime first). Throws std::logic_error for an immediate or filled order, a timed order whose expiry
+ // is not after Now(), a duplicate id, a price that crosses the opposite side or one the levels refuse (see AdmitsPrice).
+ void Restore(const Order& order, Timestamp expiry = 0){
+  if (!RestsInBook(order.GetOrderType()) || order.IsFilled()){
+   throw std::logic_error("OrderBook: only unfilled resting orders can be restored");
+  }
+  if (IsTimed(order.GetOrderType()) && expiry <= Now()){
+   throw std::logic_error("OrderBook: restored order " + std::to_string(order.GetOrderId()) + " has already expired");
+  }
+  bool crosses = order.GetOrderSide() == OrderSide::Buy ? CanMatch<OrderSide::Buy>(order.GetPrice()) : CanMatch<OrderSide::Sell>(order.GetPrice());
+  if (crosses){
+   throw std::logic_error("OrderBook: restored order " + std::to_string(order.GetOrderId()) + " crosses the book");
+  }
+  CheckPrice(order.GetOrderSide(), order.GetPrice());
+  auto [entry, inserted] = order_map_.TryEmplace(order.GetOrderId());
+  if (!inserted){
+   throw std::logic_error("OrderBook: restored order " + std::to_string(order.GetOrderId()) + " is already in the book");
+  }
+  if (order.GetOrderSide() == OrderSide::Buy){
+   Rest<OrderSide::Buy>(order, order.GetRemainingQuantity(), *entry, expiry);
+  }
+  else {
+   Rest<OrderSide::Sell>(order, order.GetRemainingQuantity(), *entry, expiry);
+  }
+ }
+
+private:
+
+ struct AuctionLevel{
+  Price price;
+  std::uint64_t bid_quantity;
+  std::uint64_t ask_quantity;
+ };
+
+ mutable std::vector<AuctionLevel> auction_levels_; // Scratch for IndicativeUncross, kept to avoid reallocating
+ std::vector<Price> drained_levels_; // Scratch for CancelRange
+
+ // Index slots per order up to which a sequential pass over the whole index costs less than draining the levels order
+ // by order (a dependent cache miss per order, then an index probe)
+ static constexpr std::size_t kIndexClearRatio = 64;
+
+ template <OrderSide Side, typename Sink>
+ bool AddOrder(const Order& order, Timestamp expiry, Sink& sink){
+  OrderId order_id = order.GetOrderId();
+  if (!RestsInBook(order.GetOrderType())){
+   return AddImmediate<Side>(order, sink);
+  }
+  if (!LevelsFor<Side>().Admits(order.GetPrice())){
+   sink.OnRejected(order, RejectReason::InvalidPrice);
+   return false;
+  }
+  if (IsTimed(order.GetOrderType())){
+   expiry = ExpiryOf(order.GetOrderType(), expiry);
+   if (expiry <= Now()){
+    sink.OnRejected(order, RejectReason::Expired);
+    return false;
+   }
+  }
+  if (!CanMatch<Side>(order.GetPrice())){
+   auto [entry, inserted] = order_map_.TryEmplace(order_id); // Passive add, one probe: duplicate check and insert
+   if (!inserted){
+    metrics_.Count(BookCounter::DuplicatesRejected);
+    sink.OnRejected(order, RejectReason::DuplicateOrderId);
+    return false; // Break if duplicate order id's
    }
+   sink.OnAccepted(order);
+   Rest<Side>(order, order.GetRemainingQuantity(), *entry, expiry);
+   return true;
+  }
+  // Crossing: the sweep releases makers from the index, which may move entries, so insert only once it is done
+  if (order_map_.Find(order_id) != nullptr){
+   metrics_.Count(BookCounter::DuplicatesRejected);
+   sink.OnRejected(order, RejectReason::DuplicateOrderId);
+   return false;
+  }
+  sink.OnAccepted(order);
+  Quantity remaining = Sweep<Side>(order_id, order.GetPrice(), order.GetRemainingQuantity(), sink);
+  if (remaining > 0){
+   Rest<Side>(order, remaining, *order_map_.TryEmplace(order_id).first, expiry);
+  }
+  return true;
  }
- else {
-   auto& orders = asks_[order->GetPrice()]; // Access list of orders at this price level
-   orders.erase(orderiterator); // Remove order from the list at its price level
-   if (orders.empty()){
-       asks_.erase(order->GetPrice()); // Remove price level if no orders remain
+
+ // Fill-and-kill, fill-or-kill and market orders: checked, swept, and any remainder cancelled. Never pooled or indexed.
+ template <OrderSide Side, typename Sink>
+ bool AddImmediate(const Order& order, Sink& sink){
+  if (order_map_.Find(order.GetOrderId()) != nullptr){
+   metrics_.Count(BookCounter::DuplicatesRejected);
+   sink.OnRejected(order, RejectReason::DuplicateOrderId);
+   return false;
+  }
+  Price limit = order.GetOrderType() == OrderType::Market ? SideTraits<Side>::kMarketLimit : order.GetPrice();
+  bool fillable = order.GetOrderType() == OrderType::Fillorkill
+   ? CanFill<Side>(limit, order.GetRemainingQuantity()) // Whole quantity, checked before touching the book
+   : CanMatch<Side>(limit);
+  if (!fillable){
+   sink.OnRejected(order, RejectReason::CannotFill);
+   return false;
+  }
+  sink.OnAccepted(order);
+  Quantity remaining = Sweep<Side>(order.GetOrderId(), limit, order.GetRemainingQuantity(), sink);
+  if (remaining > 0){
+   sink.OnCancelled(order.GetOrderId(), remaining); // Fill-and-kill and market remainder never rests
+  }
+  return true;
+ }
+
+ // Pool and level insert of an accepted order with `remaining` left to fill, without matching. entry is its index slot;
+ // a timed order is also armed to expire at `expiry`. The price has been admitted (AdmitsPrice), so only the level and pool
+ // allocations can fail; if one does the entry is taken out of the index again and the book is as it was.
+ template <OrderSide Side>
+ void Rest(const Order& order, Quantity remaining, OrderEntry& entry, Timestamp expiry = 0){
+  OrderHandle handle = kInvalidHandle;
+  Level* level = nullptr;
+  try {
+   handle = pool_.Allocate(order);
+   level = &GetOrCreateLevel<Side>(order.GetPrice()); // Access or create the level, which may resize a ladder
+  }
+  catch (...){
+   if (handle != kInvalidHandle){
+    pool_.Release(handle);
    }
+   order_map_.Erase(order.GetOrderId());
+   throw;
+  }
+  entry.handle_ = handle;
+  if (IsTimed(order.GetOrderType())){
+   expiries_.Schedule(handle, expiry);
+  }
+  pool_[handle].Fill(order.GetRemainingQuantity() - remaining); // Keep what the sweep filled in the book's copy
+
+  level->orders.push_back(pool_, handle); // Append to the level's FIFO
+  RehashLevel(Side, level->price, level->total_quantity, level->total_quantity + remaining);
+  level->total_quantity += remaining;
+  ++level->order_count;
+  TouchLevel<Side>(order.GetPrice());
  }
- 
-  // Remove order from the list at its price level
 
+ // Sized once up front and written through a pointer; push_back per level made a top-10 poll about 2.5x slower
+ template <typename Levels>
+ static void FillLevels(const Levels& side, std::size_t levels, LevelInfos& out){
+  std::size_t count = std::min(levels, side.Size());
+  out.resize(count);
+  if (count == 0){
+   return;
+  }
+  LevelInfo* cursor = out.data();
+  LevelInfo* end = cursor + count;
+  side.ForEachLevel([&cursor, end](const Level& level){
+   *cursor++ = LevelInfo{level.price, level.total_quantity, level.order_count};
+   return cursor != end;
+  });
+ }
 
-}
+ template <OrderSide Side>
+ std::size_t FillTopLevels(std::size_t levels, Price* prices, Quantity* quantities){
+  std::size_t count = 0;
+  if (levels != 0){
+   LevelsFor<Side>().ForEachLevel([&](const Level& level){
+    prices[count] = level.price;
+    quantities[count] = level.total_quantity;
+    return ++count != levels;
+   });
+  }
+  // A full read is current until a change reaches its deepest level; a short one until any change at all
+  top_watches_[Side == OrderSide::Buy ? 0 : 1] = count != 0 && count == levels ? prices[count - 1] : SideTraits<SideTraits<Side>::kOpposite>::kMarketLimit;
+  return count;
+ }
 
+ // Level an order rests at (it must be in the book)
+ Level& LevelOf(const Order& order){
+  return order.GetOrderSide() == OrderSide::Buy ? *bids_.Find(order.GetPrice()) : *asks_.Find(order.GetPrice());
+ }
 
+ // Take quantity a resting order has just lost off its level's total
+ void ReduceLevel(const Order& order, Quantity quantity){
+  Level& level = LevelOf(order);
+  RehashLevel(order.GetOrderSide(), level.price, level.total_quantity, level.total_quantity - quantity);
+  level.total_quantity -= quantity;
+ }
 
+ // Unlink an order from its level (erasing the level if it empties) and free its slot. The index entry must already be gone.
+ void RemoveFromLevel(OrderHandle handle){
+  UnlinkFromLevel(handle);
+  Disarm(handle);
+  pool_.Release(handle);
+ }
 
+ // Unlink an order from its level, erasing the level if it empties; the order keeps its slot
+ void UnlinkFromLevel(OrderHandle handle){
+  if (pool_[handle].GetOrderSide() == OrderSide::Buy){
+   UnlinkFromLevel<OrderSide::Buy>(handle);
+  }
+  else {
+   UnlinkFromLevel<OrderSide::Sell>(handle);
+  }
+ }
 
+ template <OrderSide Side>
+ void UnlinkFromLevel(OrderHandle handle){
+  const Order& order = pool_[handle];
+  auto& levels = LevelsFor<Side>();
+  Level& level = *levels.Find(order.GetPrice()); // Level of the order
+  level.orders.erase(pool_, handle); // Unlink order from the level FIFO
+  RehashLevel(Side, level.price, level.total_quantity, level.total_quantity - order.GetRemainingQuantity());
+  level.total_quantity -= order.GetRemainingQuantity();
+  --level.order_count;
+  TouchLevel<Side>(order.GetPrice());
+  if (level.orders.empty()){
+   EraseLevel(levels, order.GetPrice()); // Remove price level if no orders remain
+  }
+ }
 
+ // Cancel every order of a level and leave its queue empty; the caller erases the level
+ template <OrderSide Side, typename Sink>
+ std::size_t DrainLevel(Level& level, Sink& sink){
+  std::size_t drained = level.order_count;
+  level.orders.Drain(pool_, [&](OrderHandle handle){
+   const Order& order = pool_[handle];
+   sink.OnCancelled(order.GetOrderId(), order.GetRemainingQuantity());
+   order_map_.Erase(order.GetOrderId());
+   Disarm(handle);
+   pool_.Release(handle);
+  });
+  TouchLevel<Side>(level.price);
+  RehashLevel(Side, level.price, level.total_quantity, 0);
+  return drained;
+ }
+
+ // Drain and erase every level of one side, best first
+ template <OrderSide Side, typename Sink>
+ std::size_t DrainSide(Sink& sink){
+  auto& levels = LevelsFor<Side>();
+  std::size_t cancelled = 0;
+  while (!levels.Empty()){
+   cancelled += DrainLevel<Side>(levels.Best(), sink);
+   EraseBestLevel(levels);
+  }
+  return cancelled;
+ }
+
+ void CheckPrice(OrderSide side, Price price) const {
+  if (side == OrderSide::Buy){
+   bids_.CheckPrice(price);
+  }
+  else {
+   asks_.CheckPrice(price);
+  }
+ }
+
+ bool IndexClearCheap() const { return Size() != 0 && order_map_.Capacity() <= kIndexClearRatio * Size(); }
+
+ // Cancel every order without walking the levels' queues (see CancelAll)
+ template <typename Sink>
+ std::size_t ClearBook(Sink& sink){
+  std::size_t cancelled = Size();
+  if (!std::is_same_v<Sink, BookEventSink> || TimedOrders() != 0){
+   order_map_.ForEach([&](OrderId order_id, const OrderEntry& entry){
+    sink.OnCancelled(order_id, pool_[entry.handle_].GetRemainingQuantity());
+    Disarm(entry.handle_);
+   });
+  }
+  EraseLevels<OrderSide::Buy>();
+  EraseLevels<OrderSide::Sell>();
+  pool_.Clear();
+  order_map_.Clear();
+  depth_hashes_[0] = depth_hashes_[1] = 0;
+  return cancelled;
+ }
+
+ // Erase every level of one side along with its queue, leaving the orders to the caller
+ template <OrderSide Side>
+ void EraseLevels(){
+  auto& levels = LevelsFor<Side>();
+  if (!levels.Empty()){
+   TouchLevel<Side>(levels.Best().price);
+  }
+  while (!levels.Empty()){
+   EraseBestLevel(levels);
+  }
+ }
+
+ template <OrderSide Side, typename Sink>
+ std::size_t CancelSide(Sink& sink){
+  if (LevelsFor<SideTraits<Side>::kOpposite>().Empty() && IndexClearCheap()){
+   return ClearBook(sink); // Nothing else rests: this is the whole book
+  }
+  return DrainSide<Side>(sink);
+ }
+
+ // Levels are drained during the walk and erased after it, since erasing would invalidate the walk over map levels
+ template <OrderSide Side, typename Sink>
+ std::size_t CancelRange(Price low, Price high, Sink& sink){
+  Price nearest = Side == OrderSide::Buy ? high : low; // First price in range from the best level down
+  Price farthest = Side == OrderSide::Buy ? low : high;
+  std::size_t cancelled = 0;
+  drained_levels_.clear();
+  LevelsFor<Side>().ForEachLevel([&](Level& level){
+   if (SideTraits<Side>::Better(farthest, level.price)){
+    return false; // Past the range
+   }
+   if (!SideTraits<Side>::Better(level.price, nearest)){
+    cancelled += DrainLevel<Side>(level, sink);
+    drained_levels_.push_back(level.price);
+   }
+   return true;
+  });
+  for (Price price : drained_levels_){
+   EraseLevel(LevelsFor<Side>(), price);
+  }
+  return cancelled;
+ }
+
+ // Amended, unlinked order: sweep the opposite side if it now crosses, then append any remainder to the back of its level
+ template <OrderSide Side, typename Sink>
+ void Relink(OrderHandle handle, Sink& sink){
+  Order& order = pool_[handle]; // Stays put: the sweep only releases other slots
+  sink.OnModified(order);
+  if (CanMatch<Side>(order.GetPrice())){
+   Quantity remaining = Sweep<Side>(order.GetOrderId(), order.GetPrice(), order.GetRemainingQuantity(), sink);
+   order.Fill(order.GetRemainingQuantity() - remaining);
+   if (remaining == 0){
+    ReleaseOrder(handle);
+    return;
+   }
+  }
+  Level* level = nullptr;
+  try {
+   level = &GetOrCreateLevel<Side>(order.GetPrice());
+  }
+  catch (...){
+   sink.OnCancelled(order.GetOrderId(), order.GetRemainingQuantity()); // No level to rest at: the remainder leaves the book
+   ReleaseOrder(handle);
+   throw;
+  }
+  level->orders.push_back(pool_, handle);
+  RehashLevel(Side, level->price, level->total_quantity, level->total_quantity + order.GetRemainingQuantity());
+  level->total_quantity += order.GetRemainingQuantity();
+  ++level->order_count;
+  TouchLevel<Side>(order.GetPrice());
+ }
 
 }; // Closing brace for OrderBook class
 
+using OrderBook = BasicOrderBook<MapLevels>;        // Default: std::map price levels
+using LadderOrderBook = BasicOrderBook<LadderLevels>; // Tick-indexed ladder price levels
+using RingOrderBook = BasicOrderBook<RingLevels>;     // Ladder levels with contiguous ring queues
+
+#endif // ORDERS_API_H
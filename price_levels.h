@@ -0,0 +1,473 @@
+#ifndef PRICE_LEVELS_H
+#define PRICE_LEVELS_H
+
+#include "orders.h"
+#include "order_pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+// Price level containers for one side of the book.
+// Both backends expose the same interface so OrderBook can be built on either:
+//   Empty(), Size(), Best(), GetOrCreate(price), Find(price), Erase(price), EraseBest(), ForEachLevel(fn),
+//   Admits(price), CheckPrice(price)
+// ForEachLevel visits levels from best to worst; fn returns false to stop early. Admits tells whether GetOrCreate can
+// take a price; CheckPrice throws the std::logic_error GetOrCreate would, so a caller can refuse before changing anything.
+
+
+// A single price level: FIFO queue of pooled orders resting at one price.
+// total_quantity and order_count are kept up to date by the book on every add, fill, reduce and cancel, so depth
+// queries read them instead of walking the queue.
+// Queue is OrderQueue (linked through the orders) or RingOrderQueue (a contiguous ring per level), see order_pool.h.
+template <typename Queue>
+struct BasicPriceLevel {
+ Price price{0};
+ Quantity total_quantity{0};    // Sum of remaining quantity of the orders in the queue
+ std::uint32_t order_count{0};  // Number of orders in the queue
+ Queue orders;
+};
+
+using PriceLevel = BasicPriceLevel<OrderQueue>;
+
+// Sizing for the ladder backend (ignored by the map backend)
+struct LevelConfig {
+ Price tick_size{1};                  // Prices must be a multiple of this
+ std::uint32_t window_ticks{4096};    // Initial number of ticks covered by the ladder (rounded up to 64)
+ std::uint32_t max_window_ticks{1u << 20}; // Most ticks the ladder may grow to; a price that would need more is refused
+};
+
+
+// Price ordering of one book side as compile-time constants, so per-side code is generated without runtime side tests
+template <OrderSide Side>
+struct SideTraits {
+ static constexpr OrderSide kOpposite = Side == OrderSide::Buy ? OrderSide::Sell : OrderSide::Buy;
+
+ // Limit that crosses every opposite level (market orders)
+ static constexpr Price kMarketLimit = Side == OrderSide::Buy ? std::numeric_limits<Price>::max() : std::numeric_limits<Price>::min();
+
+ // lhs ranks ahead of rhs on this side (bids: higher, asks: lower)
+ static constexpr bool Better(Price lhs, Price rhs){ return Side == OrderSide::Buy ? lhs > rhs : lhs < rhs; }
+
+ // An order of this side limited at `price` can trade against an opposite level at `resting`
+ static constexpr bool Crosses(Price price, Price resting){ return Side == OrderSide::Buy ? price >= resting : price <= resting; }
+};
+
+
+// std::map backend: O(log N) insert/erase, best level at begin()
+template <OrderSide Side, typename Level = PriceLevel>
+class MapPriceLevels{
+ public:
+  using Compare = std::conditional_t<Side == OrderSide::Buy, std::greater<Price>, std::less<Price>>; // Bids: highest first, asks: lowest first
+
+  explicit MapPriceLevels(const LevelConfig& = {}) { }
+
+  bool Admits(Price) const { return true; }
+  void CheckPrice(Price) const { }
+
+  bool Empty() const { return levels_.empty(); }
+  std::size_t Size() const { return levels_.size(); }
+  Level& Best() { return levels_.begin()->second; }
+  const Level& Best() const { return levels_.begin()->second; }
+
+  Level& GetOrCreate(Price price){
+   auto [it, inserted] = levels_.try_emplace(price);
+   if (inserted){
+    it->second.price = price;
+   }
+   return it->second;
+  }
+
+  Level* Find(Price price){
+   auto it = levels_.find(price);
+   return it == levels_.end() ? nullptr : &it->second;
+  }
+
+  void Erase(Price price){ levels_.erase(price); }
+  void EraseBest(){ levels_.erase(levels_.begin()); } // By iterator, no second tree search
+
+  template <typename Fn>
+  void ForEachLevel(Fn&& fn){
+   for (auto& [price, level] : levels_){
+    if (!fn(level)){
+     return;
+    }
+   }
+  }
+
+  template <typename Fn>
+  void ForEachLevel(Fn&& fn) const {
+   for (const auto& [price, level] : levels_){
+    if (!fn(level)){
+     return;
+    }
+   }
+  }
+
+ private:
+  std::map<Price, Level, Compare> levels_;
+};
+
+
+// Tick-indexed ladder backend.
+// Levels live in a flat array indexed by (price - base_) / tick_size, so a level is found by arithmetic instead of a tree walk.
+// An occupancy bitmap (one bit per tick) plus a summary word per 64 bitmap words lets us find the next best level
+// without scanning empty ticks. The best index is cached so Best() is O(1).
+// When a price falls outside the window the ladder recentres around the occupied range, growing the window if the
+// occupied range no longer fits in half of it. Existing PriceLevel objects are moved; they only hold queue handles, so orders are untouched.
+// The window never grows past max_window_ticks: a price that would stretch the occupied range beyond it is refused
+// with std::logic_error, so one far-off price cannot make the ladder allocate gigabytes. Once the occupied range fits
+// in a quarter of a grown window the ladder shrinks back (checked every few erases, and at once when it empties).
+// A resize allocates the new arrays before touching the old ones, so a std::bad_alloc leaves the ladder as it was.
+template <OrderSide Side, typename Level = PriceLevel>
+class LadderPriceLevels{
+ public:
+  explicit LadderPriceLevels(const LevelConfig& config = {}):
+   tick_size_ {config.tick_size},
+   initial_window_ {RoundWindow(config.window_ticks)},
+   max_window_ {std::max(initial_window_, RoundWindow(config.max_window_ticks))}
+  {
+   if (tick_size_ <= 0){
+    throw std::logic_error("LadderPriceLevels: tick size must be positive");
+   }
+   Rebuild(0, initial_window_);
+  }
+
+  bool Admits(Price price) const {
+   std::int64_t offset = Offset(price);
+   if (offset >= 0 && offset < static_cast<std::int64_t>(slots_.size())){
+    return true;
+   }
+   std::int64_t low = price;
+   std::int64_t high = price;
+   return price % tick_size_ == 0 && Span(low, high) <= max_window_;
+  }
+
+  void CheckPrice(Price price) const {
+   if (Admits(price)){
+    return;
+   }
+   if (price % tick_size_ != 0){
+    throw std::logic_error("LadderPriceLevels: price " + std::to_string(price) + " is not a multiple of tick size " + std::to_string(tick_size_));
+   }
+   throw std::logic_error("LadderPriceLevels: price " + std::to_string(price) + " is too far from the resting levels for a window of at most "
+    + std::to_string(max_window_) + " ticks");
+  }
+
+  std::size_t WindowTicks() const { return slots_.size(); }
+
+  bool Empty() const { return count_ == 0; }
+  std::size_t Size() const { return count_; }
+  Level& Best() { return slots_[best_]; }
+  const Level& Best() const { return slots_[best_]; }
+
+  Level& GetOrCreate(Price price){
+   std::size_t index = IndexFor(price);
+   if (!Test(index)){
+    Set(index);
+    slots_[index].price = price;
+    if (count_ == 0 || Better(index, best_)){
+     best_ = index;
+    }
+    ++count_;
+   }
+   return slots_[index];
+  }
+
+  Level* Find(Price price){
+   std::int64_t offset = Offset(price);
+   if (offset < 0 || offset >= static_cast<std::int64_t>(slots_.size()) || !Test(static_cast<std::size_t>(offset))){
+    return nullptr;
+   }
+   return &slots_[static_cast<std::size_t>(offset)];
+  }
+
+  void Erase(Price price){
+   std::int64_t offset = Offset(price);
+   if (offset < 0 || offset >= static_cast<std::int64_t>(slots_.size())){
+    return;
+   }
+   EraseIndex(static_cast<std::size_t>(offset));
+  }
+
+  void EraseBest(){ EraseIndex(best_); }
+
+  template <typename Fn>
+  void ForEachLevel(Fn&& fn){
+   if (count_ == 0){
+    return;
+   }
+   for (std::size_t index = best_; ; ){
+    if (!fn(slots_[index])){
+     return;
+    }
+    if (!NextWorse(index, index)){
+     return;
+    }
+   }
+  }
+
+  template <typename Fn>
+  void ForEachLevel(Fn&& fn) const {
+   const_cast<LadderPriceLevels*>(this)->ForEachLevel([&fn](const Level& level){ return fn(level); });
+  }
+
+ private:
+  static constexpr std::size_t kWordBits = 64;
+
+  Price tick_size_;
+  std::size_t initial_window_;     // Configured window, the smallest the ladder shrinks back to
+  std::size_t max_window_;
+  std::size_t erases_{0};          // Erases since the last shrink check
+  std::int64_t base_{0};           // Price of slot 0
+  std::size_t count_{0};           // Occupied levels
+  std::size_t best_{0};            // Slot of the best level, valid when count_ > 0
+  std::vector<Level> slots_;
+  std::vector<std::uint64_t> words_;   // Occupancy, one bit per slot
+  std::vector<std::uint64_t> summary_; // One bit per non-empty word in words_
+
+  static std::size_t RoundWindow(std::uint32_t ticks){
+   std::size_t window = ticks < kWordBits ? kWordBits : ticks;
+   return (window + kWordBits - 1) / kWordBits * kWordBits;
+  }
+
+  // Bids improve upwards, asks improve downwards
+  static bool Better(std::size_t lhs, std::size_t rhs){
+   if constexpr (Side == OrderSide::Buy){
+    return lhs > rhs;
+   }
+   else {
+    return lhs < rhs;
+   }
+  }
+
+  // Slot offset of price from base_, or -1 if price is off the tick grid. base_ is always on the grid, so one division
+  // (none for unit ticks) both locates and validates the price.
+  std::int64_t Offset(Price price) const {
+   std::int64_t distance = static_cast<std::int64_t>(price) - base_;
+   if (tick_size_ == 1){
+    return distance;
+   }
+   std::int64_t offset = distance / tick_size_;
+   return offset * tick_size_ == distance ? offset : -1;
+  }
+
+  std::size_t IndexFor(Price price){
+   std::int64_t offset = Offset(price);
+   if (offset < 0 || offset >= static_cast<std::int64_t>(slots_.size())){
+    CheckPrice(price);
+    std::int64_t low = price;
+    std::int64_t high = price;
+    Span(low, high);
+    Place(low, high);
+    offset = Offset(price);
+   }
+   return static_cast<std::size_t>(offset);
+  }
+
+  bool Test(std::size_t index) const { return (words_[index / kWordBits] >> (index % kWordBits)) & 1U; }
+
+  void Set(std::size_t index){
+   std::size_t word = index / kWordBits;
+   words_[word] |= std::uint64_t{1} << (index % kWordBits);
+   summary_[word / kWordBits] |= std::uint64_t{1} << (word % kWordBits);
+  }
+
+  void Clear(std::size_t index){
+   std::size_t word = index / kWordBits;
+   words_[word] &= ~(std::uint64_t{1} << (index % kWordBits));
+   if (words_[word] == 0){
+    summary_[word / kWordBits] &= ~(std::uint64_t{1} << (word % kWordBits));
+   }
+  }
+
+  void EraseIndex(std::size_t index){
+   if (!Test(index)){
+    return;
+   }
+   Clear(index);
+   slots_[index].orders.clear();
+   slots_[index].total_quantity = 0;
+   slots_[index].order_count = 0;
+   --count_;
+   if (count_ != 0 && index == best_){
+    NextWorse(best_, best_);
+   }
+   // The range scan costs one summary word per 4096 ticks, so a grown ladder pays for it once every that many erases
+   if (slots_.size() > initial_window_ && (count_ == 0 || ++erases_ >= summary_.size())){
+    erases_ = 0;
+    Shrink();
+   }
+  }
+
+  // Next occupied slot after `from` in worse-price direction (down for bids, up for asks)
+  bool NextWorse(std::size_t from, std::size_t& out) const {
+   if constexpr (Side == OrderSide::Buy){
+    return from != 0 && FindPrev(from - 1, out);
+   }
+   else {
+    return FindNext(from + 1, out);
+   }
+  }
+
+  // Lowest occupied slot >= from
+  bool FindNext(std::size_t from, std::size_t& out) const {
+   if (from >= slots_.size()){
+    return false;
+   }
+   std::size_t word = from / kWordBits;
+   std::uint64_t bits = words_[word] & (~std::uint64_t{0} << (from % kWordBits));
+   if (bits == 0){
+    // Skip empty words through the summary
+    std::size_t next_word = word + 1;
+    std::size_t group = next_word / kWordBits;
+    if (group >= summary_.size()){
+     return false;
+    }
+    std::uint64_t groups = next_word % kWordBits == 0 ? summary_[group] : summary_[group] & (~std::uint64_t{0} << (next_word % kWordBits));
+    while (groups == 0){
+     if (++group >= summary_.size()){
+      return false;
+     }
+     groups = summary_[group];
+    }
+    word = group * kWordBits + static_cast<std::size_t>(__builtin_ctzll(groups));
+    bits = words_[word];
+   }
+   out = word * kWordBits + static_cast<std::size_t>(__builtin_ctzll(bits));
+   return true;
+  }
+
+  // Highest occupied slot <= from
+  bool FindPrev(std::size_t from, std::size_t& out) const {
+   std::size_t word = from / kWordBits;
+   std::size_t bit = from % kWordBits;
+   std::uint64_t bits = words_[word] & (bit == kWordBits - 1 ? ~std::uint64_t{0} : (std::uint64_t{2} << bit) - 1);
+   if (bits == 0){
+    if (word == 0){
+     return false;
+    }
+    std::size_t prev_word = word - 1;
+    std::size_t group = prev_word / kWordBits;
+    std::size_t group_bit = prev_word % kWordBits;
+    std::uint64_t groups = summary_[group] & (group_bit == kWordBits - 1 ? ~std::uint64_t{0} : (std::uint64_t{2} << group_bit) - 1);
+    while (groups == 0){
+     if (group == 0){
+      return false;
+     }
+     groups = summary_[--group];
+    }
+    word = group * kWordBits + (kWordBits - 1 - static_cast<std::size_t>(__builtin_clzll(groups)));
+    bits = words_[word];
+   }
+   out = word * kWordBits + (kWordBits - 1 - static_cast<std::size_t>(__builtin_clzll(bits)));
+   return true;
+  }
+
+  // Widen [low, high] to the occupied range and return its span in ticks
+  std::size_t Span(std::int64_t& low, std::int64_t& high) const {
+   if (count_ != 0){
+    std::size_t lowest = 0;
+    std::size_t highest = 0;
+    FindNext(0, lowest);
+    FindPrev(slots_.size() - 1, highest);
+    low = std::min(low, base_ + static_cast<std::int64_t>(lowest) * tick_size_);
+    high = std::max(high, base_ + static_cast<std::int64_t>(highest) * tick_size_);
+   }
+   return static_cast<std::size_t>((high - low) / tick_size_) + 1;
+  }
+
+  // Smallest window, doubling from the configured one, that span fills at most half of; max_window_ if none below it does
+  std::size_t WindowFor(std::size_t span) const {
+   std::size_t window = initial_window_;
+   while (span > window / 2 && window < max_window_){
+    window = std::min(window * 2, max_window_);
+   }
+   return window;
+  }
+
+  // Centre the prices low..high (a span the caller has checked against max_window_) in a window sized for them
+  void Place(std::int64_t low, std::int64_t high){
+   std::size_t span = static_cast<std::size_t>((high - low) / tick_size_) + 1;
+   std::size_t window = WindowFor(span);
+   Rebuild(low - static_cast<std::int64_t>((window - span) / 2) * tick_size_, window);
+  }
+
+  // Give a grown window back once the occupied range fits in a quarter of it; growing again takes more than half, so a
+  // range near either threshold does not resize back and forth
+  void Shrink(){
+   std::int64_t low = base_;
+   std::int64_t high = base_;
+   if (count_ != 0){
+    low = std::numeric_limits<std::int64_t>::max();
+    high = std::numeric_limits<std::int64_t>::min();
+    if (WindowFor(Span(low, high)) * 4 > slots_.size()){
+     return;
+    }
+   }
+   try {
+    Place(low, high);
+   }
+   catch (const std::bad_alloc&){
+    // Keep the larger window; the next check tries again
+   }
+  }
+
+  // Move every occupied level into a new window of `window` slots starting at price `base`. The new arrays are
+  // allocated first and nothing after that throws, so on std::bad_alloc the ladder is unchanged.
+  void Rebuild(std::int64_t base, std::size_t window){
+   std::vector<Level> slots(window);
+   std::vector<std::uint64_t> words(window / kWordBits, 0);
+   std::vector<std::uint64_t> summary((words.size() + kWordBits - 1) / kWordBits, 0);
+
+   std::vector<Level> old_slots = std::exchange(slots_, std::move(slots));
+   std::vector<std::uint64_t> old_words = std::exchange(words_, std::move(words));
+   summary_ = std::move(summary);
+   std::int64_t old_base = base_;
+   std::size_t old_best = best_;
+   base_ = base;
+
+   std::size_t moved = 0;
+   for (std::size_t word = 0; word < old_words.size() && moved < count_; ++word){
+    for (std::uint64_t bits = old_words[word]; bits != 0; bits &= bits - 1){
+     std::size_t old_index = word * kWordBits + static_cast<std::size_t>(__builtin_ctzll(bits));
+     std::size_t index = static_cast<std::size_t>((old_base + static_cast<std::int64_t>(old_index) * tick_size_ - base_) / tick_size_);
+     slots_[index] = std::move(old_slots[old_index]);
+     Set(index);
+     if (old_index == old_best){
+      best_ = index;
+     }
+     ++moved;
+    }
+   }
+  }
+};
+
+
+// Level backend selectors for OrderBook
+struct MapLevels{
+ using Level = PriceLevel;
+ template <OrderSide Side> using Levels = MapPriceLevels<Side>;
+};
+
+struct LadderLevels{
+ using Level = PriceLevel;
+ template <OrderSide Side> using Levels = LadderPriceLevels<Side>;
+};
+
+// Ladder levels whose queues are contiguous rings with tombstoned cancels
+struct RingLevels{
+ using Level = BasicPriceLevel<RingOrderQueue>;
+ template <OrderSide Side> using Levels = LadderPriceLevels<Side, Level>;
+};
+
+#endif // PRICE_LEVELS_H
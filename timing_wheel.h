@@ -0,0 +1,238 @@
+#ifndef TIMING_WHEEL_H
+#define TIMING_WHEEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+// Hierarchical timing wheel for order expiry.
+// Eight levels of 256 slots cover the whole 64-bit tick range. A timer sits in the level of the highest byte in which
+// its expiry tick differs from the wheel's current tick, in the slot that byte selects; level 0 holds the timers due in
+// the current lap of 256 ticks, one tick per slot. Advance fires level-0 slots in tick order. At the end of a lap it
+// moves the clock to the earliest occupied slot above and cascades that slot's timers down, so a timer moves at most
+// seven times before it fires: amortized O(1) each. Occupancy bitmaps let Advance skip empty slots, so a jump from
+// the open to the close costs the occupied slots on the way, not the ticks in between.
+// Timers are keyed by a caller-chosen dense index (the book uses the order's pool handle), so the caller stores
+// nothing extra. Each slot is an array of (expiry, index) entries and each index records where its entry is: Cancel
+// is an O(1) swap-remove, and a cascade reads its slot sequentially instead of chasing list links through memory.
+// Storage is allocated on the first Schedule.
+
+
+class TimingWheel{
+ public:
+  // tick: time units per wheel tick. Expiries are rounded up to a whole tick, so a timer never fires early and fires
+  // at most one tick late. capacity_hint: expected highest timer index, reserved on the first Schedule.
+  explicit TimingWheel(std::uint64_t tick = 1, std::size_t capacity_hint = 0):
+   tick_ {tick},
+   capacity_hint_ {capacity_hint}
+  {
+   if (tick_ == 0){
+    throw std::logic_error("TimingWheel: tick must be at least 1");
+   }
+  }
+
+  // Arm timer `index` to fire at `expiry`; an expiry at or before Now() fires on the next Advance. The index must not
+  // be armed already.
+  void Schedule(std::uint32_t index, std::uint64_t expiry){
+   if (slots_.empty()){
+    slots_.resize(kLevels * kSlots);
+    where_.reserve(capacity_hint_);
+   }
+   if (index >= where_.size()){
+    where_.resize(static_cast<std::size_t>(index) + 1);
+   }
+   if (where_[index].slot != kIdle){
+    throw std::logic_error("TimingWheel: timer " + std::to_string(index) + " is already scheduled");
+   }
+   Place(Entry{tick_ == 1 ? expiry : expiry / tick_ + (expiry % tick_ != 0), index});
+   ++size_;
+  }
+
+  // Disarm timer `index`; returns false if it was not scheduled (never armed, cancelled or already fired)
+  bool Cancel(std::uint32_t index){
+   if (index >= where_.size() || where_[index].slot == kIdle){
+    return false;
+   }
+   Location location = where_[index];
+   std::vector<Entry>& entries = slots_[location.slot];
+   if (location.position + 1 != entries.size()){
+    entries[location.position] = entries.back();
+    where_[entries[location.position].index].position = location.position;
+   }
+   entries.pop_back();
+   if (entries.empty()){
+    occupied_[location.slot >> 6] &= ~(std::uint64_t{1} << (location.slot & 63));
+   }
+   where_[index].slot = kIdle;
+   --size_;
+   return true;
+  }
+
+  bool Scheduled(std::uint32_t index) const { return index < where_.size() && where_[index].slot != kIdle; }
+
+  // Time timer `index` fires at (its expiry rounded up to a whole tick), or 0 if it is not scheduled
+  std::uint64_t Expiry(std::uint32_t index) const {
+   if (!Scheduled(index)){
+    return 0;
+   }
+   return slots_[where_[index].slot][where_[index].position].expiry * tick_;
+  }
+
+  // Move the clock to `now` and call fn(index) for every timer due by then, in tick order. Each timer is disarmed
+  // before fn sees it, so fn may schedule or cancel timers. A time before Now() changes nothing but still fires timers
+  // scheduled at or before Now(). Returns the number fired.
+  template <typename Fn>
+  std::size_t Advance(std::uint64_t now, Fn&& fn){
+   if (now > now_){
+    now_ = now;
+   }
+   std::uint64_t target = now_ / tick_;
+   std::size_t fired = 0;
+   while (size_ != 0){
+    bool last_lap = (target >> kSlotBits) == (current_ >> kSlotBits);
+    fired += FireLevelZero(static_cast<std::size_t>(current_ & kSlotMask), last_lap ? static_cast<std::size_t>(target & kSlotMask) : kSlotMask, fn);
+    if (last_lap){
+     break;
+    }
+    // Level 0 is spent for this lap: the next timers are in the lowest occupied slot above the current tick
+    std::size_t level = 0;
+    std::size_t slot = 0;
+    if (!NextOccupied(level, slot)){
+     break;
+    }
+    std::uint64_t shift = kSlotBits * level;
+    std::uint64_t prefix = shift + kSlotBits < 64 ? current_ >> (shift + kSlotBits) << (shift + kSlotBits) : 0;
+    std::uint64_t boundary = prefix | static_cast<std::uint64_t>(slot) << shift;
+    if (boundary > target){
+     break;
+    }
+    current_ = boundary;
+    Cascade(level * kSlots + slot);
+   }
+   if (target > current_){
+    current_ = target;
+   }
+   return fired;
+  }
+
+  std::uint64_t Now() const { return now_; }   // Latest time passed to Advance
+  std::size_t Size() const { return size_; }   // Timers scheduled
+
+ private:
+  static constexpr std::size_t kLevels = 8;
+  static constexpr std::uint64_t kSlotBits = 8;
+  static constexpr std::size_t kSlots = std::size_t{1} << kSlotBits;
+  static constexpr std::size_t kSlotMask = kSlots - 1;
+  static constexpr std::uint32_t kIdle = UINT32_MAX;
+
+  struct Entry{
+   std::uint64_t expiry;       // In ticks
+   std::uint32_t index;
+  };
+
+  struct Location{
+   std::uint32_t slot{kIdle};  // level * kSlots + slot, or kIdle when not scheduled
+   std::uint32_t position{0};  // In that slot's entries
+  };
+
+  // The slot the expiry selects relative to the current tick; an overdue timer goes to the current tick
+  std::size_t SlotFor(std::uint64_t expiry) const {
+   if (expiry < current_){
+    expiry = current_;
+   }
+   std::uint64_t diff = expiry ^ current_;
+   std::size_t level = diff == 0 ? 0 : static_cast<std::size_t>(63 - __builtin_clzll(diff)) / kSlotBits;
+   return level * kSlots + static_cast<std::size_t>(expiry >> (kSlotBits * level) & kSlotMask);
+  }
+
+  void Place(const Entry& entry){
+   std::size_t slot = SlotFor(entry.expiry);
+   std::vector<Entry>& entries = slots_[slot];
+   if (entries.empty()){
+    occupied_[slot >> 6] |= std::uint64_t{1} << (slot & 63);
+   }
+   where_[entry.index] = Location{static_cast<std::uint32_t>(slot), static_cast<std::uint32_t>(entries.size())};
+   entries.push_back(entry);
+  }
+
+  template <typename Fn>
+  std::size_t FireLevelZero(std::size_t first, std::size_t last, Fn& fn){
+   std::size_t fired = 0;
+   for (std::size_t slot = first; slot <= last; ){
+    std::uint64_t word = occupied_[slot >> 6] >> (slot & 63);
+    if (word == 0){
+     slot = (slot | 63) + 1;   // Rest of this bitmap word is empty
+     continue;
+    }
+    slot += static_cast<std::size_t>(__builtin_ctzll(word));
+    if (slot > last){
+     break;
+    }
+    current_ = (current_ & ~static_cast<std::uint64_t>(kSlotMask)) | slot;   // Overdue timers armed by fn land here and fire now
+    std::vector<Entry>& entries = slots_[slot];
+    while (!entries.empty()){
+     std::uint32_t index = entries.front().index;
+     Cancel(index);
+     ++fired;
+     fn(index);
+    }
+    ++slot;
+   }
+   return fired;
+  }
+
+  // Lowest level above 0 with an occupied slot, and its first occupied slot after the current tick's byte
+  bool NextOccupied(std::size_t& level, std::size_t& slot) const {
+   for (level = 1; level < kLevels; ++level){
+    std::size_t from = static_cast<std::size_t>(current_ >> (kSlotBits * level) & kSlotMask) + 1;
+    for (std::size_t word = from >> 6; from < kSlots && word < kSlots / 64; ++word){
+     std::uint64_t bits = occupied_[level * kSlots / 64 + word];
+     if (word == from >> 6){
+      bits &= ~std::uint64_t{0} << (from & 63);
+     }
+     if (bits != 0){
+      slot = word * 64 + static_cast<std::size_t>(__builtin_ctzll(bits));
+      return true;
+     }
+    }
+   }
+   return false;
+  }
+
+  // Re-place the timers of one slot now that the clock has reached its start; they all land in lower levels. When they
+  // all land in the same empty slot, as a burst of day orders does, the array moves over whole and only the recorded
+  // slot changes.
+  void Cascade(std::size_t slot){
+   scratch_.swap(slots_[slot]);   // The slot keeps the scratch array's capacity for its next timers
+   occupied_[slot >> 6] &= ~(std::uint64_t{1} << (slot & 63));
+   std::size_t target = SlotFor(scratch_.front().expiry);
+   if (slots_[target].empty() && std::all_of(scratch_.begin(), scratch_.end(), [&](const Entry& entry){ return SlotFor(entry.expiry) == target; })){
+    for (const Entry& entry : scratch_){
+     where_[entry.index].slot = static_cast<std::uint32_t>(target);
+    }
+    scratch_.swap(slots_[target]);
+    occupied_[target >> 6] |= std::uint64_t{1} << (target & 63);
+    return;
+   }
+   for (const Entry& entry : scratch_){
+    Place(entry);
+   }
+   scratch_.clear();
+  }
+
+  std::uint64_t tick_;
+  std::size_t capacity_hint_;
+  std::uint64_t now_{0};                       // In time units
+  std::uint64_t current_{0};                   // In ticks
+  std::size_t size_{0};
+  std::vector<std::vector<Entry>> slots_;      // By level * kSlots + slot
+  std::vector<Location> where_;                // By timer index
+  std::vector<Entry> scratch_;
+  std::uint64_t occupied_[kLevels * kSlots / 64]{};
+};
+
+#endif // TIMING_WHEEL_H
@@ -0,0 +1,107 @@
+// Replays many LOBSTER message files in parallel, each into its own book, and merges their statistics.
+// Usage: lobster_batch <file | directory>... [--threads N] [--ladder] [--tick N]
+//   A directory contributes every LOBSTER message file in it (*_message_*.csv) and every columnar file (*.lobc).
+//   --threads N  worker threads (default: one per hardware thread)
+//   --ladder     use the tick-indexed ladder level backend instead of std::map
+//   --tick N     ladder tick size in LOBSTER price units (default 100 = one cent)
+
+#include "../lobster_batch.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+void AddInput(const std::string& input, std::vector<std::string>& paths){
+ if (!std::filesystem::is_directory(input)){
+  paths.push_back(input);
+  return;
+ }
+ std::vector<std::string> found;
+ for (const auto& entry : std::filesystem::directory_iterator(input)){
+  std::string name = entry.path().filename().string();
+  bool message = name.find("_message_") != std::string::npos && entry.path().extension() == ".csv";
+  if (entry.is_regular_file() && (message || entry.path().extension() == ".lobc")){
+   found.push_back(entry.path().string());
+  }
+ }
+ std::sort(found.begin(), found.end());
+ paths.insert(paths.end(), found.begin(), found.end());
+}
+
+void PrintReport(const BatchStats& batch){
+ std::printf("%-48s %10s %10s %10s %7s %8s %10s %4s\n", "file", "MB", "events", "executions", "depth", "seconds", "M ev/s", "rank");
+ for (const FileReplayStats& file : batch.files){
+  std::string name = std::filesystem::path(file.path).filename().string();
+  if (!file.error.empty()){
+   std::printf("%-48s failed: %s\n", name.c_str(), file.error.c_str());
+   continue;
+  }
+  const ReplayStats& replay = file.replay;
+  std::printf("%-48s %10.1f %10llu %10llu %3zu/%-3zu %8.3f %10.2f %4zu\n", name.c_str(), static_cast<double>(file.bytes) / 1e6,
+   static_cast<unsigned long long>(replay.events), static_cast<unsigned long long>(replay.by_type[4] + replay.by_type[5]),
+   replay.max_bid_levels, replay.max_ask_levels, file.seconds, replay.events / file.seconds / 1e6, file.rank);
+ }
+
+ const ReplayStats& total = batch.total;
+ std::printf("\nfiles             %zu (%zu failed)\n", batch.files.size(), batch.failed);
+ std::printf("events            %llu\n", static_cast<unsigned long long>(total.events));
+ std::printf("executions        %llu visible, %llu hidden\n", static_cast<unsigned long long>(total.by_type[4]), static_cast<unsigned long long>(total.by_type[5]));
+ std::printf("malformed rows    %llu\n", static_cast<unsigned long long>(total.malformed_rows));
+ std::printf("unknown orders    %llu\n", static_cast<unsigned long long>(total.unknown_orders));
+ std::printf("rejected orders   %llu\n", static_cast<unsigned long long>(total.rejected_orders));
+ std::printf("book trades       %llu\n", static_cast<unsigned long long>(total.book_trades));
+ std::printf("max depth         %zu bid / %zu ask levels\n", total.max_bid_levels, total.max_ask_levels);
+ std::printf("threads           %zu (%llu steals)\n", batch.threads, static_cast<unsigned long long>(batch.steals));
+ std::printf("wall              %.3f s\n", batch.wall_seconds);
+ std::printf("cpu               %.3f s summed over files (%.2fx parallel)\n", batch.cpu_seconds, batch.cpu_seconds / batch.wall_seconds);
+ std::printf("throughput        %.1f M events/s\n", total.events / batch.wall_seconds / 1e6);
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ std::vector<std::string> paths;
+ BatchConfig config;
+ config.levels = LevelConfig{100, 4096};
+ config.capacity_hint = 1 << 20;
+ bool ladder = false;
+ try {
+  for (int i = 1; i < argc; ++i){
+   if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc){
+    config.threads = std::strtoull(argv[++i], nullptr, 10);
+   }
+   else if (std::strcmp(argv[i], "--ladder") == 0){
+    ladder = true;
+   }
+   else if (std::strcmp(argv[i], "--tick") == 0 && i + 1 < argc){
+    config.levels.tick_size = static_cast<Price>(std::atoi(argv[++i]));
+   }
+   else if (argv[i][0] == '-'){
+    paths.clear();
+    break;
+   }
+   else {
+    AddInput(argv[i], paths);
+   }
+  }
+  if (paths.empty()){
+   std::fprintf(stderr, "usage: %s <message file | directory>... [--threads N] [--ladder] [--tick N]\n", argv[0]);
+   return 2;
+  }
+
+  BatchStats batch = ladder ? ReplayLobsterFiles<LadderOrderBook>(paths, config) : ReplayLobsterFiles<OrderBook>(paths, config);
+  PrintReport(batch);
+  return batch.failed == 0 ? 0 : 1;
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "lobster_batch: %s\n", e.what());
+  return 1;
+ }
+}
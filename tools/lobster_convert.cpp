@@ -0,0 +1,88 @@
+// Converts a LOBSTER message file to the columnar binary format read by lobster_replay (see lobster_columnar.h).
+// Usage: lobster_convert <TICKER_..._message_LEVEL.csv> <out.lobc> [--delta COLUMNS]
+//   --delta COLUMNS  comma-separated columns to store as zigzag delta varints instead of raw arrays:
+//                    timestamp, order_id, size, price, or all. Raw columns are read in place; delta columns are smaller.
+
+#include "../lobster_columnar.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+
+
+namespace {
+
+bool ParseDelta(const char* list, ColumnarOptions& options){
+ static const struct { const char* name; LobsterColumn column; } kColumns[] = {
+  {"timestamp", LobsterColumn::Timestamp}, {"order_id", LobsterColumn::OrderId}, {"size", LobsterColumn::Size}, {"price", LobsterColumn::Price},
+ };
+ std::string names(list);
+ std::size_t start = 0;
+ while (start <= names.size()){
+  std::size_t comma = names.find(',', start);
+  std::string name = names.substr(start, comma == std::string::npos ? std::string::npos : comma - start);
+  bool found = false;
+  for (const auto& entry : kColumns){
+   if (name == entry.name || name == "all"){
+    options.Delta(entry.column);
+    found = true;
+   }
+  }
+  if (!found){
+   return false;
+  }
+  if (comma == std::string::npos){
+   break;
+  }
+  start = comma + 1;
+ }
+ return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ if (argc < 3){
+  std::fprintf(stderr, "usage: %s <message.csv> <out.lobc> [--delta timestamp,order_id,size,price|all]\n", argv[0]);
+  return 2;
+ }
+ ColumnarOptions options;
+ for (int i = 3; i < argc; ++i){
+  if (std::strcmp(argv[i], "--delta") == 0 && i + 1 < argc && ParseDelta(argv[i + 1], options)){
+   ++i;
+  }
+  else {
+   std::fprintf(stderr, "lobster_convert: bad argument %s\n", argv[i]);
+   return 2;
+  }
+ }
+
+ try {
+  auto start = std::chrono::steady_clock::now();
+  LobsterMessageReader reader(argv[1]);
+  LobsterColumnarWriter writer;
+  LobsterEvent event{};
+  while (reader.Next(event)){
+   writer.Add(event);
+  }
+  ColumnarHeader header;
+  std::size_t bytes = writer.Write(argv[2], options, header);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  static const char* kNames[kLobsterColumns] = {"timestamp", "type", "order_id", "size", "price", "direction"};
+  std::printf("events            %zu\n", writer.Events());
+  std::printf("csv bytes         %zu\n", reader.BytesTotal());
+  std::printf("columnar bytes    %zu (%.1f%% of csv)\n", bytes, 100.0 * static_cast<double>(bytes) / static_cast<double>(reader.BytesTotal()));
+  for (std::size_t i = 0; i < kLobsterColumns; ++i){
+   const ColumnarColumn& column = header.columns[i];
+   std::printf("  %-15s %zu bytes, %s\n", kNames[i], static_cast<std::size_t>(column.bytes), column.encoding == ColumnEncoding::Raw ? "raw" : "delta varint");
+  }
+  std::printf("elapsed           %.3f s\n", seconds);
+  return 0;
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "lobster_convert: %s\n", e.what());
+  return 1;
+ }
+}
@@ -0,0 +1,294 @@
+// Replays a LOBSTER message file into an OrderBook and reports event counts and throughput.
+// Usage: lobster_replay <TICKER_..._message_LEVEL.csv | converted .lobc> [--ladder | --ring] [--tick N] [--depth N]
+//                       [--features N [--features-out file]] [--pipeline [--batch N] [--snapshot N]]
+//                       [--validate orderbook.csv [--full-diff]] [--orderbook-out file [--orderbook-levels N]]
+//   The input may be the CSV or its columnar conversion (lobster_convert); the format is detected from the file.
+//   --ladder      use the tick-indexed ladder level backend instead of std::map
+//   --ring        the ladder with ring-buffer queues at each level (RingLevels) instead of linked orders
+//   --tick N      ladder tick size in LOBSTER price units (default 100 = one cent)
+//   --depth N     poll the top N levels per side into a reused OrderBookLevelInfos after every event
+//   --features N  compute microprice, imbalance, depth and VWAP over the top N levels after every event (book_analytics.h)
+//   --features-out file  also write the per-event features as a columnar file
+//   --pipeline    parse, match and publish on three threads (lobster_pipeline.h) and report each stage's utilization
+//   --batch N     records per queue operation in pipeline mode (default 256)
+//   --snapshot N  events between published depth snapshots in pipeline mode (default 1024, 0: final only)
+//   --validate orderbook.csv  check the book against each row of the matching LOBSTER orderbook file by hash, and
+//                 diff the levels only where they disagree (lobster_orderbook.h)
+//   --full-diff   with --validate, diff the levels after every event instead (for comparison)
+//   --orderbook-out file  write the book after every event as a LOBSTER orderbook file
+//   --orderbook-levels N  levels per side written by --orderbook-out (default 10)
+
+#include "../book_analytics.h"
+#include "../lobster_orderbook.h"
+#include "../lobster_pipeline.h"
+#include "../lobster_replay.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <thread>
+
+
+namespace {
+
+// Replay with a depth poll after every event, as a strategy reading the book would
+template <typename Reader, typename Book>
+ReplayStats ReplayWithDepth(Reader& reader, Book& book, std::size_t levels, std::uint64_t& checksum){
+ LobsterReplay<Book> replay(book);
+ OrderBookLevelInfos depth;
+ LobsterEvent event{};
+ while (reader.Next(event)){
+  replay.Apply(event);
+  book.GetDepth(levels, depth);
+  checksum += depth.getBids().size() + depth.getAsks().size(); // Keep the poll observable
+ }
+ return replay.Stats();
+}
+
+// Replay with the top-N features brought up to date after every event and appended to columns
+template <typename Reader, typename Book>
+ReplayStats ReplayWithFeatures(Reader& reader, Book& book, BookAnalytics<Book>& analytics, FeatureColumns& columns){
+ LobsterReplay<Book> replay(book);
+ LobsterEvent event{};
+ while (reader.Next(event)){
+  replay.Apply(event);
+  analytics.Update();
+  columns.Append(event.timestamp_ns, analytics.Features());
+ }
+ return replay.Stats();
+}
+
+// Replay writing the book after every event as an orderbook row
+template <typename Reader, typename Book>
+ReplayStats ReplayWithOrderbook(Reader& reader, Book& book, LobsterBookWriter& writer){
+ LobsterReplay<Book> replay(book);
+ LobsterEvent event{};
+ while (reader.Next(event)){
+  replay.Apply(event);
+  writer.Add(book);
+ }
+ return replay.Stats();
+}
+
+// --validate, --full-diff, --orderbook-out and --orderbook-levels
+struct OrderbookOptions{
+ const char* validate{nullptr};
+ bool full_diff{false};
+ const char* out{nullptr};
+ std::size_t levels{10};
+};
+
+// Orderbook file checked against (rows and validator) or written (writer) after every event, if any
+template <typename Book>
+struct OrderbookFile{
+ LobsterBookReader* rows{nullptr};
+ LobsterValidator<Book>* validator{nullptr};
+ LobsterBookWriter* writer{nullptr};
+};
+
+template <typename Reader, typename Book>
+ReplayStats ReplayReader(Reader& reader, Book& book, std::size_t depth_levels, std::uint64_t& depth_checksum, BookAnalytics<Book>* analytics,
+ FeatureColumns& columns, const OrderbookFile<Book>& orderbook){
+ if (orderbook.validator != nullptr){
+  return ValidateEvents(reader, book, *orderbook.rows, *orderbook.validator);
+ }
+ if (orderbook.writer != nullptr){
+  return ReplayWithOrderbook(reader, book, *orderbook.writer);
+ }
+ if (analytics != nullptr){
+  return ReplayWithFeatures(reader, book, *analytics, columns);
+ }
+ if (depth_levels != 0){
+  return ReplayWithDepth(reader, book, depth_levels, depth_checksum);
+ }
+ return ReplayEvents(reader, book);
+}
+
+void PrintStage(const char* name, const PipelineStageStats& stage, double wall_seconds){
+ std::printf("  %-8s %12llu %9llu %7.1f%% %9.1f%% %9.1f%% %8.3f\n", name, static_cast<unsigned long long>(stage.items),
+  static_cast<unsigned long long>(stage.batches), stage.Utilization(wall_seconds) * 100, stage.starved_seconds / wall_seconds * 100,
+  stage.blocked_seconds / wall_seconds * 100, stage.cpu_seconds);
+}
+
+template <typename Book>
+int RunPipeline(const char* path, Book& book, const PipelineConfig& config){
+ PipelineSummary summary;
+ PipelineStats stats = ReplayLobsterPipelined(path, book, summary, config);
+ std::printf("events            %llu\n", static_cast<unsigned long long>(stats.replay.events));
+ std::printf("malformed rows    %llu\n", static_cast<unsigned long long>(stats.replay.malformed_rows));
+ std::printf("unknown orders    %llu\n", static_cast<unsigned long long>(stats.replay.unknown_orders));
+ std::printf("rejected orders   %llu\n", static_cast<unsigned long long>(stats.replay.rejected_orders));
+ std::printf("trades published  %llu (%llu shares, vwap %.0f)\n", static_cast<unsigned long long>(summary.trades),
+  static_cast<unsigned long long>(summary.traded_quantity), summary.Vwap());
+ std::printf("snapshots         %llu (last at event %llu: %u bid / %u ask levels)\n", static_cast<unsigned long long>(summary.snapshots),
+  static_cast<unsigned long long>(summary.last_snapshot.events), summary.last_snapshot.bid_levels, summary.last_snapshot.ask_levels);
+ std::printf("resting orders    %zu\n", book.Size());
+ std::printf("elapsed           %.3f s\n", stats.wall_seconds);
+ std::printf("throughput        %.1f M events/s\n", stats.replay.events / stats.wall_seconds / 1e6);
+ std::printf("stages (%u hardware threads)\n", std::thread::hardware_concurrency());
+ std::printf("  %-8s %12s %9s %8s %10s %10s %8s\n", "stage", "items", "batches", "busy", "starved", "blocked", "cpu s");
+ PrintStage("parse", stats.parse, stats.wall_seconds);
+ PrintStage("match", stats.match, stats.wall_seconds);
+ PrintStage("publish", stats.publish, stats.wall_seconds);
+ return 0;
+}
+
+template <typename Book>
+int Run(const char* path, Book& book, std::size_t depth_levels, std::size_t feature_levels, const char* features_out,
+ const OrderbookOptions& orderbook_options){
+ std::unique_ptr<BookAnalytics<Book>> analytics;
+ FeatureColumns columns;
+ if (feature_levels != 0){
+  analytics = std::make_unique<BookAnalytics<Book>>(book, feature_levels);
+  columns.Reserve(1 << 20);
+ }
+ std::unique_ptr<LobsterBookReader> rows;
+ std::unique_ptr<LobsterValidator<Book>> validator;
+ std::unique_ptr<LobsterBookWriter> writer;
+ if (orderbook_options.validate != nullptr){
+  rows = std::make_unique<LobsterBookReader>(orderbook_options.validate);
+  validator = std::make_unique<LobsterValidator<Book>>(book, 8, orderbook_options.full_diff);
+ }
+ else if (orderbook_options.out != nullptr){
+  writer = std::make_unique<LobsterBookWriter>(orderbook_options.out, orderbook_options.levels);
+ }
+ OrderbookFile<Book> orderbook{rows.get(), validator.get(), writer.get()};
+ auto start = std::chrono::steady_clock::now();
+ std::uint64_t depth_checksum = 0;
+ ReplayStats stats;
+ if (IsLobsterColumnar(path)){
+  LobsterColumnarReader reader(path);
+  stats = ReplayReader(reader, book, depth_levels, depth_checksum, analytics.get(), columns, orderbook);
+  stats.malformed_rows = reader.Malformed();
+ }
+ else {
+  LobsterMessageReader reader(path);
+  stats = ReplayReader(reader, book, depth_levels, depth_checksum, analytics.get(), columns, orderbook);
+  stats.malformed_rows = reader.Malformed();
+ }
+ double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+ static const char* kNames[8] = {"", "new", "partial cancel", "delete", "visible exec", "hidden exec", "cross", "halt"};
+ std::printf("events            %llu\n", static_cast<unsigned long long>(stats.events));
+ for (int type = 1; type < 8; ++type){
+  std::printf("  %-15s %llu\n", kNames[type], static_cast<unsigned long long>(stats.by_type[type]));
+ }
+ std::printf("malformed rows    %llu\n", static_cast<unsigned long long>(stats.malformed_rows));
+ std::printf("unknown orders    %llu\n", static_cast<unsigned long long>(stats.unknown_orders));
+ std::printf("rejected orders   %llu\n", static_cast<unsigned long long>(stats.rejected_orders));
+ std::printf("executed qty      %llu (hidden/cross %llu)\n", static_cast<unsigned long long>(stats.executed_quantity), static_cast<unsigned long long>(stats.hidden_quantity));
+ std::printf("book trades       %llu\n", static_cast<unsigned long long>(stats.book_trades));
+ std::printf("resting orders    %zu\n", book.Size());
+ std::printf("max depth         %zu bid / %zu ask levels\n", stats.max_bid_levels, stats.max_ask_levels);
+ if (depth_levels != 0){
+  std::printf("depth polls       %llu x top %zu (level checksum %llu)\n", static_cast<unsigned long long>(stats.events), depth_levels,
+   static_cast<unsigned long long>(depth_checksum));
+ }
+ if (analytics != nullptr){
+  const BookFeatures& last = analytics->Features();
+  std::printf("features          %zu rows x top %zu, recomputed %llu (%llu side reads)\n", columns.Rows(), feature_levels,
+   static_cast<unsigned long long>(analytics->Recomputes()), static_cast<unsigned long long>(analytics->Reads()));
+  std::printf("  last            microprice %.1f, imbalance %.3f, vwap %.1f / %.1f\n", last.microprice, last.imbalance, last.bid_vwap, last.ask_vwap);
+ }
+ if (validator != nullptr){
+  const ValidationStats& checked = validator->Stats();
+  std::printf("validated         %llu events x top %zu (%s), %llu side re-reads\n", static_cast<unsigned long long>(checked.events), checked.levels,
+   orderbook_options.full_diff ? "full diff" : "hash", static_cast<unsigned long long>(checked.top_reads));
+  std::printf("mismatched        %llu events (first: %llu)\n", static_cast<unsigned long long>(checked.mismatched_events),
+   static_cast<unsigned long long>(checked.first_mismatch));
+  for (const DepthMismatch& mismatch : validator->Mismatches()){
+   std::printf("  event %-9llu %s level %-3zu book %d x %u, file %d x %u\n", static_cast<unsigned long long>(mismatch.event),
+    mismatch.side == OrderSide::Buy ? "bid" : "ask", mismatch.level + 1, mismatch.book.price, mismatch.book.quantity, mismatch.file.price,
+    mismatch.file.quantity);
+  }
+ }
+ std::printf("elapsed           %.3f s\n", seconds);
+ std::printf("throughput        %.1f M events/s (%.0f M events/min)\n", stats.events / seconds / 1e6, stats.events / seconds * 60 / 1e6);
+ if (features_out != nullptr && analytics != nullptr){
+  std::size_t bytes = columns.Write(features_out);
+  std::printf("features written  %s (%zu bytes)\n", features_out, bytes);
+ }
+ if (writer != nullptr){
+  std::size_t written = writer->Close();
+  std::printf("orderbook written %s (%zu rows x top %zu)\n", orderbook_options.out, written, orderbook_options.levels);
+ }
+ return validator != nullptr && validator->Stats().mismatched_events != 0 ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ if (argc < 2){
+  std::fprintf(stderr, "usage: %s <message.csv | message.lobc> [--ladder | --ring] [--tick N] [--depth N] [--features N [--features-out file]] [--pipeline [--batch N] [--snapshot N]] [--validate orderbook.csv [--full-diff]] [--orderbook-out file [--orderbook-levels N]]\n", argv[0]);
+  return 2;
+ }
+ bool ladder = false;
+ bool ring = false;
+ LevelConfig config{100, 4096};
+ std::size_t depth_levels = 0;
+ std::size_t feature_levels = 0;
+ const char* features_out = nullptr;
+ bool pipeline = false;
+ PipelineConfig pipeline_config;
+ OrderbookOptions orderbook_options;
+ for (int i = 2; i < argc; ++i){
+  if (std::strcmp(argv[i], "--ladder") == 0){
+   ladder = true;
+  }
+  else if (std::strcmp(argv[i], "--ring") == 0){
+   ring = true;
+  }
+  else if (std::strcmp(argv[i], "--tick") == 0 && i + 1 < argc){
+   config.tick_size = static_cast<Price>(std::atoi(argv[++i]));
+  }
+  else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc){
+   depth_levels = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--features") == 0 && i + 1 < argc){
+   feature_levels = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--features-out") == 0 && i + 1 < argc){
+   features_out = argv[++i];
+  }
+  else if (std::strcmp(argv[i], "--pipeline") == 0){
+   pipeline = true;
+  }
+  else if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc){
+   pipeline_config.batch = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--snapshot") == 0 && i + 1 < argc){
+   pipeline_config.snapshot_interval = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--validate") == 0 && i + 1 < argc){
+   orderbook_options.validate = argv[++i];
+  }
+  else if (std::strcmp(argv[i], "--full-diff") == 0){
+   orderbook_options.full_diff = true;
+  }
+  else if (std::strcmp(argv[i], "--orderbook-out") == 0 && i + 1 < argc){
+   orderbook_options.out = argv[++i];
+  }
+  else if (std::strcmp(argv[i], "--orderbook-levels") == 0 && i + 1 < argc){
+   orderbook_options.levels = std::strtoull(argv[++i], nullptr, 10);
+  }
+ }
+
+ try {
+  if (ring){
+   RingOrderBook book(config, 1 << 20);
+   return pipeline ? RunPipeline(argv[1], book, pipeline_config) : Run(argv[1], book, depth_levels, feature_levels, features_out, orderbook_options);
+  }
+  if (ladder){
+   LadderOrderBook book(config, 1 << 20);
+   return pipeline ? RunPipeline(argv[1], book, pipeline_config) : Run(argv[1], book, depth_levels, feature_levels, features_out, orderbook_options);
+  }
+  OrderBook book(config, 1 << 20);
+  return pipeline ? RunPipeline(argv[1], book, pipeline_config) : Run(argv[1], book, depth_levels, feature_levels, features_out, orderbook_options);
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "lobster_replay: %s\n", e.what());
+  return 1;
+ }
+}
@@ -0,0 +1,89 @@
+// Runs the shared-memory order gateway (gateway.h) until SIGINT or SIGTERM, then prints its counters.
+// Usage: order_gateway [--name /shm_name] [--clients N] [--map] [--tick N] [--reference P --band N]
+//   --name     shared memory object clients attach to (default /orderbook_gateway)
+//   --clients  client slots (default 16, at most 256)
+//   --map      use the std::map level backend instead of the tick-indexed ladder
+//   --tick     tick size; prices off the grid are rejected (default 1)
+//   --reference, --band
+//              limit prices must lie within band of reference (default: no band; the ladder still refuses prices more
+//              than 2^20 ticks from the resting levels)
+
+#include "../gateway.h"
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+
+
+namespace {
+
+std::atomic<bool> stop_requested{false};
+
+void OnSignal(int){ stop_requested.store(true, std::memory_order_relaxed); }
+
+template <typename Book>
+void Serve(const GatewayConfig& config){
+ Gateway<Book> gateway(config);
+ std::printf("gateway %s: %zu client slots, %zu-record rings\n", config.name.c_str(), gateway.Clients(), kGatewayRingCapacity);
+ std::fflush(stdout);
+ gateway.Run(stop_requested);
+ const GatewayStats& stats = gateway.Stats();
+ std::printf("requests          %llu\n", static_cast<unsigned long long>(stats.requests));
+ std::printf("rejects           %llu\n", static_cast<unsigned long long>(stats.rejects));
+ std::printf("fills             %llu\n", static_cast<unsigned long long>(stats.fills));
+ std::printf("response stalls   %llu\n", static_cast<unsigned long long>(stats.response_stalls));
+ std::printf("disconnects       %llu (%llu resting orders cancelled)\n", static_cast<unsigned long long>(stats.disconnects),
+  static_cast<unsigned long long>(stats.orphans_cancelled));
+ std::printf("resting orders    %zu\n", gateway.GetBook().Size());
+}
+
+} // namespace
+
+int main(int argc, char** argv){
+ GatewayConfig config;
+ config.levels = LevelConfig{1, 4096};
+ config.capacity_hint = 1 << 20;
+ bool map = false;
+ for (int i = 1; i < argc; ++i){
+  bool has_value = i + 1 < argc;
+  if (std::strcmp(argv[i], "--name") == 0 && has_value){
+   config.name = argv[++i];
+  }
+  else if (std::strcmp(argv[i], "--clients") == 0 && has_value){
+   config.clients = std::strtoull(argv[++i], nullptr, 10);
+  }
+  else if (std::strcmp(argv[i], "--map") == 0){
+   map = true;
+  }
+  else if (std::strcmp(argv[i], "--tick") == 0 && has_value){
+   config.levels.tick_size = static_cast<Price>(std::atoi(argv[++i]));
+  }
+  else if (std::strcmp(argv[i], "--reference") == 0 && has_value){
+   config.reference_price = static_cast<Price>(std::atoi(argv[++i]));
+  }
+  else if (std::strcmp(argv[i], "--band") == 0 && has_value){
+   config.price_band = static_cast<Price>(std::atoi(argv[++i]));
+  }
+  else {
+   std::fprintf(stderr, "usage: %s [--name /shm_name] [--clients N] [--map] [--tick N] [--reference P --band N]\n", argv[0]);
+   return 2;
+  }
+ }
+ std::signal(SIGINT, OnSignal);
+ std::signal(SIGTERM, OnSignal);
+ try {
+  if (map){
+   Serve<OrderBook>(config);
+  }
+  else {
+   Serve<LadderOrderBook>(config);
+  }
+  return 0;
+ }
+ catch (const std::exception& e){
+  std::fprintf(stderr, "order_gateway: %s\n", e.what());
+  return 1;
+ }
+}
@@ -0,0 +1,50 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include "lockfree_queue.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+
+// Latest-value channel between one writer thread and one reader thread. Neither side ever waits.
+// Of three buffers, the writer owns one, the reader owns one and the third is the hand-off slot. Publish swaps the
+// writer's buffer into the hand-off slot, and Update swaps the hand-off slot to the reader if it holds something newer.
+// The reader always sees a complete value, and the writer may publish faster than the reader looks; intermediate
+// values are simply skipped. After Publish the writer gets back an older buffer, so it must rewrite every field it uses.
+template <typename T>
+class TripleBuffer{
+ public:
+  // Writer thread only
+  T& WriteBuffer(){ return buffers_[write_].value; }
+
+  void Publish(){
+   write_ = middle_.exchange(static_cast<std::uint8_t>(write_ | kFresh), std::memory_order_acq_rel) & kIndexMask;
+  }
+
+  // Reader thread only: take the newest published value if there is one; returns false if nothing new
+  bool Update(){
+   if ((middle_.load(std::memory_order_relaxed) & kFresh) == 0){
+    return false;
+   }
+   read_ = middle_.exchange(read_, std::memory_order_acq_rel) & kIndexMask;
+   return true;
+  }
+
+  const T& ReadBuffer() const { return buffers_[read_].value; }
+
+ private:
+  static constexpr std::uint8_t kIndexMask = 3;
+  static constexpr std::uint8_t kFresh = 4; // Hand-off slot holds a value the reader has not taken
+
+  struct alignas(kCacheLineSize) Slot{
+   T value{};
+  };
+
+  std::array<Slot, 3> buffers_{};
+  alignas(kCacheLineSize) std::atomic<std::uint8_t> middle_{1};
+  alignas(kCacheLineSize) std::uint8_t write_{0}; // Writer only
+  alignas(kCacheLineSize) std::uint8_t read_{2};  // Reader only
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -0,0 +1,73 @@
+#ifndef TSC_CLOCK_H
+#define TSC_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+// Cycle-accurate timestamps for latency measurement.
+// x86: invariant TSC (rdtsc/rdtscp with lfence so the measured code cannot drift outside the timed region).
+// aarch64: the virtual counter cntvct_el0. Elsewhere: steady_clock nanoseconds.
+// Ticks are converted to nanoseconds with a ratio calibrated once against steady_clock.
+struct TscClock{
+ // Timestamp before the measured code
+ static std::uint64_t Start(){
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_lfence();
+  std::uint64_t ticks = __rdtsc();
+  _mm_lfence();
+  return ticks;
+#else
+  return Now();
+#endif
+ }
+
+ // Timestamp after the measured code (waits for it to retire)
+ static std::uint64_t Stop(){
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned aux;
+  std::uint64_t ticks = __rdtscp(&aux);
+  _mm_lfence();
+  return ticks;
+#else
+  return Now();
+#endif
+ }
+
+ // Unfenced timestamp, cheapest option when ordering does not matter
+ static std::uint64_t Now(){
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  std::uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+ }
+
+ static double TicksPerNs(){
+  static const double ratio = Calibrate();
+  return ratio;
+ }
+
+ static double ToNs(std::uint64_t ticks) { return static_cast<double>(ticks) / TicksPerNs(); }
+
+ private:
+  static double Calibrate(){
+   auto wall_start = std::chrono::steady_clock::now();
+   std::uint64_t start = Now();
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   std::uint64_t end = Now();
+   double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - wall_start).count();
+   return ns > 0 ? static_cast<double>(end - start) / ns : 1.0;
+  }
+};
+
+#endif // TSC_CLOCK_H
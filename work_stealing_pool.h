@@ -0,0 +1,180 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include "lockfree_queue.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Thread pool for batches of independent, coarse tasks (a whole file replay each).
+// Run(count, fn) deals task indices 0..count-1 round-robin onto one deque per worker. A worker takes the front of its
+// own deque; once that is empty it steals the front of the deque whose front has the lowest index. Give the tasks in
+// priority order (largest first) and every idle worker picks up the largest task left, wherever it was dealt, so a
+// long task never starts last behind a queue of short ones.
+// Tasks last milliseconds to minutes, so each deque is guarded by its own mutex: a take is one uncontended lock.
+
+
+class WorkStealingPool{
+ public:
+  // threads == 0: one worker per hardware thread
+  explicit WorkStealingPool(std::size_t threads = 0){
+   if (threads == 0){
+    threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+   }
+   for (std::size_t i = 0; i < threads; ++i){
+    queues_.push_back(std::make_unique<WorkerQueue>());
+   }
+   for (std::size_t i = 0; i < threads; ++i){
+    workers_.emplace_back([this, i]{ Work(i); });
+   }
+  }
+
+  ~WorkStealingPool(){
+   {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+   }
+   wake_.notify_all();
+   for (auto& worker : workers_){
+    worker.join();
+   }
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  std::size_t Threads() const { return workers_.size(); }
+
+  // Tasks taken from another worker's deque, over the pool's lifetime
+  std::uint64_t Steals() const { return steals_.load(std::memory_order_relaxed); }
+
+  // Call fn(task, worker) once for every task in [0, count) and return when all have finished. One batch at a time.
+  // If tasks throw, the rest still run and the first exception is rethrown here.
+  template <typename Fn>
+  void Run(std::size_t count, Fn&& fn){
+   if (count == 0){
+    return;
+   }
+   std::unique_lock<std::mutex> lock(mutex_);
+   // A worker late to wake from the previous batch may already be taking: set task_ before any task is visible
+   task_ = [&fn](std::size_t task, std::size_t worker){ fn(task, worker); };
+   finished_ = 0;
+   error_ = nullptr;
+   for (std::size_t task = 0; task < count; ++task){
+    WorkerQueue& queue = *queues_[task % queues_.size()];
+    std::lock_guard<std::mutex> queue_lock(queue.mutex);
+    queue.tasks.push_back(task);
+   }
+   ++generation_;
+   wake_.notify_all();
+   // Workers still active may be stealing; task_ must outlive them
+   done_.wait(lock, [&]{ return finished_ == count && active_ == 0; });
+   task_ = nullptr;
+   if (error_){
+    std::rethrow_exception(error_);
+   }
+  }
+
+ private:
+  struct alignas(kCacheLineSize) WorkerQueue{
+   std::mutex mutex;
+   std::deque<std::size_t> tasks;
+  };
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  std::function<void(std::size_t, std::size_t)> task_;
+  std::uint64_t generation_{0};
+  std::size_t finished_{0};
+  std::size_t active_{0};
+  bool stopping_{false};
+  std::exception_ptr error_;
+  std::atomic<std::uint64_t> steals_{0};
+
+  void Work(std::size_t index){
+   std::uint64_t seen = 0;
+   for (;;){
+    {
+     std::unique_lock<std::mutex> lock(mutex_);
+     wake_.wait(lock, [&]{ return stopping_ || generation_ != seen; });
+     if (stopping_){
+      return;
+     }
+     seen = generation_;
+     ++active_;
+    }
+    std::size_t task = 0;
+    while (Take(index, task)){
+     std::exception_ptr error;
+     try {
+      task_(task, index);
+     }
+     catch (...){
+      error = std::current_exception();
+     }
+     std::lock_guard<std::mutex> lock(mutex_);
+     ++finished_;
+     if (error && !error_){
+      error_ = error;
+     }
+    }
+    {
+     std::lock_guard<std::mutex> lock(mutex_);
+     --active_;
+    }
+    done_.notify_all();
+   }
+  }
+
+  // Front of the own deque, else the lowest-index task at the front of any other deque. Tasks never create tasks, so
+  // when every deque is empty the batch has nothing left for this worker.
+  bool Take(std::size_t index, std::size_t& task){
+   {
+    WorkerQueue& own = *queues_[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()){
+     task = own.tasks.front();
+     own.tasks.pop_front();
+     return true;
+    }
+   }
+   for (;;){
+    std::size_t victim = queues_.size();
+    std::size_t best = 0;
+    for (std::size_t i = 0; i < queues_.size(); ++i){
+     WorkerQueue& queue = *queues_[i];
+     std::lock_guard<std::mutex> lock(queue.mutex);
+     if (!queue.tasks.empty() && (victim == queues_.size() || queue.tasks.front() < best)){
+      victim = i;
+      best = queue.tasks.front();
+     }
+    }
+    if (victim == queues_.size()){
+     return false;
+    }
+    WorkerQueue& queue = *queues_[victim];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty() && queue.tasks.front() == best){   // Otherwise its owner or another thief got there first
+     task = best;
+     queue.tasks.pop_front();
+     steals_.fetch_add(1, std::memory_order_relaxed);
+     return true;
+    }
+   }
+  }
+};
+
+#endif // WORK_STEALING_POOL_H